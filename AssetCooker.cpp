@@ -0,0 +1,404 @@
+// offline asset cooker, no GL needed: walks a source tree and writes every OBJ as a cooked
+// mesh (welded, LODs, vertex cache and fetch order, quantized, see CookedAssets.h) and
+// every image as an RGBA8 texture with mips, in parallel. A manifest in the output
+// directory keeps the content hash of each output's inputs, so unchanged assets are
+// skipped on the next run.
+//   AssetCooker <source dir> <output dir> [-threads N] [-force]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <sys/stat.h>
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <direct.h>
+#else
+#include <dirent.h>
+#endif
+#include "ObjMesh.h"
+#include "ImageLoader.h"
+#include "CookedAssets.h"
+#include "ParallelFor.h"
+
+const char* manifestName = "cook.manifest";
+
+struct Asset
+{
+	std::string source;		// relative to the source directory, '/' separated
+	std::string output;		// relative to the output directory
+	bool mesh;
+
+	// filled in by Cook
+	enum { failed, upToDate, cooked } status;
+	std::vector<std::pair<std::string, unsigned long long> > inputs;	// the source first, then what it references
+	unsigned long long key;
+	size_t inputBytes, outputBytes;
+	int triangles, vertices;
+	float cacheMissRatio[2];
+	double milliseconds;
+	std::string error;
+};
+
+struct ManifestEntry
+{
+	unsigned long long key;
+	std::string inputs;
+};
+
+std::string Lowercase(std::string s)
+{
+	std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+	return s;
+}
+
+std::string Extension(const std::string& path)
+{
+	std::string::size_type dot = path.rfind('.'), slash = path.rfind('/');
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return "";
+	return Lowercase(path.substr(dot + 1));
+}
+
+std::string Directory(const std::string& path)
+{
+	std::string::size_type slash = path.rfind('/');
+	return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+}
+
+bool FileExists(const std::string& path)
+{
+	struct stat info;
+	return stat(path.c_str(), &info) == 0;
+}
+
+void MakeDirectories(const std::string& path)
+{
+	for (std::string::size_type slash = path.find('/', 1); ; slash = path.find('/', slash + 1))
+	{
+		std::string directory = path.substr(0, slash);
+#if defined(_WIN32)
+		_mkdir(directory.c_str());
+#else
+		mkdir(directory.c_str(), 0755);
+#endif
+		if (slash == std::string::npos) break;
+	}
+}
+
+// files under root/relative, recursively, as paths relative to root
+void ListFiles(const std::string& root, const std::string& relative, std::vector<std::string>& files)
+{
+	std::string directory = relative.empty() ? root : root + "/" + relative;
+	std::vector<std::string> names, subdirectories;
+#if defined(_WIN32)
+	WIN32_FIND_DATAA entry;
+	HANDLE find = FindFirstFileA((directory + "/*").c_str(), &entry);
+	if (find == INVALID_HANDLE_VALUE) return;
+	do
+	{
+		std::string name = entry.cFileName;
+		if (name == "." || name == "..") continue;
+		if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) subdirectories.push_back(name);
+		else names.push_back(name);
+	} while (FindNextFileA(find, &entry));
+	FindClose(find);
+#else
+	DIR* dir = opendir(directory.c_str());
+	if (!dir) return;
+	while (dirent* entry = readdir(dir))
+	{
+		std::string name = entry->d_name;
+		if (name == "." || name == "..") continue;
+		struct stat info;
+		if (stat((directory + "/" + name).c_str(), &info) != 0) continue;
+		if (S_ISDIR(info.st_mode)) subdirectories.push_back(name);
+		else names.push_back(name);
+	}
+	closedir(dir);
+#endif
+	std::string prefix = relative.empty() ? "" : relative + "/";
+	for (unsigned int i = 0; i < names.size(); i++) files.push_back(prefix + names[i]);
+	for (unsigned int i = 0; i < subdirectories.size(); i++) ListFiles(root, prefix + subdirectories[i], files);
+}
+
+// the material libraries an OBJ names, relative to the source directory
+std::vector<std::string> MaterialLibraries(const std::string& source, const std::vector<char>& text)
+{
+	std::vector<std::string> libraries;
+	std::istringstream lines(std::string(text.begin(), text.end()));
+	std::string line;
+	while (std::getline(lines, line))
+	{
+		if (line.compare(0, 7, "mtllib ") != 0) continue;
+		std::istringstream names(line.substr(7));
+		std::string name;
+		while (names >> name) libraries.push_back(Directory(source) + name);
+	}
+	return libraries;
+}
+
+// output\tkey\tinput:hash\t... per line
+std::map<std::string, ManifestEntry> LoadManifest(const std::string& filename)
+{
+	std::map<std::string, ManifestEntry> manifest;
+	std::ifstream file(filename.c_str());
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (line.empty() || line[0] == '#') continue;
+		std::string::size_type first = line.find('\t'), second = line.find('\t', first + 1);
+		if (first == std::string::npos) continue;
+		ManifestEntry entry;
+		entry.key = strtoull(line.substr(first + 1, second - first - 1).c_str(), 0, 16);
+		entry.inputs = second == std::string::npos ? "" : line.substr(second + 1);
+		manifest[line.substr(0, first)] = entry;
+	}
+	return manifest;
+}
+
+bool WriteManifest(const std::string& filename, const std::map<std::string, ManifestEntry>& manifest)
+{
+	std::string temporary = filename + ".tmp";
+	FILE* file = fopen(temporary.c_str(), "w");
+	if (!file)
+	{
+		printf("cannot write %s\n", temporary.c_str());
+		return false;
+	}
+	fprintf(file, "# output, content hash of the inputs and cooker version, then each input with its hash\n");
+	for (std::map<std::string, ManifestEntry>::const_iterator i = manifest.begin(); i != manifest.end(); i++)
+		fprintf(file, "%s\t%016llx\t%s\n", i->first.c_str(), i->second.key, i->second.inputs.c_str());
+	fclose(file);
+	remove(filename.c_str());
+	return rename(temporary.c_str(), filename.c_str()) == 0;
+}
+
+void Cook(Asset& asset, const std::string& sourceRoot, const std::string& outputRoot, const std::map<std::string, ManifestEntry>& manifest, bool force)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	asset.status = Asset::failed;
+	asset.inputBytes = asset.outputBytes = 0;
+	asset.triangles = asset.vertices = 0;
+	asset.cacheMissRatio[0] = asset.cacheMissRatio[1] = 0.0f;
+
+	// the key covers the contents of every input and the format version
+	std::vector<char> data;
+	if (!ReadFile(sourceRoot + "/" + asset.source, data))
+	{
+		asset.error = "cannot read";
+		return;
+	}
+	unsigned int version = asset.mesh ? CookedMesh::version : CookedTexture::version;
+	asset.key = HashBytes(&version, sizeof(version));
+	asset.inputs.push_back(std::make_pair(asset.source, HashBytes(data.empty() ? 0 : &data[0], data.size())));
+	asset.inputBytes += data.size();
+	if (asset.mesh)
+	{
+		std::vector<std::string> libraries = MaterialLibraries(asset.source, data);
+		for (unsigned int i = 0; i < libraries.size(); i++)
+		{
+			std::vector<char> library;
+			bool found = ReadFile(sourceRoot + "/" + libraries[i], library);
+			asset.inputs.push_back(std::make_pair(libraries[i], found ? HashBytes(library.empty() ? 0 : &library[0], library.size()) : 0ULL));
+		}
+	}
+	for (unsigned int i = 0; i < asset.inputs.size(); i++)
+	{
+		asset.key = HashBytes(asset.inputs[i].first.c_str(), asset.inputs[i].first.size(), asset.key);
+		asset.key = HashBytes(&asset.inputs[i].second, sizeof(asset.inputs[i].second), asset.key);
+	}
+
+	std::string output = outputRoot + "/" + asset.output;
+	std::map<std::string, ManifestEntry>::const_iterator previous = manifest.find(asset.output);
+	if (!force && previous != manifest.end() && previous->second.key == asset.key && FileExists(output))
+	{
+		asset.status = Asset::upToDate;
+		asset.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return;
+	}
+
+	MakeDirectories(Directory(output));
+	if (asset.mesh)
+	{
+		ObjMesh obj((sourceRoot + "/" + asset.source).c_str());
+		IndexedMesh* indexed = obj.BuildIndexedMesh();
+		if (!indexed)
+		{
+			asset.error = "no triangles";
+			return;
+		}
+		CookedMesh* cooked = CookedMesh::Cook(*indexed);
+		asset.triangles = obj.GetTriangleCount();
+		asset.vertices = indexed->GetVertexCount();
+		asset.cacheMissRatio[0] = cooked->cacheMissRatio[0];
+		asset.cacheMissRatio[1] = cooked->cacheMissRatio[1];
+		asset.outputBytes = cooked->GetSize();
+		bool written = cooked->Write(output);
+		delete cooked;
+		delete indexed;
+		if (!written)
+		{
+			asset.error = "cannot write";
+			return;
+		}
+	}
+	else
+	{
+		int width, height, components;
+		unsigned char* pixels = DecodeImage(sourceRoot + "/" + asset.source, width, height, components);
+		CookedTexture* cooked = CookedTexture::Cook(pixels, width, height, components);
+		if (pixels) FreeDecodedImage(pixels);
+		if (!cooked)
+		{
+			asset.error = "cannot decode";
+			return;
+		}
+		asset.vertices = width * height;
+		asset.outputBytes = cooked->GetSize();
+		bool written = cooked->Write(output);
+		delete cooked;
+		if (!written)
+		{
+			asset.error = "cannot write";
+			return;
+		}
+	}
+	asset.status = Asset::cooked;
+	asset.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+	std::string sourceRoot, outputRoot;
+	int threads = 0;
+	bool force = false;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-threads" && i + 1 < argc) threads = atoi(argv[++i]);
+		else if (arg == "-force") force = true;
+		else if (arg[0] != '-' && sourceRoot.empty()) sourceRoot = arg;
+		else if (arg[0] != '-' && outputRoot.empty()) outputRoot = arg;
+		else printf("unknown option %s\n", argv[i]);
+	}
+	if (sourceRoot.empty() || outputRoot.empty())
+	{
+		printf("usage: AssetCooker <source dir> <output dir> [-threads N] [-force]\n");
+		return 1;
+	}
+	std::replace(sourceRoot.begin(), sourceRoot.end(), '\\', '/');
+	std::replace(outputRoot.begin(), outputRoot.end(), '\\', '/');
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<std::string> files;
+	ListFiles(sourceRoot, "", files);
+	std::sort(files.begin(), files.end());
+
+	bool decoder = HasImageDecoder();
+	int skippedImages = 0;
+	std::vector<Asset> assets;
+	for (unsigned int i = 0; i < files.size(); i++)
+	{
+		std::string extension = Extension(files[i]);
+		bool mesh = extension == "obj";
+		bool image = extension == "png" || extension == "jpg" || extension == "jpeg" || extension == "bmp" || extension == "tga";
+		if (!mesh && !image) continue;
+		if (image && !decoder)
+		{
+			skippedImages++;
+			continue;
+		}
+		Asset asset;
+		asset.source = files[i];
+		asset.output = files[i] + (mesh ? ".mesh" : ".tex");
+		asset.mesh = mesh;
+		assets.push_back(asset);
+	}
+	if (skippedImages) printf("no image decoder in this build: %d images skipped\n", skippedImages);
+
+	MakeDirectories(outputRoot);
+	std::string manifestFile = outputRoot + "/" + manifestName;
+	std::map<std::string, ManifestEntry> manifest = LoadManifest(manifestFile);
+
+	// one asset per job, the slowest (largest) handed out first
+	std::vector<int> order(assets.size());
+	std::vector<long long> sizes(assets.size(), 0);
+	for (unsigned int i = 0; i < assets.size(); i++)
+	{
+		order[i] = i;
+		struct stat info;
+		if (stat((sourceRoot + "/" + assets[i].source).c_str(), &info) == 0) sizes[i] = info.st_size;
+	}
+	std::sort(order.begin(), order.end(), [&](int a, int b) { return sizes[a] > sizes[b]; });
+	ThreadPool pool(threads);
+	pool.ParallelFor((int)assets.size(), [&](int begin, int end)
+	{
+		for (int i = begin; i < end; i++) Cook(assets[order[i]], sourceRoot, outputRoot, manifest, force);
+	}, 1);
+
+	// outputs of removed sources go with their manifest entries
+	std::map<std::string, ManifestEntry> updated;
+	int cookedCount = 0, upToDateCount = 0, failedCount = 0;
+	size_t inputBytes = 0, outputBytes = 0;
+	long long triangles = 0;
+	double cookMilliseconds = 0.0;
+	for (unsigned int i = 0; i < assets.size(); i++)
+	{
+		const Asset& asset = assets[i];
+		if (asset.status == Asset::failed)
+		{
+			printf("FAILED  %s: %s\n", asset.source.c_str(), asset.error.c_str());
+			failedCount++;
+			continue;
+		}
+		ManifestEntry entry;
+		entry.key = asset.key;
+		for (unsigned int k = 0; k < asset.inputs.size(); k++)
+		{
+			char hash[24];
+			sprintf(hash, ":%016llx", asset.inputs[k].second);
+			entry.inputs += (k ? "\t" : "") + asset.inputs[k].first + hash;
+		}
+		updated[asset.output] = entry;
+		if (asset.status == Asset::upToDate)
+		{
+			upToDateCount++;
+			continue;
+		}
+		cookedCount++;
+		inputBytes += asset.inputBytes;
+		outputBytes += asset.outputBytes;
+		triangles += asset.triangles;
+		cookMilliseconds += asset.milliseconds;
+		if (asset.mesh)
+			printf("cooked  %-40s %8d triangles %7d vertices  %8.1f KB -> %7.1f KB  acmr %.2f -> %.2f  %8.2f ms\n", asset.source.c_str(),
+				asset.triangles, asset.vertices, asset.inputBytes / 1024.0, asset.outputBytes / 1024.0,
+				asset.cacheMissRatio[0], asset.cacheMissRatio[1], asset.milliseconds);
+		else
+			printf("cooked  %-40s %8d texels                     %8.1f KB -> %7.1f KB                %8.2f ms\n", asset.source.c_str(),
+				asset.vertices, asset.inputBytes / 1024.0, asset.outputBytes / 1024.0, asset.milliseconds);
+	}
+	int removedCount = 0;
+	for (std::map<std::string, ManifestEntry>::iterator i = manifest.begin(); i != manifest.end(); i++)
+		if (!updated.count(i->first))
+		{
+			remove((outputRoot + "/" + i->first).c_str());
+			removedCount++;
+		}
+	WriteManifest(manifestFile, updated);
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("%d cooked, %d up to date, %d failed, %d removed in %.3f s with %d threads\n", cookedCount, upToDateCount, failedCount,
+		removedCount, seconds, pool.GetThreadCount());
+	if (cookedCount)
+		printf("throughput: %.1f assets/s, %.2f MB/s in, %.2f MB/s out, %.0f triangles/s (%.1f ms of cooking per second)\n",
+			cookedCount / seconds, inputBytes / 1048576.0 / seconds, outputBytes / 1048576.0 / seconds, triangles / seconds, cookMilliseconds / seconds);
+	return failedCount ? 1 : 0;
+}
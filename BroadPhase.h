@@ -0,0 +1,191 @@
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <math.h>
+#include "VectorMath.h"
+#include "ParallelFor.h"
+
+// broad phase collision for many moving boxes: a uniform grid of cellSize cubes hashed into
+// a table of buckets, each box listed in the buckets of the cells it covers. Update only
+// touches the table when a box covers another range of cells than before, so objects that
+// move a little between frames cost a comparison. Cells that share a bucket only add
+// candidates, never lose them. Works best with cells about as large as the typical box.
+class SpatialHash
+{
+	struct Entry
+	{
+		BoundingBox box;
+		int cells[6];		// covered cell range: low x, y, z, high x, y, z
+	};
+
+	float cellSize, inverseCellSize;
+	std::vector<Entry> entries;
+	std::vector<int> freeIds;
+	std::vector<std::vector<int> > buckets;
+	unsigned int mask;
+
+	unsigned int Bucket(int x, int y, int z) const
+	{
+		return ((unsigned int)x * 73856093u ^ (unsigned int)y * 19349663u ^ (unsigned int)z * 83492791u) & mask;
+	}
+
+	// floorf without the call, for every box and every overlapping pair
+	int Cell(float x) const
+	{
+		x *= inverseCellSize;
+		int i = (int)x;
+		return i - (x < (float)i);
+	}
+
+	// none for an empty box
+	void CellRange(const BoundingBox& box, int* cells) const
+	{
+		if (box.IsEmpty())
+		{
+			cells[0] = cells[1] = cells[2] = 0;
+			cells[3] = cells[4] = cells[5] = -1;
+			return;
+		}
+		cells[0] = Cell(box.min.x);
+		cells[1] = Cell(box.min.y);
+		cells[2] = Cell(box.min.z);
+		cells[3] = Cell(box.max.x);
+		cells[4] = Cell(box.max.y);
+		cells[5] = Cell(box.max.z);
+	}
+
+	// once per bucket, even where several of the cells share it
+	void Insert(int id)
+	{
+		const int* c = entries[id].cells;
+		for (int z = c[2]; z <= c[5]; z++)
+			for (int y = c[1]; y <= c[4]; y++)
+				for (int x = c[0]; x <= c[3]; x++)
+				{
+					std::vector<int>& bucket = buckets[Bucket(x, y, z)];
+					if (bucket.empty() || std::find(bucket.begin(), bucket.end(), id) == bucket.end()) bucket.push_back(id);
+				}
+	}
+
+	void Erase(int id)
+	{
+		const int* c = entries[id].cells;
+		for (int z = c[2]; z <= c[5]; z++)
+			for (int y = c[1]; y <= c[4]; y++)
+				for (int x = c[0]; x <= c[3]; x++)
+				{
+					std::vector<int>& bucket = buckets[Bucket(x, y, z)];
+					std::vector<int>::iterator found = std::find(bucket.begin(), bucket.end(), id);
+					if (found == bucket.end()) continue;
+					*found = bucket.back();
+					bucket.pop_back();
+				}
+	}
+
+	static bool Overlap(const BoundingBox& a, const BoundingBox& b)
+	{
+		return a.min.x <= b.max.x && a.max.x >= b.min.x && a.min.y <= b.max.y && a.max.y >= b.min.y && a.min.z <= b.max.z && a.max.z >= b.min.z;
+	}
+
+public:
+	int inserts, moves;		// table changes since the counters were last reset
+
+	// tableSize: buckets, rounded up to a power of two; about twice the object count is plenty
+	SpatialHash(float cellSize, int tableSize = 4096) : cellSize(cellSize), inverseCellSize(1.0f / cellSize), inserts(0), moves(0)
+	{
+		unsigned int size = 1;
+		while (size < (unsigned int)tableSize) size *= 2;
+		buckets.resize(size);
+		mask = size - 1;
+	}
+
+	int GetObjectCount() const { return (int)(entries.size() - freeIds.size()); }
+
+	// the id to move, remove and find the object by; ids of removed objects are reused.
+	// An empty box holds an id without taking part in queries
+	int Add(const BoundingBox& box)
+	{
+		int id;
+		if (!freeIds.empty()) { id = freeIds.back(); freeIds.pop_back(); }
+		else { id = (int)entries.size(); entries.push_back(Entry()); }
+		entries[id].box = box;
+		CellRange(box, entries[id].cells);
+		Insert(id);
+		inserts++;
+		return id;
+	}
+
+	void Remove(int id)
+	{
+		Erase(id);
+		freeIds.push_back(id);
+	}
+
+	void Update(int id, const BoundingBox& box)
+	{
+		Entry& entry = entries[id];
+		entry.box = box;
+		int cells[6];
+		CellRange(box, cells);
+		if (std::equal(cells, cells + 6, entry.cells)) return;
+		Erase(id);
+		std::copy(cells, cells + 6, entry.cells);
+		Insert(id);
+		moves++;
+	}
+
+	const BoundingBox& GetBox(int id) const { return entries[id].box; }
+
+	// the objects whose boxes overlap box, once each
+	void Query(const BoundingBox& box, std::vector<int>& ids) const
+	{
+		int c[6];
+		CellRange(box, c);
+		size_t first = ids.size();
+		for (int z = c[2]; z <= c[5]; z++)
+			for (int y = c[1]; y <= c[4]; y++)
+				for (int x = c[0]; x <= c[3]; x++)
+				{
+					const std::vector<int>& bucket = buckets[Bucket(x, y, z)];
+					for (int i = 0; i < bucket.size(); i++)
+						if (Overlap(entries[bucket[i]].box, box)) ids.push_back(bucket[i]);
+				}
+		std::sort(ids.begin() + first, ids.end());
+		ids.erase(std::unique(ids.begin() + first, ids.end()), ids.end());
+	}
+
+	// every pair of overlapping boxes once, lower id first: a pair is reported by the bucket
+	// of the cell holding the low corner of the boxes' intersection, which both boxes cover
+	void FindPairs(std::vector<std::pair<int, int> >& pairs, ThreadPool* pool = 0) const
+	{
+		if (!pool) pool = &ThreadPool::Global();
+		int grain = std::max(64, (int)buckets.size() / (pool->GetThreadCount() * 8));
+		int chunks = ((int)buckets.size() + grain - 1) / grain;
+		std::vector<std::vector<std::pair<int, int> > > found(chunks);
+		pool->ParallelFor((int)buckets.size(), [&](int begin, int end)
+		{
+			std::vector<std::pair<int, int> >& out = found[begin / grain];
+			for (int b = begin; b < end; b++)
+			{
+				const std::vector<int>& bucket = buckets[b];
+				for (int i = 0; i < bucket.size(); i++)
+				{
+					const BoundingBox& boxA = entries[bucket[i]].box;
+					for (int j = i + 1; j < bucket.size(); j++)
+					{
+						const BoundingBox& boxB = entries[bucket[j]].box;
+						if (!Overlap(boxA, boxB)) continue;
+						if (Bucket(Cell(std::max(boxA.min.x, boxB.min.x)), Cell(std::max(boxA.min.y, boxB.min.y)), Cell(std::max(boxA.min.z, boxB.min.z))) != b) continue;
+						out.push_back(std::make_pair(std::min(bucket[i], bucket[j]), std::max(bucket[i], bucket[j])));
+					}
+				}
+			}
+		}, grain);
+		for (int i = 0; i < chunks; i++) pairs.insert(pairs.end(), found[i].begin(), found[i].end());
+	}
+};
+
+#endif
@@ -0,0 +1,849 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <math.h>
+#include "VectorMath.h"
+#include "Simd4.h"
+
+// four children with their boxes side by side, so that one query tests all of them at once
+struct BvhNode4
+{
+	float bounds[6][4];		// min x, y, z and max x, y, z of each child; empty slots have an inverted box
+	int child[4];			// a node index, or ~group for a leaf
+};
+
+// bounding volume hierarchy over boxes: a binary tree split by binned SAH, collapsed into
+// four wide nodes. A leaf is a group of four places in order, the primitive indices in
+// leaf order with -1 filling the groups of leaves with fewer than four primitives.
+class Bvh4
+{
+	struct BuildNode
+	{
+		BoundingBox box;
+		int left, right;	// children in the build tree, -1 for a leaf
+		int first, count;	// the leaf's range of the primitive list
+	};
+
+	static const int bins = 16;
+
+	static float Area(const BoundingBox& box)
+	{
+		if (box.IsEmpty()) return 0.0f;
+		float x = box.max.x - box.min.x, y = box.max.y - box.min.y, z = box.max.z - box.min.z;
+		return 2.0f * (x * y + y * z + z * x);
+	}
+
+	static float Axis(const vec3& v, int axis) { return axis == 0 ? v.x : (axis == 1 ? v.y : v.z); }
+
+	// SAH split of primitives [first, first + count) into two lists, by the centroid bins
+	// of the widest centroid extent; a median split where the bins cannot separate them
+	static int Split(std::vector<int>& primitives, int first, int count, const std::vector<BoundingBox>& boxes, const std::vector<vec3>& centroids)
+	{
+		BoundingBox centroidBox;
+		for (int i = first; i < first + count; i++) centroidBox.Extend(centroids[primitives[i]]);
+		vec3 extent = centroidBox.max - centroidBox.min;
+		int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+		float low = Axis(centroidBox.min, axis), width = Axis(extent, axis);
+		int* begin = &primitives[first];
+		if (width > 0.0f)
+		{
+			BoundingBox binBoxes[bins];
+			int binCounts[bins] = { 0 };
+			float scale = bins * 0.9999f / width;
+			for (int i = 0; i < count; i++)
+			{
+				int b = (int)((Axis(centroids[begin[i]], axis) - low) * scale);
+				binBoxes[b].Extend(boxes[begin[i]]);
+				binCounts[b]++;
+			}
+			// cost of splitting after bin b: area times count on either side
+			float leftArea[bins], rightCost = 0.0f;
+			int leftCount[bins];
+			BoundingBox box;
+			for (int b = 0, n = 0; b < bins; b++)
+			{
+				box.Extend(binBoxes[b]);
+				n += binCounts[b];
+				leftArea[b] = Area(box);
+				leftCount[b] = n;
+			}
+			float bestCost = 1e30f;
+			int bestBin = -1;
+			box = BoundingBox();
+			for (int b = bins - 1, n = 0; b > 0; b--)
+			{
+				box.Extend(binBoxes[b]);
+				n += binCounts[b];
+				rightCost = Area(box) * n;
+				float cost = leftArea[b - 1] * leftCount[b - 1] + rightCost;
+				if (leftCount[b - 1] && n && cost < bestCost) { bestCost = cost; bestBin = b; }
+			}
+			if (bestBin > 0)
+			{
+				int* middle = std::partition(begin, begin + count,
+					[&](int p) { return (int)((Axis(centroids[p], axis) - low) * scale) < bestBin; });
+				return (int)(middle - begin);
+			}
+		}
+		std::nth_element(begin, begin + count / 2, begin + count,
+			[&](int a, int b) { return Axis(centroids[a], axis) < Axis(centroids[b], axis); });
+		return count / 2;
+	}
+
+	// the node for build node b: its up to four grandchildren with the largest areas opened
+	int Collapse(const std::vector<BuildNode>& tree, int b, const std::vector<int>& primitives)
+	{
+		int children[4] = { b, -1, -1, -1 }, n = 1;
+		if (tree[b].left >= 0) { children[0] = tree[b].left; children[1] = tree[b].right; n = 2; }
+		while (n < 4)
+		{
+			int widest = -1;
+			for (int i = 0; i < n; i++)
+				if (tree[children[i]].left >= 0 && (widest < 0 || Area(tree[children[i]].box) > Area(tree[children[widest]].box))) widest = i;
+			if (widest < 0) break;
+			int opened = children[widest];
+			children[widest] = tree[opened].left;
+			children[n++] = tree[opened].right;
+		}
+
+		int node = (int)nodes.size();
+		nodes.push_back(BvhNode4());
+		for (int i = 0; i < 4; i++)
+		{
+			BoundingBox box = i < n ? tree[children[i]].box : BoundingBox();
+			float corner[6] = { box.min.x, box.min.y, box.min.z, box.max.x, box.max.y, box.max.z };
+			for (int k = 0; k < 6; k++) nodes[node].bounds[k][i] = corner[k];
+			nodes[node].child[i] = ~0;
+			if (i >= n) continue;
+			const BuildNode& c = tree[children[i]];
+			if (c.left >= 0)
+			{
+				int index = Collapse(tree, children[i], primitives);
+				nodes[node].child[i] = index;
+			}
+			else
+			{
+				int group = (int)order.size() / 4;
+				for (int k = 0; k < 4; k++) order.push_back(k < c.count ? primitives[c.first + k] : -1);
+				nodes[node].child[i] = ~group;
+			}
+		}
+		return node;
+	}
+
+public:
+	static const int maxLeaf = 4;
+
+	std::vector<BvhNode4> nodes;	// the root first
+	std::vector<int> order;			// four per leaf
+	BoundingBox bounds;
+
+	int GetGroupCount() const { return (int)order.size() / 4; }
+
+	void Build(const std::vector<BoundingBox>& boxes)
+	{
+		nodes.clear();
+		order.clear();
+		bounds = BoundingBox();
+		if (boxes.empty()) return;
+
+		std::vector<vec3> centroids(boxes.size());
+		std::vector<int> primitives(boxes.size());
+		for (int i = 0; i < (int)boxes.size(); i++)
+		{
+			centroids[i] = boxes[i].GetCenter();
+			primitives[i] = i;
+			bounds.Extend(boxes[i]);
+		}
+
+		// binary tree, splitting until the leaves are small enough
+		std::vector<BuildNode> tree;
+		BuildNode root = { bounds, -1, -1, 0, (int)boxes.size() };
+		tree.push_back(root);
+		std::vector<int> stack(1, 0);
+		while (!stack.empty())
+		{
+			int b = stack.back();
+			stack.pop_back();
+			if (tree[b].count <= maxLeaf) continue;
+			int first = tree[b].first, count = tree[b].count;
+			int leftCount = Split(primitives, first, count, boxes, centroids);
+			BuildNode left = { BoundingBox(), -1, -1, first, leftCount }, right = { BoundingBox(), -1, -1, first + leftCount, count - leftCount };
+			for (int i = first; i < first + leftCount; i++) left.box.Extend(boxes[primitives[i]]);
+			for (int i = first + leftCount; i < first + count; i++) right.box.Extend(boxes[primitives[i]]);
+			tree[b].left = (int)tree.size();
+			tree[b].right = tree[b].left + 1;
+			tree.push_back(left);
+			tree.push_back(right);
+			stack.push_back(tree[b].left);
+			stack.push_back(tree[b].right);
+		}
+
+		nodes.reserve(tree.size() / 2 + 1);
+		order.reserve(boxes.size() * 2);
+		Collapse(tree, 0, primitives);
+	}
+
+	// leaf(group, tMax) for the leaves whose box the ray origin + t * direction enters at a t
+	// below tMax, nearer boxes first; leaf may lower tMax, and returning true stops the walk
+	template<class Leaf> void Traverse(const vec3& origin, const vec3& direction, float& tMax, Leaf leaf) const
+	{
+		if (nodes.empty()) return;
+		float inverse[3] = { 1.0f / (fabsf(direction.x) > 1e-20f ? direction.x : 1e-20f),
+			1.0f / (fabsf(direction.y) > 1e-20f ? direction.y : 1e-20f), 1.0f / (fabsf(direction.z) > 1e-20f ? direction.z : 1e-20f) };
+		float o[3] = { origin.x, origin.y, origin.z };
+		int nearRow[3], farRow[3];
+		float4 invDir[3], scaledOrigin[3];
+		for (int k = 0; k < 3; k++)
+		{
+			nearRow[k] = inverse[k] >= 0.0f ? k : k + 3;
+			farRow[k] = inverse[k] >= 0.0f ? k + 3 : k;
+			invDir[k] = float4(inverse[k]);
+			scaledOrigin[k] = float4(o[k] * inverse[k]);
+		}
+
+		std::pair<float, int> stack[256];
+		int top = 0;
+		stack[top++] = std::make_pair(0.0f, 0);
+		while (top)
+		{
+			std::pair<float, int> entry = stack[--top];
+			if (entry.first > tMax) continue;
+			if (entry.second < 0)
+			{
+				if (leaf(~entry.second, tMax)) return;
+				continue;
+			}
+			const BvhNode4& node = nodes[entry.second];
+			float4 tNear = float4(0.0f), tFar = float4(tMax);
+			for (int k = 0; k < 3; k++)
+			{
+				tNear = Max(tNear, float4::Load(node.bounds[nearRow[k]]) * invDir[k] - scaledOrigin[k]);
+				tFar = Min(tFar, float4::Load(node.bounds[farRow[k]]) * invDir[k] - scaledOrigin[k]);
+			}
+			int hits = MoveMask(tNear <= tFar);
+			if (!hits) continue;
+			float t[4];
+			tNear.Store(t);
+			// farthest pushed first
+			int begin = top;
+			for (int i = 0; i < 4; i++)
+			{
+				if (!(hits & (1 << i))) continue;
+				int j = top++;
+				while (j > begin && stack[j - 1].first < t[i]) { stack[j] = stack[j - 1]; j--; }
+				stack[j] = std::make_pair(t[i], node.child[i]);
+			}
+		}
+	}
+
+	// four rays in the lanes, for coherent rays such as those of neighbouring pixels: each node
+	// is fetched once for the whole packet and its children are tested against the four rays
+	// at once. leaf(group, tMax, active) for the leaves whose box one of the active rays enters
+	// below its lane of tMax, nearer boxes first; leaf may lower lanes of tMax and returns the
+	// rays still active, the walk stops when none is
+	template<class Leaf> void TraversePacket(const float4* origin, const float4* direction, float4& tMax, int active, Leaf leaf) const
+	{
+		if (nodes.empty() || !active) return;
+		float4 invDir[3];
+		for (int k = 0; k < 3; k++)
+		{
+			float d[4];
+			direction[k].Store(d);
+			for (int i = 0; i < 4; i++) d[i] = 1.0f / (fabsf(d[i]) > 1e-20f ? d[i] : 1e-20f);
+			invDir[k] = float4::Load(d);
+		}
+		float4 activeMask = LaneMask(active);
+
+		std::pair<float, int> stack[256];
+		int top = 0;
+		stack[top++] = std::make_pair(0.0f, 0);
+		while (top)
+		{
+			std::pair<float, int> entry = stack[--top];
+			float limits[4];
+			tMax.Store(limits);
+			float limit = -1e30f;
+			for (int i = 0; i < 4; i++) if (active & (1 << i)) limit = std::max(limit, limits[i]);
+			if (entry.first > limit) continue;
+			if (entry.second < 0)
+			{
+				active = leaf(~entry.second, tMax, active);
+				if (!active) return;
+				activeMask = LaneMask(active);
+				continue;
+			}
+			const BvhNode4& node = nodes[entry.second];
+			int begin = top;
+			for (int i = 0; i < 4; i++)
+			{
+				// empty slots: min/max of the slabs would turn the inverted box into everything
+				if (node.bounds[0][i] > node.bounds[3][i]) continue;
+				float4 tNear = float4(0.0f), tFar = tMax;
+				for (int k = 0; k < 3; k++)
+				{
+					float4 t0 = (float4(node.bounds[k][i]) - origin[k]) * invDir[k];
+					float4 t1 = (float4(node.bounds[k + 3][i]) - origin[k]) * invDir[k];
+					tNear = Max(tNear, Min(t0, t1));
+					tFar = Min(tFar, Max(t0, t1));
+				}
+				float4 hits = And(tNear <= tFar, activeMask);
+				if (!MoveMask(hits)) continue;
+				float t[4];
+				Select(hits, tNear, float4(1e30f)).Store(t);
+				float nearest = std::min(std::min(t[0], t[1]), std::min(t[2], t[3]));
+				// farthest pushed first
+				int j = top++;
+				while (j > begin && stack[j - 1].first < nearest) { stack[j] = stack[j - 1]; j--; }
+				stack[j] = std::make_pair(nearest, node.child[i]);
+			}
+		}
+	}
+
+	// leaf(group) for the leaves whose box overlaps box
+	template<class Leaf> void Traverse(const BoundingBox& box, Leaf leaf) const
+	{
+		if (nodes.empty()) return;
+		float4 low[3] = { float4(box.min.x), float4(box.min.y), float4(box.min.z) };
+		float4 high[3] = { float4(box.max.x), float4(box.max.y), float4(box.max.z) };
+		int stack[256], top = 0;
+		stack[top++] = 0;
+		while (top)
+		{
+			int child = stack[--top];
+			if (child < 0)
+			{
+				leaf(~child);
+				continue;
+			}
+			const BvhNode4& node = nodes[child];
+			float4 inside = float4::Load(node.bounds[0]) <= high[0];
+			for (int k = 0; k < 3; k++)
+			{
+				if (k) inside = And(inside, float4::Load(node.bounds[k]) <= high[k]);
+				inside = And(inside, float4::Load(node.bounds[k + 3]) >= low[k]);
+			}
+			int hits = MoveMask(inside);
+			for (int i = 0; i < 4; i++) if (hits & (1 << i)) stack[top++] = node.child[i];
+		}
+	}
+
+	// leaf(group, maxDistance2) for the leaves whose box is closer to p than the square root
+	// of maxDistance2, nearer boxes first; leaf may lower maxDistance2
+	template<class Leaf> void TraverseNearest(const vec3& p, float& maxDistance2, Leaf leaf) const
+	{
+		if (nodes.empty()) return;
+		float4 point[3] = { float4(p.x), float4(p.y), float4(p.z) };
+		std::pair<float, int> stack[256];
+		int top = 0;
+		stack[top++] = std::make_pair(0.0f, 0);
+		while (top)
+		{
+			std::pair<float, int> entry = stack[--top];
+			if (entry.first > maxDistance2) continue;
+			if (entry.second < 0)
+			{
+				leaf(~entry.second, maxDistance2);
+				continue;
+			}
+			const BvhNode4& node = nodes[entry.second];
+			float4 distance2 = float4(0.0f);
+			for (int k = 0; k < 3; k++)
+			{
+				float4 outside = Max(Max(float4::Load(node.bounds[k]) - point[k], point[k] - float4::Load(node.bounds[k + 3])), float4(0.0f));
+				distance2 = distance2 + outside * outside;
+			}
+			// empty slots: the inverted box is far from everything
+			int hits = MoveMask(distance2 <= float4(maxDistance2));
+			float d[4];
+			distance2.Store(d);
+			int begin = top;
+			for (int i = 0; i < 4; i++)
+			{
+				if (!(hits & (1 << i)) || node.bounds[0][i] > node.bounds[3][i]) continue;
+				int j = top++;
+				while (j > begin && stack[j - 1].first < d[i]) { stack[j] = stack[j - 1]; j--; }
+				stack[j] = std::make_pair(d[i], node.child[i]);
+			}
+		}
+	}
+};
+
+// a ray hit: origin + t * direction, with the barycentric coordinates of the hit point in the
+// triangle, its geometric normal (unit length, facing either way) and the instance hit
+struct RayHit
+{
+	float t, u, v;
+	int triangle, instance;
+	vec3 normal;
+
+	RayHit(float tMax = 1e30f) : t(tMax), u(0.0f), v(0.0f), triangle(-1), instance(-1) {}
+};
+
+// the hits of a packet of four rays, lane by lane as in RayHit; t holds the limits to hit below
+struct PacketHit
+{
+	float4 t;
+	float u[4], v[4];
+	int triangle[4], instance[4];
+	vec3 normal[4];
+
+	PacketHit(float tMax = 1e30f) : t(tMax)
+	{
+		for (int i = 0; i < 4; i++) { u[i] = v[i] = 0.0f; triangle[i] = instance[i] = -1; }
+	}
+};
+
+// the point of the geometry nearest to a query point
+struct PointHit
+{
+	vec3 point;
+	float distance;
+	int triangle, instance;
+
+	PointHit(float maxDistance = 1e30f) : distance(maxDistance), triangle(-1), instance(-1) {}
+};
+
+// the triangles of a mesh for ray casts, closest point and overlap queries. Each leaf keeps
+// its four triangles side by side (corner, both edges), so a ray is tested against all of
+// them at once; rays hit both sides.
+class TriangleBvh
+{
+	Bvh4 bvh;
+	int triangleCount;
+	std::vector<float> groups;		// per leaf: v0 x, y, z, edge1 x, y, z, edge2 x, y, z, four lanes each
+
+	static vec3 Lane(const float* group, int row, int lane) { return vec3(group[row * 4 + lane], group[(row + 1) * 4 + lane], group[(row + 2) * 4 + lane]); }
+
+	// nearest point of triangle abc to p, Ericson's Real-Time Collision Detection 5.1.5
+	static vec3 ClosestOnTriangle(vec3 p, vec3 a, vec3 b, vec3 c)
+	{
+		vec3 ab = b - a, ac = c - a, ap = p - a;
+		float d1 = dot(ab, ap), d2 = dot(ac, ap);
+		if (d1 <= 0.0f && d2 <= 0.0f) return a;
+		vec3 bp = p - b;
+		float d3 = dot(ab, bp), d4 = dot(ac, bp);
+		if (d3 >= 0.0f && d4 <= d3) return b;
+		float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return a + ab * (d1 / (d1 - d3));
+		vec3 cp = p - c;
+		float d5 = dot(ab, cp), d6 = dot(ac, cp);
+		if (d6 >= 0.0f && d5 <= d6) return c;
+		float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return a + ac * (d2 / (d2 - d6));
+		float va = d3 * d6 - d5 * d4;
+		if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+		float denominator = 1.0f / (va + vb + vc);
+		return a + ab * (vb * denominator) + ac * (vc * denominator);
+	}
+
+	// separating axis test of the triangle and a box, Akenine-Moller's 13 axes
+	static bool TriangleOverlapsBox(vec3 a, vec3 b, vec3 c, const BoundingBox& box)
+	{
+		vec3 center = box.GetCenter(), half = (vec3(box.max) - box.min) * 0.5f;
+		vec3 v[3] = { a - center, b - center, c - center };
+		vec3 e[3] = { v[1] - v[0], v[2] - v[1], v[0] - v[2] };
+		float h[3] = { half.x, half.y, half.z };
+		for (int k = 0; k < 3; k++)
+		{
+			float p[3] = { Component(v[0], k), Component(v[1], k), Component(v[2], k) };
+			if (std::min(p[0], std::min(p[1], p[2])) > h[k] || std::max(p[0], std::max(p[1], p[2])) < -h[k]) return false;
+		}
+		vec3 n = cross(e[0], e[1]);
+		float r = h[0] * fabsf(n.x) + h[1] * fabsf(n.y) + h[2] * fabsf(n.z);
+		if (fabsf(dot(n, v[0])) > r) return false;
+		for (int i = 0; i < 3; i++)
+			for (int k = 0; k < 3; k++)
+			{
+				vec3 unit(k == 0, k == 1, k == 2);
+				vec3 axis = cross(unit, e[i]);
+				float p0 = dot(axis, v[0]), p1 = dot(axis, v[1]), p2 = dot(axis, v[2]);
+				r = h[0] * fabsf(axis.x) + h[1] * fabsf(axis.y) + h[2] * fabsf(axis.z);
+				if (std::min(p0, std::min(p1, p2)) > r || std::max(p0, std::max(p1, p2)) < -r) return false;
+			}
+		return true;
+	}
+
+	static float Component(const vec3& v, int k) { return k == 0 ? v.x : (k == 1 ? v.y : v.z); }
+
+public:
+	int GetTriangleCount() const { return triangleCount; }
+	int GetNodeCount() const { return (int)bvh.nodes.size(); }
+	const BoundingBox& GetBounds() const { return bvh.bounds; }
+
+	TriangleBvh() : triangleCount(0) {}
+
+	// three corners per triangle
+	TriangleBvh(const std::vector<vec3>& corners) { Build(corners); }
+
+	void Build(const std::vector<vec3>& corners)
+	{
+		triangleCount = (int)corners.size() / 3;
+		std::vector<BoundingBox> boxes(triangleCount);
+		for (int t = 0; t < triangleCount; t++)
+			for (int k = 0; k < 3; k++) boxes[t].Extend(corners[t * 3 + k]);
+		bvh.Build(boxes);
+
+		// unused lanes stay zero: no area, never hit
+		groups.assign(bvh.GetGroupCount() * 36, 0.0f);
+		for (int i = 0; i < (int)bvh.order.size(); i++)
+		{
+			int t = bvh.order[i];
+			if (t < 0) continue;
+			vec3 a = corners[t * 3], b = corners[t * 3 + 1], c = corners[t * 3 + 2];
+			vec3 e1 = b - a, e2 = c - a;
+			float values[9] = { a.x, a.y, a.z, e1.x, e1.y, e1.z, e2.x, e2.y, e2.z };
+			float* group = &groups[(i / 4) * 36];
+			for (int k = 0; k < 9; k++) group[k * 4 + i % 4] = values[k];
+		}
+	}
+
+	// the triangle with index into the corners given to Build
+	int GetTriangle(int group, int lane) const { return bvh.order[group * 4 + lane]; }
+
+	// the nearest hit in front of the origin closer than hit.t; hit is only changed on a hit
+	bool Raycast(const vec3& origin, const vec3& direction, RayHit& hit) const
+	{
+		return Intersect(origin, direction, hit, false);
+	}
+
+	// any hit closer than tMax, for shadow rays
+	bool Occluded(const vec3& origin, const vec3& direction, float tMax) const
+	{
+		RayHit hit(tMax);
+		return Intersect(origin, direction, hit, true);
+	}
+
+	bool Intersect(const vec3& origin, const vec3& direction, RayHit& hit, bool anyHit) const
+	{
+		float4 o[3] = { float4(origin.x), float4(origin.y), float4(origin.z) };
+		float4 d[3] = { float4(direction.x), float4(direction.y), float4(direction.z) };
+		bool found = false;
+		float tMax = hit.t;
+		int hitGroup = -1, hitLane = 0;
+		bvh.Traverse(origin, direction, tMax, [&](int group, float& t) -> bool
+		{
+			// Moller-Trumbore on four triangles
+			const float* g = &groups[group * 36];
+			float4 e1[3] = { float4::Load(g + 12), float4::Load(g + 16), float4::Load(g + 20) };
+			float4 e2[3] = { float4::Load(g + 24), float4::Load(g + 28), float4::Load(g + 32) };
+			float4 s[3] = { o[0] - float4::Load(g), o[1] - float4::Load(g + 4), o[2] - float4::Load(g + 8) };
+			float4 p[3] = { d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0] };
+			float4 det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+			float4 valid = Or(det > float4(1e-12f), det < float4(-1e-12f));
+			float4 inverse = float4(1.0f) / Select(valid, det, float4(1.0f));
+			float4 u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inverse;
+			float4 q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+			float4 v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * inverse;
+			float4 tHit = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inverse;
+			valid = And(valid, And(u >= float4(0.0f), v >= float4(0.0f)));
+			valid = And(valid, And(u + v <= float4(1.0f), And(tHit > float4(0.0f), tHit < float4(t))));
+			int mask = MoveMask(valid);
+			if (!mask) return false;
+			float ts[4], us[4], vs[4];
+			tHit.Store(ts);
+			u.Store(us);
+			v.Store(vs);
+			for (int i = 0; i < 4; i++)
+			{
+				if (!(mask & (1 << i)) || ts[i] >= t) continue;
+				t = ts[i];
+				hit.u = us[i];
+				hit.v = vs[i];
+				hitGroup = group;
+				hitLane = i;
+			}
+			found = true;
+			return anyHit;
+		});
+		if (!found) return false;
+		hit.t = tMax;
+		hit.triangle = GetTriangle(hitGroup, hitLane);
+		const float* g = &groups[hitGroup * 36];
+		hit.normal = cross(Lane(g, 3, hitLane), Lane(g, 6, hitLane)).normalize();
+		return true;
+	}
+
+	// Intersect for the active lanes of a packet of four rays, each triangle tested against the
+	// four at once; returns the lanes hit, whose hits were changed. With anyHit a ray stops at
+	// its first hit
+	int IntersectPacket(const float4* origin, const float4* direction, PacketHit& hit, int active, bool anyHit) const
+	{
+		int found = 0, hitGroup[4] = { -1, -1, -1, -1 }, hitLane[4] = {};
+		bvh.TraversePacket(origin, direction, hit.t, active, [&](int group, float4& tMax, int lanes) -> int
+		{
+			const float* g = &groups[group * 36];
+			for (int j = 0; j < 4 && lanes; j++)
+			{
+				if (GetTriangle(group, j) < 0) continue;
+				// Moller-Trumbore, one triangle against the four rays
+				float4 e1[3] = { float4(g[12 + j]), float4(g[16 + j]), float4(g[20 + j]) };
+				float4 e2[3] = { float4(g[24 + j]), float4(g[28 + j]), float4(g[32 + j]) };
+				float4 s[3] = { origin[0] - float4(g[j]), origin[1] - float4(g[4 + j]), origin[2] - float4(g[8 + j]) };
+				float4 p[3] = { direction[1] * e2[2] - direction[2] * e2[1], direction[2] * e2[0] - direction[0] * e2[2], direction[0] * e2[1] - direction[1] * e2[0] };
+				float4 det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+				float4 valid = And(LaneMask(lanes), Or(det > float4(1e-12f), det < float4(-1e-12f)));
+				float4 inverse = float4(1.0f) / Select(valid, det, float4(1.0f));
+				float4 u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inverse;
+				float4 q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+				float4 v = (direction[0] * q[0] + direction[1] * q[1] + direction[2] * q[2]) * inverse;
+				float4 tHit = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inverse;
+				valid = And(valid, And(u >= float4(0.0f), v >= float4(0.0f)));
+				valid = And(valid, And(u + v <= float4(1.0f), And(tHit > float4(0.0f), tHit < tMax)));
+				int mask = MoveMask(valid);
+				if (!mask) continue;
+				tMax = Select(valid, tHit, tMax);
+				float us[4], vs[4];
+				u.Store(us);
+				v.Store(vs);
+				for (int i = 0; i < 4; i++)
+				{
+					if (!(mask & (1 << i))) continue;
+					hit.u[i] = us[i];
+					hit.v[i] = vs[i];
+					hitGroup[i] = group;
+					hitLane[i] = j;
+				}
+				found |= mask;
+				if (anyHit) lanes &= ~mask;
+			}
+			return lanes;
+		});
+		for (int i = 0; i < 4; i++)
+		{
+			if (!(found & (1 << i))) continue;
+			hit.triangle[i] = GetTriangle(hitGroup[i], hitLane[i]);
+			const float* g = &groups[hitGroup[i] * 36];
+			hit.normal[i] = cross(Lane(g, 3, hitLane[i]), Lane(g, 6, hitLane[i])).normalize();
+		}
+		return found;
+	}
+
+	// the nearest point closer than hit.distance; hit is only changed when one is found
+	bool ClosestPoint(const vec3& p, PointHit& hit) const
+	{
+		float maxDistance2 = hit.distance * hit.distance;
+		bool found = false;
+		bvh.TraverseNearest(p, maxDistance2, [&](int group, float& distance2)
+		{
+			const float* g = &groups[group * 36];
+			for (int i = 0; i < 4; i++)
+			{
+				if (GetTriangle(group, i) < 0) continue;
+				vec3 a = Lane(g, 0, i);
+				vec3 closest = ClosestOnTriangle(p, a, a + Lane(g, 3, i), a + Lane(g, 6, i));
+				vec3 offset = closest - p;
+				float d2 = dot(offset, offset);
+				if (d2 >= distance2) continue;
+				distance2 = d2;
+				hit.point = closest;
+				hit.triangle = GetTriangle(group, i);
+				found = true;
+			}
+		});
+		if (found) hit.distance = sqrtf(maxDistance2);
+		return found;
+	}
+
+	// appends the triangles that overlap box
+	void Overlap(const BoundingBox& box, std::vector<int>& triangles) const
+	{
+		bvh.Traverse(box, [&](int group)
+		{
+			const float* g = &groups[group * 36];
+			for (int i = 0; i < 4; i++)
+			{
+				if (GetTriangle(group, i) < 0) continue;
+				vec3 a = Lane(g, 0, i);
+				if (TriangleOverlapsBox(a, a + Lane(g, 3, i), a + Lane(g, 6, i), box)) triangles.push_back(GetTriangle(group, i));
+			}
+		});
+	}
+
+	// whether any triangle overlaps box
+	bool Overlaps(const BoundingBox& box) const
+	{
+		std::vector<int> triangles;
+		Overlap(box, triangles);
+		return !triangles.empty();
+	}
+};
+
+// meshes placed in the world: each instance is a TriangleBvh under a transform (row
+// vectors, p * M), with a top level Bvh4 over the instances' world boxes. Closest point
+// queries assume uniformly scaled instances; overlap queries take the box into each
+// instance's space as the box around its corners, which can report triangles of rotated
+// instances slightly outside it.
+class InstanceBvh
+{
+	struct Instance
+	{
+		const TriangleBvh* mesh;
+		mat4 toWorld, toLocal;
+		float scale;
+	};
+
+	Bvh4 bvh;
+	std::vector<Instance> instances;
+
+	static vec3 Point(const vec3& p, const mat4& M) { vec4 r = vec4(p.x, p.y, p.z, 1.0f) * M; return vec3(r.v[0], r.v[1], r.v[2]); }
+	static vec3 Direction(const vec3& d, const mat4& M) { vec4 r = vec4(d.x, d.y, d.z, 0.0f) * M; return vec3(r.v[0], r.v[1], r.v[2]); }
+
+	// object to world for normals: the transposed inverse
+	static vec3 Normal(const vec3& n, const mat4& toLocal)
+	{
+		const float (*m)[4] = toLocal.m;
+		return vec3(m[0][0] * n.x + m[0][1] * n.y + m[0][2] * n.z, m[1][0] * n.x + m[1][1] * n.y + m[1][2] * n.z,
+			m[2][0] * n.x + m[2][1] * n.y + m[2][2] * n.z).normalize();
+	}
+
+public:
+	int GetInstanceCount() const { return (int)instances.size(); }
+	int GetNodeCount() const { return (int)bvh.nodes.size(); }
+
+	// the instance index; Build makes additions and moves visible to the queries
+	int Add(const TriangleBvh* mesh, const mat4& M, const mat4& InvM)
+	{
+		Instance instance = { mesh, M, InvM, 1.0f };
+		instances.push_back(instance);
+		Move((int)instances.size() - 1, M, InvM);
+		return (int)instances.size() - 1;
+	}
+
+	void Move(int i, const mat4& M, const mat4& InvM)
+	{
+		instances[i].toWorld = M;
+		instances[i].toLocal = InvM;
+		instances[i].scale = Direction(vec3(1.0f, 0.0f, 0.0f), M).length();
+	}
+
+	void Build()
+	{
+		std::vector<BoundingBox> boxes(instances.size());
+		for (int i = 0; i < (int)instances.size(); i++) boxes[i] = instances[i].mesh->GetBounds().Transform(instances[i].toWorld);
+		bvh.Build(boxes);
+	}
+
+	bool Raycast(const vec3& origin, const vec3& direction, RayHit& hit) const
+	{
+		return Intersect(origin, direction, hit, false);
+	}
+
+	bool Occluded(const vec3& origin, const vec3& direction, float tMax) const
+	{
+		RayHit hit(tMax);
+		return Intersect(origin, direction, hit, true);
+	}
+
+	// the instance's ray is origin and direction through toLocal, which keeps t as it is
+	bool Intersect(const vec3& origin, const vec3& direction, RayHit& hit, bool anyHit) const
+	{
+		bool found = false;
+		float tMax = hit.t;
+		bvh.Traverse(origin, direction, tMax, [&](int group, float& t) -> bool
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				int index = bvh.order[group * 4 + i];
+				if (index < 0) continue;
+				const Instance& instance = instances[index];
+				RayHit local(t);
+				if (!instance.mesh->Intersect(Point(origin, instance.toLocal), Direction(direction, instance.toLocal), local, anyHit)) continue;
+				hit = local;
+				hit.instance = index;
+				hit.normal = Normal(local.normal, instance.toLocal);
+				t = local.t;
+				found = true;
+				if (anyHit) return true;
+			}
+			return false;
+		});
+		return found;
+	}
+
+	// Intersect for the active lanes of a packet of four rays; returns the lanes hit
+	int IntersectPacket(const float4* origin, const float4* direction, PacketHit& hit, int active, bool anyHit) const
+	{
+		int found = 0;
+		bvh.TraversePacket(origin, direction, hit.t, active, [&](int group, float4& tMax, int lanes) -> int
+		{
+			for (int i = 0; i < 4 && lanes; i++)
+			{
+				int index = bvh.order[group * 4 + i];
+				if (index < 0) continue;
+				const Instance& instance = instances[index];
+				const float (*m)[4] = instance.toLocal.m;
+				float4 o[3], d[3];
+				for (int k = 0; k < 3; k++)
+				{
+					o[k] = origin[0] * float4(m[0][k]) + origin[1] * float4(m[1][k]) + origin[2] * float4(m[2][k]) + float4(m[3][k]);
+					d[k] = direction[0] * float4(m[0][k]) + direction[1] * float4(m[1][k]) + direction[2] * float4(m[2][k]);
+				}
+				PacketHit local;
+				local.t = tMax;
+				int mask = instance.mesh->IntersectPacket(o, d, local, lanes, anyHit);
+				if (!mask) continue;
+				tMax = local.t;
+				for (int k = 0; k < 4; k++)
+				{
+					if (!(mask & (1 << k))) continue;
+					hit.u[k] = local.u[k];
+					hit.v[k] = local.v[k];
+					hit.triangle[k] = local.triangle[k];
+					hit.instance[k] = index;
+					hit.normal[k] = Normal(local.normal[k], instance.toLocal);
+				}
+				found |= mask;
+				if (anyHit) lanes &= ~mask;
+			}
+			return lanes;
+		});
+		return found;
+	}
+
+	bool ClosestPoint(const vec3& p, PointHit& hit) const
+	{
+		float maxDistance2 = hit.distance * hit.distance;
+		bool found = false;
+		bvh.TraverseNearest(p, maxDistance2, [&](int group, float& distance2)
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				int index = bvh.order[group * 4 + i];
+				if (index < 0) continue;
+				const Instance& instance = instances[index];
+				PointHit local(sqrtf(distance2) / instance.scale);
+				if (!instance.mesh->ClosestPoint(Point(p, instance.toLocal), local)) continue;
+				hit.point = Point(local.point, instance.toWorld);
+				hit.distance = local.distance * instance.scale;
+				hit.triangle = local.triangle;
+				hit.instance = index;
+				distance2 = hit.distance * hit.distance;
+				found = true;
+			}
+		});
+		return found;
+	}
+
+	// appends (instance, triangle) for the triangles that overlap box
+	void Overlap(const BoundingBox& box, std::vector<std::pair<int, int> >& triangles) const
+	{
+		std::vector<int> local;
+		bvh.Traverse(box, [&](int group)
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				int index = bvh.order[group * 4 + i];
+				if (index < 0) continue;
+				local.clear();
+				instances[index].mesh->Overlap(box.Transform(instances[index].toLocal), local);
+				for (int k = 0; k < (int)local.size(); k++) triangles.push_back(std::make_pair(index, local[k]));
+			}
+		});
+	}
+};
+
+#endif
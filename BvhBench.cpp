@@ -0,0 +1,269 @@
+// CPU benchmark for the triangle and instance BVHs of Bvh.h, no GL needed. Builds the BVH of
+// a bumpy sphere (or an OBJ file), checks ray casts, closest points and box overlaps against
+// brute force, then times rays per thread count, alone and through a field of instances, one
+// at a time and as packets of four like the ray tracer casts them.
+//   g++ -O2 -std=c++11 -pthread BvhBench.cpp ObjMesh.cpp -o BvhBench
+//   ./BvhBench [triangles] [rays] [file.obj]
+
+#define _USE_MATH_DEFINES
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "Bvh.h"
+#include "ObjMesh.h"
+#include "ParallelFor.h"
+
+double Milliseconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+float Random() { return (float)rand() / RAND_MAX; }
+
+// random unit vector
+vec3 RandomDirection()
+{
+	vec3 d;
+	do d = vec3::random(); while (d.length() > 1.0f || d.length() < 1e-3f);
+	return d.normalize();
+}
+
+// the sphere's corners pushed in and out by a pattern over the position, so shared corners stay shared
+void BumpySphere(int triangles, std::vector<vec3>& corners)
+{
+	int stacks = std::max(2, (int)sqrt(triangles / 4.0));
+	ObjMesh sphere(2 * stacks, stacks);
+	sphere.GetTrianglePositions(corners);
+	for (int i = 0; i < corners.size(); i++)
+	{
+		vec3& p = corners[i];
+		p = p * (1.0f + 0.1f * sinf(7.0f * p.x) * sinf(5.0f * p.y) * sinf(6.0f * p.z));
+	}
+}
+
+// brute force references, with the same triangle tests as the BVH
+bool BruteRaycast(const std::vector<vec3>& corners, const vec3& origin, const vec3& direction, RayHit& hit)
+{
+	bool found = false;
+	for (int t = 0; t < corners.size() / 3; t++)
+	{
+		std::vector<vec3> one(corners.begin() + t * 3, corners.begin() + t * 3 + 3);
+		TriangleBvh single(one);
+		RayHit local(hit.t);
+		if (!single.Raycast(origin, direction, local)) continue;
+		hit = local;
+		hit.triangle = t;
+		found = true;
+	}
+	return found;
+}
+
+int main(int argc, char* argv[])
+{
+	int triangleTarget = argc > 1 ? atoi(argv[1]) : 1000000;
+	int rayCount = argc > 2 ? atoi(argv[2]) : 1000000;
+	srand(1);
+
+	std::vector<vec3> corners;
+	if (argc > 3)
+	{
+		ObjMesh mesh(argv[3]);
+		mesh.GetTrianglePositions(corners);
+	}
+	else BumpySphere(triangleTarget, corners);
+	int triangles = (int)corners.size() / 3;
+	if (!triangles) { printf("no triangles\n"); return 1; }
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	TriangleBvh bvh(corners);
+	double buildTime = Milliseconds(start);
+	printf("mesh: %d triangles, BVH built in %.1f ms (%.2f M triangles/s), %d nodes\n",
+		triangles, buildTime, triangles / (buildTime * 1000.0), bvh.GetNodeCount());
+
+	// rays from a sphere around the mesh toward points inside its bounds
+	BoundingBox bounds = bvh.GetBounds();
+	vec3 center = bounds.GetCenter(), size = bounds.max - bounds.min;
+	float radius = size.length();
+	std::vector<vec3> origins(rayCount), directions(rayCount);
+	for (int i = 0; i < rayCount; i++)
+	{
+		origins[i] = center + RandomDirection() * radius;
+		vec3 target = center + vec3(size.x * (Random() - 0.5f), size.y * (Random() - 0.5f), size.z * (Random() - 0.5f)) * 0.8f;
+		directions[i] = (target - origins[i]).normalize();
+	}
+
+	// checks against brute force on a few hundred queries, for meshes small enough
+	int errors = 0, checks = std::min(rayCount, triangles > 100000 ? 0 : 300);
+	for (int i = 0; i < checks; i++)
+	{
+		RayHit fast, slow;
+		bool a = bvh.Raycast(origins[i], directions[i], fast), b = BruteRaycast(corners, origins[i], directions[i], slow);
+		if (a != b || (a && fabsf(fast.t - slow.t) > 1e-4f * std::max(1.0f, slow.t)))
+		{
+			if (errors++ < 5) printf("ray %d: BVH %s t %f, brute force %s t %f\n", i, a ? "hit" : "miss", fast.t, b ? "hit" : "miss", slow.t);
+		}
+		if (a != bvh.Occluded(origins[i], directions[i], 1e30f)) { if (errors++ < 5) printf("ray %d: occlusion disagrees\n", i); }
+
+		vec3 p = center + vec3(size.x * (Random() - 0.5f), size.y * (Random() - 0.5f), size.z * (Random() - 0.5f)) * 1.5f;
+		PointHit near;
+		bvh.ClosestPoint(p, near);
+		float best = 1e30f;
+		for (int t = 0; t < triangles; t++)
+		{
+			std::vector<vec3> one(corners.begin() + t * 3, corners.begin() + t * 3 + 3);
+			PointHit local;
+			if (TriangleBvh(one).ClosestPoint(p, local)) best = std::min(best, local.distance);
+		}
+		if (fabsf(near.distance - best) > 1e-4f * std::max(1.0f, best)) { if (errors++ < 5) printf("point %d: BVH %f, brute force %f\n", i, near.distance, best); }
+
+		BoundingBox box;
+		box.Extend(p);
+		box.Extend(p + vec3(Random(), Random(), Random()) * (radius * 0.1f));
+		std::vector<int> found;
+		bvh.Overlap(box, found);
+		int expected = 0;
+		for (int t = 0; t < triangles; t++)
+		{
+			std::vector<vec3> one(corners.begin() + t * 3, corners.begin() + t * 3 + 3);
+			expected += TriangleBvh(one).Overlaps(box);
+		}
+		if (found.size() != expected) { if (errors++ < 5) printf("box %d: BVH %d triangles, brute force %d\n", i, (int)found.size(), expected); }
+	}
+	if (checks) printf("check: %d queries against brute force, %d errors\n", checks * 3, errors);
+	else printf("check: skipped above 100000 triangles\n");
+
+	// a grid of turned and scaled copies under one top level BVH
+	int side = 32;
+	InstanceBvh field;
+	std::vector<mat4> toLocal;
+	for (int i = 0; i < side * side; i++)
+	{
+		float s = 0.5f + Random(), angle = Random() * 2.0f * M_PI, c = cosf(angle), n = sinf(angle);
+		vec3 position = vec3((i % side - side / 2) * radius, 0.0f, (i / side - side / 2) * radius);
+		mat4 M(s * c, 0.0f, s * n, 0.0f, 0.0f, s, 0.0f, 0.0f, -s * n, 0.0f, s * c, 0.0f, position.x, position.y, position.z, 1.0f);
+		toLocal.push_back(inverse(M));
+		field.Add(&bvh, M, toLocal.back());
+	}
+	start = std::chrono::steady_clock::now();
+	field.Build();
+	double fieldBuildTime = Milliseconds(start);
+	std::vector<vec3> fieldOrigins(rayCount), fieldDirections(rayCount);
+	for (int i = 0; i < rayCount; i++)
+	{
+		fieldOrigins[i] = vec3((Random() - 0.5f) * side * radius, radius * 2.0f, (Random() - 0.5f) * side * radius);
+		fieldDirections[i] = vec3(Random() - 0.5f, -1.0f, Random() - 0.5f).normalize();
+	}
+
+	// the top level against every instance on its own
+	for (int i = 0; i < checks; i++)
+	{
+		RayHit fast, slow;
+		bool a = field.Raycast(fieldOrigins[i], fieldDirections[i], fast), b = false;
+		for (int k = 0; k < side * side; k++)
+		{
+			vec4 o = vec4(fieldOrigins[i].x, fieldOrigins[i].y, fieldOrigins[i].z, 1.0f) * toLocal[k];
+			vec4 d = vec4(fieldDirections[i].x, fieldDirections[i].y, fieldDirections[i].z, 0.0f) * toLocal[k];
+			if (bvh.Raycast(vec3(o.v[0], o.v[1], o.v[2]), vec3(d.v[0], d.v[1], d.v[2]), slow)) { b = true; slow.instance = k; }
+		}
+		if (a != b || (a && (fabsf(fast.t - slow.t) > 1e-4f * std::max(1.0f, slow.t))))
+		{
+			if (errors++ < 5) printf("instance ray %d: top level %s t %f, each instance %s t %f\n", i, a ? "hit" : "miss", fast.t, b ? "hit" : "miss", slow.t);
+		}
+	}
+	printf("instances: %d, top level built in %.3f ms, %d nodes\n", field.GetInstanceCount(), fieldBuildTime, field.GetNodeCount());
+
+	// packets of four against the same rays one at a time, closest and any hit
+	for (int i = 0; i + 4 <= checks; i += 4)
+	{
+		float o[3][4], d[3][4];
+		for (int k = 0; k < 4; k++)
+		{
+			o[0][k] = fieldOrigins[i + k].x; o[1][k] = fieldOrigins[i + k].y; o[2][k] = fieldOrigins[i + k].z;
+			d[0][k] = fieldDirections[i + k].x; d[1][k] = fieldDirections[i + k].y; d[2][k] = fieldDirections[i + k].z;
+		}
+		float4 origin[3] = { float4::Load(o[0]), float4::Load(o[1]), float4::Load(o[2]) };
+		float4 direction[3] = { float4::Load(d[0]), float4::Load(d[1]), float4::Load(d[2]) };
+		PacketHit packet, any;
+		int found = field.IntersectPacket(origin, direction, packet, 15, false);
+		int blocked = field.IntersectPacket(origin, direction, any, 15, true);
+		float t[4];
+		packet.t.Store(t);
+		for (int k = 0; k < 4; k++)
+		{
+			RayHit hit;
+			bool a = (found >> k & 1) != 0, b = field.Raycast(fieldOrigins[i + k], fieldDirections[i + k], hit);
+			if (a != b || (blocked >> k & 1) != b || (a && (fabsf(t[k] - hit.t) > 1e-4f * std::max(1.0f, hit.t) || packet.instance[k] != hit.instance)))
+			{
+				if (errors++ < 5) printf("packet ray %d: %s t %f, single ray %s t %f\n", i + k, a ? "hit" : "miss", t[k], b ? "hit" : "miss", hit.t);
+			}
+		}
+	}
+
+	printf("threads\tclosest Mrays/s\tany hit Mrays/s\tinstances Mrays/s\tpackets Mrays/s\thit rate\n");
+	std::vector<int> threadCounts = ThreadCounts();
+	for (unsigned int step = 0; step < threadCounts.size(); step++)
+	{
+		int t = threadCounts[step];
+		ThreadPool pool(t);
+		std::vector<char> hits(rayCount), occluded(rayCount), fieldHits(rayCount);
+		start = std::chrono::steady_clock::now();
+		pool.ParallelFor(rayCount, [&](int begin, int end)
+		{
+			for (int i = begin; i < end; i++)
+			{
+				RayHit hit;
+				hits[i] = bvh.Raycast(origins[i], directions[i], hit);
+			}
+		}, 1024);
+		double closestTime = Milliseconds(start);
+		start = std::chrono::steady_clock::now();
+		pool.ParallelFor(rayCount, [&](int begin, int end)
+		{
+			for (int i = begin; i < end; i++) occluded[i] = bvh.Occluded(origins[i], directions[i], 1e30f);
+		}, 1024);
+		double anyTime = Milliseconds(start);
+		start = std::chrono::steady_clock::now();
+		pool.ParallelFor(rayCount, [&](int begin, int end)
+		{
+			for (int i = begin; i < end; i++)
+			{
+				RayHit hit;
+				fieldHits[i] = field.Raycast(fieldOrigins[i], fieldDirections[i], hit);
+			}
+		}, 1024);
+		double fieldTime = Milliseconds(start);
+		start = std::chrono::steady_clock::now();
+		pool.ParallelFor(rayCount / 4, [&](int begin, int end)
+		{
+			for (int i = begin; i < end; i++)
+			{
+				float o[3][4], d[3][4];
+				for (int k = 0; k < 4; k++)
+				{
+					const vec3& a = fieldOrigins[i * 4 + k];
+					const vec3& b = fieldDirections[i * 4 + k];
+					o[0][k] = a.x; o[1][k] = a.y; o[2][k] = a.z;
+					d[0][k] = b.x; d[1][k] = b.y; d[2][k] = b.z;
+				}
+				float4 origin[3] = { float4::Load(o[0]), float4::Load(o[1]), float4::Load(o[2]) };
+				float4 direction[3] = { float4::Load(d[0]), float4::Load(d[1]), float4::Load(d[2]) };
+				PacketHit hit;
+				field.IntersectPacket(origin, direction, hit, 15, false);
+			}
+		}, 256);
+		double packetTime = Milliseconds(start);
+		int hitCount = 0;
+		for (int i = 0; i < rayCount; i++)
+		{
+			hitCount += hits[i];
+			if (hits[i] != occluded[i]) errors++;
+		}
+		printf("%d\t%.2f\t\t%.2f\t\t%.2f\t\t\t%.2f\t\t%.0f%%\n", t, rayCount / (closestTime * 1000.0), rayCount / (anyTime * 1000.0),
+			rayCount / (fieldTime * 1000.0), rayCount / 4 * 4 / (packetTime * 1000.0), 100.0 * hitCount / rayCount);
+	}
+	return errors ? 1 : 0;
+}
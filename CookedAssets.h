@@ -0,0 +1,428 @@
+#ifndef COOKEDASSETS_H
+#define COOKEDASSETS_H
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "VectorMath.h"
+#include "IndexedMesh.h"
+
+// FNV-1a, 64 bit, chained through h
+inline unsigned long long HashBytes(const void* data, size_t size, unsigned long long h = 14695981039346656037ULL)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++) h = (h ^ bytes[i]) * 1099511628211ULL;
+	return h;
+}
+
+inline bool ReadFile(const std::string& filename, std::vector<char>& data)
+{
+	FILE* file = fopen(filename.c_str(), "rb");
+	if (!file) return false;
+	data.clear();
+	char buffer[65536];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) data.insert(data.end(), buffer, buffer + n);
+	fclose(file);
+	return true;
+}
+
+inline unsigned short FloatToHalf(float f)
+{
+	unsigned int x;
+	memcpy(&x, &f, sizeof(x));
+	unsigned int sign = (x >> 16) & 0x8000;
+	int exponent = (int)((x >> 23) & 0xff) - 127 + 15;
+	unsigned int mantissa = x & 0x7fffff;
+	if (exponent <= 0) return (unsigned short)sign;						// denormals flush to zero
+	if (exponent >= 31) return (unsigned short)(sign | 0x7bff);			// clamped to the largest half
+	unsigned int half = sign | (exponent << 10) | (mantissa >> 13);
+	if (mantissa & 0x1000) half++;										// round half up, may carry into the exponent
+	return (unsigned short)std::min(half, sign | 0x7bffu);
+}
+
+inline float HalfToFloat(unsigned short h)
+{
+	unsigned int sign = (unsigned int)(h & 0x8000) << 16;
+	unsigned int exponent = (h >> 10) & 0x1f, mantissa = h & 0x3ff;
+	unsigned int x = exponent == 0 ? sign : sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+	float f;
+	memcpy(&f, &x, sizeof(f));
+	return f;
+}
+
+// average transformed vertices per triangle through a FIFO post-transform cache
+inline float AverageCacheMissRatio(const std::vector<unsigned int>& indices, int vertexCount, int cacheSize = 16)
+{
+	if (indices.size() < 3) return 0.0f;
+	std::vector<int> inserted(vertexCount, -cacheSize - 1);
+	int misses = 0;
+	for (unsigned int i = 0; i < indices.size(); i++)
+		if (misses - inserted[indices[i]] > cacheSize)
+			inserted[indices[i]] = misses++;
+	return (float)misses / (indices.size() / 3);
+}
+
+// Tipsify (Sander, Nehab and Barczak 2007): fans around recently used vertices so the
+// triangles reuse the post-transform cache, in linear time
+inline void OptimizeVertexCache(std::vector<unsigned int>& indices, int vertexCount, int cacheSize = 16)
+{
+	int triangleCount = (int)indices.size() / 3;
+	if (triangleCount == 0) return;
+
+	std::vector<int> live(vertexCount, 0), offsets(vertexCount + 1, 0), adjacency(triangleCount * 3);
+	for (int i = 0; i < triangleCount * 3; i++) live[indices[i]]++;
+	for (int v = 0; v < vertexCount; v++) offsets[v + 1] = offsets[v] + live[v];
+	std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+	for (int i = 0; i < triangleCount * 3; i++) adjacency[fill[indices[i]]++] = i / 3;
+
+	std::vector<int> stamps(vertexCount, 0), deadEnds;
+	std::vector<char> emitted(triangleCount, 0);
+	std::vector<unsigned int> result;
+	result.reserve(indices.size());
+	std::vector<int> candidates;
+	int time = cacheSize + 1, cursor = 0, fan = 0;
+
+	while (fan >= 0)
+	{
+		candidates.clear();
+		for (int a = offsets[fan]; a < offsets[fan + 1]; a++)
+		{
+			int t = adjacency[a];
+			if (emitted[t]) continue;
+			for (int k = 0; k < 3; k++)
+			{
+				int v = indices[t * 3 + k];
+				result.push_back(v);
+				deadEnds.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (time - stamps[v] > cacheSize) stamps[v] = time++;
+			}
+			emitted[t] = 1;
+		}
+
+		// the candidate that stays in the cache for all its remaining triangles, oldest first
+		fan = -1;
+		int best = -1;
+		for (unsigned int i = 0; i < candidates.size(); i++)
+		{
+			int v = candidates[i];
+			if (live[v] <= 0) continue;
+			int priority = time - stamps[v] + 2 * live[v] <= cacheSize ? time - stamps[v] : 0;
+			if (priority > best)
+			{
+				best = priority;
+				fan = v;
+			}
+		}
+		if (fan >= 0) continue;
+
+		while (!deadEnds.empty())
+		{
+			int v = deadEnds.back();
+			deadEnds.pop_back();
+			if (live[v] > 0) { fan = v; break; }
+		}
+		while (fan < 0 && cursor < vertexCount)
+		{
+			if (live[cursor] > 0) fan = cursor;
+			cursor++;
+		}
+	}
+	indices.swap(result);
+}
+
+// a quantized vertex, 16 bytes: position in 1/65535ths of the bounds (w unused), half
+// float texture coordinate, octahedral unit normal in signed 16 bit
+struct CookedVertex
+{
+	unsigned short position[4];
+	unsigned short texcoord[2];
+	short normal[2];
+};
+
+struct CookedMeshHeader
+{
+	char magic[4];				// "MSHC"
+	unsigned int version;
+	unsigned int vertexCount;
+	unsigned int indexSize;		// 2 or 4 bytes
+	unsigned int indexCounts[IndexedMesh::lodCount];
+	float boundsMin[3], boundsMax[3];
+};
+
+// an IndexedMesh ready to load without processing: every LOD reordered for the vertex
+// cache, vertices in first use order of the full LOD, quantized. File layout: header,
+// vertices, then the index lists of each LOD.
+class CookedMesh
+{
+	static short ToSnorm(float x) { return (short)floorf(std::max(-1.0f, std::min(1.0f, x)) * 32767.0f + 0.5f); }
+
+public:
+	static const unsigned int version = 1;
+
+	CookedMeshHeader header;
+	std::vector<CookedVertex> vertices;
+	std::vector<unsigned int> lods[IndexedMesh::lodCount];
+	float cacheMissRatio[2];	// of the full LOD before and after reordering, Cook only
+
+	static CookedMesh* Cook(const IndexedMesh& mesh)
+	{
+		CookedMesh* cooked = new CookedMesh();
+		int vertexCount = mesh.GetVertexCount();
+		for (int lod = 0; lod < IndexedMesh::lodCount; lod++) cooked->lods[lod] = mesh.lods[lod];
+		cooked->cacheMissRatio[0] = AverageCacheMissRatio(cooked->lods[0], vertexCount);
+		for (int lod = 0; lod < IndexedMesh::lodCount; lod++) OptimizeVertexCache(cooked->lods[lod], vertexCount);
+		cooked->cacheMissRatio[1] = AverageCacheMissRatio(cooked->lods[0], vertexCount);
+
+		// vertex fetch order: as the full LOD first uses them, then any it never uses
+		std::vector<unsigned int> remap(vertexCount, ~0u);
+		std::vector<int> order;
+		for (unsigned int i = 0; i < cooked->lods[0].size(); i++)
+			if (remap[cooked->lods[0][i]] == ~0u)
+			{
+				remap[cooked->lods[0][i]] = (unsigned int)order.size();
+				order.push_back(cooked->lods[0][i]);
+			}
+		for (int v = 0; v < vertexCount; v++)
+			if (remap[v] == ~0u)
+			{
+				remap[v] = (unsigned int)order.size();
+				order.push_back(v);
+			}
+		for (int lod = 0; lod < IndexedMesh::lodCount; lod++)
+			for (unsigned int i = 0; i < cooked->lods[lod].size(); i++) cooked->lods[lod][i] = remap[cooked->lods[lod][i]];
+
+		BoundingBox bounds = mesh.bounds;
+		vec3 extent = bounds.max - bounds.min;
+		float scale[3] = { extent.x > 0.0f ? 65535.0f / extent.x : 0.0f, extent.y > 0.0f ? 65535.0f / extent.y : 0.0f, extent.z > 0.0f ? 65535.0f / extent.z : 0.0f };
+		float minimum[3] = { bounds.min.x, bounds.min.y, bounds.min.z };
+		cooked->vertices.resize(vertexCount);
+		for (int v = 0; v < vertexCount; v++)
+		{
+			const float* source = &mesh.vertices[order[v] * IndexedMesh::vertexSize];
+			CookedVertex& vertex = cooked->vertices[v];
+			for (int k = 0; k < 3; k++) vertex.position[k] = (unsigned short)std::min(65535.0f, floorf((source[k] - minimum[k]) * scale[k] + 0.5f));
+			vertex.position[3] = 0;
+			vertex.texcoord[0] = FloatToHalf(source[3]);
+			vertex.texcoord[1] = FloatToHalf(source[4]);
+
+			// onto the octahedron |x| + |y| + |z| = 1, the lower half folded over the upper
+			float n[3] = { source[5], source[6], source[7] };
+			float l1 = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+			float u = l1 > 0.0f ? n[0] / l1 : 0.0f, w = l1 > 0.0f ? n[1] / l1 : 0.0f;
+			if (n[2] < 0.0f)
+			{
+				float fu = (1.0f - fabsf(w)) * (u >= 0.0f ? 1.0f : -1.0f), fw = (1.0f - fabsf(u)) * (w >= 0.0f ? 1.0f : -1.0f);
+				u = fu;
+				w = fw;
+			}
+			vertex.normal[0] = ToSnorm(u);
+			vertex.normal[1] = ToSnorm(w);
+		}
+
+		memcpy(cooked->header.magic, "MSHC", 4);
+		cooked->header.version = version;
+		cooked->header.vertexCount = vertexCount;
+		cooked->header.indexSize = vertexCount <= 65536 ? 2 : 4;
+		for (int lod = 0; lod < IndexedMesh::lodCount; lod++) cooked->header.indexCounts[lod] = (unsigned int)cooked->lods[lod].size();
+		for (int k = 0; k < 3; k++)
+		{
+			cooked->header.boundsMin[k] = minimum[k];
+			cooked->header.boundsMax[k] = k == 0 ? bounds.max.x : (k == 1 ? bounds.max.y : bounds.max.z);
+		}
+		return cooked;
+	}
+
+	// bytes in the file
+	size_t GetSize() const
+	{
+		size_t indices = 0;
+		for (int lod = 0; lod < IndexedMesh::lodCount; lod++) indices += lods[lod].size();
+		return sizeof(header) + vertices.size() * sizeof(CookedVertex) + indices * header.indexSize;
+	}
+
+	bool Write(const std::string& filename) const
+	{
+		FILE* file = fopen(filename.c_str(), "wb");
+		if (!file)
+		{
+			printf("cannot write %s\n", filename.c_str());
+			return false;
+		}
+		fwrite(&header, sizeof(header), 1, file);
+		if (!vertices.empty()) fwrite(&vertices[0], sizeof(CookedVertex), vertices.size(), file);
+		for (int lod = 0; lod < IndexedMesh::lodCount; lod++)
+		{
+			if (header.indexSize == 4)
+			{
+				if (!lods[lod].empty()) fwrite(&lods[lod][0], sizeof(unsigned int), lods[lod].size(), file);
+				continue;
+			}
+			std::vector<unsigned short> shortIndices(lods[lod].begin(), lods[lod].end());
+			if (!shortIndices.empty()) fwrite(&shortIndices[0], sizeof(unsigned short), shortIndices.size(), file);
+		}
+		bool written = ferror(file) == 0;
+		fclose(file);
+		if (!written) printf("cannot write %s\n", filename.c_str());
+		return written;
+	}
+
+	// 0 for a missing, truncated or foreign file
+	static CookedMesh* Read(const std::string& filename)
+	{
+		std::vector<char> data;
+		if (!ReadFile(filename, data) || data.size() < sizeof(CookedMeshHeader)) return 0;
+		CookedMesh* cooked = new CookedMesh();
+		memcpy(&cooked->header, &data[0], sizeof(CookedMeshHeader));
+		const CookedMeshHeader& header = cooked->header;
+		size_t size = sizeof(CookedMeshHeader) + (size_t)header.vertexCount * sizeof(CookedVertex), offset = size;
+		for (int lod = 0; lod < IndexedMesh::lodCount; lod++) size += (size_t)header.indexCounts[lod] * header.indexSize;
+		if (memcmp(header.magic, "MSHC", 4) != 0 || header.version != version || (header.indexSize != 2 && header.indexSize != 4) || data.size() != size)
+		{
+			delete cooked;
+			return 0;
+		}
+		cooked->vertices.resize(header.vertexCount);
+		if (header.vertexCount) memcpy(&cooked->vertices[0], &data[sizeof(CookedMeshHeader)], header.vertexCount * sizeof(CookedVertex));
+		for (int lod = 0; lod < IndexedMesh::lodCount; lod++)
+		{
+			cooked->lods[lod].resize(header.indexCounts[lod]);
+			for (unsigned int i = 0; i < header.indexCounts[lod]; i++, offset += header.indexSize)
+			{
+				if (header.indexSize == 4) memcpy(&cooked->lods[lod][i], &data[offset], 4);
+				else
+				{
+					unsigned short index;
+					memcpy(&index, &data[offset], 2);
+					cooked->lods[lod][i] = index;
+				}
+			}
+		}
+		cooked->cacheMissRatio[0] = cooked->cacheMissRatio[1] = 0.0f;
+		return cooked;
+	}
+
+	// back to float vertices, for the renderer's buffers
+	IndexedMesh* Expand() const
+	{
+		IndexedMesh* mesh = new IndexedMesh();
+		float extent[3];
+		for (int k = 0; k < 3; k++) extent[k] = (header.boundsMax[k] - header.boundsMin[k]) / 65535.0f;
+		mesh->vertices.resize(vertices.size() * IndexedMesh::vertexSize);
+		for (unsigned int v = 0; v < vertices.size(); v++)
+		{
+			const CookedVertex& vertex = vertices[v];
+			float* target = &mesh->vertices[v * IndexedMesh::vertexSize];
+			for (int k = 0; k < 3; k++) target[k] = header.boundsMin[k] + vertex.position[k] * extent[k];
+			target[3] = HalfToFloat(vertex.texcoord[0]);
+			target[4] = HalfToFloat(vertex.texcoord[1]);
+			float u = vertex.normal[0] / 32767.0f, w = vertex.normal[1] / 32767.0f, z = 1.0f - fabsf(u) - fabsf(w);
+			if (z < 0.0f)
+			{
+				float fu = (1.0f - fabsf(w)) * (u >= 0.0f ? 1.0f : -1.0f), fw = (1.0f - fabsf(u)) * (w >= 0.0f ? 1.0f : -1.0f);
+				u = fu;
+				w = fw;
+			}
+			float length = sqrtf(u * u + w * w + z * z);
+			target[5] = u / length;
+			target[6] = w / length;
+			target[7] = z / length;
+			mesh->bounds.Extend(vec3(target[0], target[1], target[2]));
+		}
+		for (int lod = 0; lod < IndexedMesh::lodCount; lod++) mesh->lods[lod] = lods[lod];
+		return mesh;
+	}
+};
+
+struct CookedTextureHeader
+{
+	char magic[4];				// "TEXC"
+	unsigned int version;
+	unsigned int width, height;
+	unsigned int levelCount;
+};
+
+// RGBA8 with the full mip chain, box filtered; file layout: header, then the levels
+// from the largest down to 1x1
+class CookedTexture
+{
+public:
+	static const unsigned int version = 1;
+
+	CookedTextureHeader header;
+	std::vector<std::vector<unsigned char> > levels;
+
+	static CookedTexture* Cook(const unsigned char* pixels, int width, int height, int components)
+	{
+		if (!pixels || width <= 0 || height <= 0 || components < 1 || components > 4) return 0;
+		CookedTexture* cooked = new CookedTexture();
+		memcpy(cooked->header.magic, "TEXC", 4);
+		cooked->header.version = version;
+		cooked->header.width = width;
+		cooked->header.height = height;
+
+		// grey, grey + alpha, RGB and RGBA all to RGBA
+		std::vector<unsigned char> level(width * height * 4);
+		for (int i = 0; i < width * height; i++)
+		{
+			const unsigned char* p = pixels + i * components;
+			unsigned char* q = &level[i * 4];
+			q[0] = p[0];
+			q[1] = components >= 3 ? p[1] : p[0];
+			q[2] = components >= 3 ? p[2] : p[0];
+			q[3] = components == 4 ? p[3] : (components == 2 ? p[1] : 255);
+		}
+		cooked->levels.push_back(level);
+
+		while (width > 1 || height > 1)
+		{
+			int w = std::max(1, width / 2), h = std::max(1, height / 2);
+			const std::vector<unsigned char>& source = cooked->levels.back();
+			std::vector<unsigned char> next(w * h * 4);
+			for (int y = 0; y < h; y++)
+				for (int x = 0; x < w; x++)
+				{
+					int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+					int y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+					for (int c = 0; c < 4; c++)
+						next[(y * w + x) * 4 + c] = (unsigned char)((source[(y0 * width + x0) * 4 + c] + source[(y0 * width + x1) * 4 + c] +
+							source[(y1 * width + x0) * 4 + c] + source[(y1 * width + x1) * 4 + c] + 2) / 4);
+				}
+			cooked->levels.push_back(next);
+			width = w;
+			height = h;
+		}
+		cooked->header.levelCount = (unsigned int)cooked->levels.size();
+		return cooked;
+	}
+
+	size_t GetSize() const
+	{
+		size_t size = sizeof(header);
+		for (unsigned int i = 0; i < levels.size(); i++) size += levels[i].size();
+		return size;
+	}
+
+	bool Write(const std::string& filename) const
+	{
+		FILE* file = fopen(filename.c_str(), "wb");
+		if (!file)
+		{
+			printf("cannot write %s\n", filename.c_str());
+			return false;
+		}
+		fwrite(&header, sizeof(header), 1, file);
+		for (unsigned int i = 0; i < levels.size(); i++) fwrite(&levels[i][0], 1, levels[i].size(), file);
+		bool written = ferror(file) == 0;
+		fclose(file);
+		if (!written) printf("cannot write %s\n", filename.c_str());
+		return written;
+	}
+};
+
+#endif
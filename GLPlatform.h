@@ -0,0 +1,23 @@
+#ifndef GLPLATFORM_H
+#define GLPLATFORM_H
+
+// the GL headers and entry point loader of each platform; window system headers (GLUT,
+// EGL) are left to the front ends
+#if defined(__APPLE__)
+#include <OpenGL/gl3.h>
+#include <OpenGL/glu.h>
+#else
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__)
+#include <windows.h>
+#endif
+#if defined(MESHLOADER_NO_GLEW)
+// Mesa and other Linux GL libraries export every entry point, no loader needed
+#define GL_GLEXT_PROTOTYPES 1
+#include <GL/gl.h>
+#include <GL/glext.h>
+#else
+#include <GL/glew.h>
+#endif
+#endif
+
+#endif
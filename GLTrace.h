@@ -0,0 +1,543 @@
+#ifndef GLTRACE_H
+#define GLTRACE_H
+
+// optional GL tracing layer, for builds with -DMESHLOADER_GL_TRACE. Included after the GL
+// headers, it replaces the GL entry points used by the renderer with wrappers that count
+// the calls of every function per frame and the state sets that change nothing (binding
+// the bound program, texture, vertex array, buffer or framebuffer again, enabling what is
+// enabled). Only client-side bookkeeping, so it works on any GL, Mesa's software GL too.
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <type_traits>
+
+class GLTrace
+{
+	enum StateKind { program = 1, vertexArray, activeTexture, texture, buffer, indexedBuffer, drawFramebuffer, readFramebuffer,
+		renderbuffer, capability, depthFunc, depthMask, colorMask, viewport };
+
+	std::map<unsigned long long, unsigned long long> state;	// what is known to be bound or set
+
+	static unsigned long long Key(StateKind kind, unsigned long long a = 0, unsigned long long b = 0)
+	{
+		return (unsigned long long)kind << 56 | (a & 0xffffffull) << 32 | (b & 0xffffffffull);
+	}
+
+	// records value, true if it was already set
+	bool Set(unsigned long long key, unsigned long long value)
+	{
+		std::map<unsigned long long, unsigned long long>::iterator known = state.find(key);
+		if (known != state.end() && known->second == value) return true;
+		state[key] = value;
+		return false;
+	}
+
+	unsigned long long Known(unsigned long long key)
+	{
+		std::map<unsigned long long, unsigned long long>::iterator known = state.find(key);
+		return known == state.end() ? 0 : known->second;
+	}
+
+	std::vector<unsigned int> frameCalls, frameRedundant;		// by function, this frame
+	std::vector<unsigned int> maxCalls, maxRedundant;			// worst frame after the first
+	std::vector<double> totalCalls, totalRedundant;
+	unsigned int maxAllCalls, maxAllRedundant;
+	int frames;												// rendered frames whose counts were added up
+
+public:
+	std::vector<std::string> names;
+
+	GLTrace() : maxAllCalls(0), maxAllRedundant(0), frames(-1) {}
+
+	static GLTrace& Get()
+	{
+		static GLTrace trace;
+		return trace;
+	}
+
+	int Register(const char* name)
+	{
+		names.push_back(name);
+		frameCalls.push_back(0);
+		frameRedundant.push_back(0);
+		maxCalls.push_back(0);
+		maxRedundant.push_back(0);
+		totalCalls.push_back(0.0);
+		totalRedundant.push_back(0.0);
+		return (int)names.size() - 1;
+	}
+
+	void Count(int function, bool redundant)
+	{
+		frameCalls[function]++;
+		if (redundant) frameRedundant[function]++;
+	}
+
+	// closes the running frame; the calls before the first frame (loading) and the first
+	// frame itself (lazily created resources) are left out of the statistics
+	void BeginFrame()
+	{
+		if (frames >= 0)
+		{
+			unsigned int calls = 0, redundant = 0;
+			for (unsigned int f = 0; f < names.size(); f++)
+			{
+				calls += frameCalls[f];
+				redundant += frameRedundant[f];
+				if (!frames) continue;
+				totalCalls[f] += frameCalls[f];
+				totalRedundant[f] += frameRedundant[f];
+				maxCalls[f] = std::max(maxCalls[f], frameCalls[f]);
+				maxRedundant[f] = std::max(maxRedundant[f], frameRedundant[f]);
+			}
+			if (frames)
+			{
+				maxAllCalls = std::max(maxAllCalls, calls);
+				maxAllRedundant = std::max(maxAllRedundant, redundant);
+			}
+		}
+		frames++;
+		std::fill(frameCalls.begin(), frameCalls.end(), 0);
+		std::fill(frameRedundant.begin(), frameRedundant.end(), 0);
+	}
+
+	int GetFrameCount() const { return std::max(frames - 1, 0); }
+
+	void PrintReport(int top = 12)
+	{
+		int count = GetFrameCount();
+		if (!count) return;
+		double calls = 0.0, redundant = 0.0;
+		std::vector<std::pair<double, int> > order;
+		for (unsigned int f = 0; f < names.size(); f++)
+		{
+			calls += totalCalls[f];
+			redundant += totalRedundant[f];
+			if (totalCalls[f] > 0.0) order.push_back(std::make_pair(-totalCalls[f], (int)f));
+		}
+		std::sort(order.begin(), order.end());
+		printf("gl calls per frame: %.1f (max %u), redundant state sets %.1f (max %u), %d functions\n",
+			calls / count, maxAllCalls, redundant / count, maxAllRedundant, (int)order.size());
+		for (int i = 0; i < (int)order.size() && i < top; i++)
+		{
+			int f = order[i].second;
+			printf("  %-28s %9.1f (max %u)", names[f].c_str(), totalCalls[f] / count, maxCalls[f]);
+			if (totalRedundant[f] > 0.0) printf(", %.1f redundant", totalRedundant[f] / count);
+			printf("\n");
+		}
+	}
+
+	// the worst frame against each limit: "calls", "redundant", a function name or
+	// "redundant:" and a function name; returns the number of limits exceeded
+	int CheckBudgets(const std::vector<std::pair<std::string, unsigned int> >& budgets)
+	{
+		int exceeded = 0;
+		for (unsigned int i = 0; i < budgets.size(); i++)
+		{
+			const std::string& name = budgets[i].first;
+			bool redundant = name.compare(0, 10, "redundant:") == 0;
+			std::string function = redundant ? name.substr(10) : name;
+			unsigned int worst = 0;
+			if (name == "calls") worst = maxAllCalls;
+			else if (name == "redundant") worst = maxAllRedundant;
+			else
+			{
+				std::vector<std::string>::iterator found = std::find(names.begin(), names.end(), function);
+				if (found == names.end())
+				{
+					printf("gl budget %s: no such traced function\n", name.c_str());
+					exceeded++;
+					continue;
+				}
+				int f = (int)(found - names.begin());
+				worst = redundant ? maxRedundant[f] : maxCalls[f];
+			}
+			if (worst <= budgets[i].second) continue;
+			printf("gl budget exceeded: %s %u per frame, limit %u\n", name.c_str(), worst, budgets[i].second);
+			exceeded++;
+		}
+		return exceeded;
+	}
+
+	// state hooks, true when the call changes nothing
+
+	static bool UseProgram(GLuint p) { return Get().Set(Key(program), p); }
+
+	static bool BindVertexArray(GLuint v) { return Get().Set(Key(vertexArray), v); }
+
+	static bool ActiveTexture(GLenum unit) { return Get().Set(Key(activeTexture), unit); }
+
+	static bool BindTexture(GLenum target, GLuint t)
+	{
+		GLTrace& trace = Get();
+		return trace.Set(Key(texture, trace.Known(Key(activeTexture)), target), t);
+	}
+
+	// the element array binding belongs to the vertex array object
+	static bool BindBuffer(GLenum target, GLuint b)
+	{
+		GLTrace& trace = Get();
+		unsigned long long owner = target == GL_ELEMENT_ARRAY_BUFFER ? trace.Known(Key(vertexArray)) : 0;
+		return trace.Set(Key(buffer, owner, target), b);
+	}
+
+	// also the generic binding of target
+	static bool BindBufferBase(GLenum target, GLuint index, GLuint b)
+	{
+		GLTrace& trace = Get();
+		trace.Set(Key(buffer, 0, target), b);
+		return trace.Set(Key(indexedBuffer, index, target), b);
+	}
+
+	static bool BindFramebuffer(GLenum target, GLuint f)
+	{
+		GLTrace& trace = Get();
+		bool draw = target != GL_READ_FRAMEBUFFER, read = target != GL_DRAW_FRAMEBUFFER;
+		bool drawSet = draw ? trace.Set(Key(drawFramebuffer), f) : true;
+		bool readSet = read ? trace.Set(Key(readFramebuffer), f) : true;
+		return drawSet && readSet;
+	}
+
+	static bool BindRenderbuffer(GLenum target, GLuint r) { return Get().Set(Key(renderbuffer, 0, target), r); }
+
+	static bool Enable(GLenum cap) { return Get().Set(Key(capability, 0, cap), 1); }
+
+	static bool Disable(GLenum cap) { return Get().Set(Key(capability, 0, cap), 0); }
+
+	static bool DepthFunc(GLenum f) { return Get().Set(Key(depthFunc), f); }
+
+	static bool DepthMask(GLboolean m) { return Get().Set(Key(depthMask), m); }
+
+	static bool ColorMask(GLboolean r, GLboolean g, GLboolean b, GLboolean a) { return Get().Set(Key(colorMask), r | g << 1 | b << 2 | a << 3); }
+
+	static bool Viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+	{
+		return Get().Set(Key(viewport), (unsigned long long)(x & 0xffff) << 48 | (unsigned long long)(y & 0xffff) << 32 | (unsigned long long)(width & 0xffff) << 16 | (height & 0xffff));
+	}
+
+	// a deleted object may have been bound anywhere; nothing is known afterwards
+	static bool Delete(GLsizei, const GLuint*) { Get().state.clear(); return false; }
+
+	static bool DeleteOne(GLuint) { Get().state.clear(); return false; }
+};
+
+// a GL entry point behind its call counter; resolve returns the function (or GLEW's
+// pointer) at call time, redundant is the state hook or 0
+template <typename F> struct GLTracedFunction;
+
+template <typename R, typename... A> struct GLTracedFunction<R(A...)>
+{
+	int function;
+	R (*(*resolve)())(A...);
+	bool (*redundant)(A...);
+
+	R operator()(A... args) const
+	{
+		GLTrace::Get().Count(function, redundant && redundant(args...));
+		return resolve()(args...);
+	}
+};
+
+#define GL_TRACE_STATE(name, hook) \
+	static const GLTracedFunction<std::remove_pointer<decltype(name)>::type> GLTraced_##name = { GLTrace::Get().Register(#name), []() { return name; }, hook };
+#define GL_TRACE(name) GL_TRACE_STATE(name, 0)
+
+GL_TRACE_STATE(glUseProgram, GLTrace::UseProgram)
+GL_TRACE_STATE(glBindVertexArray, GLTrace::BindVertexArray)
+GL_TRACE_STATE(glActiveTexture, GLTrace::ActiveTexture)
+GL_TRACE_STATE(glBindTexture, GLTrace::BindTexture)
+GL_TRACE_STATE(glBindBuffer, GLTrace::BindBuffer)
+GL_TRACE_STATE(glBindBufferBase, GLTrace::BindBufferBase)
+GL_TRACE_STATE(glBindFramebuffer, GLTrace::BindFramebuffer)
+GL_TRACE_STATE(glBindRenderbuffer, GLTrace::BindRenderbuffer)
+GL_TRACE_STATE(glEnable, GLTrace::Enable)
+GL_TRACE_STATE(glDisable, GLTrace::Disable)
+GL_TRACE_STATE(glDepthFunc, GLTrace::DepthFunc)
+GL_TRACE_STATE(glDepthMask, GLTrace::DepthMask)
+GL_TRACE_STATE(glColorMask, GLTrace::ColorMask)
+GL_TRACE_STATE(glViewport, GLTrace::Viewport)
+GL_TRACE_STATE(glDeleteBuffers, GLTrace::Delete)
+GL_TRACE_STATE(glDeleteTextures, GLTrace::Delete)
+GL_TRACE_STATE(glDeleteVertexArrays, GLTrace::Delete)
+GL_TRACE_STATE(glDeleteFramebuffers, GLTrace::Delete)
+GL_TRACE_STATE(glDeleteRenderbuffers, GLTrace::Delete)
+GL_TRACE_STATE(glDeleteProgram, GLTrace::DeleteOne)
+
+GL_TRACE(glGetUniformLocation)
+GL_TRACE(glUniform1i)
+GL_TRACE(glUniform1ui)
+GL_TRACE(glUniform1f)
+GL_TRACE(glUniform2f)
+GL_TRACE(glUniform3f)
+GL_TRACE(glUniform3i)
+GL_TRACE(glUniform4f)
+GL_TRACE(glUniform4fv)
+GL_TRACE(glUniformMatrix4fv)
+GL_TRACE(glDrawArrays)
+GL_TRACE(glDrawElements)
+GL_TRACE(glDrawElementsBaseVertex)
+GL_TRACE(glMultiDrawElementsIndirect)
+GL_TRACE(glDispatchCompute)
+GL_TRACE(glMemoryBarrier)
+GL_TRACE(glClear)
+GL_TRACE(glClearColor)
+GL_TRACE(glClearBufferfv)
+GL_TRACE(glBlitFramebuffer)
+GL_TRACE(glDrawBuffers)
+GL_TRACE(glFinish)
+GL_TRACE(glGetIntegerv)
+GL_TRACE(glGetString)
+GL_TRACE(glGetStringi)
+GL_TRACE(glGenBuffers)
+GL_TRACE(glBufferData)
+GL_TRACE(glBufferSubData)
+GL_TRACE(glCopyBufferSubData)
+GL_TRACE(glMapBufferRange)
+GL_TRACE(glUnmapBuffer)
+GL_TRACE(glGenVertexArrays)
+GL_TRACE(glEnableVertexAttribArray)
+GL_TRACE(glVertexAttribPointer)
+GL_TRACE(glVertexAttribIPointer)
+GL_TRACE(glVertexAttribI1ui)
+GL_TRACE(glVertexAttribDivisor)
+GL_TRACE(glGenTextures)
+GL_TRACE(glTexImage2D)
+GL_TRACE(glTexSubImage2D)
+GL_TRACE(glTexImage3D)
+GL_TRACE(glTexSubImage3D)
+GL_TRACE(glGetTexImage)
+GL_TRACE(glPixelStorei)
+GL_TRACE(glFenceSync)
+GL_TRACE(glClientWaitSync)
+GL_TRACE(glDeleteSync)
+GL_TRACE(glTexParameteri)
+GL_TRACE(glGenFramebuffers)
+GL_TRACE(glFramebufferTexture2D)
+GL_TRACE(glFramebufferRenderbuffer)
+GL_TRACE(glCheckFramebufferStatus)
+GL_TRACE(glGenRenderbuffers)
+GL_TRACE(glRenderbufferStorage)
+GL_TRACE(glGenQueries)
+GL_TRACE(glDeleteQueries)
+GL_TRACE(glBeginQuery)
+GL_TRACE(glEndQuery)
+GL_TRACE(glGetQueryObjectiv)
+GL_TRACE(glGetQueryObjectuiv)
+GL_TRACE(glGetQueryObjectui64v)
+GL_TRACE(glCreateShader)
+GL_TRACE(glShaderSource)
+GL_TRACE(glCompileShader)
+GL_TRACE(glGetShaderiv)
+GL_TRACE(glGetShaderInfoLog)
+GL_TRACE(glDeleteShader)
+GL_TRACE(glCreateProgram)
+GL_TRACE(glAttachShader)
+GL_TRACE(glDetachShader)
+GL_TRACE(glBindAttribLocation)
+GL_TRACE(glBindFragDataLocation)
+GL_TRACE(glLinkProgram)
+GL_TRACE(glGetProgramiv)
+GL_TRACE(glProgramParameteri)
+GL_TRACE(glProgramBinary)
+GL_TRACE(glGetProgramBinary)
+
+#undef glUseProgram
+#define glUseProgram GLTraced_glUseProgram
+#undef glBindVertexArray
+#define glBindVertexArray GLTraced_glBindVertexArray
+#undef glActiveTexture
+#define glActiveTexture GLTraced_glActiveTexture
+#undef glBindTexture
+#define glBindTexture GLTraced_glBindTexture
+#undef glBindBuffer
+#define glBindBuffer GLTraced_glBindBuffer
+#undef glBindBufferBase
+#define glBindBufferBase GLTraced_glBindBufferBase
+#undef glBindFramebuffer
+#define glBindFramebuffer GLTraced_glBindFramebuffer
+#undef glBindRenderbuffer
+#define glBindRenderbuffer GLTraced_glBindRenderbuffer
+#undef glEnable
+#define glEnable GLTraced_glEnable
+#undef glDisable
+#define glDisable GLTraced_glDisable
+#undef glDepthFunc
+#define glDepthFunc GLTraced_glDepthFunc
+#undef glDepthMask
+#define glDepthMask GLTraced_glDepthMask
+#undef glColorMask
+#define glColorMask GLTraced_glColorMask
+#undef glViewport
+#define glViewport GLTraced_glViewport
+#undef glDeleteBuffers
+#define glDeleteBuffers GLTraced_glDeleteBuffers
+#undef glDeleteTextures
+#define glDeleteTextures GLTraced_glDeleteTextures
+#undef glDeleteVertexArrays
+#define glDeleteVertexArrays GLTraced_glDeleteVertexArrays
+#undef glDeleteFramebuffers
+#define glDeleteFramebuffers GLTraced_glDeleteFramebuffers
+#undef glDeleteRenderbuffers
+#define glDeleteRenderbuffers GLTraced_glDeleteRenderbuffers
+#undef glDeleteProgram
+#define glDeleteProgram GLTraced_glDeleteProgram
+
+#undef glGetUniformLocation
+#define glGetUniformLocation GLTraced_glGetUniformLocation
+#undef glUniform1i
+#define glUniform1i GLTraced_glUniform1i
+#undef glUniform1ui
+#define glUniform1ui GLTraced_glUniform1ui
+#undef glUniform1f
+#define glUniform1f GLTraced_glUniform1f
+#undef glUniform2f
+#define glUniform2f GLTraced_glUniform2f
+#undef glUniform3f
+#define glUniform3f GLTraced_glUniform3f
+#undef glUniform3i
+#define glUniform3i GLTraced_glUniform3i
+#undef glUniform4f
+#define glUniform4f GLTraced_glUniform4f
+#undef glUniform4fv
+#define glUniform4fv GLTraced_glUniform4fv
+#undef glUniformMatrix4fv
+#define glUniformMatrix4fv GLTraced_glUniformMatrix4fv
+#undef glDrawArrays
+#define glDrawArrays GLTraced_glDrawArrays
+#undef glDrawElements
+#define glDrawElements GLTraced_glDrawElements
+#undef glDrawElementsBaseVertex
+#define glDrawElementsBaseVertex GLTraced_glDrawElementsBaseVertex
+#undef glMultiDrawElementsIndirect
+#define glMultiDrawElementsIndirect GLTraced_glMultiDrawElementsIndirect
+#undef glDispatchCompute
+#define glDispatchCompute GLTraced_glDispatchCompute
+#undef glMemoryBarrier
+#define glMemoryBarrier GLTraced_glMemoryBarrier
+#undef glClear
+#define glClear GLTraced_glClear
+#undef glClearColor
+#define glClearColor GLTraced_glClearColor
+#undef glClearBufferfv
+#define glClearBufferfv GLTraced_glClearBufferfv
+#undef glBlitFramebuffer
+#define glBlitFramebuffer GLTraced_glBlitFramebuffer
+#undef glDrawBuffers
+#define glDrawBuffers GLTraced_glDrawBuffers
+#undef glFinish
+#define glFinish GLTraced_glFinish
+#undef glGetIntegerv
+#define glGetIntegerv GLTraced_glGetIntegerv
+#undef glGetString
+#define glGetString GLTraced_glGetString
+#undef glGetStringi
+#define glGetStringi GLTraced_glGetStringi
+#undef glGenBuffers
+#define glGenBuffers GLTraced_glGenBuffers
+#undef glBufferData
+#define glBufferData GLTraced_glBufferData
+#undef glBufferSubData
+#define glBufferSubData GLTraced_glBufferSubData
+#undef glCopyBufferSubData
+#define glCopyBufferSubData GLTraced_glCopyBufferSubData
+#undef glMapBufferRange
+#define glMapBufferRange GLTraced_glMapBufferRange
+#undef glUnmapBuffer
+#define glUnmapBuffer GLTraced_glUnmapBuffer
+#undef glGenVertexArrays
+#define glGenVertexArrays GLTraced_glGenVertexArrays
+#undef glEnableVertexAttribArray
+#define glEnableVertexAttribArray GLTraced_glEnableVertexAttribArray
+#undef glVertexAttribPointer
+#define glVertexAttribPointer GLTraced_glVertexAttribPointer
+#undef glVertexAttribIPointer
+#define glVertexAttribIPointer GLTraced_glVertexAttribIPointer
+#undef glVertexAttribI1ui
+#define glVertexAttribI1ui GLTraced_glVertexAttribI1ui
+#undef glVertexAttribDivisor
+#define glVertexAttribDivisor GLTraced_glVertexAttribDivisor
+#undef glGenTextures
+#define glGenTextures GLTraced_glGenTextures
+#undef glTexImage2D
+#define glTexImage2D GLTraced_glTexImage2D
+#undef glTexSubImage2D
+#define glTexSubImage2D GLTraced_glTexSubImage2D
+#undef glTexImage3D
+#define glTexImage3D GLTraced_glTexImage3D
+#undef glTexSubImage3D
+#define glTexSubImage3D GLTraced_glTexSubImage3D
+#undef glGetTexImage
+#define glGetTexImage GLTraced_glGetTexImage
+#undef glPixelStorei
+#define glPixelStorei GLTraced_glPixelStorei
+#undef glFenceSync
+#define glFenceSync GLTraced_glFenceSync
+#undef glClientWaitSync
+#define glClientWaitSync GLTraced_glClientWaitSync
+#undef glDeleteSync
+#define glDeleteSync GLTraced_glDeleteSync
+#undef glTexParameteri
+#define glTexParameteri GLTraced_glTexParameteri
+#undef glGenFramebuffers
+#define glGenFramebuffers GLTraced_glGenFramebuffers
+#undef glFramebufferTexture2D
+#define glFramebufferTexture2D GLTraced_glFramebufferTexture2D
+#undef glFramebufferRenderbuffer
+#define glFramebufferRenderbuffer GLTraced_glFramebufferRenderbuffer
+#undef glCheckFramebufferStatus
+#define glCheckFramebufferStatus GLTraced_glCheckFramebufferStatus
+#undef glGenRenderbuffers
+#define glGenRenderbuffers GLTraced_glGenRenderbuffers
+#undef glRenderbufferStorage
+#define glRenderbufferStorage GLTraced_glRenderbufferStorage
+#undef glGenQueries
+#define glGenQueries GLTraced_glGenQueries
+#undef glDeleteQueries
+#define glDeleteQueries GLTraced_glDeleteQueries
+#undef glBeginQuery
+#define glBeginQuery GLTraced_glBeginQuery
+#undef glEndQuery
+#define glEndQuery GLTraced_glEndQuery
+#undef glGetQueryObjectiv
+#define glGetQueryObjectiv GLTraced_glGetQueryObjectiv
+#undef glGetQueryObjectuiv
+#define glGetQueryObjectuiv GLTraced_glGetQueryObjectuiv
+#undef glGetQueryObjectui64v
+#define glGetQueryObjectui64v GLTraced_glGetQueryObjectui64v
+#undef glCreateShader
+#define glCreateShader GLTraced_glCreateShader
+#undef glShaderSource
+#define glShaderSource GLTraced_glShaderSource
+#undef glCompileShader
+#define glCompileShader GLTraced_glCompileShader
+#undef glGetShaderiv
+#define glGetShaderiv GLTraced_glGetShaderiv
+#undef glGetShaderInfoLog
+#define glGetShaderInfoLog GLTraced_glGetShaderInfoLog
+#undef glDeleteShader
+#define glDeleteShader GLTraced_glDeleteShader
+#undef glCreateProgram
+#define glCreateProgram GLTraced_glCreateProgram
+#undef glAttachShader
+#define glAttachShader GLTraced_glAttachShader
+#undef glDetachShader
+#define glDetachShader GLTraced_glDetachShader
+#undef glBindAttribLocation
+#define glBindAttribLocation GLTraced_glBindAttribLocation
+#undef glBindFragDataLocation
+#define glBindFragDataLocation GLTraced_glBindFragDataLocation
+#undef glLinkProgram
+#define glLinkProgram GLTraced_glLinkProgram
+#undef glGetProgramiv
+#define glGetProgramiv GLTraced_glGetProgramiv
+#undef glProgramParameteri
+#define glProgramParameteri GLTraced_glProgramParameteri
+#undef glProgramBinary
+#define glProgramBinary GLTraced_glProgramBinary
+#undef glGetProgramBinary
+#define glGetProgramBinary GLTraced_glGetProgramBinary
+
+#endif
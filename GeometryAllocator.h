@@ -0,0 +1,116 @@
+#ifndef GEOMETRYALLOCATOR_H
+#define GEOMETRYALLOCATOR_H
+
+#include <map>
+#include <set>
+#include <utility>
+
+// suballocates [0, capacity) in whole elements (vertices or indices of a shared buffer).
+// Free ranges are kept both by offset, to merge with their neighbours on release, and
+// by size, so that Allocate takes the smallest range that fits (best fit).
+class RangeAllocator
+{
+	typedef std::pair<unsigned int, unsigned int> SizeOffset;
+
+	std::map<unsigned int, unsigned int> freeByOffset;	// offset -> size
+	std::set<SizeOffset> freeBySize;
+	unsigned int capacity, used;
+	int allocations;
+
+	void Insert(unsigned int offset, unsigned int size)
+	{
+		freeByOffset[offset] = size;
+		freeBySize.insert(SizeOffset(size, offset));
+	}
+
+	void Erase(std::map<unsigned int, unsigned int>::iterator range)
+	{
+		freeBySize.erase(SizeOffset(range->second, range->first));
+		freeByOffset.erase(range);
+	}
+
+public:
+	static const unsigned int invalid = 0xffffffff;
+
+	struct Stats
+	{
+		unsigned int capacity, used, freeRanges, largestFree;
+		int allocations;
+
+		// share of the free space that is not in the largest free range, 0 if it is all in one piece
+		float GetFragmentation() const
+		{
+			unsigned int free = capacity - used;
+			return free ? 1.0f - (float)largestFree / free : 0.0f;
+		}
+	};
+
+	RangeAllocator(unsigned int capacity = 0) : capacity(0), used(0), allocations(0) { Grow(capacity); }
+
+	// offset of size free elements, or invalid when no free range is large enough
+	unsigned int Allocate(unsigned int size)
+	{
+		if (size == 0) return invalid;
+		std::set<SizeOffset>::iterator fit = freeBySize.lower_bound(SizeOffset(size, 0));
+		if (fit == freeBySize.end()) return invalid;
+
+		unsigned int offset = fit->second, rangeSize = fit->first;
+		Erase(freeByOffset.find(offset));
+		if (rangeSize > size) Insert(offset + size, rangeSize - size);
+		used += size;
+		allocations++;
+		return offset;
+	}
+
+	void Free(unsigned int offset, unsigned int size)
+	{
+		if (size == 0 || offset == invalid) return;
+		used -= size;
+		allocations--;
+
+		std::map<unsigned int, unsigned int>::iterator next = freeByOffset.lower_bound(offset);
+		if (next != freeByOffset.end() && offset + size == next->first)
+		{
+			size += next->second;
+			Erase(next);
+		}
+		std::map<unsigned int, unsigned int>::iterator previous = freeByOffset.lower_bound(offset);
+		if (previous != freeByOffset.begin())
+		{
+			--previous;
+			if (previous->first + previous->second == offset)
+			{
+				offset = previous->first;
+				size += previous->second;
+				Erase(previous);
+			}
+		}
+		Insert(offset, size);
+	}
+
+	// appends free space at the end, merged with a free range that ends there
+	void Grow(unsigned int newCapacity)
+	{
+		if (newCapacity <= capacity) return;
+		unsigned int offset = capacity, size = newCapacity - capacity;
+		capacity = newCapacity;
+		used += size;
+		allocations++;
+		Free(offset, size);
+	}
+
+	unsigned int GetCapacity() const { return capacity; }
+
+	Stats GetStats() const
+	{
+		Stats stats;
+		stats.capacity = capacity;
+		stats.used = used;
+		stats.freeRanges = (unsigned int)freeByOffset.size();
+		stats.largestFree = freeBySize.empty() ? 0 : freeBySize.rbegin()->first;
+		stats.allocations = allocations;
+		return stats;
+	}
+};
+
+#endif
@@ -0,0 +1,118 @@
+// CPU stress test for the RangeAllocator behind the shared geometry buffers, no GL needed.
+// Loads a few thousand meshes of mixed sizes, then repeatedly unloads a random part of them
+// and loads new ones, growing the capacity by doubling like GeometryBuffer does.
+//   g++ -O2 -std=c++11 GeometryBench.cpp -o GeometryBench
+//   ./GeometryBench [meshes] [rounds]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include "GeometryAllocator.h"
+
+struct Allocation
+{
+	unsigned int firstVertex, vertexCount, firstIndex, indexCount;
+};
+
+// between 24 and 24 * 2^10 vertices, log-uniform like a mix of props, characters and terrain
+unsigned int RandomVertexCount()
+{
+	return (unsigned int)(24.0 * pow(2.0, 10.0 * rand() / RAND_MAX));
+}
+
+unsigned int Allocate(RangeAllocator& ranges, unsigned int size, int& growths)
+{
+	unsigned int offset = ranges.Allocate(size);
+	if (offset != RangeAllocator::invalid) return offset;
+	unsigned int capacity = std::max(ranges.GetCapacity(), 1u << 12);
+	while (capacity < ranges.GetCapacity() + size) capacity *= 2;
+	ranges.Grow(capacity);
+	growths++;
+	return ranges.Allocate(size);
+}
+
+// every element owned by at most one live allocation
+bool Overlaps(const std::vector<Allocation>& live, const RangeAllocator& vertices, const RangeAllocator& indices)
+{
+	std::vector<char> vertexUsed(vertices.GetCapacity(), 0), indexUsed(indices.GetCapacity(), 0);
+	for (unsigned int i = 0; i < live.size(); i++)
+	{
+		for (unsigned int v = 0; v < live[i].vertexCount; v++)
+			if (vertexUsed[live[i].firstVertex + v]++) return true;
+		for (unsigned int k = 0; k < live[i].indexCount; k++)
+			if (indexUsed[live[i].firstIndex + k]++) return true;
+	}
+	return false;
+}
+
+int main(int argc, char* argv[])
+{
+	int meshCount = argc > 1 ? atoi(argv[1]) : 5000;
+	int rounds = argc > 2 ? atoi(argv[2]) : 20;
+	srand(1);
+
+	RangeAllocator vertices, indices;
+	std::vector<Allocation> live;
+	int vertexGrowths = 0, indexGrowths = 0, operations = 0;
+	double milliseconds = 0.0;
+
+	printf("round\tlive\tvertex capacity\tused %%\tfree ranges\tfragmented %%\tindex capacity\tused %%\tfree ranges\tfragmented %%\n");
+	for (int round = 0; round <= rounds; round++)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		// round 0 loads the scene, later rounds unload a random third and load as many new meshes
+		int unloads = round ? (int)live.size() / 3 : 0;
+		for (int i = 0; i < unloads; i++)
+		{
+			int victim = rand() % live.size();
+			vertices.Free(live[victim].firstVertex, live[victim].vertexCount);
+			indices.Free(live[victim].firstIndex, live[victim].indexCount);
+			live[victim] = live.back();
+			live.pop_back();
+		}
+		int loads = round ? unloads : meshCount;
+		for (int i = 0; i < loads; i++)
+		{
+			Allocation allocation;
+			allocation.vertexCount = RandomVertexCount();
+			allocation.indexCount = allocation.vertexCount * 6;
+			allocation.firstVertex = Allocate(vertices, allocation.vertexCount, vertexGrowths);
+			allocation.firstIndex = Allocate(indices, allocation.indexCount, indexGrowths);
+			live.push_back(allocation);
+		}
+
+		milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		operations += unloads + loads;
+
+		RangeAllocator::Stats v = vertices.GetStats(), k = indices.GetStats();
+		printf("%d\t%d\t%u\t\t%.1f\t%u\t\t%.1f\t\t%u\t%.1f\t%u\t\t%.1f\n", round, (int)live.size(),
+			v.capacity, 100.0 * v.used / v.capacity, v.freeRanges, v.GetFragmentation() * 100.0,
+			k.capacity, 100.0 * k.used / k.capacity, k.freeRanges, k.GetFragmentation() * 100.0);
+		if (Overlaps(live, vertices, indices))
+		{
+			printf("overlapping allocations after round %d\n", round);
+			return 1;
+		}
+	}
+
+	printf("%d loads and unloads in %.3f ms (%.3f us each), %d vertex and %d index buffer growths\n",
+		operations, milliseconds, milliseconds * 1000.0 / operations, vertexGrowths, indexGrowths);
+
+	for (unsigned int i = 0; i < live.size(); i++)
+	{
+		vertices.Free(live[i].firstVertex, live[i].vertexCount);
+		indices.Free(live[i].firstIndex, live[i].indexCount);
+	}
+	RangeAllocator::Stats v = vertices.GetStats(), k = indices.GetStats();
+	if (v.used || k.used || v.freeRanges != 1 || k.freeRanges != 1)
+	{
+		printf("free space did not merge back into one range\n");
+		return 1;
+	}
+	printf("all freed: one free range per buffer\n");
+	return 0;
+}
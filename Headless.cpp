@@ -0,0 +1,311 @@
+// offscreen front end of the renderer library, for benchmarks and tests
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "GLPlatform.h"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include "InputScript.h"
+#include "Renderer.h"
+#include "ParallelFor.h"
+
+// value at fraction q of the sorted times
+double Percentile(const std::vector<double>& sorted, double q)
+{
+	return sorted[std::min((size_t)(q * sorted.size()), sorted.size() - 1)];
+}
+
+// the run's setup, frame time distribution and per frame counters, for trend tracking
+void WriteBenchmarkJson(const std::string& filename, const std::vector<double>& frameTimes, const RenderStats& totals)
+{
+	FILE* file = fopen(filename.c_str(), "w");
+	if (!file)
+	{
+		printf("cannot write %s\n", filename.c_str());
+		return;
+	}
+	std::string renderer = (const char*)glGetString(GL_RENDERER);
+	std::replace(renderer.begin(), renderer.end(), '"', '\'');
+	std::string path = options.inputPath;
+	std::replace(path.begin(), path.end(), '\\', '/');
+	std::vector<double> sorted = frameTimes;
+	std::sort(sorted.begin(), sorted.end());
+	double n = (double)frameTimes.size(), total = 0.0, squares = 0.0;
+	for (unsigned int i = 0; i < frameTimes.size(); i++) total += frameTimes[i];
+	for (unsigned int i = 0; i < frameTimes.size(); i++) squares += (frameTimes[i] - total / n) * (frameTimes[i] - total / n);
+
+	fprintf(file, "{\n  \"gl_renderer\": \"%s\",\n", renderer.c_str());
+	fprintf(file, "  \"setup\": {\"path\": \"%s\", \"frames\": %d, \"dt\": %g, \"width\": %d, \"height\": %d, \"seed\": %d,\n",
+		path.c_str(), (int)frameTimes.size(), options.fixedDt, options.width, options.height, options.seed);
+	fprintf(file, "    \"shading\": \"%s\", \"point_lights\": %d, \"objects\": %d, \"synthetic_objects\": %d, \"synthetic_triangles\": %d, \"trees\": %d,\n",
+		options.deferred ? "deferred" : (options.forwardPlus ? "forward+" : "forward"), options.forwardPlus || options.deferred ? options.pointLights : 0,
+		GetObjectCount(), options.objects, options.triangles, options.trees);
+	fprintf(file, "    \"prepass\": %s, \"sort\": %s, \"occlusion\": %s, \"softocclusion\": %s, \"gpudriven\": %s, \"meshlets\": %s, \"imposters\": %g},\n",
+		options.depthPrepass ? "true" : "false", options.sortOpaque ? "true" : "false", options.occlusionCulling ? "true" : "false",
+		options.softwareOcclusion ? "true" : "false", options.gpuDriven ? "true" : "false", options.meshlets ? "true" : "false", options.imposters);
+	fprintf(file, "  \"frame_ms\": {\"avg\": %.4f, \"stddev\": %.4f, \"min\": %.4f, \"median\": %.4f, \"p90\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f},\n",
+		total / n, sqrt(squares / n), sorted.front(), Percentile(sorted, 0.5), Percentile(sorted, 0.9), Percentile(sorted, 0.95), Percentile(sorted, 0.99), sorted.back());
+	fprintf(file, "  \"per_frame\": {\"light_grid_ms\": %.4f, \"submission_ms\": %.4f, \"cull_ms\": %.4f, \"occlusion_ms\": %.4f, \"meshlet_ms\": %.4f, \"texture_ms\": %.4f,\n",
+		totals.lightGridTime / n, totals.submissionTime / n, totals.cullTime / n, totals.occlusionTime / n, totals.meshletTime / n, totals.textureTime / n);
+	fprintf(file, "    \"draw_calls\": %.2f, \"objects_culled\": %.2f, \"occlusion_queries\": %.2f, \"meshlets_visible\": %.2f",
+		totals.drawCalls / n, totals.objectsCulled / n, totals.occlusionQueries / n, totals.meshletsVisible / n);
+	if (options.passStats)
+		fprintf(file, ",\n    \"depth_pass_ms\": %.4f, \"shading_pass_ms\": %.4f, \"lighting_pass_ms\": %.4f, \"shadow_pass_ms\": %.4f, \"fragments_shaded\": %u, \"fragments_lit\": %u",
+			totals.depthPassTime / n, totals.shadingPassTime / n, totals.lightingPassTime / n, totals.shadowPassTime / n, totals.fragmentsShaded, totals.fragmentsLit);
+	fprintf(file, "},\n  \"frame_times_ms\": [");
+	for (unsigned int i = 0; i < frameTimes.size(); i++) fprintf(file, "%s%.4f", i ? ", " : "", frameTimes[i]);
+	fprintf(file, "]\n}\n");
+	fclose(file);
+	printf("benchmark written to %s\n", filename.c_str());
+}
+
+// the GL frame against the ray traced one: the CPU image timed on 1, 2, 4 ... threads up to
+// every hardware thread, written to options.rayTraceFile, then compared pixel by pixel.
+// Filtering and rasterization rules differ a little, so a pixel only counts as different
+// past a few levels; returns whether more than 1% of the pixels are
+bool CompareRayTraced()
+{
+	int width = options.width, height = options.height;
+	std::vector<unsigned char> gl(width * height * 3), traced(width * height * 3);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &gl[0]);
+
+	printf("ray traced %dx%d: threads  ms  Mrays/s  speedup\n", width, height);
+	std::vector<int> threadCounts = ThreadCounts();
+	double single = 0.0;
+	for (unsigned int step = 0; step < threadCounts.size(); step++)
+	{
+		int threads = threadCounts[step];
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		long long rays = RayTraceScene(width, height, &traced[0], threads);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (threads == 1) single = ms;
+		printf("  %d  %.1f  %.2f  %.2fx\n", threads, ms, rays / (ms * 1000.0), single / ms);
+	}
+
+	FILE* file = fopen(options.rayTraceFile.c_str(), "wb");
+	if (file)
+	{
+		fprintf(file, "P6 %d %d 255\n", width, height);
+		for (int y = height - 1; y >= 0; y--) fwrite(&traced[y * width * 3], 1, width * 3, file);
+		fclose(file);
+		printf("ray traced frame written to %s\n", options.rayTraceFile.c_str());
+	}
+	else printf("cannot write %s\n", options.rayTraceFile.c_str());
+
+	const int tolerance = 24;
+	int differing = 0;
+	double total = 0.0;
+	for (int i = 0; i < width * height; i++)
+	{
+		int worst = 0;
+		for (int c = 0; c < 3; c++) worst = std::max(worst, abs(gl[i * 3 + c] - traced[i * 3 + c]));
+		total += worst;
+		if (worst > tolerance) differing++;
+	}
+	double percent = 100.0 * differing / (width * height);
+	printf("ray traced vs GL: %d pixels (%.2f%%) differ by more than %d levels, mean difference %.2f\n",
+		differing, percent, tolerance, total / (width * height));
+	return percent > 1.0;
+}
+
+// offscreen harness: renders options.frames frames with a fixed time step into a
+// framebuffer object on a surfaceless EGL context (Mesa's software GL works) and
+// prints frame time statistics
+int main(int argc, char * argv[]) 
+{
+	ParseOptions(argc, argv);
+
+	EGLDisplay display = EGL_NO_DISPLAY;
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay) display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) { printf("Cannot initialize EGL\n"); return 1; }
+
+	EGLint configAttributes[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+	EGLConfig config;
+	EGLint nConfigs = 0;
+	eglChooseConfig(display, configAttributes, &config, 1, &nConfigs);
+	eglBindAPI(EGL_OPENGL_API);
+
+	EGLContext context = eglCreateContext(display, nConfigs ? config : (EGLConfig)0, EGL_NO_CONTEXT, NULL);
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+	{
+		printf("Cannot create GL context\n");
+		return 1;
+	}
+
+#if !defined(MESHLOADER_NO_GLEW)
+	glewExperimental = true;	
+	glewInit();
+#endif
+	printf("GL Renderer  : %s\n", glGetString(GL_RENDERER));
+	printf("GL Version (string)  : %s\n", glGetString(GL_VERSION));
+	glGetIntegerv(GL_MAJOR_VERSION, &majorVersion);
+	glGetIntegerv(GL_MINOR_VERSION, &minorVersion);
+
+	unsigned int fbo, renderbuffers[2];
+	glGenFramebuffers(1, &fbo);
+	glGenRenderbuffers(2, &renderbuffers[0]);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, options.width, options.height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+	glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, options.width, options.height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) { printf("Incomplete framebuffer\n"); return 1; }
+
+	// a path replaces the keyboard and sets the length of the run
+	InputScript script;
+	if (!options.inputPath.empty())
+	{
+		const char* builtin = InputScript::GetBuiltin(options.inputPath);
+		if (builtin ? !script.Parse(builtin) : !script.Load(options.inputPath)) { printf("Invalid path %s\n", options.inputPath.c_str()); return 1; }
+		options.frames = script.GetFrameCount();
+	}
+
+	onInitialization();
+
+	std::vector<double> frameTimes;
+	RenderStats totals;
+	double maxTextureTime = 0.0;
+	int gpuVisibleFrames = 0, gpuTriangleFrames = 0;	// the frames whose GpuScene survivors and triangles were counted
+	for (int frame = 0; frame < options.frames; frame++)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		BeginProfilerFrame();
+		if (script.GetFrameCount()) script.Apply(frame, keyboardState);
+
+		ClearFrame();
+		UpdateCamera(options.fixedDt);
+		DrawScene(options.fixedDt);
+		glFinish();
+
+		frameTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		const RenderStats& stats = GetRenderStats();
+		totals.lightGridTime += stats.lightGridTime;
+		totals.depthPassTime += stats.depthPassTime;
+		totals.shadingPassTime += stats.shadingPassTime;
+		totals.lightingPassTime += stats.lightingPassTime;
+		totals.shadowPassTime += stats.shadowPassTime;
+		totals.fragmentsShaded += stats.fragmentsShaded / options.frames;
+		totals.fragmentsLit += stats.fragmentsLit / options.frames;
+		totals.fragmentInvocations += stats.fragmentInvocations / options.frames;
+		totals.occlusionTime += stats.occlusionTime;
+		totals.objectsCulled += stats.objectsCulled;
+		totals.occlusionQueries += stats.occlusionQueries;
+		totals.occluderTriangles += stats.occluderTriangles;
+		totals.submissionTime += stats.submissionTime;
+		totals.cullTime += stats.cullTime;
+		totals.drawCalls += stats.drawCalls;
+		if (stats.gpuVisibleObjects >= 0)
+		{
+			totals.gpuVisibleObjects += stats.gpuVisibleObjects;
+			gpuVisibleFrames++;
+		}
+		if (stats.gpuTriangles >= 0)
+		{
+			totals.gpuTriangles += stats.gpuTriangles;
+			gpuTriangleFrames++;
+		}
+		totals.imposters += stats.imposters;
+		totals.imposterBakeTime = stats.imposterBakeTime;
+		totals.imposterAtlasBytes = stats.imposterAtlasBytes;
+		totals.meshletTime += stats.meshletTime;
+		totals.meshletsTested += stats.meshletsTested;
+		totals.meshletsVisible += stats.meshletsVisible;
+		totals.meshletTrianglesTested += stats.meshletTrianglesTested / options.frames;
+		totals.meshletTrianglesVisible += stats.meshletTrianglesVisible / options.frames;
+		totals.textureTime += stats.textureTime;
+		totals.texturesPending = stats.texturesPending;
+		maxTextureTime = std::max(maxTextureTime, stats.textureTime);
+		totals.transformTime += stats.transformTime;
+		totals.transformNodes += stats.transformNodes;
+		totals.broadPhaseTime += stats.broadPhaseTime;
+		totals.broadPhaseMoves += stats.broadPhaseMoves;
+		totals.broadPhasePairs += stats.broadPhasePairs;
+		totals.terrainTime += stats.terrainTime;
+		totals.terrainNodes += stats.terrainNodes;
+		totals.terrainTriangles += stats.terrainTriangles / options.frames;
+		totals.terrainLoads += stats.terrainLoads;
+		totals.terrainResidentTiles = stats.terrainResidentTiles;
+		totals.terrainResidentBytes = std::max(totals.terrainResidentBytes, stats.terrainResidentBytes);
+		totals.terrainFileBytes = stats.terrainFileBytes;
+		totals.terrainExtent = stats.terrainExtent;
+	}
+
+	bool rayTracedDiffers = !options.rayTraceFile.empty() && CompareRayTraced();
+	WriteProfile();
+	int budgetsExceeded = CheckGLBudgets();
+	if (frameTimes.empty()) return budgetsExceeded ? 2 : (rayTracedDiffers ? 3 : 0);
+	double total = 0.0;
+	for (unsigned int i = 0; i < frameTimes.size(); i++) total += frameTimes[i];
+	std::vector<double> sorted = frameTimes;
+	std::sort(sorted.begin(), sorted.end());
+	bool pointLights = options.forwardPlus || options.deferred;
+	printf("%dx%d, %d frames, %s, %d point lights\n", options.width, options.height, (int)frameTimes.size(),
+		options.deferred ? "deferred" : (options.forwardPlus ? "forward+" : "forward"), pointLights ? options.pointLights : 0);
+	printf("frame ms: avg %.3f  min %.3f  median %.3f  p95 %.3f  max %.3f\n", total / frameTimes.size(),
+		sorted.front(), Percentile(sorted, 0.5), Percentile(sorted, 0.95), sorted.back());
+	if (pointLights) printf("light grid ms: avg %.3f\n", totals.lightGridTime / frameTimes.size());
+	PrintGeometryStats();
+	if (options.occlusionCulling || options.softwareOcclusion)
+		printf("occlusion: %.1f of %d objects culled, %.1f queries, %.1f occluder triangles, %.3f ms per frame\n",
+			(double)totals.objectsCulled / frameTimes.size(), GetObjectCount(), (double)totals.occlusionQueries / frameTimes.size(),
+			(double)totals.occluderTriangles / frameTimes.size(), totals.occlusionTime / frameTimes.size());
+	printf("submission ms: avg %.3f  shading draw calls %.1f\n", totals.submissionTime / frameTimes.size(),
+		(double)totals.drawCalls / frameTimes.size());
+	bool gpuCompute;
+	int gpuObjects;
+	if (GetGpuSceneInfo(gpuCompute, gpuObjects))
+	{
+		printf("gpu driven: %s, %d objects batched, cull %.3f ms", gpuCompute ? "compute culling + multi-draw indirect" :
+			"CPU culling fallback", gpuObjects, totals.cullTime / frameTimes.size());
+		if (gpuVisibleFrames) printf(", %.1f visible", (double)totals.gpuVisibleObjects / gpuVisibleFrames);
+		if (gpuTriangleFrames) printf(", %.0f triangles", (double)totals.gpuTriangles / gpuTriangleFrames);
+		printf("\n");
+		if (options.imposters > 0.0f)
+			printf("imposters: %.1f per frame (%.0f triangles) from %.2f units, the meshes gone at %.2f; atlases %.0f KB, baked in %.1f ms\n",
+				(double)totals.imposters / frameTimes.size(), 2.0 * totals.imposters / frameTimes.size(), options.imposters, 1.25f * options.imposters,
+				totals.imposterAtlasBytes / 1024.0, totals.imposterBakeTime);
+	}
+	if (options.meshlets)
+		printf("meshlets: %.1f of %.1f visible, %u of %u triangles drawn (%.1f%% rejected), %.3f ms per frame\n",
+			(double)totals.meshletsVisible / frameTimes.size(), (double)totals.meshletsTested / frameTimes.size(),
+			totals.meshletTrianglesVisible, totals.meshletTrianglesTested,
+			totals.meshletTrianglesTested ? 100.0 - 100.0 * totals.meshletTrianglesVisible / totals.meshletTrianglesTested : 0.0,
+			totals.meshletTime / frameTimes.size());
+	if (options.textureBudget || options.bulkTextures)
+		printf("textures: %s, %.3f ms per frame, %.3f ms worst frame, %d pending at exit\n",
+			options.textureBudget ? "streamed" : "uploaded while loading", totals.textureTime / frameTimes.size(), maxTextureTime, totals.texturesPending);
+	printf("transforms: %.1f world matrices updated, %.3f ms per frame\n", (double)totals.transformNodes / frameTimes.size(),
+		totals.transformTime / frameTimes.size());
+	if (totals.terrainExtent > 0.0f)
+		printf("terrain: %.0f units square, %.1f MB cooked; %.1f nodes, %u triangles drawn, %.2f tiles read, %.3f ms per frame; %d tiles, %.0f KB at most resident\n",
+			totals.terrainExtent, totals.terrainFileBytes / 1048576.0, (double)totals.terrainNodes / frameTimes.size(), totals.terrainTriangles,
+			(double)totals.terrainLoads / frameTimes.size(), totals.terrainTime / frameTimes.size(), totals.terrainResidentTiles,
+			totals.terrainResidentBytes / 1024.0);
+	if (options.collisions)
+		printf("broad phase: %.1f objects moved, %.1f overlapping pairs, %.3f ms per frame\n", (double)totals.broadPhaseMoves / frameTimes.size(),
+			(double)totals.broadPhasePairs / frameTimes.size(), totals.broadPhaseTime / frameTimes.size());
+	if (options.passStats)
+	{
+		printf("pass ms: depth %.3f  shading %.3f  lighting %.3f  shadows %.3f\n", totals.depthPassTime / frameTimes.size(),
+			totals.shadingPassTime / frameTimes.size(), totals.lightingPassTime / frameTimes.size(), totals.shadowPassTime / frameTimes.size());
+		float pixels = (float)options.width * options.height;
+		printf("fragments per frame: shaded %u (%.2f per pixel)  lit %u (%.2f per pixel)\n",
+			totals.fragmentsShaded, totals.fragmentsShaded / pixels, totals.fragmentsLit, totals.fragmentsLit / pixels);
+		if (totals.fragmentInvocations) printf("fragment shader invocations in shading pass: %u\n", totals.fragmentInvocations);
+	}
+	if (!options.jsonFile.empty()) WriteBenchmarkJson(options.jsonFile, frameTimes, totals);
+	return budgetsExceeded ? 2 : (rayTracedDiffers ? 3 : 0);
+}
@@ -0,0 +1,43 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__has_include)
+#if __has_include("heart.cpp")
+#include "heart.cpp"
+#define MESHLOADER_HAS_HEART
+#endif
+#else
+#include "heart.cpp"
+#define MESHLOADER_HAS_HEART
+#endif
+#include "ImageLoader.h"
+
+#if defined(MESHLOADER_STB_IMAGE)
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#elif defined(MESHLOADER_HAS_HEART)
+extern "C" unsigned char* stbi_load(char const *filename, int *x, int *y, int *comp, int req_comp);
+#endif
+
+unsigned char* DecodeImage(const std::string& filename, int& width, int& height, int& components)
+{
+#if defined(MESHLOADER_STB_IMAGE) || defined(MESHLOADER_HAS_HEART)
+	return stbi_load(filename.c_str(), &width, &height, &components, 0);
+#else
+	return 0;
+#endif
+}
+
+void FreeDecodedImage(unsigned char* pixels)
+{
+	free(pixels);
+}
+
+bool HasImageDecoder()
+{
+#if defined(MESHLOADER_STB_IMAGE) || defined(MESHLOADER_HAS_HEART)
+	return true;
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,16 @@
+#ifndef IMAGELOADER_H
+#define IMAGELOADER_H
+
+#include <string>
+
+// decodes an image file with whichever decoder the build has (heart.cpp next to the
+// sources or stb_image.h); pixels are 8 bit, components per pixel as stored (1 to 4).
+// Returns 0 when the file cannot be decoded or there is no decoder. Safe to call from
+// several threads.
+unsigned char* DecodeImage(const std::string& filename, int& width, int& height, int& components);
+void FreeDecodedImage(unsigned char* pixels);
+
+// false when every DecodeImage fails, so tools can tell a missing decoder from a bad file
+bool HasImageDecoder();
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef INDEXEDMESH_H
+#define INDEXEDMESH_H
+
+#include <vector>
+#include <map>
+#include <algorithm>
+#include "VectorMath.h"
+
+// triangle list over shared vertices, each vertex is position, texture coordinate and
+// normal interleaved (vertexSize floats), with coarser index lists for distant LODs
+// that reuse the same vertices
+struct IndexedMesh
+{
+	static const int vertexSize = 8;
+	static const int lodCount = 3;
+
+	std::vector<float> vertices;
+	std::vector<unsigned int> lods[lodCount];	// lods[0] is the full mesh
+	BoundingBox bounds;
+
+	int GetVertexCount() const { return (int)vertices.size() / vertexSize; }
+
+	// welds the equal vertices of a non-indexed triangle list and builds the LODs by
+	// vertex clustering on the given grids (one per LOD after the first)
+	static IndexedMesh* Build(const std::vector<float>& triangles, const int* lodGrids)
+	{
+		IndexedMesh* mesh = new IndexedMesh();
+		std::map<std::vector<float>, unsigned int> lookup;
+		for (unsigned int i = 0; i + vertexSize <= triangles.size(); i += vertexSize)
+		{
+			std::vector<float> vertex(triangles.begin() + i, triangles.begin() + i + vertexSize);
+			std::map<std::vector<float>, unsigned int>::iterator found = lookup.find(vertex);
+			if (found == lookup.end())
+			{
+				found = lookup.insert(std::make_pair(vertex, (unsigned int)mesh->GetVertexCount())).first;
+				mesh->vertices.insert(mesh->vertices.end(), vertex.begin(), vertex.end());
+				mesh->bounds.Extend(vec3(vertex[0], vertex[1], vertex[2]));
+			}
+			mesh->lods[0].push_back(found->second);
+		}
+		for (int lod = 1; lod < lodCount; lod++) mesh->Simplify(lodGrids[lod - 1], mesh->lods[lod]);
+		return mesh;
+	}
+
+	// vertex clustering on a grid^3 lattice over the bounds: every vertex is replaced by
+	// the first vertex of its cell, so attributes stay valid, and collapsed triangles go
+	void Simplify(int grid, std::vector<unsigned int>& result) const
+	{
+		result.clear();
+		if (bounds.IsEmpty()) return;
+
+		BoundingBox box = bounds;
+		vec3 extent = box.max - box.min;
+		float cell[3] = { extent.x / grid, extent.y / grid, extent.z / grid };
+		std::map<int, unsigned int> cells;
+		std::vector<unsigned int> remap(GetVertexCount());
+
+		for (int v = 0; v < GetVertexCount(); v++)
+		{
+			const float* p = &vertices[v * vertexSize];
+			float offset[3] = { p[0] - box.min.x, p[1] - box.min.y, p[2] - box.min.z };
+			int c[3];
+			for (int k = 0; k < 3; k++) c[k] = cell[k] > 0.0f ? std::min((int)(offset[k] / cell[k]), grid - 1) : 0;
+			int key = (c[0] * grid + c[1]) * grid + c[2];
+			remap[v] = cells.insert(std::make_pair(key, (unsigned int)v)).first->second;
+		}
+
+		const std::vector<unsigned int>& full = lods[0];
+		for (unsigned int i = 0; i + 2 < full.size(); i += 3)
+		{
+			unsigned int a = remap[full[i]], b = remap[full[i + 1]], c = remap[full[i + 2]];
+			if (a == b || b == c || a == c) continue;
+			result.push_back(a);
+			result.push_back(b);
+			result.push_back(c);
+		}
+	}
+};
+
+#endif
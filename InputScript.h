@@ -0,0 +1,127 @@
+#ifndef INPUTSCRIPT_H
+#define INPUTSCRIPT_H
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+
+// held keys frame by frame, to replay the keyboard driven camera and avatar with a fixed
+// time step. The text form has one run of frames per line:
+//   <frames> <keys held, '-' for none>
+// e.g. "120 t" holds 't' (Camera trackShot) for 120 frames; '#' starts a comment
+class InputScript
+{
+	struct Run
+	{
+		int frames;
+		std::string keys;
+	};
+
+	std::vector<Run> runs;
+	int frameCount;
+
+public:
+	InputScript() : frameCount(0) {}
+
+	int GetFrameCount() const { return frameCount; }
+
+	void Append(int frames, const std::string& keys)
+	{
+		if (frames <= 0) return;
+		if (!runs.empty() && runs.back().keys == keys) runs.back().frames += frames;
+		else
+		{
+			Run run = { frames, keys };
+			runs.push_back(run);
+		}
+		frameCount += frames;
+	}
+
+	// one frame of live input, for recording
+	void Record(const bool keyboard[256])
+	{
+		std::string keys;
+		for (int k = 33; k < 127; k++) if (keyboard[k] && k != '-' && k != '#') keys += (char)k;
+		Append(1, keys);
+	}
+
+	bool Parse(const std::string& text)
+	{
+		std::istringstream lines(text);
+		std::string line;
+		for (int number = 1; std::getline(lines, line); number++)
+		{
+			size_t comment = line.find('#');
+			if (comment != std::string::npos) line.erase(comment);
+			std::istringstream fields(line);
+			int frames;
+			std::string keys;
+			if (!(fields >> frames)) continue;
+			if (!(fields >> keys) || frames <= 0)
+			{
+				printf("input script line %d: expected <frames> <keys>\n", number);
+				return false;
+			}
+			Append(frames, keys == "-" ? "" : keys);
+		}
+		return frameCount > 0;
+	}
+
+	bool Load(const std::string& filename)
+	{
+		std::ifstream file(filename.c_str());
+		if (!file.is_open())
+		{
+			printf("cannot open %s\n", filename.c_str());
+			return false;
+		}
+		std::stringstream text;
+		text << file.rdbuf();
+		return Parse(text.str());
+	}
+
+	bool Write(const std::string& filename) const
+	{
+		FILE* file = fopen(filename.c_str(), "w");
+		if (!file)
+		{
+			printf("cannot write %s\n", filename.c_str());
+			return false;
+		}
+		fprintf(file, "# frames  keys held\n");
+		for (unsigned int i = 0; i < runs.size(); i++) fprintf(file, "%d %s\n", runs[i].frames, runs[i].keys.empty() ? "-" : runs[i].keys.c_str());
+		fclose(file);
+		return true;
+	}
+
+	// sets the keys of frame (the last frame holds on), releases all others
+	void Apply(int frame, bool keyboard[256]) const
+	{
+		memset(keyboard, 0, 256 * sizeof(bool));
+		for (unsigned int i = 0; i < runs.size(); i++)
+		{
+			if (frame < runs[i].frames || i + 1 == runs.size())
+			{
+				for (unsigned int k = 0; k < runs[i].keys.size(); k++) keyboard[(unsigned char)runs[i].keys[k]] = true;
+				return;
+			}
+			frame -= runs[i].frames;
+		}
+	}
+
+	// the camera modes of Camera::Control and a drive of the avatar (',' forward, 'a'/'e' turn)
+	static const char* GetBuiltin(const std::string& name)
+	{
+		if (name == "heli") return "300 -\n";
+		if (name == "drive") return "60 -\n120 ,\n60 ,a\n120 ,\n60 ,e\n";
+		if (name == "orbit") return "600 t\n";
+		if (name == "walk") return "120 c,\n90 ca\n120 c,\n90 ce\n120 c,\n";
+		if (name == "tour") return "60 -\n120 ,\n60 ,a\n240 t\n60 -\n120 c,\n60 ca\n";
+		return 0;
+	}
+};
+
+#endif
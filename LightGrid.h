@@ -0,0 +1,222 @@
+#ifndef LIGHTGRID_H
+#define LIGHTGRID_H
+
+#include <vector>
+#include <algorithm>
+#include "VectorMath.h"
+#include "Simd4.h"
+#include "ParallelFor.h"
+
+struct PointLight
+{
+	vec3 position;
+	float radius;
+	vec3 color;
+
+	PointLight(vec3 position = vec3(0.0, 0.0, 0.0), float radius = 1.0, vec3 color = vec3(1.0, 1.0, 1.0))
+		: position(position), radius(radius), color(color) {}
+};
+
+// clustered light lists for forward+ shading: the screen is divided into
+// tileSize x tileSize pixel tiles and the view depth range into exponentially
+// spaced slices, and every cluster lists the point lights whose bounding sphere
+// may touch it. Assumes a symmetric perspective projection like Camera's.
+class LightGrid
+{
+	int tileSize, slices;
+	int width, height, tilesX, tilesY;
+	float sliceScale, sliceBias;
+
+	// per light cluster ranges, filled by the first pass; empty z range when culled
+	std::vector<int> minX, maxX, minY, maxY, minZ, maxZ;
+
+	// per slice scratch of the second pass
+	std::vector<std::vector<unsigned int> > sliceIndices;
+	std::vector<std::vector<unsigned int> > sliceOffsets;
+	std::vector<std::vector<unsigned int> > sliceCandidates;
+
+public:
+	// (offset into lightIndices, light count) for every cluster, x fastest then y then slice
+	std::vector<unsigned int> clusterTable;
+	std::vector<unsigned int> lightIndices;
+	int visibleLights;
+
+	LightGrid(int tileSize = 32, int slices = 16) : tileSize(tileSize), slices(slices)
+	{
+		sliceScale = sliceBias = 0.0;
+		visibleLights = 0;
+		Resize(512, 512);
+	}
+
+	void Resize(int w, int h)
+	{
+		width = w; height = h;
+		tilesX = (width + tileSize - 1) / tileSize;
+		tilesY = (height + tileSize - 1) / tileSize;
+		clusterTable.assign(tilesX * tilesY * slices * 2, 0);
+	}
+
+	int GetTileSize() { return tileSize; }
+	int GetTilesX() { return tilesX; }
+	int GetTilesY() { return tilesY; }
+	int GetSlices() { return slices; }
+	int GetClusterCount() { return tilesX * tilesY * slices; }
+
+	// slice = log(viewDepth) * sliceScale + sliceBias
+	float GetSliceScale() { return sliceScale; }
+	float GetSliceBias() { return sliceBias; }
+
+	int GetSlice(float viewDepth)
+	{
+		int s = (int)floor(log(viewDepth) * sliceScale + sliceBias);
+		return std::min(std::max(s, 0), slices - 1);
+	}
+
+	int GetClusterIndex(int tx, int ty, int slice) { return (slice * tilesY + ty) * tilesX + tx; }
+
+	void Build(const std::vector<PointLight>& lights, mat4& V, mat4& P, float nearPlane, float farPlane, ThreadPool* pool = 0)
+	{
+		if (!pool) pool = &ThreadPool::Global();
+
+		int n = (int)lights.size();
+		sliceScale = slices / log(farPlane / nearPlane);
+		sliceBias = -log(nearPlane) * sliceScale;
+
+		minX.resize(n); maxX.resize(n);
+		minY.resize(n); maxY.resize(n);
+		minZ.resize(n); maxZ.resize(n);
+
+		// pass 1: view-space sphere to cluster range, four lights at a time
+		pool->ParallelFor((n + 3) / 4, [&](int begin, int end)
+		{
+			float4 near4(nearPlane), far4(farPlane), zero(0.0f), one(1.0f), minusOne(-1.0f);
+			float4 tileScaleX(0.5f * width / tileSize), tileScaleY(0.5f * height / tileSize);
+			float4 lastX((float)(tilesX - 1)), lastY((float)(tilesY - 1));
+
+			for (int b = begin; b < end; b++)
+			{
+				float px[4], py[4], pz[4], pr[4];
+				for (int k = 0; k < 4; k++)
+				{
+					const PointLight& l = lights[std::min(b * 4 + k, n - 1)];
+					px[k] = l.position.x; py[k] = l.position.y; pz[k] = l.position.z; pr[k] = l.radius;
+				}
+				float4 x = float4::Load(px), y = float4::Load(py), z = float4::Load(pz), r = float4::Load(pr);
+
+				float4 vx = x * V.m[0][0] + y * V.m[1][0] + z * V.m[2][0] + V.m[3][0];
+				float4 vy = x * V.m[0][1] + y * V.m[1][1] + z * V.m[2][1] + V.m[3][1];
+				float4 vz = x * V.m[0][2] + y * V.m[1][2] + z * V.m[2][2] + V.m[3][2];
+
+				float4 d = zero - vz;
+				float4 dn = Max(d - r, near4);
+				float4 df = d + r;
+				float4 visible = And(df > near4, d - r < far4);
+
+				// screen rectangle of the view-space bounding box, each edge divided by
+				// whichever of the near/far box depths pushes it further out
+				float4 x0 = vx - r, x1 = vx + r, y0 = vy - r, y1 = vy + r;
+				float4 ndcX0 = x0 * P.m[0][0] / Select(x0 < zero, dn, df);
+				float4 ndcX1 = x1 * P.m[0][0] / Select(x1 > zero, dn, df);
+				float4 ndcY0 = y0 * P.m[1][1] / Select(y0 < zero, dn, df);
+				float4 ndcY1 = y1 * P.m[1][1] / Select(y1 > zero, dn, df);
+				visible = And(visible, And(And(ndcX0 < one, ndcX1 > minusOne), And(ndcY0 < one, ndcY1 > minusOne)));
+
+				int tx0[4], tx1[4], ty0[4], ty1[4];
+				StoreInt(Min(Max((Max(ndcX0, minusOne) + one) * tileScaleX, zero), lastX), tx0);
+				StoreInt(Min(Max((Min(ndcX1, one) + one) * tileScaleX, zero), lastX), tx1);
+				StoreInt(Min(Max((Max(ndcY0, minusOne) + one) * tileScaleY, zero), lastY), ty0);
+				StoreInt(Min(Max((Min(ndcY1, one) + one) * tileScaleY, zero), lastY), ty1);
+
+				float dnear[4], dfar[4];
+				dn.Store(dnear); Min(df, far4).Store(dfar);
+				int mask = MoveMask(visible);
+
+				for (int k = 0; k < 4 && b * 4 + k < n; k++)
+				{
+					int i = b * 4 + k;
+					minX[i] = tx0[k]; maxX[i] = tx1[k];
+					minY[i] = ty0[k]; maxY[i] = ty1[k];
+					if (mask & (1 << k))
+					{
+						minZ[i] = GetSlice(dnear[k]);
+						maxZ[i] = GetSlice(dfar[k]);
+					}
+					else
+					{
+						minZ[i] = 1; maxZ[i] = 0;
+					}
+				}
+			}
+		});
+
+		// pass 2: every slice counts, then fills, its own clusters
+		int tilesPerSlice = tilesX * tilesY;
+		sliceIndices.resize(slices);
+		sliceOffsets.resize(slices);
+		sliceCandidates.resize(slices);
+
+		pool->ParallelFor(slices, [&](int begin, int end)
+		{
+			for (int s = begin; s < end; s++)
+			{
+				std::vector<unsigned int>& candidates = sliceCandidates[s];
+				std::vector<unsigned int>& offsets = sliceOffsets[s];
+				std::vector<unsigned int>& indices = sliceIndices[s];
+				unsigned int* table = &clusterTable[s * tilesPerSlice * 2];
+
+				candidates.clear();
+				for (int i = 0; i < n; i++)
+					if (minZ[i] <= s && s <= maxZ[i]) candidates.push_back(i);
+
+				for (int c = 0; c < tilesPerSlice; c++) table[c * 2 + 1] = 0;
+				for (unsigned int j = 0; j < candidates.size(); j++)
+				{
+					int i = candidates[j];
+					for (int ty = minY[i]; ty <= maxY[i]; ty++)
+						for (int tx = minX[i]; tx <= maxX[i]; tx++)
+							table[(ty * tilesX + tx) * 2 + 1]++;
+				}
+
+				offsets.resize(tilesPerSlice);
+				unsigned int total = 0;
+				for (int c = 0; c < tilesPerSlice; c++)
+				{
+					offsets[c] = total;
+					total += table[c * 2 + 1];
+				}
+
+				indices.resize(total);
+				for (unsigned int j = 0; j < candidates.size(); j++)
+				{
+					int i = candidates[j];
+					for (int ty = minY[i]; ty <= maxY[i]; ty++)
+						for (int tx = minX[i]; tx <= maxX[i]; tx++)
+							indices[offsets[ty * tilesX + tx]++] = i;
+				}
+			}
+		}, 1);
+
+		// pass 3: concatenate the slices into the final index list
+		std::vector<unsigned int> sliceBase(slices + 1, 0);
+		for (int s = 0; s < slices; s++) sliceBase[s + 1] = sliceBase[s] + (unsigned int)sliceIndices[s].size();
+		lightIndices.resize(sliceBase[slices]);
+
+		pool->ParallelFor(slices, [&](int begin, int end)
+		{
+			for (int s = begin; s < end; s++)
+			{
+				unsigned int* table = &clusterTable[s * tilesPerSlice * 2];
+				std::vector<unsigned int>& indices = sliceIndices[s];
+				if (!indices.empty()) std::copy(indices.begin(), indices.end(), lightIndices.begin() + sliceBase[s]);
+				// offsets were advanced to each cluster's end while filling
+				for (int c = 0; c < tilesPerSlice; c++)
+					table[c * 2] = sliceBase[s] + sliceOffsets[s][c] - table[c * 2 + 1];
+			}
+		}, 1);
+
+		visibleLights = 0;
+		for (int i = 0; i < n; i++) if (minZ[i] <= maxZ[i]) visibleLights++;
+	}
+};
+
+#endif
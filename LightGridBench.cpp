@@ -0,0 +1,157 @@
+// CPU benchmark for LightGrid::Build, no GL needed. Every build's light lists are checked
+// against a brute-force pass over a sample of clusters: each light's view-space sphere is
+// bounded in scalar code the way the grid bounds it and tested against the cluster, and a
+// light whose sphere holds the cluster's center has to be listed whatever the bounds say.
+//   g++ -O2 -std=c++11 -pthread LightGridBench.cpp -o LightGridBench
+//   ./LightGridBench [width height]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include "LightGrid.h"
+
+mat4 LookAt(vec3 wEye, vec3 wLookat, vec3 wVup)
+{
+	vec3 w = (wEye - wLookat).normalize();
+	vec3 u = cross(wVup, w).normalize();
+	vec3 v = cross(w, u);
+	return
+		mat4(1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			-wEye.x, -wEye.y, -wEye.z, 1.0f) *
+		mat4(u.x, v.x, w.x, 0.0f,
+			u.y, v.y, w.y, 0.0f,
+			u.z, v.z, w.z, 0.0f,
+			0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+mat4 Perspective(float fov, float asp, float fp, float bp)
+{
+	float sy = 1 / tan(fov / 2);
+	return mat4(
+		sy / asp, 0.0f, 0.0f, 0.0f,
+		0.0f, sy, 0.0f, 0.0f,
+		0.0f, 0.0f, -(fp + bp) / (bp - fp), -1.0f,
+		0.0f, 0.0f, -2 * fp * bp / (bp - fp), 0.0f);
+}
+
+// the lights the grid should list for cluster (tx, ty, slice), from every light's sphere
+std::vector<unsigned int> ReferenceLights(LightGrid& grid, const std::vector<PointLight>& lights, mat4& V, mat4& P,
+	float fp, float bp, int width, int height, int tx, int ty, int slice, std::vector<unsigned int>& required)
+{
+	std::vector<unsigned int> listed;
+	required.clear();
+	int tileSize = grid.GetTileSize(), lastX = grid.GetTilesX() - 1, lastY = grid.GetTilesY() - 1;
+	float tileScaleX = 0.5f * width / tileSize, tileScaleY = 0.5f * height / tileSize;
+
+	// the cluster's center in view space
+	float nearDepth = exp((slice - grid.GetSliceBias()) / grid.GetSliceScale());
+	float farDepth = exp((slice + 1 - grid.GetSliceBias()) / grid.GetSliceScale());
+	float depth = 0.5f * (nearDepth + farDepth);
+	float cx = ((tx + 0.5f) / tileScaleX - 1.0f) * depth / P.m[0][0], cy = ((ty + 0.5f) / tileScaleY - 1.0f) * depth / P.m[1][1];
+	bool centerOnScreen = (tx + 1) * tileSize <= width && (ty + 1) * tileSize <= height;
+
+	for (unsigned int i = 0; i < lights.size(); i++)
+	{
+		const PointLight& l = lights[i];
+		float vx = l.position.x * V.m[0][0] + l.position.y * V.m[1][0] + l.position.z * V.m[2][0] + V.m[3][0];
+		float vy = l.position.x * V.m[0][1] + l.position.y * V.m[1][1] + l.position.z * V.m[2][1] + V.m[3][1];
+		float vz = l.position.x * V.m[0][2] + l.position.y * V.m[1][2] + l.position.z * V.m[2][2] + V.m[3][2];
+		float r = l.radius, d = 0.0f - vz;
+		float dn = std::max(d - r, fp), df = d + r;
+
+		float dx = vx - cx, dy = vy - cy, dz = d - depth;
+		if (centerOnScreen && depth > fp && depth < bp && dx * dx + dy * dy + dz * dz < r * r) required.push_back(i);
+
+		if (!(df > fp && d - r < bp)) continue;
+		float x0 = vx - r, x1 = vx + r, y0 = vy - r, y1 = vy + r;
+		float ndcX0 = x0 * P.m[0][0] / (x0 < 0.0f ? dn : df), ndcX1 = x1 * P.m[0][0] / (x1 > 0.0f ? dn : df);
+		float ndcY0 = y0 * P.m[1][1] / (y0 < 0.0f ? dn : df), ndcY1 = y1 * P.m[1][1] / (y1 > 0.0f ? dn : df);
+		if (!(ndcX0 < 1.0f && ndcX1 > -1.0f && ndcY0 < 1.0f && ndcY1 > -1.0f)) continue;
+
+		int tx0 = (int)std::min(std::max((std::max(ndcX0, -1.0f) + 1.0f) * tileScaleX, 0.0f), (float)lastX);
+		int tx1 = (int)std::min(std::max((std::min(ndcX1, 1.0f) + 1.0f) * tileScaleX, 0.0f), (float)lastX);
+		int ty0 = (int)std::min(std::max((std::max(ndcY0, -1.0f) + 1.0f) * tileScaleY, 0.0f), (float)lastY);
+		int ty1 = (int)std::min(std::max((std::min(ndcY1, 1.0f) + 1.0f) * tileScaleY, 0.0f), (float)lastY);
+		if (tx < tx0 || tx > tx1 || ty < ty0 || ty > ty1) continue;
+		if (slice < grid.GetSlice(dn) || slice > grid.GetSlice(std::min(df, bp))) continue;
+		listed.push_back(i);
+	}
+	return listed;
+}
+
+// clusters whose list differs from the reference or misses a light holding their center
+int CheckGrid(LightGrid& grid, const std::vector<PointLight>& lights, mat4& V, mat4& P, float fp, float bp, int width, int height)
+{
+	int errors = 0;
+	std::vector<unsigned int> required;
+	for (int c = 0; c < grid.GetClusterCount(); c += 7)
+	{
+		int tx = c % grid.GetTilesX(), ty = c / grid.GetTilesX() % grid.GetTilesY(), slice = c / (grid.GetTilesX() * grid.GetTilesY());
+		std::vector<unsigned int> expected = ReferenceLights(grid, lights, V, P, fp, bp, width, height, tx, ty, slice, required);
+		unsigned int first = grid.clusterTable[c * 2], count = grid.clusterTable[c * 2 + 1];
+		std::vector<unsigned int> actual(grid.lightIndices.begin() + first, grid.lightIndices.begin() + first + count);
+		std::sort(actual.begin(), actual.end());
+
+		bool missing = false;
+		for (unsigned int k = 0; k < required.size(); k++) missing = missing || !std::binary_search(actual.begin(), actual.end(), required[k]);
+		if (actual == expected && !missing) continue;
+		if (errors++ < 5)
+			printf("cluster %d, %d slice %d: %d lights listed, %d expected%s\n", tx, ty, slice, (int)actual.size(), (int)expected.size(),
+				missing ? ", a light around its center missing" : "");
+	}
+	return errors;
+}
+
+int main(int argc, char* argv[])
+{
+	int width = argc > 2 ? atoi(argv[1]) : 1280;
+	int height = argc > 2 ? atoi(argv[2]) : 720;
+	const int iterations = 50;
+	float fp = 0.01, bp = 100.0;
+
+	mat4 V = LookAt(vec3(0.0, 3.0, 12.0), vec3(0.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0));
+	mat4 P = Perspective(M_PI / 4.0, (float)width / height, fp, bp);
+
+	int lightCounts[] = { 1000, 2000, 5000, 10000 };
+	std::vector<int> threadCounts = ThreadCounts();
+
+	printf("%dx%d, 32px tiles, 16 slices, %d iterations\n", width, height, iterations);
+	printf("lights\tthreads\tms/build\tvisible\tindices\twrong clusters\n");
+
+	int errors = 0;
+
+	for (unsigned int step = 0; step < threadCounts.size(); step++)
+	{
+		int t = threadCounts[step];
+		ThreadPool pool(t);
+		for (int c = 0; c < 4; c++)
+		{
+			srand(1);
+			std::vector<PointLight> lights;
+			for (int i = 0; i < lightCounts[c]; i++)
+			{
+				vec3 p = vec3::random();
+				lights.push_back(PointLight(vec3(p.x * 20.0, p.y + 1.0, p.z * 20.0),
+					0.5 + (float)rand() / RAND_MAX, vec3(1.0, 1.0, 1.0)));
+			}
+
+			LightGrid grid;
+			grid.Resize(width, height);
+			grid.Build(lights, V, P, fp, bp, &pool);
+
+			auto start = std::chrono::steady_clock::now();
+			for (int i = 0; i < iterations; i++) grid.Build(lights, V, P, fp, bp, &pool);
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+			int wrong = CheckGrid(grid, lights, V, P, fp, bp, width, height);
+			errors += wrong;
+			printf("%d\t%d\t%.3f\t%d\t%d\t%d\n", lightCounts[c], t, ms, grid.visibleLights, (int)grid.lightIndices.size(), wrong);
+		}
+	}
+	printf("check: %s\n", errors ? "failed" : "every sampled cluster lists the reference's lights");
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,184 @@
+// CPU benchmark for meshlet building and MeshletCuller, no GL needed.
+//   g++ -O2 -std=c++11 -pthread MeshletBench.cpp -o MeshletBench
+//   ./MeshletBench [instances]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include "Meshlets.h"
+
+mat4 LookAt(vec3 wEye, vec3 wLookat, vec3 wVup)
+{
+	vec3 w = (wEye - wLookat).normalize();
+	vec3 u = cross(wVup, w).normalize();
+	vec3 v = cross(w, u);
+	return
+		mat4(1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			-wEye.x, -wEye.y, -wEye.z, 1.0f) *
+		mat4(u.x, v.x, w.x, 0.0f,
+			u.y, v.y, w.y, 0.0f,
+			u.z, v.z, w.z, 0.0f,
+			0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+mat4 Perspective(float fov, float asp, float fp, float bp)
+{
+	float sy = 1 / tan(fov / 2);
+	return mat4(
+		sy / asp, 0.0f, 0.0f, 0.0f,
+		0.0f, sy, 0.0f, 0.0f,
+		0.0f, 0.0f, -(fp + bp) / (bp - fp), -1.0f,
+		0.0f, 0.0f, -2 * fp * bp / (bp - fp), 0.0f);
+}
+
+// uniform scale s, turned by angle around y, then moved to position (row vectors)
+void Placement(vec3 position, float s, float angle, mat4& M, mat4& InvM)
+{
+	float c = cos(angle), n = sin(angle);
+	M = mat4(s * c, 0.0f, s * n, 0.0f,
+		0.0f, s, 0.0f, 0.0f,
+		-s * n, 0.0f, s * c, 0.0f,
+		position.x, position.y, position.z, 1.0f);
+	InvM = inverse(M);
+}
+
+// closed bumpy sphere on a latitude/longitude grid, position and normal per vertex
+void BumpySphere(int slices, int stacks, std::vector<float>& vertices, std::vector<unsigned int>& triangles)
+{
+	for (int i = 0; i <= stacks; i++)
+		for (int j = 0; j < slices; j++)
+		{
+			float theta = M_PI * i / stacks, phi = 2.0 * M_PI * j / slices;
+			vec3 d = vec3(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+			vec3 p = d * (1.0f + 0.15f * sin(6.0f * theta) * sin(6.0f * phi));
+			float vertex[6] = { p.x, p.y, p.z, d.x, d.y, d.z };
+			vertices.insert(vertices.end(), vertex, vertex + 6);
+		}
+	for (int i = 0; i < stacks; i++)
+		for (int j = 0; j < slices; j++)
+		{
+			unsigned int a = i * slices + j, b = i * slices + (j + 1) % slices, c = a + slices, d = b + slices;
+			unsigned int quad[6] = { a, b, d, a, d, c };
+			triangles.insert(triangles.end(), quad, quad + 6);
+		}
+}
+
+vec3 Position(const std::vector<float>& vertices, unsigned int v) { return vec3(vertices[v * 6], vertices[v * 6 + 1], vertices[v * 6 + 2]); }
+
+// the reasons one meshlet is hidden, scalar, from the lanes of MeshletMesh::bounds
+void Reference(const MeshletMesh& mesh, int m, const Frustum& frustum, vec3 eye, bool& outside, bool& backFacing)
+{
+	const float* b = &mesh.bounds[(m / 4) * MeshletMesh::groupFloats + m % 4];
+	vec3 center = vec3(b[0], b[4], b[8]), axis = vec3(b[16], b[20], b[24]);
+	float radius = b[12], cutoff = b[28];
+	outside = !frustum.IntersectsSphere(center, radius);
+	vec3 v = center - eye;
+	backFacing = dot(v, axis) >= cutoff * (v.length() + radius) + radius;
+}
+
+int main(int argc, char* argv[])
+{
+	int instanceCount = argc > 1 ? atoi(argv[1]) : 1000;
+	const int iterations = 20;
+	float fp = 0.1, bp = 400.0;
+	vec3 eye = vec3(0.0, 3.0, -10.0);
+	mat4 VP = LookAt(eye, vec3(0.0, 1.0, 30.0), vec3(0.0, 1.0, 0.0)) * Perspective(M_PI / 4.0, 1280.0f / 720.0f, fp, bp);
+
+	std::vector<float> vertices;
+	std::vector<unsigned int> triangles;
+	BumpySphere(256, 128, vertices, triangles);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	MeshletMesh* mesh = MeshletMesh::Build(vertices, 6, 3, triangles);
+	double buildTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	int fullMeshlets = 0;
+	double averageVertices = 0.0, averageTriangles = 0.0;
+	for (unsigned int m = 0; m < mesh->meshlets.size(); m++)
+	{
+		averageVertices += mesh->meshlets[m].vertexCount;
+		averageTriangles += mesh->meshlets[m].triangleCount;
+		if (mesh->meshlets[m].triangleCount == MeshletMesh::maxTriangles || mesh->meshlets[m].vertexCount > MeshletMesh::maxVertices - 3) fullMeshlets++;
+	}
+	printf("mesh: %d vertices, %d triangles -> %d meshlets (%.1f vertices, %.1f triangles on average, %d full) in %.1f ms\n",
+		(int)vertices.size() / 6, mesh->GetTriangleCount(), (int)mesh->meshlets.size(), averageVertices / mesh->meshlets.size(),
+		averageTriangles / mesh->meshlets.size(), fullMeshlets, buildTime);
+
+	// a field of instances in front of the camera, some behind it or off to the sides
+	srand(1);
+	std::vector<MeshletCuller::Instance> instances(instanceCount);
+	std::vector<mat4> inverses(instanceCount);
+	for (int i = 0; i < instanceCount; i++)
+	{
+		vec3 r = vec3::random();
+		mat4 M;
+		Placement(vec3(r.x * 120.0, 1.0, 20.0 + r.z * 100.0), 0.5f + fabs(r.y) * 2.0f, r.y * M_PI, M, inverses[i]);
+		instances[i].mesh = mesh;
+		instances[i].MVP = M * VP;
+		vec4 local = vec4(eye.x, eye.y, eye.z, 1.0) * inverses[i];
+		instances[i].eye = vec3(local.v[0], local.v[1], local.v[2]);
+	}
+
+	// the SIMD result against the scalar reference, and every cone-culled triangle against
+	// the exact back face test: a front face in a culled meshlet must never happen
+	MeshletCuller culler;
+	culler.Run(instances);
+	int outside = 0, backFacing = 0, mismatches = 0, unsafe = 0;
+	for (int i = 0; i < instanceCount; i++)
+	{
+		Frustum frustum(instances[i].MVP);
+		unsigned int streamed = 0;
+		for (unsigned int m = 0; m < mesh->meshlets.size(); m++)
+		{
+			bool out, back;
+			Reference(*mesh, m, frustum, instances[i].eye, out, back);
+			if (out) outside++;
+			else if (back) backFacing++;
+			bool visible = !out && !back;
+			const Meshlet& meshlet = mesh->meshlets[m];
+			if (visible)
+			{
+				for (unsigned int k = 0; k < meshlet.triangleCount * 3; k++)
+					if (culler.stream[instances[i].firstIndex + streamed + k] != mesh->indices[meshlet.firstIndex + k]) { mismatches++; break; }
+				streamed += meshlet.triangleCount * 3;
+			}
+			if (out || !back) continue;
+			for (unsigned int t = 0; t < meshlet.triangleCount; t++)
+			{
+				const unsigned int* corner = &mesh->indices[meshlet.firstIndex + t * 3];
+				vec3 p0 = Position(vertices, corner[0]), p1 = Position(vertices, corner[1]), p2 = Position(vertices, corner[2]);
+				vec3 n = cross(p1 - p0, p2 - p0), toEye = instances[i].eye - p0;
+				if (dot(n, toEye) > 1e-6f * n.length() * toEye.length()) { unsafe++; break; }
+			}
+		}
+		if (streamed != instances[i].indexCount) mismatches++;
+	}
+	int tested = instanceCount * (int)mesh->meshlets.size();
+	printf("%d instances, %d meshlets tested: %.1f%% outside the frustum, %.1f%% back facing; %d SIMD mismatches, %d unsafe\n",
+		instanceCount, tested, 100.0 * outside / tested, 100.0 * backFacing / tested, mismatches, unsafe);
+	printf("%u of %u triangles kept (%.1f%% rejected)\n", culler.trianglesVisible, culler.trianglesTested,
+		100.0 - 100.0 * culler.trianglesVisible / culler.trianglesTested);
+
+	printf("threads\tcull ms\tmeshlets per us\n");
+	std::vector<int> threadCounts = ThreadCounts();
+	for (unsigned int step = 0; step < threadCounts.size(); step++)
+	{
+		int t = threadCounts[step];
+		ThreadPool pool(t);
+		double time = 0.0;
+		for (int i = 0; i < iterations; i++)
+		{
+			std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+			culler.Run(instances, &pool);
+			time += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+		}
+		printf("%d\t%.3f\t%.1f\n", t, time / iterations, tested / (time / iterations * 1000.0));
+	}
+
+	delete mesh;
+	return mismatches || unsafe ? 1 : 0;
+}
@@ -0,0 +1,291 @@
+#ifndef MESHLETS_H
+#define MESHLETS_H
+
+#include <vector>
+#include <algorithm>
+#include <string.h>
+#include "VectorMath.h"
+#include "Simd4.h"
+#include "ParallelFor.h"
+
+struct Meshlet
+{
+	unsigned int firstIndex, triangleCount, vertexCount;
+};
+
+// an indexed mesh regrouped into clusters of at most maxVertices vertices and maxTriangles
+// triangles, each with a bounding sphere and a cone around its face normals. The triangles
+// of a meshlet are contiguous in indices, so the visible ones compact with memcpy.
+struct MeshletMesh
+{
+	static const int maxVertices = 64, maxTriangles = 124;
+	static const int groupFloats = 32;	// per four meshlets: x, y, z, radius, axis x, y, z, cutoff
+
+	std::vector<Meshlet> meshlets;
+	std::vector<unsigned int> indices;	// the triangles of the source mesh in meshlet order
+	std::vector<float> bounds;			// groupFloats per group of four meshlets, lanes side by side
+
+	int GetGroupCount() const { return (int)bounds.size() / groupFloats; }
+	int GetTriangleCount() const { return (int)indices.size() / 3; }
+
+	// greedy clustering: starting from the first unused triangle, keep adding the adjacent
+	// triangle that brings the fewest new vertices until either limit is reached.
+	// vertices are vertexSize floats with the position first and the normal at normalOffset;
+	// the normals only decide whether the mesh winds its front faces clockwise.
+	static MeshletMesh* Build(const std::vector<float>& vertices, int vertexSize, int normalOffset, const std::vector<unsigned int>& triangles)
+	{
+		MeshletMesh* mesh = new MeshletMesh();
+		int vertexCount = (int)vertices.size() / vertexSize, triangleCount = (int)triangles.size() / 3;
+
+		// vertex -> triangles, by counting sort
+		std::vector<int> adjacencyStart(vertexCount + 1, 0), adjacency(triangleCount * 3);
+		for (int i = 0; i < triangleCount * 3; i++) adjacencyStart[triangles[i] + 1]++;
+		for (int v = 0; v < vertexCount; v++) adjacencyStart[v + 1] += adjacencyStart[v];
+		std::vector<int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+		for (int i = 0; i < triangleCount * 3; i++) adjacency[fill[triangles[i]]++] = i / 3;
+
+		// most face normals by winding agree with the vertex normals, or all are turned around
+		int votes = 0;
+		for (int t = 0; t < triangleCount; t++)
+		{
+			vec3 n = FaceNormal(vertices, vertexSize, &triangles[t * 3]), shading;
+			for (int k = 0; k < 3; k++)
+			{
+				const float* vn = &vertices[triangles[t * 3 + k] * vertexSize + normalOffset];
+				shading = shading + vec3(vn[0], vn[1], vn[2]);
+			}
+			votes += dot(n, shading) >= 0.0f ? 1 : -1;
+		}
+		float orientation = votes >= 0 ? 1.0f : -1.0f;
+
+		std::vector<char> used(triangleCount, 0);
+		std::vector<int> stamp(vertexCount, -1);	// meshlet that already holds the vertex
+		std::vector<int> candidates, meshletVertices, meshletTriangles;
+		int seed = 0;
+		for (;;)
+		{
+			while (seed < triangleCount && used[seed]) seed++;
+			if (seed == triangleCount) break;
+
+			int id = (int)mesh->meshlets.size();
+			candidates.assign(1, seed);
+			meshletVertices.clear();
+			meshletTriangles.clear();
+			for (;;)
+			{
+				int best = -1, bestNew = 4;
+				int kept = 0;
+				for (unsigned int c = 0; c < candidates.size(); c++)
+				{
+					int t = candidates[c];
+					if (used[t]) continue;
+					candidates[kept++] = t;
+					int added = 0;
+					for (int k = 0; k < 3; k++) if (stamp[triangles[t * 3 + k]] != id) added++;
+					if (added < bestNew) { best = t; bestNew = added; }
+				}
+				candidates.resize(kept);
+				if (best < 0 || (int)meshletVertices.size() + bestNew > maxVertices || (int)meshletTriangles.size() == maxTriangles) break;
+
+				used[best] = 1;
+				meshletTriangles.push_back(best);
+				for (int k = 0; k < 3; k++)
+				{
+					int v = triangles[best * 3 + k];
+					if (stamp[v] == id) continue;
+					stamp[v] = id;
+					meshletVertices.push_back(v);
+					for (int a = adjacencyStart[v]; a < adjacencyStart[v + 1]; a++) if (!used[adjacency[a]]) candidates.push_back(adjacency[a]);
+				}
+			}
+
+			Meshlet meshlet;
+			meshlet.firstIndex = (unsigned int)mesh->indices.size();
+			meshlet.triangleCount = (unsigned int)meshletTriangles.size();
+			meshlet.vertexCount = (unsigned int)meshletVertices.size();
+			for (unsigned int t = 0; t < meshletTriangles.size(); t++)
+				mesh->indices.insert(mesh->indices.end(), triangles.begin() + meshletTriangles[t] * 3, triangles.begin() + meshletTriangles[t] * 3 + 3);
+			mesh->meshlets.push_back(meshlet);
+			mesh->AddBounds(vertices, vertexSize, orientation, meshletVertices, meshletTriangles, triangles);
+		}
+		return mesh;
+	}
+
+	// visibility bits of the four meshlets of each group in [beginGroup, endGroup);
+	// a meshlet is hidden outside the frustum or when all its faces point away from the eye.
+	// frustum and eye are in the object space of the mesh.
+	void Cull(const Frustum& frustum, const vec3& eye, int beginGroup, int endGroup, unsigned char* visible) const
+	{
+		float4 ex(eye.x), ey(eye.y), ez(eye.z), zero(0.0f);
+		for (int g = beginGroup; g < endGroup; g++)
+		{
+			const float* b = &bounds[g * groupFloats];
+			float4 cx = float4::Load(b), cy = float4::Load(b + 4), cz = float4::Load(b + 8), r = float4::Load(b + 12);
+			float4 minusR = zero - r;
+
+			float4 hidden = zero < zero;
+			for (int p = 0; p < 6; p++)
+			{
+				const float* plane = frustum.planes[p];
+				float4 d = cx * float4(plane[0]) + cy * float4(plane[1]) + cz * float4(plane[2]) + float4(plane[3]);
+				hidden = Or(hidden, d < minusR);
+			}
+
+			// every point p of the sphere sees the axis at no more than 90 degrees minus the cone
+			// angle, dot(p - eye, axis) >= sin(cone angle) * |p - eye|, so every face is a back face
+			float4 vx = cx - ex, vy = cy - ey, vz = cz - ez;
+			float4 distance = Sqrt(vx * vx + vy * vy + vz * vz);
+			float4 along = vx * float4::Load(b + 16) + vy * float4::Load(b + 20) + vz * float4::Load(b + 24);
+			hidden = Or(hidden, along >= float4::Load(b + 28) * (distance + r) + r);
+
+			visible[g - beginGroup] = (unsigned char)(~MoveMask(hidden) & 15);
+		}
+	}
+
+private:
+	static vec3 FaceNormal(const std::vector<float>& vertices, int vertexSize, const unsigned int* corner)
+	{
+		const float *p0 = &vertices[corner[0] * vertexSize], *p1 = &vertices[corner[1] * vertexSize], *p2 = &vertices[corner[2] * vertexSize];
+		return cross(vec3(p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]), vec3(p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]));
+	}
+
+	void AddBounds(const std::vector<float>& vertices, int vertexSize, float orientation,
+		const std::vector<int>& meshletVertices, const std::vector<int>& meshletTriangles, const std::vector<unsigned int>& triangles)
+	{
+		int lane = (int)(meshlets.size() - 1) % 4;
+		if (lane == 0)
+		{
+			// padding lanes are never visible: an inverted sphere is outside every plane
+			bounds.resize(bounds.size() + groupFloats, 0.0f);
+			float* b = &bounds[bounds.size() - groupFloats];
+			for (int i = 0; i < 4; i++) { b[12 + i] = -1e30f; b[28 + i] = 2.0f; }
+		}
+		float* b = &bounds[bounds.size() - groupFloats];
+
+		BoundingBox box;
+		for (unsigned int i = 0; i < meshletVertices.size(); i++)
+			box.Extend(vec3(vertices[meshletVertices[i] * vertexSize], vertices[meshletVertices[i] * vertexSize + 1], vertices[meshletVertices[i] * vertexSize + 2]));
+		vec3 center = box.GetCenter();
+		float radius = 0.0f;
+		for (unsigned int i = 0; i < meshletVertices.size(); i++)
+		{
+			const float* p = &vertices[meshletVertices[i] * vertexSize];
+			radius = std::max(radius, (vec3(p[0], p[1], p[2]) - center).length());
+		}
+
+		std::vector<vec3> normals;
+		vec3 sum;
+		for (unsigned int t = 0; t < meshletTriangles.size(); t++)
+		{
+			vec3 n = FaceNormal(vertices, vertexSize, &triangles[meshletTriangles[t] * 3]);
+			float length = n.length();
+			if (length <= 0.0f) continue;
+			n = n * (orientation / length);
+			normals.push_back(n);
+			sum = sum + n;
+		}
+
+		// sin of the cone half angle; 2 turns the test off for cones of 90 degrees or more
+		vec3 axis;
+		float cutoff = 2.0f;
+		if (!normals.empty() && sum.length() > 0.0f)
+		{
+			axis = sum.normalize();
+			float minDot = 1.0f;
+			for (unsigned int i = 0; i < normals.size(); i++) minDot = std::min(minDot, dot(normals[i], axis));
+			if (minDot > 0.0f) cutoff = sqrtf(1.0f - minDot * minDot);
+		}
+
+		float values[8] = { center.x, center.y, center.z, radius, axis.x, axis.y, axis.z, cutoff };
+		for (int k = 0; k < 8; k++) b[k * 4 + lane] = values[k];
+	}
+};
+
+// culls the meshlets of many instances in one go and writes the triangles of the visible
+// ones into a single compacted index stream, instance after instance. Culling is spread
+// over groups of four meshlets of all instances, compaction over the instances.
+class MeshletCuller
+{
+	std::vector<int> groupStart;		// first group of each instance in visible
+	std::vector<unsigned char> visible;
+	std::vector<Frustum> frustums;
+
+public:
+	struct Instance
+	{
+		const MeshletMesh* mesh;
+		mat4 MVP;			// object space to clip space
+		vec3 eye;			// in object space
+		unsigned int firstIndex, indexCount;	// output: the range in stream
+	};
+
+	std::vector<unsigned int> stream;
+	int meshletsTested, meshletsVisible;
+	unsigned int trianglesTested, trianglesVisible;
+
+	MeshletCuller() : meshletsTested(0), meshletsVisible(0), trianglesTested(0), trianglesVisible(0) {}
+
+	void Run(std::vector<Instance>& instances, ThreadPool* pool = 0)
+	{
+		if (!pool) pool = &ThreadPool::Global();
+		int count = (int)instances.size();
+		groupStart.resize(count + 1);
+		groupStart[0] = 0;
+		frustums.clear();
+		for (int i = 0; i < count; i++)
+		{
+			groupStart[i + 1] = groupStart[i] + instances[i].mesh->GetGroupCount();
+			frustums.push_back(Frustum(instances[i].MVP));
+		}
+		visible.resize(groupStart[count]);
+
+		pool->ParallelFor(groupStart[count], [&](int begin, int end)
+		{
+			int i = (int)(std::upper_bound(groupStart.begin(), groupStart.end(), begin) - groupStart.begin()) - 1;
+			while (begin < end)
+			{
+				int stop = std::min(end, groupStart[i + 1]);
+				instances[i].mesh->Cull(frustums[i], instances[i].eye, begin - groupStart[i], stop - groupStart[i], &visible[begin]);
+				begin = stop;
+				i++;
+			}
+		}, 64);
+
+		meshletsTested = meshletsVisible = 0;
+		trianglesTested = 0;
+		for (int i = 0; i < count; i++)
+		{
+			const MeshletMesh* mesh = instances[i].mesh;
+			instances[i].indexCount = 0;
+			for (unsigned int m = 0; m < mesh->meshlets.size(); m++)
+				if (visible[groupStart[i] + m / 4] >> (m % 4) & 1)
+				{
+					instances[i].indexCount += mesh->meshlets[m].triangleCount * 3;
+					meshletsVisible++;
+				}
+			instances[i].firstIndex = i ? instances[i - 1].firstIndex + instances[i - 1].indexCount : 0;
+			meshletsTested += (int)mesh->meshlets.size();
+			trianglesTested += mesh->GetTriangleCount();
+		}
+		stream.resize(count ? instances[count - 1].firstIndex + instances[count - 1].indexCount : 0);
+		trianglesVisible = (unsigned int)stream.size() / 3;
+
+		pool->ParallelFor(count, [&](int begin, int end)
+		{
+			for (int i = begin; i < end; i++)
+			{
+				const MeshletMesh* mesh = instances[i].mesh;
+				unsigned int* out = stream.empty() ? 0 : &stream[0] + instances[i].firstIndex;
+				for (unsigned int m = 0; m < mesh->meshlets.size(); m++)
+				{
+					if (!(visible[groupStart[i] + m / 4] >> (m % 4) & 1)) continue;
+					const Meshlet& meshlet = mesh->meshlets[m];
+					memcpy(out, &mesh->indices[meshlet.firstIndex], meshlet.triangleCount * 3 * sizeof(unsigned int));
+					out += meshlet.triangleCount * 3;
+				}
+			}
+		}, 1);
+	}
+};
+
+#endif
@@ -0,0 +1,505 @@
+#define _USE_MATH_DEFINES
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <fstream>
+#include <string.h>
+#include <algorithm>
+#include "ObjMesh.h"
+#include "ParallelFor.h"
+
+// the first word after s
+static std::string Token(const char* s)
+{
+	s += strspn(s, " \t");
+	return std::string(s, strcspn(s, " \t"));
+}
+
+// one corner of an 'f' record: "p", "p/t", "p//n" or "p/t/n"; indices are 1-based, or
+// relative to the end of the lists when negative
+static bool ParseCorner(const char*& s, const int counts[3], ObjMesh::Corner& corner)
+{
+	int indices[3] = { -1, -1, -1 };
+	for (int k = 0; k < 3; k++)
+	{
+		if (k > 0)
+		{
+			if (*s != '/') break;
+			s++;
+		}
+		char* end;
+		long value = strtol(s, &end, 10);
+		if (end == s)
+		{
+			if (k == 0) return false;
+			continue;			// the empty texcoord of p//n
+		}
+		s = end;
+		long index = value > 0 ? value - 1 : counts[k] + value;
+		if (value == 0 || index < 0 || index >= counts[k]) return false;
+		indices[k] = (int)index;
+	}
+	if (*s && *s != ' ' && *s != '\t') return false;
+	corner.position = indices[0];
+	corner.texcoord = indices[1];
+	corner.normal = indices[2];
+	return true;
+}
+
+ObjMesh::ObjMesh(const char *filename)
+{
+	invalidFaces = 0;
+	generatedNormals = false;
+
+	std::ifstream file(filename);
+	if(!file.is_open())
+	{
+		printf("cannot open %s\n", filename);
+		return;
+	}
+	Load(file);
+	GenerateNormals();
+	if (invalidFaces) printf("%s: %d faces with invalid indices skipped\n", filename, invalidFaces);
+
+	// libraries and texture maps are named relative to the OBJ file
+	std::string path = filename;
+	std::string::size_type slash = path.find_last_of("/\\");
+	std::string directory = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+	for (unsigned int i = 0; i < materialLibraries.size(); i++) LoadMaterialLibrary(directory + materialLibraries[i], directory);
+}
+
+
+ObjMesh::ObjMesh(std::istream& stream, bool generateNormals)
+{
+	invalidFaces = 0;
+	generatedNormals = false;
+	Load(stream);
+	if (generateNormals) GenerateNormals();
+}
+
+
+void ObjMesh::Load(std::istream& stream)
+{
+	Submesh first = { 0, 0, -1 };
+	submeshes.push_back(first);
+
+	std::string line;
+	std::vector<Corner> polygon;
+	while (std::getline(stream, line))
+	{
+		if (!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+		const char* s = line.c_str();
+		while (*s == ' ' || *s == '\t') s++;
+
+		if (s[0] == 'v' && s[1] == ' ')
+		{
+			vec3 p;
+			sscanf(s + 2, "%f %f %f", &p.x, &p.y, &p.z);
+			positions.push_back(p);
+		}
+		else if (s[0] == 'v' && s[1] == 'n')
+		{
+			vec3 n;
+			sscanf(s + 2, "%f %f %f", &n.x, &n.y, &n.z);
+			normals.push_back(n);
+		}
+		else if (s[0] == 'v' && s[1] == 't')
+		{
+			vec2 t;
+			sscanf(s + 2, "%f %f", &t.x, &t.y);
+			texcoords.push_back(t);
+		}
+		else if (s[0] == 'f' && (s[1] == ' ' || s[1] == '\t'))
+		{
+			int counts[3] = { (int)positions.size(), (int)texcoords.size(), (int)normals.size() };
+			polygon.clear();
+			bool valid = true;
+			s++;
+			for (;;)
+			{
+				while (*s == ' ' || *s == '\t') s++;
+				if (!*s) break;
+				Corner corner;
+				if (!ParseCorner(s, counts, corner))
+				{
+					valid = false;
+					break;
+				}
+				polygon.push_back(corner);
+			}
+			if (valid && polygon.size() >= 3) AddPolygon(polygon);
+			else invalidFaces++;
+		}
+		else if (s[0] == 'g') StartSubmesh(submeshes.back().material);
+		else if (strncmp(s, "usemtl", 6) == 0 && (s[6] == ' ' || s[6] == '\t'))
+		{
+			std::string name = Token(s + 6);
+			int material = 0;
+			while (material < materials.size() && materials[material].name != name) material++;
+			if (material == materials.size())
+			{
+				Material added = { name, false, vec3(0.1, 0.1, 0.1), vec3(0.9, 0.9, 0.9), vec3(0.0, 0.0, 0.0), 20.0f, "" };
+				materials.push_back(added);
+			}
+			StartSubmesh(material);
+		}
+		else if (strncmp(s, "mtllib", 6) == 0 && (s[6] == ' ' || s[6] == '\t'))
+		{
+			for (s += 6; *(s += strspn(s, " \t")); s += strcspn(s, " \t"))
+				materialLibraries.push_back(std::string(s, strcspn(s, " \t")));
+		}
+	}
+}
+
+
+void ObjMesh::StartSubmesh(int material)
+{
+	if (submeshes.back().triangleCount == 0) submeshes.back().material = material;
+	else
+	{
+		Submesh next = { GetTriangleCount(), 0, material };
+		submeshes.push_back(next);
+	}
+}
+
+
+// newmtl entries for the materials the faces use, the others are skipped
+void ObjMesh::LoadMaterialLibrary(const std::string& filename, const std::string& directory)
+{
+	std::ifstream file(filename.c_str());
+	if (!file.is_open())
+	{
+		printf("cannot open %s\n", filename.c_str());
+		return;
+	}
+
+	std::string line;
+	Material* material = 0;
+	while (std::getline(file, line))
+	{
+		if (!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+		const char* s = line.c_str();
+		s += strspn(s, " \t");
+
+		if (strncmp(s, "newmtl", 6) == 0 && (s[6] == ' ' || s[6] == '\t'))
+		{
+			std::string name = Token(s + 6);
+			material = 0;
+			for (unsigned int i = 0; i < materials.size() && !material; i++)
+				if (materials[i].name == name && !materials[i].defined) material = &materials[i];
+			if (material) material->defined = true;
+		}
+		else if (!material) continue;
+		else if (strncmp(s, "Ka ", 3) == 0) sscanf(s + 3, "%f %f %f", &material->ambient.x, &material->ambient.y, &material->ambient.z);
+		else if (strncmp(s, "Kd ", 3) == 0) sscanf(s + 3, "%f %f %f", &material->diffuse.x, &material->diffuse.y, &material->diffuse.z);
+		else if (strncmp(s, "Ks ", 3) == 0) sscanf(s + 3, "%f %f %f", &material->specular.x, &material->specular.y, &material->specular.z);
+		else if (strncmp(s, "Ns ", 3) == 0) sscanf(s + 3, "%f", &material->shininess);
+		else if (strncmp(s, "map_Kd", 6) == 0 && (s[6] == ' ' || s[6] == '\t'))
+		{
+			// the file name is the last word, after any options
+			std::string map = s + 6;
+			map.erase(map.find_last_not_of(" \t") + 1);
+			map = map.substr(map.find_last_of(" \t") + 1);
+			bool absolute = !map.empty() && (map[0] == '/' || map[0] == '\\' || (map.size() > 1 && map[1] == ':'));
+			material->diffuseMap = absolute ? map : directory + map;
+		}
+	}
+}
+
+
+// a unit sphere of slices x stacks quads, each split into two triangles, for synthetic scenes
+ObjMesh::ObjMesh(int slices, int stacks)
+{
+	invalidFaces = 0;
+	generatedNormals = false;
+
+	for(int i = 0; i <= stacks; i++)
+		for(int j = 0; j <= slices; j++)
+		{
+			float theta = M_PI * i / stacks, phi = 2.0 * M_PI * j / slices;
+			vec3 d = vec3(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+			positions.push_back(d);
+			normals.push_back(d);
+			texcoords.push_back(vec2((float)j / slices, (float)i / stacks));
+		}
+
+	for(int i = 0; i < stacks; i++)
+		for(int j = 0; j < slices; j++)
+		{
+			int a = i * (slices + 1) + j, b = a + 1, c = a + slices + 1, d = c + 1;
+			int triangles[2][3] = { { a, b, d }, { a, d, c } };
+			for(int t = 0; t < 2; t++)
+				for(int k = 0; k < 3; k++)
+				{
+					Corner corner = { triangles[t][k], triangles[t][k], triangles[t][k] };
+					corners.push_back(corner);
+				}
+		}
+	Submesh all = { 0, GetTriangleCount(), -1 };
+	submeshes.push_back(all);
+}
+
+
+// ear clipping in the plane of the polygon's Newell normal; convex polygons become fans
+// around their first corner, a polygon without ears (self-intersecting) falls back to one
+void ObjMesh::AddPolygon(const std::vector<Corner>& polygon)
+{
+	int n = (int)polygon.size();
+	int first = GetTriangleCount();
+	if (n == 3) corners.insert(corners.end(), polygon.begin(), polygon.end());
+	else
+	{
+		float normal[3] = { 0.0f, 0.0f, 0.0f };
+		for (int i = 0; i < n; i++)
+		{
+			const vec3& p = positions[polygon[i].position];
+			const vec3& q = positions[polygon[(i + 1) % n].position];
+			normal[0] += (p.y - q.y) * (p.z + q.z);
+			normal[1] += (p.z - q.z) * (p.x + q.x);
+			normal[2] += (p.x - q.x) * (p.y + q.y);
+		}
+		int drop = fabsf(normal[0]) > fabsf(normal[1]) ? (fabsf(normal[0]) > fabsf(normal[2]) ? 0 : 2) : (fabsf(normal[1]) > fabsf(normal[2]) ? 1 : 2);
+		std::vector<float> u(n), v(n);
+		float area = 0.0f;
+		for (int i = 0; i < n; i++)
+		{
+			const vec3& p = positions[polygon[i].position];
+			u[i] = drop == 0 ? p.y : p.x;
+			v[i] = drop == 2 ? p.y : p.z;
+		}
+		for (int i = 0; i < n; i++) area += u[i] * v[(i + 1) % n] - u[(i + 1) % n] * v[i];
+
+		std::vector<int> remaining(n);
+		for (int i = 0; i < n; i++) remaining[i] = i;
+		while (remaining.size() > 3)
+		{
+			int m = (int)remaining.size();
+			bool clipped = false;
+			for (int k = 0; k < m && !clipped; k++)
+			{
+				int i = (k + 1) % m;
+				int a = remaining[(i + m - 1) % m], b = remaining[i], c = remaining[(i + 1) % m];
+				float turn = (u[b] - u[a]) * (v[c] - v[a]) - (v[b] - v[a]) * (u[c] - u[a]);
+				if (turn * area <= 0.0f) continue;		// reflex or degenerate corner
+
+				bool contains = false;
+				for (int j = 0; j < m && !contains; j++)
+				{
+					int p = remaining[j];
+					if (p == a || p == b || p == c) continue;
+					float ab = (u[b] - u[a]) * (v[p] - v[a]) - (v[b] - v[a]) * (u[p] - u[a]);
+					float bc = (u[c] - u[b]) * (v[p] - v[b]) - (v[c] - v[b]) * (u[p] - u[b]);
+					float ca = (u[a] - u[c]) * (v[p] - v[c]) - (v[a] - v[c]) * (u[p] - u[c]);
+					contains = ab * area > 0.0f && bc * area > 0.0f && ca * area > 0.0f;
+				}
+				if (contains) continue;
+
+				corners.push_back(polygon[a]);
+				corners.push_back(polygon[b]);
+				corners.push_back(polygon[c]);
+				remaining.erase(remaining.begin() + i);
+				clipped = true;
+			}
+			if (!clipped) break;
+		}
+		for (unsigned int i = 1; i + 1 < remaining.size(); i++)
+		{
+			corners.push_back(polygon[remaining[0]]);
+			corners.push_back(polygon[remaining[i]]);
+			corners.push_back(polygon[remaining[i + 1]]);
+		}
+	}
+	submeshes.back().triangleCount += GetTriangleCount() - first;
+}
+
+
+// the faces around a position are gathered first, so the sums run in parallel
+void ObjMesh::GenerateNormals(ThreadPool* pool)
+{
+	bool missing = false;
+	for (unsigned int i = 0; i < corners.size() && !missing; i++) missing = corners[i].normal < 0;
+	if (!missing) return;
+
+	if (!pool) pool = &ThreadPool::Global();
+	int triangleCount = GetTriangleCount(), positionCount = (int)positions.size();
+	std::vector<vec3> faceNormals(triangleCount);
+	pool->ParallelFor(triangleCount, [&](int begin, int end)
+	{
+		for (int t = begin; t < end; t++)
+		{
+			vec3 p0 = positions[corners[t * 3].position], p1 = positions[corners[t * 3 + 1].position], p2 = positions[corners[t * 3 + 2].position];
+			faceNormals[t] = cross(p1 - p0, p2 - p0);
+		}
+	});
+
+	std::vector<int> offsets(positionCount + 1, 0), faces(corners.size());
+	for (unsigned int i = 0; i < corners.size(); i++) offsets[corners[i].position + 1]++;
+	for (int p = 0; p < positionCount; p++) offsets[p + 1] += offsets[p];
+	std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+	for (unsigned int i = 0; i < corners.size(); i++) faces[fill[corners[i].position]++] = i / 3;
+
+	int base = (int)normals.size();
+	normals.resize(base + positionCount);
+	pool->ParallelFor(positionCount, [&](int begin, int end)
+	{
+		for (int p = begin; p < end; p++)
+		{
+			vec3 sum;
+			for (int i = offsets[p]; i < offsets[p + 1]; i++) sum = sum + faceNormals[faces[i]];
+			normals[base + p] = sum.length() > 0.0f ? sum.normalize() : vec3(0.0, 1.0, 0.0);
+		}
+	});
+	for (unsigned int i = 0; i < corners.size(); i++)
+		if (corners[i].normal < 0) corners[i].normal = base + corners[i].position;
+	generatedNormals = true;
+}
+
+
+void ObjMesh::GetTriangles(std::vector<float>& triangles) const
+{
+	triangles.reserve(triangles.size() + corners.size() * IndexedMesh::vertexSize);
+	for (unsigned int i = 0; i < corners.size(); i++)
+	{
+		const vec3& p = positions[corners[i].position];
+		vec2 uv = corners[i].texcoord >= 0 ? texcoords[corners[i].texcoord] : vec2();
+		const vec3& n = normals[corners[i].normal];
+		float vertex[IndexedMesh::vertexSize] = { p.x, p.y, p.z, uv.x, 1-uv.y, n.x, n.y, n.z };
+		triangles.insert(triangles.end(), vertex, vertex + IndexedMesh::vertexSize);
+	}
+}
+
+
+void ObjMesh::GetTrianglePositions(std::vector<vec3>& triangles) const
+{
+	for (unsigned int i = 0; i < corners.size(); i++) triangles.push_back(positions[corners[i].position]);
+}
+
+
+static vec3 Normalized(vec3 v)
+{
+	float length = v.length();
+	return length > 1e-20f ? v / length : vec3();
+}
+
+// v without its component along the unit vector n
+static vec3 Reject(vec3 v, vec3 n)
+{
+	return v - n * dot(v, n);
+}
+
+void ObjMesh::GetTangents(std::vector<float>& tangents, ThreadPool* pool) const
+{
+	if (!pool) pool = &ThreadPool::Global();
+	int triangleCount = GetTriangleCount(), positionCount = (int)positions.size();
+
+	// per corner: the face tangent in the corner's tangent plane, weighted by the corner angle
+	std::vector<vec3> weighted(corners.size());
+	std::vector<char> preserving(triangleCount);
+	pool->ParallelFor(triangleCount, [&](int begin, int end)
+	{
+		for (int t = begin; t < end; t++)
+		{
+			const Corner* c = &corners[t * 3];
+			vec3 p[3];
+			vec2 uv[3];
+			for (int k = 0; k < 3; k++)
+			{
+				p[k] = positions[c[k].position];
+				uv[k] = c[k].texcoord >= 0 ? texcoords[c[k].texcoord] : vec2();
+				uv[k].y = 1.0f - uv[k].y;
+			}
+			vec3 d1 = p[1] - p[0], d2 = p[2] - p[0];
+			float s1 = uv[1].x - uv[0].x, t1 = uv[1].y - uv[0].y, s2 = uv[2].x - uv[0].x, t2 = uv[2].y - uv[0].y;
+			float signedArea = s1 * t2 - s2 * t1;
+			preserving[t] = signedArea > 0.0f;
+			vec3 faceTangent = Normalized(d1 * t2 - d2 * t1) * (signedArea > 0.0f ? 1.0f : -1.0f);
+			if (fabsf(signedArea) < 1e-20f) faceTangent = vec3();
+
+			for (int k = 0; k < 3; k++)
+			{
+				vec3 n = normals[c[k].normal];
+				vec3 e1 = Normalized(Reject(p[(k + 1) % 3] - p[k], n)), e2 = Normalized(Reject(p[(k + 2) % 3] - p[k], n));
+				float angle = acosf(std::max(-1.0f, std::min(1.0f, dot(e1, e2))));
+				weighted[t * 3 + k] = Normalized(Reject(faceTangent, n)) * angle;
+			}
+		}
+	});
+
+	// the corners around each position, grouped by texcoord, normal and handedness
+	std::vector<int> offsets(positionCount + 1, 0), around(corners.size());
+	for (unsigned int i = 0; i < corners.size(); i++) offsets[corners[i].position + 1]++;
+	for (int p = 0; p < positionCount; p++) offsets[p + 1] += offsets[p];
+	std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+	for (unsigned int i = 0; i < corners.size(); i++) around[fill[corners[i].position]++] = i;
+
+	tangents.resize(corners.size() * 4);
+	pool->ParallelFor(positionCount, [&](int begin, int end)
+	{
+		for (int p = begin; p < end; p++)
+			for (int i = offsets[p]; i < offsets[p + 1]; i++)
+			{
+				const Corner& corner = corners[around[i]];
+				bool handedness = preserving[around[i] / 3] != 0;
+				vec3 sum;
+				for (int j = offsets[p]; j < offsets[p + 1]; j++)
+				{
+					const Corner& other = corners[around[j]];
+					if (other.texcoord == corner.texcoord && other.normal == corner.normal && (preserving[around[j] / 3] != 0) == handedness)
+						sum = sum + weighted[around[j]];
+				}
+				vec3 n = normals[corner.normal];
+				vec3 tangent = Normalized(sum);
+				if (tangent.length() == 0.0f)
+				{
+					// no usable texture coordinates: any direction in the tangent plane
+					tangent = Normalized(Reject(fabsf(n.x) < 0.9f ? vec3(1.0, 0.0, 0.0) : vec3(0.0, 1.0, 0.0), n));
+				}
+				float* target = &tangents[around[i] * 4];
+				target[0] = tangent.x;
+				target[1] = tangent.y;
+				target[2] = tangent.z;
+				target[3] = handedness ? 1.0f : -1.0f;
+			}
+	});
+}
+
+
+void ObjMesh::SortByMaterial(std::vector<int>& order, std::vector<Submesh>& ranges) const
+{
+	std::vector<int> used;
+	for (unsigned int i = 0; i < submeshes.size(); i++)
+		if (std::find(used.begin(), used.end(), submeshes[i].material) == used.end()) used.push_back(submeshes[i].material);
+
+	order.clear();
+	ranges.clear();
+	for (unsigned int m = 0; m < used.size(); m++)
+	{
+		Submesh range = { (int)order.size(), 0, used[m] };
+		for (unsigned int i = 0; i < submeshes.size(); i++)
+			if (submeshes[i].material == used[m])
+				for (int t = 0; t < submeshes[i].triangleCount; t++) order.push_back(submeshes[i].firstTriangle + t);
+		range.triangleCount = (int)order.size() - range.firstTriangle;
+		if (range.triangleCount > 0) ranges.push_back(range);
+	}
+}
+
+
+IndexedMesh* ObjMesh::BuildIndexedMesh() const
+{
+	if (GetTriangleCount() == 0) return 0;
+
+	std::vector<float> triangles;
+	GetTriangles(triangles);
+	static const int lodGrids[IndexedMesh::lodCount - 1] = { 24, 8 };
+	return IndexedMesh::Build(triangles, lodGrids);
+}
+
+
+OccluderMesh* ObjMesh::BuildOccluder() const
+{
+	if (GetTriangleCount() == 0) return 0;
+
+	std::vector<vec3> triangles;
+	GetTrianglePositions(triangles);
+	return OccluderMesh::Simplify(triangles, 16);
+}
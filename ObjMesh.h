@@ -0,0 +1,107 @@
+#ifndef OBJMESH_H
+#define OBJMESH_H
+
+#include <string>
+#include <vector>
+#include <istream>
+#include "VectorMath.h"
+#include "IndexedMesh.h"
+#include "SoftwareOcclusion.h"
+
+class ThreadPool;
+
+// the faces of a Wavefront OBJ file (or a generated sphere) as read, before any GL
+// upload; PolygonalMesh draws them, offline tools use them directly. Faces may use any
+// of the v, v/vt, v//vn and v/vt/vn forms with positive or negative (relative) indices;
+// polygons are ear clipped into triangles, and corners without a normal get smooth
+// normals generated from the faces around their position. 'g' and 'usemtl' records start
+// submeshes; the materials come from the mtllib files next to the OBJ file.
+class ObjMesh
+{
+public:
+	// indices into positions, texcoords and normals, -1 where the face gave none
+	struct Corner
+	{
+		int position, texcoord, normal;
+	};
+
+	// the triangles between two 'g' or 'usemtl' records, with an index into the
+	// materials or -1 before the first usemtl
+	struct Submesh
+	{
+		int firstTriangle, triangleCount;
+		int material;
+	};
+
+	// a newmtl entry of a material library; a usemtl name found in none of the libraries
+	// stays undefined, with the defaults below
+	struct Material
+	{
+		std::string name;
+		bool defined;
+		vec3 ambient, diffuse, specular;	// Ka, Kd, Ks
+		float shininess;					// Ns
+		std::string diffuseMap;				// map_Kd, relative to the working directory
+	};
+
+private:
+	std::vector<vec3> positions;
+	std::vector<vec2> texcoords;
+	std::vector<vec3> normals;
+	std::vector<Corner> corners;	// three per triangle
+	std::vector<Submesh> submeshes;
+	std::vector<Material> materials;
+	std::vector<std::string> materialLibraries;	// as named by mtllib
+	int invalidFaces;				// skipped for indices out of range or too few corners
+	bool generatedNormals;
+
+	void Load(std::istream& stream);
+	void AddPolygon(const std::vector<Corner>& polygon);
+	void StartSubmesh(int material);
+	void LoadMaterialLibrary(const std::string& filename, const std::string& directory);
+
+public:
+	ObjMesh(const char *filename);
+	// OBJ text from any stream, e.g. generated in memory; without generateNormals, corners
+	// may lack normals until GenerateNormals. Material libraries are not read, so every
+	// material stays undefined.
+	ObjMesh(std::istream& stream, bool generateNormals = true);
+	// a unit sphere of slices x stacks quads, each split into two triangles, for synthetic scenes
+	ObjMesh(int slices, int stacks);
+
+	int GetTriangleCount() const { return (int)corners.size() / 3; }
+	int GetInvalidFaceCount() const { return invalidFaces; }
+	bool HasGeneratedNormals() const { return generatedNormals; }
+	const std::vector<Submesh>& GetSubmeshes() const { return submeshes; }
+	const std::vector<Material>& GetMaterials() const { return materials; }
+
+	// the triangles grouped by material, materials in order of first use: triangle i of
+	// the grouping is triangle order[i] of the mesh, ranges has one Submesh per material
+	void SortByMaterial(std::vector<int>& order, std::vector<Submesh>& ranges) const;
+
+	// smooth normals for the corners without one: area weighted face normals summed
+	// around each position; nothing to do when every corner has a normal
+	void GenerateNormals(ThreadPool* pool = 0);
+
+	// unwelded triangles in the IndexedMesh vertex layout (position, texture coordinate
+	// with v flipped for GL, normal)
+	void GetTriangles(std::vector<float>& triangles) const;
+
+	// three corners per triangle
+	void GetTrianglePositions(std::vector<vec3>& triangles) const;
+
+	// one tangent per corner of GetTriangles: xyz and the bitangent sign in w, for the
+	// texture coordinates as GetTriangles flips them. MikkTSpace's construction: face
+	// tangents from the texture coordinate gradients, projected into each corner's
+	// tangent plane and angle weighted over the corners sharing position, texture
+	// coordinate, normal and handedness.
+	void GetTangents(std::vector<float>& tangents, ThreadPool* pool = 0) const;
+
+	// welded vertices with the LOD index lists, 0 for an empty mesh
+	IndexedMesh* BuildIndexedMesh() const;
+
+	// simplified triangles for software occlusion, 0 for an empty mesh
+	OccluderMesh* BuildOccluder() const;
+};
+
+#endif
@@ -0,0 +1,193 @@
+// CPU benchmark for OBJ parsing and smooth normal and tangent generation, no GL needed.
+// First checks the face forms and usemtl grouping on small hand written files, then parses a large
+// generated one: a band of a sphere in v/vt quads (every other row with negative indices)
+// closed by two n-gon caps, without any vn records.
+//   g++ -O2 -std=c++11 -pthread ObjMeshBench.cpp ObjMesh.cpp -o ObjMeshBench
+//   ./ObjMeshBench [slices] [stacks]
+
+#define _USE_MATH_DEFINES
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "ObjMesh.h"
+#include "ParallelFor.h"
+
+// every face form, invalid faces, CRLF, and a concave hexagon of area 3 in a second group
+const char* formsText =
+	"v 0 0 0\nv 2 0 0\nv 2 1 0\nv 1 1 0\nv 1 2 0\nv 0 2 0\n"
+	"vt 0 0\nvt 1 0\nvt 1 1\nvn 0 0 1\n"
+	"f 1 2 3\n"
+	"f 1/1 2/2 3/3\r\n"
+	"f 1//1 2//1 3//1\n"
+	"f -6/-3/-1 -5/-2/-1 -4/-1/-1\n"
+	"f 1 2 99\n"
+	"f 1/1/5 2 3\n"
+	"f 1 2\n"
+	"g second\n"
+	"f 1 2 3 4 5 6\n";
+
+// submeshes by usemtl, with material a used twice
+const char* materialsText =
+	"mtllib none.mtl\n"
+	"v 0 0 0\nv 1 0 0\nv 0 1 0\n"
+	"f 1 2 3\n"
+	"usemtl a\nf 1 2 3\nf 1 2 3\n"
+	"g x\nusemtl b\nf 1 2 3\n"
+	"usemtl a\nf 1 2 3\n";
+
+int CheckForms()
+{
+	std::istringstream text(formsText);
+	ObjMesh mesh(text);
+	int errors = 0;
+	if (mesh.GetTriangleCount() != 8) { printf("forms: %d triangles, expected 8\n", mesh.GetTriangleCount()); errors++; }
+	if (mesh.GetInvalidFaceCount() != 3) { printf("forms: %d invalid faces, expected 3\n", mesh.GetInvalidFaceCount()); errors++; }
+	if (mesh.GetSubmeshes().size() != 2) { printf("forms: %d submeshes, expected 2\n", (int)mesh.GetSubmeshes().size()); errors++; }
+	if (!mesh.HasGeneratedNormals()) { printf("forms: no normals generated\n"); errors++; }
+
+	std::vector<vec3> triangles;
+	mesh.GetTrianglePositions(triangles);
+	float area = 0.0f;
+	for (int t = 4; t < mesh.GetTriangleCount(); t++)
+	{
+		vec3 a = triangles[t * 3], b = triangles[t * 3 + 1], c = triangles[t * 3 + 2];
+		float z = cross(b - a, c - a).z * 0.5f;
+		if (z <= 0.0f) { printf("forms: hexagon triangle %d flipped or degenerate\n", t); errors++; }
+		area += z;
+	}
+	if (fabsf(area - 3.0f) > 1e-5f) { printf("forms: hexagon area %f, expected 3\n", area); errors++; }
+
+	std::vector<float> vertices;
+	mesh.GetTriangles(vertices);
+	for (int i = 0; i < mesh.GetTriangleCount() * 3; i++)
+		if (fabsf(vertices[i * IndexedMesh::vertexSize + 7] - 1.0f) > 1e-5f) { printf("forms: corner %d normal not +z\n", i); errors++; break; }
+
+	std::istringstream materialText(materialsText);
+	ObjMesh materialMesh(materialText);
+	std::vector<int> order;
+	std::vector<ObjMesh::Submesh> ranges;
+	materialMesh.SortByMaterial(order, ranges);
+	static const int expectedOrder[5] = { 0, 1, 2, 4, 3 };
+	static const int expectedRanges[3][3] = { { 0, 1, -1 }, { 1, 3, 0 }, { 4, 1, 1 } };
+	bool sorted = materialMesh.GetSubmeshes().size() == 4 && materialMesh.GetMaterials().size() == 2 && order.size() == 5 && ranges.size() == 3;
+	for (int i = 0; sorted && i < 5; i++) sorted = order[i] == expectedOrder[i];
+	for (int i = 0; sorted && i < 3; i++)
+		sorted = ranges[i].firstTriangle == expectedRanges[i][0] && ranges[i].triangleCount == expectedRanges[i][1] && ranges[i].material == expectedRanges[i][2];
+	if (!sorted) { printf("forms: usemtl submeshes not grouped by material\n"); errors++; }
+	return errors;
+}
+
+// ring i of the band has slices + 1 vertices (the seam twice, for the texture coordinates)
+std::string GenerateBand(int slices, int stacks)
+{
+	std::ostringstream text;
+	float theta0 = 0.15f * M_PI, theta1 = 0.85f * M_PI;
+	for (int i = 0; i <= stacks; i++)
+		for (int j = 0; j <= slices; j++)
+		{
+			float theta = theta0 + (theta1 - theta0) * i / stacks, phi = 2.0f * M_PI * j / slices;
+			char line[96];
+			sprintf(line, "v %.6f %.6f %.6f\n", sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+			text << line;
+		}
+	for (int i = 0; i <= stacks; i++)
+		for (int j = 0; j <= slices; j++)
+		{
+			char line[64];
+			sprintf(line, "vt %.6f %.6f\n", (float)j / slices, (float)i / stacks);
+			text << line;
+		}
+	int count = (stacks + 1) * (slices + 1);
+	for (int i = 0; i < stacks; i++)
+		for (int j = 0; j < slices; j++)
+		{
+			int a = i * (slices + 1) + j + 1, b = a + 1, c = a + slices + 1, d = c + 1;
+			if (i % 2) { a -= count + 1; b -= count + 1; c -= count + 1; d -= count + 1; }
+			char line[128];
+			sprintf(line, "f %d/%d %d/%d %d/%d %d/%d\n", a, a, b, b, d, d, c, c);
+			text << line;
+		}
+	// caps facing up and down, positions only
+	text << "f";
+	for (int j = slices - 1; j >= 0; j--) text << ' ' << j + 1;
+	text << "\nf";
+	for (int j = 0; j < slices; j++) text << ' ' << stacks * (slices + 1) + j + 1;
+	text << "\n";
+	return text.str();
+}
+
+double Milliseconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+	int slices = argc > 1 ? atoi(argv[1]) : 1536;
+	int stacks = argc > 2 ? atoi(argv[2]) : 768;
+
+	int errors = CheckForms();
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::string text = GenerateBand(slices, stacks);
+	double generateTime = Milliseconds(start);
+
+	start = std::chrono::steady_clock::now();
+	std::istringstream stream(text);
+	ObjMesh parsed(stream, false);
+	double parseTime = Milliseconds(start);
+	int triangles = parsed.GetTriangleCount();
+	printf("mesh: %d triangles, %.1f MB of OBJ text (generated in %.0f ms), parsed in %.1f ms (%.1f MB/s, %.2f M triangles/s)\n",
+		triangles, text.size() / 1048576.0, generateTime, parseTime, text.size() / 1048576.0 / (parseTime * 0.001), triangles / (parseTime * 1000.0));
+	if (triangles != 2 * slices * stacks + 2 * (slices - 2)) { printf("expected %d triangles\n", 2 * slices * stacks + 2 * (slices - 2)); errors++; }
+
+	printf("threads\tnormals ms\ttangents ms\tM triangles/s\n");
+	std::vector<int> threadCounts = ThreadCounts();
+	ObjMesh mesh = parsed;
+	std::vector<float> tangents;
+	for (unsigned int step = 0; step < threadCounts.size(); step++)
+	{
+		int t = threadCounts[step];
+		ThreadPool pool(t);
+		mesh = parsed;
+		start = std::chrono::steady_clock::now();
+		mesh.GenerateNormals(&pool);
+		double normalTime = Milliseconds(start);
+		start = std::chrono::steady_clock::now();
+		mesh.GetTangents(tangents, &pool);
+		double tangentTime = Milliseconds(start);
+		printf("%d\t%.1f\t\t%.1f\t\t%.2f\n", t, normalTime, tangentTime, triangles / ((normalTime + tangentTime) * 1000.0));
+	}
+
+	// band corners away from the rims: radial normals, tangents along increasing phi, one
+	// handedness; every corner: unit tangent in the tangent plane
+	std::vector<float> vertices;
+	mesh.GetTriangles(vertices);
+	int badNormals = 0, badTangents = 0, badBand = 0, signs[2] = { 0, 0 };
+	for (int i = 0; i < triangles * 3; i++)
+	{
+		const float* v = &vertices[i * IndexedMesh::vertexSize];
+		const float* t = &tangents[i * 4];
+		vec3 p(v[0], v[1], v[2]), n(v[5], v[6], v[7]), tangent(t[0], t[1], t[2]);
+		if (fabsf(n.length() - 1.0f) > 1e-4f) badNormals++;
+		if (fabsf(tangent.length() - 1.0f) > 1e-4f || fabsf(dot(tangent, n)) > 1e-3f || fabsf(fabsf(t[3]) - 1.0f) > 0.0f) badTangents++;
+
+		bool band = i < 2 * slices * stacks * 3;
+		float rim = fabsf(p.y) - cosf(0.15f * M_PI);
+		if (!band || fabsf(rim) < 1e-4f) continue;
+		vec3 radial = p.normalize();
+		float phi = atan2f(p.z, p.x);
+		vec3 along(-sinf(phi), 0.0f, cosf(phi));
+		if (dot(n, radial) < 0.999f) badNormals++;
+		if (dot(tangent, along) < 0.99f) badBand++;
+		signs[t[3] > 0.0f]++;
+	}
+	if (signs[0] && signs[1]) badBand += std::min(signs[0], signs[1]);
+	printf("check: %d bad normals, %d bad tangents, %d band tangents off the phi direction or handedness\n", badNormals, badTangents, badBand);
+	return errors || badNormals || badTangents || badBand ? 1 : 0;
+}
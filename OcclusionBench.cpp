@@ -0,0 +1,194 @@
+// CPU benchmark for SoftwareOcclusion, no GL needed.
+//   g++ -O2 -std=c++11 -pthread OcclusionBench.cpp -o OcclusionBench
+//   ./OcclusionBench [occludees]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include "SoftwareOcclusion.h"
+
+mat4 LookAt(vec3 wEye, vec3 wLookat, vec3 wVup)
+{
+	vec3 w = (wEye - wLookat).normalize();
+	vec3 u = cross(wVup, w).normalize();
+	vec3 v = cross(w, u);
+	return
+		mat4(1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			-wEye.x, -wEye.y, -wEye.z, 1.0f) *
+		mat4(u.x, v.x, w.x, 0.0f,
+			u.y, v.y, w.y, 0.0f,
+			u.z, v.z, w.z, 0.0f,
+			0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+mat4 Perspective(float fov, float asp, float fp, float bp)
+{
+	float sy = 1 / tan(fov / 2);
+	return mat4(
+		sy / asp, 0.0f, 0.0f, 0.0f,
+		0.0f, sy, 0.0f, 0.0f,
+		0.0f, 0.0f, -(fp + bp) / (bp - fp), -1.0f,
+		0.0f, 0.0f, -2 * fp * bp / (bp - fp), 0.0f);
+}
+
+mat4 Placement(vec3 position, vec3 scale)
+{
+	return mat4(scale.x, 0.0f, 0.0f, 0.0f,
+		0.0f, scale.y, 0.0f, 0.0f,
+		0.0f, 0.0f, scale.z, 0.0f,
+		position.x, position.y, position.z, 1.0f);
+}
+
+// unit cube [0,1]^3 as an indexed occluder
+OccluderMesh* Cube()
+{
+	static const unsigned int faces[6][4] = {
+		{ 0, 2, 6, 4 }, { 1, 5, 7, 3 }, { 0, 4, 5, 1 }, { 2, 3, 7, 6 }, { 0, 1, 3, 2 }, { 4, 6, 7, 5 } };
+	OccluderMesh* mesh = new OccluderMesh();
+	for (int i = 0; i < 8; i++) mesh->positions.push_back(vec3(i & 1 ? 1.0 : 0.0, i & 2 ? 1.0 : 0.0, i & 4 ? 1.0 : 0.0));
+	for (int f = 0; f < 6; f++)
+	{
+		unsigned int quad[6] = { faces[f][0], faces[f][1], faces[f][2], faces[f][0], faces[f][2], faces[f][3] };
+		mesh->indices.insert(mesh->indices.end(), quad, quad + 6);
+	}
+	return mesh;
+}
+
+// unit sphere as a triangle soup, like the output of PolygonalMesh
+std::vector<vec3> SphereTriangles(int slices, int stacks)
+{
+	std::vector<vec3> triangles;
+	for (int i = 0; i < stacks; i++)
+		for (int j = 0; j < slices; j++)
+		{
+			vec3 p[4];
+			for (int k = 0; k < 4; k++)
+			{
+				float theta = M_PI * (i + (k >> 1)) / stacks, phi = 2.0 * M_PI * (j + (k & 1)) / slices;
+				p[k] = vec3(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+			}
+			triangles.push_back(p[0]); triangles.push_back(p[1]); triangles.push_back(p[3]);
+			triangles.push_back(p[0]); triangles.push_back(p[3]); triangles.push_back(p[2]);
+		}
+	return triangles;
+}
+
+// level 0 only, every pixel under the rectangle
+bool IsVisibleReference(SoftwareOcclusion& occlusion, mat4& VP, float nearPlane, BoundingBox& box)
+{
+	int width = occlusion.GetWidth(), height = occlusion.GetHeight();
+	float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, minZ = 1e30f;
+	for (int i = 0; i < 8; i++)
+	{
+		vec4 p = vec4(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y, i & 4 ? box.max.z : box.min.z, 1.0) * VP;
+		if (p.v[3] < nearPlane) return true;
+		float invW = 1.0f / p.v[3];
+		float x = (p.v[0] * invW * 0.5f + 0.5f) * width, y = (p.v[1] * invW * 0.5f + 0.5f) * height;
+		minX = std::min(minX, x); maxX = std::max(maxX, x);
+		minY = std::min(minY, y); maxY = std::max(maxY, y);
+		minZ = std::min(minZ, p.v[2] * invW * 0.5f + 0.5f);
+	}
+	if (maxX < 0.0f || maxY < 0.0f || minX > width || minY > height || minZ > 1.0f) return false;
+	for (int y = std::max((int)minY, 0); y <= std::min((int)maxY, height - 1); y++)
+		for (int x = std::max((int)minX, 0); x <= std::min((int)maxX, width - 1); x++)
+			if (occlusion.GetDepth()[y * occlusion.GetStride() + x] >= minZ) return true;
+	return false;
+}
+
+int main(int argc, char* argv[])
+{
+	int occludeeCount = argc > 1 ? atoi(argv[1]) : 10000;
+	int width = 1280 / 4, height = 720 / 4;
+	const int iterations = 50;
+	float fp = 0.1, bp = 200.0;
+
+	mat4 VP = LookAt(vec3(0.0, 2.0, -10.0), vec3(0.0, 1.0, 30.0), vec3(0.0, 1.0, 0.0)) *
+		Perspective(M_PI / 4.0, 1280.0f / 720.0f, fp, bp);
+
+	// a street of buildings and a few boulders in front of a field of small boxes
+	srand(1);
+	OccluderMesh* cube = Cube();
+	OccluderMesh* boulder = OccluderMesh::Simplify(SphereTriangles(64, 32), 8);
+	std::vector<OccluderMesh*> occluders;
+	std::vector<mat4> placements;
+	for (int i = 0; i < 24; i++)
+	{
+		vec3 r = vec3::random();
+		occluders.push_back(cube);
+		placements.push_back(Placement(vec3(-30.0 + i * 2.5, 0.0, 5.0 + r.z * 3.0), vec3(2.0, 4.0 + r.y * 2.0, 2.0)));
+	}
+	for (int i = 0; i < 16; i++)
+	{
+		vec3 r = vec3::random();
+		occluders.push_back(boulder);
+		placements.push_back(Placement(vec3(r.x * 15.0, 0.5, 2.0 + fabs(r.z) * 4.0), vec3(1.0, 1.0, 1.0)));
+	}
+
+	std::vector<BoundingBox> boxes;
+	for (int i = 0; i < occludeeCount; i++)
+	{
+		vec3 p = vec3::random(), s = vec3::random();
+		BoundingBox box;
+		box.Extend(vec3(p.x * 40.0, 0.0, 10.0 + (p.z + 1.0) * 35.0));
+		box.Extend(box.min + vec3(0.2 + fabs(s.x), 0.2 + fabs(s.y) * 2.0, 0.2 + fabs(s.z)));
+		boxes.push_back(box);
+	}
+
+	printf("%dx%d depth, %d occluders (boulder: %d triangles from %d), %d occludees, %d iterations\n", width, height,
+		(int)occluders.size(), boulder->GetTriangleCount(), 64 * 32 * 2, occludeeCount, iterations);
+	// boxes that only the frustum removes
+	SoftwareOcclusion empty(width, height);
+	empty.Begin(VP, fp);
+	empty.Rasterize();
+	std::vector<char> inFrustum;
+	empty.TestBoxes(boxes, inFrustum);
+	int outside = 0;
+	for (int i = 0; i < occludeeCount; i++) if (!inFrustum[i]) outside++;
+	printf("%d occludees outside the frustum\n", outside);
+
+	printf("threads\traster ms\ttest ms\ttotal ms\ttriangles\toccluded\tunsafe\n");
+
+	std::vector<int> threadCounts = ThreadCounts();
+	for (unsigned int step = 0; step < threadCounts.size(); step++)
+	{
+		int t = threadCounts[step];
+		ThreadPool pool(t);
+		SoftwareOcclusion occlusion(width, height);
+		std::vector<char> visible;
+		double rasterTime = 0.0, testTime = 0.0;
+
+		for (int i = 0; i < iterations; i++)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			occlusion.Begin(VP, fp);
+			for (unsigned int o = 0; o < occluders.size(); o++) occlusion.AddOccluder(*occluders[o], placements[o]);
+			occlusion.Rasterize(&pool);
+			std::chrono::steady_clock::time_point rasterized = std::chrono::steady_clock::now();
+			occlusion.TestBoxes(boxes, visible, &pool);
+			std::chrono::steady_clock::time_point tested = std::chrono::steady_clock::now();
+
+			rasterTime += std::chrono::duration<double, std::milli>(rasterized - start).count();
+			testTime += std::chrono::duration<double, std::milli>(tested - rasterized).count();
+		}
+
+		// hidden by the pyramid although a level 0 pixel shows it: must never happen
+		int occluded = 0, unsafe = 0;
+		for (int i = 0; i < occludeeCount; i++)
+		{
+			if (visible[i] || !inFrustum[i]) continue;
+			occluded++;
+			if (IsVisibleReference(occlusion, VP, fp, boxes[i])) unsafe++;
+		}
+
+		printf("%d\t%.3f\t\t%.3f\t\t%.3f\t\t%d\t\t%d\t\t%d\n", t, rasterTime / iterations, testTime / iterations,
+			(rasterTime + testTime) / iterations, occlusion.occluderTriangles, occluded, unsafe);
+	}
+
+	delete cube;
+	delete boulder;
+	return 0;
+}
@@ -0,0 +1,122 @@
+#ifndef PARALLELFOR_H
+#define PARALLELFOR_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <algorithm>
+
+// persistent worker pool: ParallelFor hands out contiguous [begin, end) chunks of
+// an index range to the workers and the calling thread, and returns when all of
+// them are done. Not reentrant: jobs must not call ParallelFor on the same pool.
+class ThreadPool
+{
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake, done;
+
+	std::function<void(int, int)> job;
+	int jobCount, jobGrain;
+	std::atomic<int> next;
+	int busy;
+	unsigned int generation;
+	bool quit;
+
+	void RunChunks()
+	{
+		for (;;)
+		{
+			int begin = next.fetch_add(jobGrain);
+			if (begin >= jobCount) break;
+			job(begin, std::min(begin + jobGrain, jobCount));
+		}
+	}
+
+	void WorkerLoop()
+	{
+		unsigned int seen = 0;
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [&] { return quit || generation != seen; });
+				if (quit) return;
+				seen = generation;
+			}
+			RunChunks();
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (--busy == 0) done.notify_one();
+			}
+		}
+	}
+
+public:
+	// nThreads counts the calling thread; 0 uses every hardware thread
+	ThreadPool(int nThreads = 0) : jobCount(0), jobGrain(1), next(0), busy(0), generation(0), quit(false)
+	{
+		if (nThreads <= 0) nThreads = std::max(1, (int)std::thread::hardware_concurrency());
+		for (int i = 1; i < nThreads; i++) workers.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			quit = true;
+		}
+		wake.notify_all();
+		for (unsigned int i = 0; i < workers.size(); i++) workers[i].join();
+	}
+
+	int GetThreadCount() { return (int)workers.size() + 1; }
+
+	void ParallelFor(int count, const std::function<void(int begin, int end)>& f, int grain = 0)
+	{
+		if (count <= 0) return;
+		if (grain <= 0) grain = std::max(1, count / (GetThreadCount() * 4));
+		if (workers.empty() || count <= grain)
+		{
+			f(0, count);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job = f;
+			jobCount = count;
+			jobGrain = grain;
+			next = 0;
+			busy = (int)workers.size();
+			generation++;
+		}
+		wake.notify_all();
+		RunChunks();
+
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [&] { return busy == 0; });
+		job = nullptr;
+	}
+
+	static ThreadPool& Global()
+	{
+		static ThreadPool pool;
+		return pool;
+	}
+};
+
+// the thread counts a benchmark steps through: the powers of two below maxThreads, then
+// maxThreads itself; 0 for every hardware thread
+inline std::vector<int> ThreadCounts(int maxThreads = 0)
+{
+	if (maxThreads <= 0) maxThreads = std::max(1, (int)std::thread::hardware_concurrency());
+	std::vector<int> counts;
+	for (int t = 1; t < maxThreads; t *= 2) counts.push_back(t);
+	counts.push_back(maxThreads);
+	return counts;
+}
+
+#endif
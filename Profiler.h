@@ -0,0 +1,174 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdio.h>
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+#include <chrono>
+
+// named CPU scopes and GPU pass times of the last frameCapacity frames in a ring buffer,
+// exported as Chrome trace JSON (chrome://tracing or ui.perfetto.dev). Scopes are recorded
+// from the main thread only. Off by default: a disabled scope costs one branch, and
+// MESHLOADER_NO_PROFILER compiles the PROFILE_SCOPE markers out entirely.
+class Profiler
+{
+public:
+	struct Event
+	{
+		const char* name;		// string literal, never copied
+		double start, duration;	// microseconds since the profiler was created
+		bool gpu;
+	};
+
+	struct Frame
+	{
+		int index;
+		std::vector<Event> events;	// kept between reuses, so recording does not allocate
+	};
+
+	static const int frameCapacity = 256;
+
+private:
+	std::vector<Frame> frames;
+	int frameCount;
+	std::chrono::steady_clock::time_point origin;
+
+	static void WriteEvent(FILE* file, const Event& event, double start, int frame, bool& first)
+	{
+		fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%d}}",
+			first ? "" : ",", event.name, event.gpu ? 2 : 1, start, event.duration, frame);
+		first = false;
+	}
+
+public:
+	bool enabled;
+
+	Profiler() : frames(frameCapacity), frameCount(0), origin(std::chrono::steady_clock::now()), enabled(false) {}
+
+	static Profiler& Get()
+	{
+		static Profiler profiler;
+		return profiler;
+	}
+
+	double Now() const { return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - origin).count(); }
+
+	// everything recorded from here on belongs to a new frame, which replaces the oldest one
+	void BeginFrame()
+	{
+		if (!enabled) return;
+		Frame& frame = frames[frameCount % frameCapacity];
+		frame.index = frameCount++;
+		frame.events.clear();
+	}
+
+	int GetFrameIndex() const { return frameCount - 1; }
+
+	// frame < 0 is the current frame; results for frames that left the ring are dropped
+	void AddEvent(const char* name, double start, double duration, bool gpu = false, int frame = -1)
+	{
+		if (frame < 0) frame = frameCount - 1;
+		if (frame < 0 || frame < frameCount - frameCapacity) return;
+		Event event = { name, start, duration, gpu };
+		frames[frame % frameCapacity].events.push_back(event);
+	}
+
+	// GPU times only come with durations, so each frame's GPU passes are laid out in
+	// submission order, none starting before its CPU submission or the previous pass' end
+	bool WriteChromeTrace(const std::string& filename) const
+	{
+		FILE* file = fopen(filename.c_str(), "w");
+		if (!file)
+		{
+			printf("cannot write %s\n", filename.c_str());
+			return false;
+		}
+		fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+		fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n");
+		fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU (GL_TIME_ELAPSED)\"}}");
+		bool first = false;
+		for (int f = std::max(0, frameCount - frameCapacity); f < frameCount; f++)
+		{
+			const Frame& frame = frames[f % frameCapacity];
+			double gpuEnd = 0.0;
+			for (unsigned int i = 0; i < frame.events.size(); i++)
+			{
+				const Event& event = frame.events[i];
+				double start = event.start;
+				if (event.gpu)
+				{
+					start = std::max(start, gpuEnd);
+					gpuEnd = start + event.duration;
+				}
+				WriteEvent(file, event, start, frame.index, first);
+			}
+		}
+		fprintf(file, "\n]}\n");
+		fclose(file);
+		return true;
+	}
+
+	// per scope name, average milliseconds and calls per frame over the frames in the ring
+	void PrintSummary() const
+	{
+		struct Total { double milliseconds; int calls; };
+		std::map<std::string, Total> totals;
+		int first = std::max(0, frameCount - frameCapacity);
+		for (int f = first; f < frameCount; f++)
+		{
+			const Frame& frame = frames[f % frameCapacity];
+			for (unsigned int i = 0; i < frame.events.size(); i++)
+			{
+				Total& total = totals[std::string(frame.events[i].gpu ? "gpu " : "cpu ") + frame.events[i].name];
+				total.milliseconds += frame.events[i].duration * 0.001;
+				total.calls++;
+			}
+		}
+		std::vector<std::pair<double, std::string> > order;
+		for (std::map<std::string, Total>::iterator t = totals.begin(); t != totals.end(); t++) order.push_back(std::make_pair(-t->second.milliseconds, t->first));
+		std::sort(order.begin(), order.end());
+
+		int count = frameCount - first;
+		printf("profile over %d frames (ms per frame, calls per frame):\n", count);
+		for (unsigned int i = 0; i < order.size(); i++)
+		{
+			const Total& total = totals[order[i].second];
+			printf("  %-32s %9.3f  %8.1f\n", order[i].second.c_str(), total.milliseconds / count, (double)total.calls / count);
+		}
+	}
+};
+
+// records its lifetime as an event of the current frame
+class ProfileScope
+{
+	const char* name;
+	double start;
+
+public:
+	ProfileScope(const char* name) : name(0)
+	{
+		Profiler& profiler = Profiler::Get();
+		if (!profiler.enabled) return;
+		this->name = name;
+		start = profiler.Now();
+	}
+
+	~ProfileScope()
+	{
+		if (!name) return;
+		Profiler& profiler = Profiler::Get();
+		profiler.AddEvent(name, start, profiler.Now() - start);
+	}
+};
+
+#if defined(MESHLOADER_NO_PROFILER)
+#define PROFILE_SCOPE(name)
+#else
+#define PROFILE_SCOPE_JOIN(a, b) a##b
+#define PROFILE_SCOPE_NAME(line) PROFILE_SCOPE_JOIN(profileScope, line)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_SCOPE_NAME(__LINE__)(name)
+#endif
+
+#endif
@@ -0,0 +1,257 @@
+#ifndef RAYTRACER_H
+#define RAYTRACER_H
+
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include "VectorMath.h"
+#include "Simd4.h"
+#include "Bvh.h"
+#include "ParallelFor.h"
+
+// RGBA texels sampled like GL_LINEAR with GL_REPEAT and no mipmaps, the first row at t = 0
+struct TraceTexture
+{
+	int width, height;
+	std::vector<unsigned char> texels;
+
+	vec3 Texel(int x, int y) const
+	{
+		x %= width;
+		y %= height;
+		if (x < 0) x += width;
+		if (y < 0) y += height;
+		const unsigned char* p = &texels[(y * width + x) * 4];
+		return vec3(p[0], p[1], p[2]);
+	}
+
+	vec3 Sample(float s, float t) const
+	{
+		float x = s * width - 0.5f, y = t * height - 0.5f;
+		float fx = floorf(x), fy = floorf(y), ax = x - fx, ay = y - fy;
+		int x0 = (int)fx, y0 = (int)fy;
+		vec3 low = Texel(x0, y0) * (1.0f - ax) + Texel(x0 + 1, y0) * ax;
+		vec3 high = Texel(x0, y0 + 1) * (1.0f - ax) + Texel(x0 + 1, y0 + 1) * ax;
+		return (low * (1.0f - ay) + high * ay) * (1.0f / 255.0f);
+	}
+};
+
+// the material uniforms of MeshShader
+struct TraceMaterial
+{
+	vec3 ka, kd, ks;
+	float shininess;
+	int texture;		// into RayTracer::textures, -1 for white
+};
+
+// a mesh's triangles with the attributes the rasterizer interpolates over them
+struct TraceMesh
+{
+	const TriangleBvh* bvh;
+	std::vector<float> vertices;	// three per triangle of the BVH, in the IndexedMesh layout (position, texture coordinate, normal)
+	std::vector<int> materials;		// per triangle, into RayTracer::materials
+};
+
+// CPU reference for the forward path: one ray per pixel center through the same camera,
+// MeshShader's Blinn-Phong lighting with the texture lookup, the textured ground plane of
+// InfiniteQuadShader and the ground shadows ShadowShader projects from a point. Tiles of the
+// image are handed to the threads one at a time; within a tile, 2x2 pixels go through the
+// BVH together as one packet, and so do their shadow rays.
+class RayTracer
+{
+	InstanceBvh world;
+	std::vector<int> instanceMeshes;
+	std::vector<mat4> instanceInverses;
+
+	static vec3 Modulate(const vec3& a, const vec3& b) { return vec3(a.x * b.x, a.y * b.y, a.z * b.z); }
+
+	vec3 Shade(const TraceMaterial& material, vec3 texel, vec3 N, vec3 p)
+	{
+		vec3 V = (viewer - p).normalize();
+		vec3 L = (vec3(lightPosition.x, lightPosition.y, lightPosition.z) - p * lightPosition.w).normalize();
+		vec3 H = (V + L).normalize();
+		vec3 diffuse = Modulate(Modulate(Le, material.kd), texel) * std::max(0.0f, dot(L, N));
+		vec3 specular = Modulate(Le, material.ks) * powf(std::max(0.0f, dot(H, N)), material.shininess);
+		return Modulate(La, material.ka) + diffuse + specular;
+	}
+
+	vec3 Sample(const TraceMaterial& material, float s, float t) const
+	{
+		return material.texture >= 0 ? textures[material.texture].Sample(s, t) : vec3(1.0f, 1.0f, 1.0f);
+	}
+
+	// the interpolated attributes of the triangle hit in lane i, lit
+	vec3 ShadeHit(const PacketHit& hit, int i, vec3 p)
+	{
+		const TraceMesh& mesh = meshes[instanceMeshes[hit.instance[i]]];
+		const float* a = &mesh.vertices[hit.triangle[i] * 24];
+		float w[3] = { 1.0f - hit.u[i] - hit.v[i], hit.u[i], hit.v[i] };
+		float s = 0.0f, t = 0.0f;
+		vec3 n;
+		for (int k = 0; k < 3; k++)
+		{
+			const float* c = a + k * 8;
+			s += c[3] * w[k];
+			t += c[4] * w[k];
+			n = n + vec3(c[5], c[6], c[7]) * w[k];
+		}
+		// object to world for normals, as MeshShader's InvM * n
+		const float (*m)[4] = instanceInverses[hit.instance[i]].m;
+		vec3 N = vec3(m[0][0] * n.x + m[0][1] * n.y + m[0][2] * n.z, m[1][0] * n.x + m[1][1] * n.y + m[1][2] * n.z,
+			m[2][0] * n.x + m[2][1] * n.y + m[2][2] * n.z).normalize();
+		const TraceMaterial& material = materials[mesh.materials[hit.triangle[i]]];
+		return Shade(material, Sample(material, s, t), N, p);
+	}
+
+	static unsigned char Byte(float c) { return (unsigned char)(std::min(std::max(c, 0.0f), 1.0f) * 255.0f + 0.5f); }
+
+	// pixels [x0, x1) x [y0, y1), two by two; returns the rays cast
+	long long RenderTile(int width, int height, int x0, int y0, int x1, int y1, unsigned char* rgb)
+	{
+		long long rays = 0;
+		for (int y = y0; y < y1; y += 2)
+			for (int x = x0; x < x1; x += 2)
+			{
+				// lanes: (x, y), (x + 1, y), (x, y + 1), (x + 1, y + 1), rows from the bottom
+				int active = 0;
+				float d[3][4];
+				for (int i = 0; i < 4; i++)
+				{
+					int px = x + (i & 1), py = y + (i >> 1);
+					if (px < x1 && py < y1) active |= 1 << i;
+					vec3 direction = forward + right * (2.0f * (px + 0.5f) / width - 1.0f) + up * (2.0f * (py + 0.5f) / height - 1.0f);
+					d[0][i] = direction.x;
+					d[1][i] = direction.y;
+					d[2][i] = direction.z;
+				}
+				// from the near plane, so that t + nearPlane is the view depth
+				float4 direction[3] = { float4::Load(d[0]), float4::Load(d[1]), float4::Load(d[2]) };
+				float4 origin[3] = { float4(eye.x) + direction[0] * float4(nearPlane), float4(eye.y) + direction[1] * float4(nearPlane),
+					float4(eye.z) + direction[2] * float4(nearPlane) };
+				PacketHit hit(farPlane - nearPlane);
+				int found = world.IntersectPacket(origin, direction, hit, active, false);
+				rays += (active & 1) + (active >> 1 & 1) + (active >> 2 & 1) + (active >> 3 & 1);
+
+				float t[4];
+				hit.t.Store(t);
+				int ground = 0;
+				vec3 points[4];
+				for (int i = 0; i < 4; i++)
+				{
+					if (!(active & (1 << i))) continue;
+					vec3 o = eye + vec3(d[0][i], d[1][i], d[2][i]) * nearPlane;
+					if (groundMaterial >= 0 && d[1][i] < 0.0f)
+					{
+						float tGround = (groundHeight - o.y) / d[1][i];
+						if (tGround > 0.0f && tGround < t[i])
+						{
+							t[i] = tGround;
+							ground |= 1 << i;
+						}
+					}
+					points[i] = o + vec3(d[0][i], d[1][i], d[2][i]) * t[i];
+				}
+
+				// the ground points that see the shadow light only past an object are in shadow
+				int shadowed = 0;
+				if (ground)
+				{
+					float s[3][4];
+					for (int i = 0; i < 4; i++)
+					{
+						vec3 p = ground & (1 << i) ? points[i] : shadowLight - vec3(0.0f, 1.0f, 0.0f);
+						vec3 toLight = shadowLight - p;
+						s[0][i] = p.x; s[1][i] = p.y; s[2][i] = p.z;
+						d[0][i] = toLight.x; d[1][i] = toLight.y; d[2][i] = toLight.z;
+					}
+					float4 shadowOrigin[3] = { float4::Load(s[0]), float4::Load(s[1]), float4::Load(s[2]) };
+					float4 shadowDirection[3] = { float4::Load(d[0]), float4::Load(d[1]), float4::Load(d[2]) };
+					PacketHit blocker(1.0f);
+					shadowed = world.IntersectPacket(shadowOrigin, shadowDirection, blocker, ground, true);
+					rays += (ground & 1) + (ground >> 1 & 1) + (ground >> 2 & 1) + (ground >> 3 & 1);
+				}
+
+				for (int i = 0; i < 4; i++)
+				{
+					if (!(active & (1 << i))) continue;
+					vec3 color = background;
+					if (shadowed & (1 << i)) color = shadowColor;
+					else if (ground & (1 << i))
+					{
+						const TraceMaterial& material = materials[groundMaterial];
+						vec3 p = points[i];
+						color = Shade(material, Sample(material, p.x - floorf(p.x), p.z - floorf(p.z)), vec3(0.0f, 1.0f, 0.0f), p);
+					}
+					else if (found & (1 << i)) color = ShadeHit(hit, i, points[i]);
+					unsigned char* pixel = &rgb[((y + (i >> 1)) * width + x + (i & 1)) * 3];
+					pixel[0] = Byte(color.x);
+					pixel[1] = Byte(color.y);
+					pixel[2] = Byte(color.z);
+				}
+			}
+		return rays;
+	}
+
+public:
+	std::vector<TraceTexture> textures;
+	std::vector<TraceMaterial> materials;
+	std::vector<TraceMesh> meshes;
+
+	// the camera: a pixel's ray is forward + right * x + up * y for its center at x, y in
+	// [-1, 1], so that t along it is the view depth; hits are clipped to [nearPlane, farPlane]
+	vec3 eye, forward, right, up;
+	float nearPlane, farPlane;
+	vec3 viewer;			// the eye position of the lighting, normally eye
+
+	vec3 La, Le;
+	vec4 lightPosition;		// w = 0 for a directional light
+
+	float groundHeight;
+	int groundMaterial;		// -1 for no ground
+	vec3 shadowLight, shadowColor;
+	vec3 background;
+
+	RayTracer() : nearPlane(0.01f), farPlane(10.0f), groundHeight(0.0f), groundMaterial(-1), shadowColor(0.0f, 0.1f, 0.0f) {}
+
+	int GetInstanceCount() const { return (int)instanceMeshes.size(); }
+
+	void ClearInstances()
+	{
+		world = InstanceBvh();
+		instanceMeshes.clear();
+		instanceInverses.clear();
+	}
+
+	// a placed copy of meshes[mesh]; Build makes the instances visible to Render
+	int AddInstance(int mesh, const mat4& M, const mat4& InvM)
+	{
+		instanceMeshes.push_back(mesh);
+		instanceInverses.push_back(InvM);
+		return world.Add(meshes[mesh].bvh, M, InvM);
+	}
+
+	void Build() { world.Build(); }
+
+	// width x height RGB pixels, rows from the bottom like glReadPixels, in tiles of tileSize
+	// pixels square; returns the rays cast
+	long long Render(int width, int height, unsigned char* rgb, ThreadPool* pool = 0, int tileSize = 16)
+	{
+		if (!pool) pool = &ThreadPool::Global();
+		tileSize = std::max(2, tileSize & ~1);
+		int columns = (width + tileSize - 1) / tileSize, rows = (height + tileSize - 1) / tileSize;
+		std::vector<long long> rays(columns * rows, 0);
+		pool->ParallelFor(columns * rows, [&](int begin, int end)
+		{
+			for (int tile = begin; tile < end; tile++)
+			{
+				int x = tile % columns * tileSize, y = tile / columns * tileSize;
+				rays[tile] = RenderTile(width, height, x, y, std::min(x + tileSize, width), std::min(y + tileSize, height), rgb);
+			}
+		}, 1);
+		long long total = 0;
+		for (int i = 0; i < rays.size(); i++) total += rays[i];
+		return total;
+	}
+};
+
+#endif
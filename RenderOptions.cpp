@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "RenderOptions.h"
+
+RenderOptions options;
+
+void ParseOptions(int argc, char * argv[])
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-forwardplus") options.forwardPlus = true;
+		else if (arg == "-deferred") options.deferred = true;
+		else if (arg == "-passstats") options.passStats = true;
+		else if (arg == "-prepass") options.depthPrepass = true;
+		else if (arg == "-sort") options.sortOpaque = true;
+		else if (arg == "-occlusion") options.occlusionCulling = true;
+		else if (arg == "-softocclusion") options.softwareOcclusion = true;
+		else if (arg == "-gpudriven") options.gpuDriven = true;
+		else if (arg == "-nocompute") options.gpuCompute = false;
+		else if (arg == "-nolod") options.gpuLod = false;
+		else if (arg == "-texturearrays") options.textureArrays = true;
+		else if (arg == "-imposters" && i + 1 < argc) options.imposters = atof(argv[++i]);
+		else if (arg == "-meshlets") options.meshlets = true;
+		else if (arg == "-collisions") options.collisions = true;
+		else if (arg == "-texturebudget" && i + 1 < argc) options.textureBudget = atoi(argv[++i]) * 1024;
+		else if (arg == "-bulktextures" && i + 1 < argc) options.bulkTextures = atoi(argv[++i]);
+		else if (arg == "-trees" && i + 1 < argc) options.trees = atoi(argv[++i]);
+		else if (arg == "-objects" && i + 1 < argc) options.objects = atoi(argv[++i]);
+		else if (arg == "-triangles" && i + 1 < argc) options.triangles = atoi(argv[++i]);
+		else if (arg == "-seed" && i + 1 < argc) options.seed = atoi(argv[++i]);
+		else if (arg == "-path" && i + 1 < argc) options.inputPath = argv[++i];
+		else if (arg == "-record" && i + 1 < argc) options.recordFile = argv[++i];
+		else if (arg == "-json" && i + 1 < argc) options.jsonFile = argv[++i];
+		else if (arg == "-raytrace" && i + 1 < argc) options.rayTraceFile = argv[++i];
+		else if (arg == "-terrain" && i + 1 < argc) options.terrainFile = argv[++i];
+		else if (arg == "-lights" && i + 1 < argc) options.pointLights = atoi(argv[++i]);
+		else if (arg == "-frames" && i + 1 < argc) options.frames = atoi(argv[++i]);
+		else if (arg == "-dt" && i + 1 < argc) options.fixedDt = atof(argv[++i]);
+		else if (arg == "-shadercache" && i + 1 < argc) options.shaderCache = argv[++i];
+		else if (arg == "-noshadercache") options.shaderCache = "";
+		else if (arg == "-profile" && i + 1 < argc) options.profileFile = argv[++i];
+		else if (arg == "-glbudget" && i + 1 < argc && strchr(argv[i + 1], '='))
+		{
+			std::string budget = argv[++i];
+			size_t equals = budget.find('=');
+			options.glBudgets.push_back(std::make_pair(budget.substr(0, equals), (unsigned int)atoi(budget.c_str() + equals + 1)));
+		}
+		else if (arg == "-size" && i + 2 < argc)
+		{
+			options.width = atoi(argv[++i]);
+			options.height = atoi(argv[++i]);
+		}
+		else printf("unknown option %s\n", argv[i]);
+	}
+}
+
@@ -0,0 +1,53 @@
+#ifndef RENDEROPTIONS_H
+#define RENDEROPTIONS_H
+
+#include <string>
+#include <vector>
+#include <utility>
+
+const unsigned int windowWidth = 512, windowHeight = 512;
+
+// startup switches, see ParseOptions
+struct RenderOptions
+{
+	bool forwardPlus;	// clustered point lights through ForwardPlusShader
+	bool deferred;		// G-buffer + full-screen lighting instead of forward shading
+	bool passStats;		// per pass timings and fragment counts in Scene::stats (stalls the pipeline)
+	bool depthPrepass;	// depth-only pass, then shading with GL_EQUAL
+	bool sortOpaque;	// draw opaque objects front to back
+	bool occlusionCulling;	// skip objects whose bounding box was hidden last frame
+	bool softwareOcclusion;	// skip objects hidden behind the nearest objects, tested on the CPU
+	bool gpuDriven;		// PolygonalMesh objects through GpuScene (occlusion and sorting do not apply to them)
+	bool gpuCompute;	// GpuScene culls with a compute shader where GL 4.3 is available
+	bool gpuLod;		// GpuScene picks coarser index lists for distant objects
+	bool textureArrays;	// GpuScene batches materials whose textures have the same size through texture arrays
+	float imposters;	// GpuScene objects this far from the eye fade into billboards, 0 for none
+	bool meshlets;		// draw only the meshlets in the frustum and facing the camera (closed meshes only)
+	bool collisions;	// the avatar rests on the meshes under it and stops at the ones in its way
+	int textureBudget;	// bytes per frame streamed into textures through pixel buffers, 0 to upload while loading
+	int bulkTextures;	// 1024x1024 textures created on frame 10, to measure what loading costs a frame
+	int trees;			// extra trees planted behind the scene
+	int objects;		// synthetic spheres scattered around the avatar
+	int triangles;		// triangles per synthetic sphere
+	int pointLights;
+	int frames;			// headless: number of frames to render, unless inputPath sets it
+	int seed;			// srand seed, for the lights, trees and spheres
+	std::string inputPath;	// headless: held keys replayed frame by frame, a file or an InputScript builtin
+	std::string recordFile;	// viewer: held keys written here at exit, to replay with inputPath
+	std::string jsonFile;	// headless: frame times and counters as JSON
+	std::string terrainFile;	// heightmap terrain cooked in this file (from RollingHills where missing) instead of the ground plane
+	std::string rayTraceFile;	// headless: the last frame ray traced on the CPU as well, written here (PPM) and compared with the GL frame
+	float fixedDt;		// headless: simulation step per frame
+	int width, height;
+	std::string shaderCache;	// program binary directory, empty to always compile
+	std::string profileFile;	// Chrome trace of the last frames written here at exit, empty for no profiling
+	std::vector<std::pair<std::string, unsigned int> > glBudgets;	// headless with MESHLOADER_GL_TRACE: per frame limits, see GLTrace::CheckBudgets
+
+	RenderOptions() : forwardPlus(false), deferred(false), passStats(false), depthPrepass(false), sortOpaque(false), occlusionCulling(false), softwareOcclusion(false), gpuDriven(false), gpuCompute(true), gpuLod(true), textureArrays(false), imposters(0.0f), meshlets(false), collisions(false), textureBudget(0), bulkTextures(0), trees(0), objects(0), triangles(2000), pointLights(256), frames(300), seed(1), fixedDt(1.0 / 60.0), width(windowWidth), height(windowHeight), shaderCache("shadercache") {}
+};
+
+extern RenderOptions options;
+
+void ParseOptions(int argc, char * argv[]);
+
+#endif
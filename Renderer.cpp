@@ -0,0 +1,5010 @@
+
+#define _USE_MATH_DEFINES
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "GLPlatform.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <fstream>
+#include <algorithm> 
+#include <chrono>
+#include <sys/stat.h>
+#if defined(_WIN32)
+#include <direct.h>
+#endif
+#include "VectorMath.h"
+#include "LightGrid.h"
+#include "SoftwareOcclusion.h"
+#include "IndexedMesh.h"
+#include "GeometryAllocator.h"
+#include "Meshlets.h"
+#include "Bvh.h"
+#include "BroadPhase.h"
+#include "RayTracer.h"
+#include "TransformGraph.h"
+#include "Terrain.h"
+#include "ObjMesh.h"
+#include "ImageLoader.h"
+#include "Profiler.h"
+#include "Renderer.h"
+#if defined(MESHLOADER_GL_TRACE)
+#include "GLTrace.h"
+#endif
+
+int majorVersion = 3, minorVersion = 0;
+
+bool keyboardState[256];
+
+void getErrorInfo(unsigned int handle) 
+{
+	int logLen;
+	glGetShaderiv(handle, GL_INFO_LOG_LENGTH, &logLen);
+	if (logLen > 0) 
+	{
+		char * log = new char[logLen];
+		int written;
+		glGetShaderInfoLog(handle, logLen, &written, log);
+		printf("Shader log:\n%s", log);
+		delete log;
+	}
+}
+
+void checkShader(unsigned int shader, char * message) 
+{
+	int OK;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &OK);
+	if (!OK) 
+	{
+		printf("%s!\n", message);
+		getErrorInfo(shader);
+	}
+}
+
+void checkLinking(unsigned int program) 
+{
+	int OK;
+	glGetProgramiv(program, GL_LINK_STATUS, &OK);
+	if (!OK) 
+	{
+		printf("Failed to link shader program!\n");
+		getErrorInfo(program);
+	}
+}
+
+bool hasExtension(const char * name)
+{
+	int n = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &n);
+	for (int i = 0; i < n; i++)
+		if (strcmp((const char *)glGetStringi(GL_EXTENSIONS, i), name) == 0) return true;
+	return false;
+}
+
+
+class GeometryBuffer;
+
+// a mesh inside the shared buffers of its vertex format
+struct GeometryRange
+{
+	GeometryBuffer* buffer;		// 0 for an empty range
+	unsigned int firstVertex, vertexCount, firstIndex, indexCount;
+
+	GeometryRange() : buffer(0), firstVertex(0), vertexCount(0), firstIndex(0), indexCount(0) {}
+};
+
+// every mesh of one vertex format lives in a single interleaved vertex buffer and a
+// single index buffer behind one VAO, suballocated by RangeAllocator. Full buffers are
+// doubled with glCopyBufferSubData, which keeps every offset. Draws pass the first index
+// and a base vertex; without GL 3.2 the indices are rebased at upload instead.
+class GeometryBuffer
+{
+	std::vector<int> format;	// components of attribute 0, 1, ...
+	int vertexSize;				// floats per vertex
+	bool baseVertex;
+	unsigned int vao, positionVao, vertexBuffer, indexBuffer;
+	RangeAllocator vertexRanges, indexRanges;
+	int growths;
+
+	static const unsigned int initialVertices = 1 << 12, initialIndices = 1 << 14;
+
+	// a larger buffer with the old contents at the same offsets
+	static void Resize(unsigned int& buffer, unsigned int oldSize, unsigned int newSize)
+	{
+		unsigned int resized;
+		glGenBuffers(1, &resized);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, resized);
+		glBufferData(GL_COPY_WRITE_BUFFER, newSize, NULL, GL_STATIC_DRAW);
+		if (buffer)
+		{
+			glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+			glDeleteBuffers(1, &buffer);
+		}
+		buffer = resized;
+	}
+
+	void SetupVertexArrays()
+	{
+		glBindVertexArray(vao);
+		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+		for (int a = 0, offset = 0; a < format.size(); offset += format[a], a++)
+		{
+			glEnableVertexAttribArray(a);
+			glVertexAttribPointer(a, format[a], GL_FLOAT, GL_FALSE, vertexSize * sizeof(float), (void*)(offset * sizeof(float)));
+		}
+
+		glBindVertexArray(positionVao);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, format[0], GL_FLOAT, GL_FALSE, vertexSize * sizeof(float), NULL);
+		glBindVertexArray(0);
+	}
+
+	// the doubled capacity that fits size more elements, 0 if a free range already does
+	static unsigned int GrownCapacity(const RangeAllocator& ranges, unsigned int initial, unsigned int size)
+	{
+		if (ranges.GetStats().largestFree >= size) return 0;
+		unsigned int capacity = std::max(ranges.GetCapacity(), initial);
+		while (capacity < ranges.GetCapacity() + size) capacity *= 2;
+		return capacity;
+	}
+
+public:
+	GeometryBuffer(const std::vector<int>& format, bool baseVertex) : format(format), baseVertex(baseVertex)
+	{
+		vertexSize = 0;
+		for (int a = 0; a < format.size(); a++) vertexSize += format[a];
+		vertexBuffer = indexBuffer = 0;
+		growths = 0;
+		glGenVertexArrays(1, &vao);
+		glGenVertexArrays(1, &positionVao);
+	}
+
+	~GeometryBuffer()
+	{
+		glDeleteVertexArrays(1, &vao);
+		glDeleteVertexArrays(1, &positionVao);
+		if (vertexBuffer) glDeleteBuffers(1, &vertexBuffer);
+		if (indexBuffer) glDeleteBuffers(1, &indexBuffer);
+	}
+
+	const std::vector<int>& GetFormat() { return format; }
+
+	GeometryRange Allocate(const float* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount)
+	{
+		PROFILE_SCOPE("geometry upload");
+		GeometryRange range;
+		if (vertexCount == 0 || indexCount == 0) return range;
+
+		unsigned int vertexCapacity = GrownCapacity(vertexRanges, initialVertices, vertexCount);
+		unsigned int indexCapacity = GrownCapacity(indexRanges, initialIndices, indexCount);
+		if (vertexCapacity)
+		{
+			Resize(vertexBuffer, vertexRanges.GetCapacity() * vertexSize * sizeof(float), vertexCapacity * vertexSize * sizeof(float));
+			vertexRanges.Grow(vertexCapacity);
+		}
+		if (indexCapacity)
+		{
+			Resize(indexBuffer, indexRanges.GetCapacity() * sizeof(unsigned int), indexCapacity * sizeof(unsigned int));
+			indexRanges.Grow(indexCapacity);
+		}
+		if (vertexCapacity || indexCapacity)
+		{
+			SetupVertexArrays();
+			growths++;
+		}
+
+		range.buffer = this;
+		range.vertexCount = vertexCount;
+		range.indexCount = indexCount;
+		range.firstVertex = vertexRanges.Allocate(vertexCount);
+		range.firstIndex = indexRanges.Allocate(indexCount);
+
+		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+		glBufferSubData(GL_ARRAY_BUFFER, range.firstVertex * vertexSize * sizeof(float), vertexCount * vertexSize * sizeof(float), vertices);
+		std::vector<unsigned int> rebased;
+		if (!baseVertex)
+		{
+			rebased.assign(indices, indices + indexCount);
+			for (unsigned int i = 0; i < indexCount; i++) rebased[i] += range.firstVertex;
+			indices = &rebased[0];
+		}
+		glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, range.firstIndex * sizeof(unsigned int), indexCount * sizeof(unsigned int), indices);
+		return range;
+	}
+
+	void Free(GeometryRange& range)
+	{
+		vertexRanges.Free(range.firstVertex, range.vertexCount);
+		indexRanges.Free(range.firstIndex, range.indexCount);
+		range = GeometryRange();
+	}
+
+	void Draw(const GeometryRange& range, bool positionsOnly = false)
+	{
+		Bind(positionsOnly);
+		DrawPart(range, 0, range.indexCount);
+	}
+
+	void Bind(bool positionsOnly = false)
+	{
+		glBindVertexArray(positionsOnly ? positionVao : vao);
+	}
+
+	// indexCount indices of range from its firstIndex on, with the buffer already bound
+	void DrawPart(const GeometryRange& range, unsigned int firstIndex, unsigned int indexCount)
+	{
+		void* first = (void*)((range.firstIndex + firstIndex) * sizeof(unsigned int));
+		if (baseVertex) glDrawElementsBaseVertex(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, first, range.firstVertex);
+		else glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, first);
+	}
+
+	// indices from another element buffer, relative to the first vertex of range like its own
+	void DrawIndices(const GeometryRange& range, unsigned int indexBuffer, unsigned int firstIndex, unsigned int indexCount, bool positionsOnly)
+	{
+		glBindVertexArray(positionsOnly ? positionVao : vao);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+		void* first = (void*)(firstIndex * sizeof(unsigned int));
+		if (baseVertex) glDrawElementsBaseVertex(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, first, range.firstVertex);
+		else glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, first);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->indexBuffer);
+	}
+
+	bool UsesBaseVertex() { return baseVertex; }
+
+	void PrintStats()
+	{
+		RangeAllocator::Stats vertexStats = vertexRanges.GetStats(), indexStats = indexRanges.GetStats();
+		std::string layout;
+		for (int a = 0; a < format.size(); a++) layout += (a ? "/" : "") + std::to_string(format[a]);
+		printf("geometry %s: %d meshes, vertices %u of %u (%u free ranges, %.1f%% fragmented), indices %u of %u (%u free ranges, %.1f%% fragmented), %d resizes\n",
+			layout.c_str(), vertexStats.allocations, vertexStats.used, vertexStats.capacity, vertexStats.freeRanges,
+			vertexStats.GetFragmentation() * 100.0f, indexStats.used, indexStats.capacity, indexStats.freeRanges,
+			indexStats.GetFragmentation() * 100.0f, growths);
+	}
+};
+
+// the GeometryBuffer of each vertex format, created on first use
+class GeometryPool
+{
+	std::vector<GeometryBuffer*> buffers;
+
+public:
+	~GeometryPool()
+	{
+		for (int i = 0; i < buffers.size(); i++) delete buffers[i];
+	}
+
+	GeometryRange Allocate(const std::vector<int>& format, const float* vertices, unsigned int vertexCount,
+		const unsigned int* indices, unsigned int indexCount)
+	{
+		GeometryBuffer* buffer = 0;
+		for (int i = 0; i < buffers.size() && !buffer; i++) if (buffers[i]->GetFormat() == format) buffer = buffers[i];
+		if (!buffer)
+		{
+			bool baseVertex = majorVersion * 10 + minorVersion >= 32 || hasExtension("GL_ARB_draw_elements_base_vertex");
+			buffer = new GeometryBuffer(format, baseVertex);
+			buffers.push_back(buffer);
+		}
+		return buffer->Allocate(vertices, vertexCount, indices, indexCount);
+	}
+
+	void PrintStats()
+	{
+		for (int i = 0; i < buffers.size(); i++) buffers[i]->PrintStats();
+	}
+};
+
+GeometryPool geometryPool;
+
+
+class Geometry
+{
+public:
+	virtual ~Geometry() {}
+
+	virtual void Draw() = 0;
+
+	virtual void DrawPositions() { Draw(); }
+
+	// object space bounds; empty for unbounded geometry, which is never culled
+	virtual BoundingBox GetBounds() { return BoundingBox(); }
+
+	// simplified triangles for software occlusion, 0 if the geometry cannot occlude
+	virtual OccluderMesh* GetOccluder() { return 0; }
+
+	// shared vertices and LOD index lists for the merged buffers of GpuScene, 0 if unsupported
+	virtual IndexedMesh* GetIndexedMesh() { return 0; }
+
+	// clusters for per-frame culling, 0 if unsupported
+	virtual MeshletMesh* GetMeshlets() { return 0; }
+
+	// a subset of the triangles, as MeshletMesh::indices, from a separate element buffer
+	virtual void DrawIndices(unsigned int indexBuffer, unsigned int firstIndex, unsigned int indexCount, bool positionsOnly) {}
+
+	// the faces as loaded, 0 for generated geometry
+	virtual ObjMesh* GetObjMesh() { return 0; }
+
+	// triangles for ray casts and proximity queries, 0 if unsupported
+	virtual TriangleBvh* GetBvh() { return 0; }
+
+	// the full detail triangles by material (into GetObjMesh()->GetMaterials()) in draw
+	// order; empty when the geometry is drawn with a single material
+	virtual const std::vector<ObjMesh::Submesh>& GetMaterialRanges()
+	{
+		static const std::vector<ObjMesh::Submesh> none;
+		return none;
+	}
+
+	// one of the material ranges, between BeginRanges and EndRanges
+	virtual void BeginRanges() {}
+	virtual void DrawRange(const ObjMesh::Submesh& range) {}
+	virtual void EndRanges() {}
+};
+
+
+class   PolygonalMesh : public Geometry
+{
+	ObjMesh* obj;
+	BoundingBox bounds;
+	OccluderMesh* occluder;
+	IndexedMesh* indexedMesh;
+	MeshletMesh* meshlets;
+	TriangleBvh* bvh;
+	GeometryRange range;
+	std::vector<ObjMesh::Submesh> materialRanges;
+
+	static const int vertexFormat[3];	// position, texture coordinate, normal
+
+	void Upload();
+
+public:
+	PolygonalMesh(const char *filename);
+	PolygonalMesh(int slices, int stacks);
+	~PolygonalMesh();
+
+	void Draw();
+	void DrawPositions();
+	BoundingBox GetBounds() { return bounds; }
+	OccluderMesh* GetOccluder();
+	IndexedMesh* GetIndexedMesh();
+	MeshletMesh* GetMeshlets();
+	void DrawIndices(unsigned int indexBuffer, unsigned int firstIndex, unsigned int indexCount, bool positionsOnly);
+	ObjMesh* GetObjMesh() { return obj; }
+	TriangleBvh* GetBvh();
+	const std::vector<ObjMesh::Submesh>& GetMaterialRanges() { return materialRanges; }
+	void BeginRanges();
+	void DrawRange(const ObjMesh::Submesh& range);
+	void EndRanges();
+};
+
+class TexturedQuad: public Geometry
+{
+    GeometryRange range;
+
+public:
+    // the ground: a fan around the origin out to the points at infinity (w = 0)
+    TexturedQuad() {
+        static const float vertices[] = {
+            // position             texture     normal
+            0.0, 0.0, 0.0, 1.0,     0.0, 1.0,   0.0, 1.0, 0.0,
+            -1.0, 0.0, 1.0, 0.0,    0.0, 0.0,   0.0, 1.0, 0.0,
+            -1.0, 0.0, -1.0, 0.0,   1.0, 0.0,   0.0, 1.0, 0.0,
+            1.0, 0.0, -1.0, 0.0,    1.0, 1.0,   0.0, 1.0, 0.0,
+            1.0, 0.0, 1.0, 0.0,     0.0, 0.0,   0.0, 1.0, 0.0 };
+        static const unsigned int indices[] = { 0, 1, 2, 0, 2, 3, 0, 3, 4, 0, 4, 1 };
+        static const int format[] = { 4, 2, 3 };
+        range = geometryPool.Allocate(std::vector<int>(format, format + 3), vertices, 5, indices, 12);
+    }
+
+    ~TexturedQuad() {
+        if (range.buffer) range.buffer->Free(range);
+    }
+
+    void Draw() {
+        glEnable(GL_DEPTH_TEST);
+        range.buffer->Draw(range);
+        glDisable(GL_DEPTH_TEST);
+    }
+
+    void DrawPositions() {
+        glEnable(GL_DEPTH_TEST);
+        range.buffer->Draw(range, true);
+        glDisable(GL_DEPTH_TEST);
+    }
+
+};
+
+
+
+// covers the viewport with a single triangle generated from gl_VertexID, no vertex buffers
+class FullScreenTriangle : public Geometry
+{
+    unsigned int vao;
+
+public:
+    FullScreenTriangle() {
+        glGenVertexArrays(1, &vao);
+    }
+
+    void Draw() {
+        glBindVertexArray(vao);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+};
+
+
+const int PolygonalMesh::vertexFormat[3] = { 3, 2, 3 };
+
+PolygonalMesh::PolygonalMesh(const char *filename)
+{
+	PROFILE_SCOPE("load mesh");
+	occluder = 0;
+	indexedMesh = 0;
+	meshlets = 0;
+	bvh = 0;
+	obj = new ObjMesh(filename);
+	Upload();
+}
+
+
+// a unit sphere of slices x stacks quads, each split into two triangles, for synthetic scenes
+PolygonalMesh::PolygonalMesh(int slices, int stacks)
+{
+	PROFILE_SCOPE("build sphere");
+	occluder = 0;
+	indexedMesh = 0;
+	meshlets = 0;
+	bvh = 0;
+	obj = new ObjMesh(slices, stacks);
+	Upload();
+}
+
+
+// puts the welded mesh into the shared buffers, with the full detail triangles grouped
+// by material when the file uses any
+void PolygonalMesh::Upload()
+{
+	IndexedMesh* indexed = GetIndexedMesh();
+	if (!indexed) return;
+	bounds = indexed->bounds;
+	if (!obj->GetMaterials().empty())
+	{
+		std::vector<int> order;
+		obj->SortByMaterial(order, materialRanges);
+		std::vector<unsigned int> sorted(indexed->lods[0].size());
+		for (unsigned int t = 0; t < order.size(); t++)
+			std::copy(&indexed->lods[0][order[t] * 3], &indexed->lods[0][order[t] * 3] + 3, &sorted[t * 3]);
+		indexed->lods[0].swap(sorted);
+	}
+	range = geometryPool.Allocate(std::vector<int>(vertexFormat, vertexFormat + 3), &indexed->vertices[0], indexed->GetVertexCount(),
+		&indexed->lods[0][0], (unsigned int)indexed->lods[0].size());
+}
+
+
+void PolygonalMesh::Draw()
+{
+	if (!range.buffer) return;
+	glEnable(GL_DEPTH_TEST);
+	range.buffer->Draw(range);
+	glDisable(GL_DEPTH_TEST);
+}
+
+
+void PolygonalMesh::DrawPositions()
+{
+	if (!range.buffer) return;
+	glEnable(GL_DEPTH_TEST);
+	range.buffer->Draw(range, true);
+	glDisable(GL_DEPTH_TEST);
+}
+
+
+// built on first use from the faces, which are kept after loading
+OccluderMesh* PolygonalMesh::GetOccluder()
+{
+	if (!occluder) occluder = obj->BuildOccluder();
+	return occluder;
+}
+
+
+// built on first use like the occluder, with the attributes of the vertex buffers
+IndexedMesh* PolygonalMesh::GetIndexedMesh()
+{
+	if (!indexedMesh) indexedMesh = obj->BuildIndexedMesh();
+	return indexedMesh;
+}
+
+
+// clusters of the full detail triangles, with indices relative to the first vertex of the
+// range unless the buffer rebased its own indices
+MeshletMesh* PolygonalMesh::GetMeshlets()
+{
+	if (meshlets || !range.buffer) return meshlets;
+
+	meshlets = MeshletMesh::Build(indexedMesh->vertices, IndexedMesh::vertexSize, 5, indexedMesh->lods[0]);
+	if (!range.buffer->UsesBaseVertex())
+		for (unsigned int i = 0; i < meshlets->indices.size(); i++) meshlets->indices[i] += range.firstVertex;
+	return meshlets;
+}
+
+
+// built on first use from the faces, in the mesh's object space
+TriangleBvh* PolygonalMesh::GetBvh()
+{
+	if (bvh) return bvh;
+	PROFILE_SCOPE("build bvh");
+	std::vector<vec3> corners;
+	obj->GetTrianglePositions(corners);
+	bvh = new TriangleBvh(corners);
+	return bvh;
+}
+
+
+void PolygonalMesh::DrawIndices(unsigned int indexBuffer, unsigned int firstIndex, unsigned int indexCount, bool positionsOnly)
+{
+	if (!range.buffer) return;
+	glEnable(GL_DEPTH_TEST);
+	range.buffer->DrawIndices(range, indexBuffer, firstIndex, indexCount, positionsOnly);
+	glDisable(GL_DEPTH_TEST);
+}
+
+
+void PolygonalMesh::BeginRanges()
+{
+	glEnable(GL_DEPTH_TEST);
+	if (range.buffer) range.buffer->Bind();
+}
+
+
+void PolygonalMesh::DrawRange(const ObjMesh::Submesh& part)
+{
+	if (range.buffer) range.buffer->DrawPart(range, part.firstTriangle * 3, part.triangleCount * 3);
+}
+
+
+void PolygonalMesh::EndRanges()
+{
+	glDisable(GL_DEPTH_TEST);
+}
+
+
+PolygonalMesh::~PolygonalMesh()
+{
+	if(range.buffer) range.buffer->Free(range);
+	if(meshlets) delete meshlets;
+	if(bvh) delete bvh;
+	if(occluder) delete occluder;
+	if(indexedMesh) delete indexedMesh;
+	delete obj;
+}
+
+
+
+// builds GLSL programs from a source plus #define feature lines and hands out one
+// program per permutation. Linked programs are also kept on disk through
+// glGetProgramBinary, named by a hash of the driver strings and the final sources,
+// so that later runs skip compilation; a stale or foreign binary is recompiled.
+class ShaderManager
+{
+	struct Entry
+	{
+		std::string name;
+		const char* origin;		// "compiled", "binary" or "memory"
+		double milliseconds;
+	};
+
+	std::map<unsigned long long, unsigned int> programs;
+	std::vector<Entry> report;
+	std::string cacheDirectory;
+	int binaryFormats;		// -1 until asked
+
+	static unsigned long long Hash(const std::string& s, unsigned long long h = 14695981039346656037ULL)
+	{
+		for (unsigned int i = 0; i < s.size(); i++) h = (h ^ (unsigned char)s[i]) * 1099511628211ULL;
+		return h;
+	}
+
+	// the defines go right after the #version line
+	static std::string WithDefines(const char* source, const std::string& defines)
+	{
+		std::string lines;
+		std::string::size_type begin = 0, end;
+		while (begin < defines.size())
+		{
+			end = defines.find(' ', begin);
+			if (end == std::string::npos) end = defines.size();
+			if (end > begin) lines += "#define " + defines.substr(begin, end - begin) + "\n";
+			begin = end + 1;
+		}
+
+		std::string result = source;
+		std::string::size_type version = result.find("#version");
+		std::string::size_type lineEnd = version == std::string::npos ? std::string::npos : result.find('\n', version);
+		if (lineEnd == std::string::npos) return lines + result;
+		return result.insert(lineEnd + 1, lines);
+	}
+
+	bool CanCacheBinaries()
+	{
+		if (binaryFormats < 0)
+		{
+			binaryFormats = 0;
+#if defined(GL_NUM_PROGRAM_BINARY_FORMATS)
+			if (majorVersion * 10 + minorVersion >= 41 || hasExtension("GL_ARB_get_program_binary"))
+				glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+#endif
+		}
+		return !cacheDirectory.empty() && binaryFormats > 0;
+	}
+
+	unsigned int Compile(const std::vector<unsigned int>& stages, const std::vector<std::string>& sources,
+		const std::vector<std::string>& fragmentOutputs, bool retrievable)
+	{
+		unsigned int program = glCreateProgram();
+		if (!program) { printf("Error in shader program creation\n"); exit(1); }
+
+		std::vector<unsigned int> shaders;
+		for (unsigned int i = 0; i < stages.size(); i++)
+		{
+			unsigned int shader = glCreateShader(stages[i]);
+			if (!shader) { printf("Error in shader creation\n"); exit(1); }
+
+			const char* source = sources[i].c_str();
+			glShaderSource(shader, 1, &source, NULL);
+			glCompileShader(shader);
+			char vertexError[] = "Vertex shader error", fragmentError[] = "Fragment shader error", computeError[] = "Compute shader error";
+			checkShader(shader, stages[i] == GL_VERTEX_SHADER ? vertexError : (stages[i] == GL_FRAGMENT_SHADER ? fragmentError : computeError));
+			glAttachShader(program, shader);
+			shaders.push_back(shader);
+		}
+
+		glBindAttribLocation(program, 0, "vertexPosition");
+		glBindAttribLocation(program, 1, "vertexTexCoord");
+		glBindAttribLocation(program, 2, "vertexNormal");
+		glBindAttribLocation(program, 3, "objectIndex");
+
+		for (unsigned int i = 0; i < fragmentOutputs.size(); i++)
+			glBindFragDataLocation(program, i, fragmentOutputs[i].c_str());
+
+#if defined(GL_PROGRAM_BINARY_RETRIEVABLE_HINT)
+		if (retrievable) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
+		glLinkProgram(program);
+		checkLinking(program);
+
+		for (unsigned int i = 0; i < shaders.size(); i++)
+		{
+			glDetachShader(program, shaders[i]);
+			glDeleteShader(shaders[i]);
+		}
+		return program;
+	}
+
+	// file layout: binary format, then the program binary
+	unsigned int LoadBinary(const std::string& path)
+	{
+#if defined(GL_PROGRAM_BINARY_LENGTH)
+		FILE* file = fopen(path.c_str(), "rb");
+		if (!file) return 0;
+		std::vector<char> data;
+		char buffer[4096];
+		size_t n;
+		while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) data.insert(data.end(), buffer, buffer + n);
+		fclose(file);
+		if (data.size() <= sizeof(unsigned int)) return 0;
+
+		unsigned int format;
+		memcpy(&format, &data[0], sizeof(format));
+		unsigned int program = glCreateProgram();
+		glProgramBinary(program, format, &data[sizeof(format)], (int)(data.size() - sizeof(format)));
+		int linked = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+		if (linked) return program;
+		glDeleteProgram(program);
+#endif
+		return 0;
+	}
+
+	void SaveBinary(const std::string& path, unsigned int program)
+	{
+#if defined(GL_PROGRAM_BINARY_LENGTH)
+		int length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0) return;
+		std::vector<char> data(length);
+		unsigned int format = 0;
+		glGetProgramBinary(program, length, &length, &format, &data[0]);
+
+#if defined(_WIN32)
+		_mkdir(cacheDirectory.c_str());
+#else
+		mkdir(cacheDirectory.c_str(), 0755);
+#endif
+		FILE* file = fopen(path.c_str(), "wb");
+		if (!file) { printf("cannot write %s\n", path.c_str()); return; }
+		fwrite(&format, sizeof(format), 1, file);
+		fwrite(&data[0], 1, length, file);
+		fclose(file);
+#endif
+	}
+
+	// memory, then disk, then compile; stages and sources in pipeline order
+	unsigned int GetProgram(const std::string& name, const std::string& defines, const std::vector<unsigned int>& stages,
+		const std::vector<std::string>& sources, const std::vector<std::string>& fragmentOutputs)
+	{
+		PROFILE_SCOPE("shader program");
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		unsigned long long key = Hash(std::string());
+		for (unsigned int i = 0; i < stages.size(); i++)
+		{
+			char stage[16];
+			sprintf(stage, "%u;", stages[i]);
+			key = Hash(sources[i], Hash(stage, key));
+		}
+		for (unsigned int i = 0; i < fragmentOutputs.size(); i++) key = Hash(fragmentOutputs[i] + ";", key);
+
+		Entry entry;
+		std::string::size_type first = defines.find_first_not_of(' '), last = defines.find_last_not_of(' ');
+		entry.name = first == std::string::npos ? name : name + " [" + defines.substr(first, last - first + 1) + "]";
+		unsigned int program = 0;
+
+		std::map<unsigned long long, unsigned int>::iterator found = programs.find(key);
+		if (found != programs.end())
+		{
+			program = found->second;
+			entry.origin = "memory";
+		}
+		else
+		{
+			std::string path;
+			bool cacheBinaries = CanCacheBinaries();
+			if (cacheBinaries)
+			{
+				std::string driver = std::string((const char*)glGetString(GL_VENDOR)) + (const char*)glGetString(GL_RENDERER)
+					+ (const char*)glGetString(GL_VERSION);
+				char file[32];
+				sprintf(file, "/%016llx.bin", Hash(driver, key));
+				path = cacheDirectory + file;
+				program = LoadBinary(path);
+			}
+			entry.origin = "binary";
+			if (!program)
+			{
+				program = Compile(stages, sources, fragmentOutputs, cacheBinaries);
+				if (cacheBinaries) SaveBinary(path, program);
+				entry.origin = "compiled";
+			}
+			programs[key] = program;
+		}
+
+		entry.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		report.push_back(entry);
+		return program;
+	}
+
+public:
+	ShaderManager() : binaryFormats(-1) {}
+
+	~ShaderManager()
+	{
+		for (std::map<unsigned long long, unsigned int>::iterator p = programs.begin(); p != programs.end(); p++)
+			glDeleteProgram(p->second);
+	}
+
+	// empty (the default) turns the disk cache off
+	void SetCacheDirectory(const std::string& directory) { cacheDirectory = directory; }
+
+	// defines is a space separated list of feature names; fragmentOutputs are bound to
+	// draw buffers 0, 1, ... in order
+	unsigned int GetProgram(const std::string& name, const char* vertexSource, const char* fragmentSource,
+		const std::string& defines, const std::vector<std::string>& fragmentOutputs)
+	{
+		std::vector<unsigned int> stages;
+		std::vector<std::string> sources;
+		stages.push_back(GL_VERTEX_SHADER);
+		sources.push_back(WithDefines(vertexSource, defines));
+		stages.push_back(GL_FRAGMENT_SHADER);
+		sources.push_back(WithDefines(fragmentSource, defines));
+		return GetProgram(name, defines, stages, sources, fragmentOutputs);
+	}
+
+#if defined(GL_COMPUTE_SHADER)
+	unsigned int GetComputeProgram(const std::string& name, const char* computeSource, const std::string& defines = "")
+	{
+		std::vector<unsigned int> stages(1, GL_COMPUTE_SHADER);
+		std::vector<std::string> sources(1, WithDefines(computeSource, defines));
+		return GetProgram(name, defines, stages, sources, std::vector<std::string>());
+	}
+#endif
+
+	void PrintReport()
+	{
+		double total = 0.0;
+		for (unsigned int i = 0; i < report.size(); i++)
+		{
+			printf("shader %-32s %-8s %8.3f ms\n", report[i].name.c_str(), report[i].origin, report[i].milliseconds);
+			total += report[i].milliseconds;
+		}
+		printf("shaders: %d programs, %.3f ms%s\n", (int)programs.size(), total,
+			CanCacheBinaries() ? "" : " (no program binary cache)");
+	}
+};
+
+ShaderManager shaderManager;
+
+
+class Shader
+{
+protected:
+	unsigned int shaderProgram;		// owned by shaderManager, shared between equal permutations
+
+public:
+	Shader()
+	{
+		shaderProgram = 0;
+	}
+
+	void Run()
+	{
+		if(shaderProgram) glUseProgram(shaderProgram);
+	}
+
+protected:
+	// defines is a space separated list of feature names, see ShaderManager::GetProgram
+	void CompileProgram(const char *name, const char *vertexSource, const char *fragmentSource, const std::string& defines = "",
+		const std::vector<std::string>& fragmentOutputs = std::vector<std::string>(1, "fragmentColor"))
+	{
+		shaderProgram = shaderManager.GetProgram(name, vertexSource, fragmentSource, defines, fragmentOutputs);
+	}
+
+	// cluster lookup uniforms shared by every shader that walks a LightGrid,
+	// with the light textures on firstUnit .. firstUnit + 2 (see ClusteredLights::Bind)
+	void UploadLightGridUniforms(LightGrid& grid, int firstUnit)
+	{
+		int location = glGetUniformLocation(shaderProgram, "lightData");
+		if (location >= 0) glUniform1i(location, firstUnit);
+		else printf("uniform lightData cannot be set\n");
+
+		location = glGetUniformLocation(shaderProgram, "clusterTable");
+		if (location >= 0) glUniform1i(location, firstUnit + 1);
+		else printf("uniform clusterTable cannot be set\n");
+
+		location = glGetUniformLocation(shaderProgram, "lightIndexList");
+		if (location >= 0) glUniform1i(location, firstUnit + 2);
+		else printf("uniform lightIndexList cannot be set\n");
+
+		location = glGetUniformLocation(shaderProgram, "gridSize");
+		if (location >= 0) glUniform3i(location, grid.GetTilesX(), grid.GetTilesY(), grid.GetSlices());
+		else printf("uniform gridSize cannot be set\n");
+
+		location = glGetUniformLocation(shaderProgram, "tileSize");
+		if (location >= 0) glUniform1i(location, grid.GetTileSize());
+		else printf("uniform tileSize cannot be set\n");
+
+		location = glGetUniformLocation(shaderProgram, "sliceParams");
+		if (location >= 0) glUniform2f(location, grid.GetSliceScale(), grid.GetSliceBias());
+		else printf("uniform sliceParams cannot be set\n");
+	}
+
+public:
+	// per object matrices of the INSTANCE_DATA variants, see GpuScene::BindObjectData
+	void UploadObjectData(int unit)
+	{
+		int location = glGetUniformLocation(shaderProgram, "objectData");
+		if (location >= 0) glUniform1i(location, unit);
+		else printf("uniform objectData cannot be set\n");
+	}
+
+	// per object material attributes and texture layer of the TEXTURE_ARRAY variants
+	void UploadMaterialData(int unit)
+	{
+		int location = glGetUniformLocation(shaderProgram, "materialData");
+		if (location >= 0) glUniform1i(location, unit);
+		else printf("uniform materialData cannot be set\n");
+	}
+
+	virtual void UploadInvM(mat4& InVM) { }
+
+	virtual void UploadMVP(mat4& MVP) { }
+
+    virtual void UploadVP(mat4& VP) { }
+    
+    virtual void UploadM(mat4& M) { }
+
+	virtual void UploadColor(vec4& color) { }
+
+	virtual void UploadSamplerID() { }
+
+    virtual void UploadMaterialAttributes(vec3& ka, vec3& kd, vec3& ks, float shininess) { }
+
+    virtual void UploadLightAttributes(vec3& La, vec3& Le, vec4& worldLightPosition) {}
+
+    virtual void UploadEyePosition(vec3& wEye) {}
+
+	// the eye in the terrain's space, for the TERRAIN variants
+	virtual void UploadMorphEye(vec3& eye) {}
+
+	// where the IMPOSTER and IMPOSTER_FADE variants hand over from the meshes to their
+	// imposters: between start and end from the eye to the objects' origins
+	virtual void UploadImposterFade(vec3& eye, float start, float end) {}
+
+	// the atlas of the IMPOSTER variants: the mesh's bounding sphere in object space, the
+	// views around it and the unit of the normal atlas
+	virtual void UploadImposterAtlas(vec4& sphere, int azimuths, int elevations, int normalUnit) {}
+
+    virtual void UploadLightGrid(LightGrid& grid, int firstUnit) {}
+};
+
+
+
+// Blinn-Phong surface shader shared by every lit object. Permutations:
+//   GROUND            homogeneous vertices of the infinite plane, texture tiled over world xz
+//   CLUSTERED_LIGHTS  adds the point lights of the fragment's LightGrid cluster; with GROUND at the
+//                     homogeneous world position, clip w being its w times the view depth
+//   GBUFFER           writes the G-buffer of the deferred path instead of a color
+//   INSTANCE_DATA     model matrices from the object data texture instead of uniforms, see GpuScene
+//   TEXTURE_ARRAY     with INSTANCE_DATA: material attributes and texture array layer per object
+//   TERRAIN           with GROUND: TerrainQuadtree vertices, morphed to the coarser level by distance to morphEye
+//   IMPOSTER          with INSTANCE_DATA: a quad facing the eye with the nearest view of an ImposterAtlas, faded in with distance
+//   IMPOSTER_FADE     with INSTANCE_DATA: the meshes, dithered out where their imposters fade in; both discard
+//                     by the same per pixel threshold, so a mesh and its imposter never cover the same pixel
+class MeshShader : public Shader
+{
+	static const char *VertexSource()
+	{
+		return "\n\
+            #version 130 \n\
+            precision highp float; \n\
+            #ifdef GROUND \n\
+            in vec4 vertexPosition; \n\
+            #else \n\
+            in vec3 vertexPosition; \n\
+            #endif \n\
+            #ifdef TERRAIN \n\
+            in vec4 vertexTexCoord; \n\
+            uniform vec3 morphEye; \n\
+            #else \n\
+            in vec2 vertexTexCoord; \n\
+            #endif \n\
+            in vec3 vertexNormal; \n\
+            #ifdef INSTANCE_DATA \n\
+            in uint objectIndex; \n\
+            uniform sampler2D objectData; \n\
+            uniform mat4 VP; \n\
+            mat4 objectMatrix(int column) { \n\
+                ivec2 texel = ivec2(int(objectIndex) % 128 * 8 + column, int(objectIndex) / 128); \n\
+                return mat4(texelFetch(objectData, texel, 0), texelFetch(objectData, texel + ivec2(1, 0), 0), \n\
+                    texelFetch(objectData, texel + ivec2(2, 0), 0), texelFetch(objectData, texel + ivec2(3, 0), 0)); \n\
+            } \n\
+            #else \n\
+            uniform mat4 M, InvM, MVP; \n\
+            #endif \n\
+            #ifdef TEXTURE_ARRAY \n\
+            uniform sampler2D materialData; \n\
+            flat out vec4 materialAmbient, materialDiffuse, materialSpecular; \n\
+            #endif \n\
+            #if defined(IMPOSTER) || defined(IMPOSTER_FADE) \n\
+            uniform vec3 imposterEye; \n\
+            uniform vec2 imposterRange; \n\
+            flat out float fade; \n\
+            #endif \n\
+            #ifdef IMPOSTER \n\
+            uniform vec4 imposterSphere; \n\
+            uniform ivec2 imposterViews; \n\
+            flat out mat3 normalMatrix; \n\
+            #endif \n\
+            invariant gl_Position; \n\
+            uniform vec3 worldEyePosition; \n\
+            uniform vec4 worldLightPosition; \n\
+            out vec2 texCoord; \n\
+            out vec3 worldNormal; \n\
+            #if defined(GROUND) \n\
+            out vec4 worldPosition; \n\
+            #elif !defined(GBUFFER) \n\
+            out vec3 worldView; \n\
+            out vec3 worldLight; \n\
+            #endif \n\
+            #if defined(CLUSTERED_LIGHTS) && !defined(GROUND) \n\
+            out vec3 worldPosition; \n\
+            out float viewDepth; \n\
+            #endif \n\
+            \n\
+            void main() { \n\
+            #ifdef INSTANCE_DATA \n\
+            mat4 M = objectMatrix(0), InvM = objectMatrix(4), MVP = M * VP; \n\
+            #endif \n\
+            #ifdef TEXTURE_ARRAY \n\
+            ivec2 materialTexel = ivec2(int(objectIndex) % 256 * 4, int(objectIndex) / 256); \n\
+            materialAmbient = texelFetch(materialData, materialTexel, 0); \n\
+            materialDiffuse = texelFetch(materialData, materialTexel + ivec2(1, 0), 0); \n\
+            materialSpecular = texelFetch(materialData, materialTexel + ivec2(2, 0), 0); \n\
+            #endif \n\
+            #ifdef GROUND \n\
+            vec4 position = vertexPosition; \n\
+            #else \n\
+            vec4 position = vec4(vertexPosition, 1); \n\
+            #endif \n\
+            #if defined(IMPOSTER) || defined(IMPOSTER_FADE) \n\
+            fade = clamp((distance((vec4(0.0, 0.0, 0.0, 1.0) * M).xyz, imposterEye) - imposterRange.x) / (imposterRange.y - imposterRange.x), 0.0, 1.0); \n\
+            #endif \n\
+            #ifdef TERRAIN \n\
+            position.y = mix(position.y, vertexTexCoord.x, clamp((distance(position.xyz, morphEye) - vertexTexCoord.y) / (vertexTexCoord.z - vertexTexCoord.y), 0.0, 1.0)); \n\
+            texCoord = vec2(0.0); \n\
+            #elif defined(IMPOSTER) \n\
+            vec3 toEye = normalize((vec4(imposterEye, 1.0) * InvM).xyz - imposterSphere.xyz); \n\
+            vec3 right = abs(toEye.y) > 0.999 ? vec3(1.0, 0.0, 0.0) : normalize(cross(vec3(0.0, 1.0, 0.0), toEye)); \n\
+            vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1)) * 2.0 - 1.0; \n\
+            position = vec4(imposterSphere.xyz + (right * corner.x + cross(toEye, right) * corner.y) * imposterSphere.w, 1.0); \n\
+            float azimuth = mod(floor(atan(toEye.z, toEye.x) / 6.2831853 * float(imposterViews.x) + 0.5), float(imposterViews.x)); \n\
+            float elevation = clamp(floor(asin(clamp(toEye.y, -1.0, 1.0)) / 1.5707963 * float(imposterViews.y) + 0.5), 0.0, float(imposterViews.y - 1)); \n\
+            texCoord = (vec2(azimuth, elevation) + corner * 0.5 + 0.5) / vec2(imposterViews); \n\
+            normalMatrix = mat3(InvM); \n\
+            #else \n\
+            texCoord = vertexTexCoord; \n\
+            #endif \n\
+            worldNormal = (InvM * vec4(vertexNormal, 0.0)).xyz; \n\
+            gl_Position = position * MVP; \n\
+            #if defined(GROUND) \n\
+            worldPosition = position * M; \n\
+            #elif !defined(GBUFFER) \n\
+            vec4 wPosition = position * M; \n\
+            worldLight  = worldLightPosition.xyz * wPosition.w - wPosition.xyz * worldLightPosition.w; \n\
+            worldView = worldEyePosition - wPosition.xyz; \n\
+            #ifdef CLUSTERED_LIGHTS \n\
+            worldPosition = wPosition.xyz / wPosition.w; \n\
+            viewDepth = gl_Position.w; \n\
+            #endif \n\
+            #endif \n\
+            } \n\
+            ";
+	}
+
+	static const char *FragmentSource()
+	{
+		return "\n\
+            #version 130 \n\
+            precision highp float; \n\
+            #ifdef TEXTURE_ARRAY \n\
+            uniform sampler2DArray samplerUnit; \n\
+            flat in vec4 materialAmbient, materialDiffuse, materialSpecular; \n\
+            #define ka materialAmbient.rgb \n\
+            #define kd materialDiffuse.rgb \n\
+            #define ks materialSpecular.rgb \n\
+            #define shininess materialDiffuse.a \n\
+            #else \n\
+            uniform sampler2D samplerUnit; \n\
+            uniform vec3 ka, kd, ks; \n\
+            uniform float shininess; \n\
+            #endif \n\
+            uniform vec3 La, Le; \n\
+            in vec2 texCoord; \n\
+            in vec3 worldNormal; \n\
+            #if defined(IMPOSTER) || defined(IMPOSTER_FADE) \n\
+            flat in float fade; \n\
+            #endif \n\
+            #ifdef IMPOSTER \n\
+            uniform sampler2D imposterNormals; \n\
+            flat in mat3 normalMatrix; \n\
+            #endif \n\
+            #if defined(GROUND) \n\
+            uniform vec3 worldEyePosition; \n\
+            uniform vec4 worldLightPosition; \n\
+            in vec4 worldPosition; \n\
+            #elif !defined(GBUFFER) \n\
+            in vec3 worldView; \n\
+            in vec3 worldLight; \n\
+            #endif \n\
+            #ifdef CLUSTERED_LIGHTS \n\
+            uniform sampler2D lightData; \n\
+            uniform usampler2D clusterTable; \n\
+            uniform usampler2D lightIndexList; \n\
+            uniform ivec3 gridSize; \n\
+            uniform int tileSize; \n\
+            uniform vec2 sliceParams; \n\
+            #ifndef GROUND \n\
+            in vec3 worldPosition; \n\
+            in float viewDepth; \n\
+            #endif \n\
+            \n\
+            ivec2 row(int i) { return ivec2(i % 1024, i / 1024); } \n\
+            #endif \n\
+            #ifdef GBUFFER \n\
+            out vec4 accumulation; \n\
+            out vec4 albedo; \n\
+            out vec4 normalShininess; \n\
+            out vec4 specular; \n\
+            #else \n\
+            out vec4 fragmentColor; \n\
+            #endif \n\
+            \n\
+            void main() { \n\
+            #if defined(IMPOSTER) || defined(IMPOSTER_FADE) \n\
+            float dither = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715)))); \n\
+            #ifdef IMPOSTER \n\
+            if (dither >= fade) discard; \n\
+            #else \n\
+            if (dither < fade) discard; \n\
+            #endif \n\
+            #endif \n\
+            #ifdef IMPOSTER \n\
+            vec4 atlasTexel = texture(samplerUnit, texCoord); \n\
+            if (atlasTexel.a < 0.5) discard; \n\
+            vec3 N = normalize(normalMatrix * (texture(imposterNormals, texCoord).xyz * 2.0 - 1.0)); \n\
+            vec3 texel = atlasTexel.rgb; \n\
+            #else \n\
+            vec3 N = normalize(worldNormal); \n\
+            #ifdef GROUND \n\
+            vec2 position = worldPosition.xz / worldPosition.w; \n\
+            vec3 texel = texture(samplerUnit, position - floor(position)).xyz; \n\
+            #elif defined(TEXTURE_ARRAY) \n\
+            vec3 texel = texture(samplerUnit, vec3(texCoord, materialAmbient.a)).xyz; \n\
+            #else \n\
+            vec3 texel = texture(samplerUnit, texCoord).xyz; \n\
+            #endif \n\
+            #endif \n\
+            #ifdef GBUFFER \n\
+            accumulation = vec4(La * ka, 1); \n\
+            albedo = vec4(kd * texel, 1); \n\
+            normalShininess = vec4(N, shininess); \n\
+            specular = vec4(ks, 1); \n\
+            #else \n\
+            #ifdef GROUND \n\
+            vec3 V = normalize(worldEyePosition * worldPosition.w - worldPosition.xyz); \n\
+            vec3 L = normalize(worldLightPosition.xyz * worldPosition.w - worldPosition.xyz * worldLightPosition.w); \n\
+            #else \n\
+            vec3 V = normalize(worldView); \n\
+            vec3 L = normalize(worldLight); \n\
+            #endif \n\
+            vec3 H = normalize(V + L); \n\
+            vec3 color = \n\
+            La * ka + \n\
+            Le * kd * texel * max(0.0, dot(L, N)) + \n\
+            Le * ks * pow(max(0.0, dot(H, N)), shininess); \n\
+            #ifdef CLUSTERED_LIGHTS \n\
+            #ifdef GROUND \n\
+            vec3 surfacePosition = worldPosition.xyz / worldPosition.w; \n\
+            float surfaceDepth = 1.0 / (gl_FragCoord.w * worldPosition.w); \n\
+            #else \n\
+            vec3 surfacePosition = worldPosition; \n\
+            float surfaceDepth = viewDepth; \n\
+            #endif \n\
+            \n\
+            ivec3 cluster = ivec3(ivec2(gl_FragCoord.xy) / tileSize, int(floor(log(surfaceDepth) * sliceParams.x + sliceParams.y))); \n\
+            cluster = clamp(cluster, ivec3(0), gridSize - 1); \n\
+            uvec2 range = texelFetch(clusterTable, ivec2(cluster.y * gridSize.x + cluster.x, cluster.z), 0).xy; \n\
+            for (int i = 0; i < int(range.y); i++) { \n\
+                int light = int(texelFetch(lightIndexList, row(int(range.x) + i), 0).r); \n\
+                vec4 positionRadius = texelFetch(lightData, row(light * 2), 0); \n\
+                vec3 lightColor = texelFetch(lightData, row(light * 2 + 1), 0).rgb; \n\
+                vec3 toLight = positionRadius.xyz - surfacePosition; \n\
+                float dist = length(toLight); \n\
+                float attenuation = clamp(1.0 - dist / positionRadius.w, 0.0, 1.0); \n\
+                vec3 Lp = toLight / max(dist, 0.0001); \n\
+                vec3 Hp = normalize(V + Lp); \n\
+                color += lightColor * attenuation * attenuation * \n\
+                    (kd * texel * max(0.0, dot(Lp, N)) + ks * pow(max(0.0, dot(Hp, N)), shininess)); \n\
+            } \n\
+            #endif \n\
+            fragmentColor = vec4(color, 1); \n\
+            #endif \n\
+            } \n\
+        ";
+	}
+
+public:
+	MeshShader(const std::string& defines = "",
+		const std::vector<std::string>& fragmentOutputs = std::vector<std::string>(1, "fragmentColor"))
+	{
+		CompileProgram("surface", VertexSource(), FragmentSource(), defines, fragmentOutputs);
+	}
+
+	// only the INSTANCE_DATA variants take VP
+	void UploadVP(mat4& VP)
+	{
+		int location = glGetUniformLocation(shaderProgram, "VP");
+		if (location >= 0) glUniformMatrix4fv(location, 1, GL_TRUE, VP); 
+	}
+
+	void UploadSamplerID()
+	{
+		int samplerUnit = 0; 
+		int location = glGetUniformLocation(shaderProgram, "samplerUnit");
+		glUniform1i(location, samplerUnit);
+		glActiveTexture(GL_TEXTURE0 + samplerUnit); 
+	}
+
+	void UploadInvM(mat4& InvM)
+	{
+		int location = glGetUniformLocation(shaderProgram, "InvM");
+		if (location >= 0) glUniformMatrix4fv(location, 1, GL_TRUE, InvM); 
+		else printf("uniform InvM cannot be set\n");
+	}
+
+	void UploadMVP(mat4& MVP)
+	{
+		int location = glGetUniformLocation(shaderProgram, "MVP");
+		if (location >= 0) glUniformMatrix4fv(location, 1, GL_TRUE, MVP); 
+		else printf("uniform MVP cannot be set\n");
+	}
+
+	void UploadM(mat4& M)
+	{
+		int location = glGetUniformLocation(shaderProgram, "M");
+		if (location >= 0) glUniformMatrix4fv(location, 1, GL_TRUE, M); 
+		else printf("uniform M cannot be set\n");
+	}
+
+    void UploadMaterialAttributes(vec3& ka, vec3& kd, vec3& ks, float shininess) {
+
+        int location = glGetUniformLocation(shaderProgram, "ka");
+		if (location >= 0) glUniform3f(location, ka.x, ka.y, ka.z); 
+		else printf("uniform ka cannot be set\n");
+
+        location = glGetUniformLocation(shaderProgram, "kd");
+		if (location >= 0) glUniform3f(location, kd.x, kd.y, kd.z);
+		else printf("uniform kd cannot be set\n");
+
+        location = glGetUniformLocation(shaderProgram, "ks");
+		if (location >= 0) glUniform3f(location, ks.x, ks.y, ks.z); 
+		else printf("uniform ks cannot be set\n");
+
+        location = glGetUniformLocation(shaderProgram, "shininess");
+		if (location >= 0) glUniform1f(location, shininess);
+		else printf("uniform shininess cannot be set\n");
+
+    }
+
+    void UploadLightAttributes(vec3& La, vec3& Le, vec4& worldLightPosition) {
+
+        int location = glGetUniformLocation(shaderProgram, "La");
+		if (location >= 0) glUniform3f(location, La.x, La.y, La.z);
+		else printf("uniform La cannot be set\n");
+
+        location = glGetUniformLocation(shaderProgram, "Le");
+		if (location >= 0) glUniform3f(location, Le.x, Le.y, Le.z);
+		else printf("uniform Le cannot be set\n");
+
+        location = glGetUniformLocation(shaderProgram, "worldLightPosition");
+		if (location >= 0) glUniform4f(location, worldLightPosition.x, 
+                worldLightPosition.y, worldLightPosition.z, worldLightPosition.w);
+		else printf("uniform worldLightPosition cannot be set\n");
+    }
+
+    void UploadEyePosition(vec3& wEye) {
+
+        int location = glGetUniformLocation(shaderProgram, "worldEyePosition");
+		if (location >= 0) glUniform3f(location, wEye.x, wEye.y, wEye.z);
+		else printf("uniform wEye cannot be set\n");
+    }
+
+	void UploadMorphEye(vec3& eye)
+	{
+		int location = glGetUniformLocation(shaderProgram, "morphEye");
+		if (location >= 0) glUniform3f(location, eye.x, eye.y, eye.z);
+		else printf("uniform morphEye cannot be set\n");
+	}
+
+	void UploadImposterFade(vec3& eye, float start, float end)
+	{
+		int location = glGetUniformLocation(shaderProgram, "imposterEye");
+		if (location >= 0) glUniform3f(location, eye.x, eye.y, eye.z);
+		else printf("uniform imposterEye cannot be set\n");
+
+		location = glGetUniformLocation(shaderProgram, "imposterRange");
+		if (location >= 0) glUniform2f(location, start, end);
+		else printf("uniform imposterRange cannot be set\n");
+	}
+
+	void UploadImposterAtlas(vec4& sphere, int azimuths, int elevations, int normalUnit)
+	{
+		int location = glGetUniformLocation(shaderProgram, "imposterSphere");
+		if (location >= 0) glUniform4f(location, sphere.x, sphere.y, sphere.z, sphere.w);
+		else printf("uniform imposterSphere cannot be set\n");
+
+		location = glGetUniformLocation(shaderProgram, "imposterViews");
+		if (location >= 0) glUniform2i(location, azimuths, elevations);
+		else printf("uniform imposterViews cannot be set\n");
+
+		location = glGetUniformLocation(shaderProgram, "imposterNormals");
+		if (location >= 0) glUniform1i(location, normalUnit);
+		else printf("uniform imposterNormals cannot be set\n");
+	}
+};
+
+// point light lists of a LightGrid as integer/float textures, readable with texelFetch from GLSL 1.30
+class ClusteredLights
+{
+	unsigned int lightTexture, clusterTexture, indexTexture;
+	std::vector<float> lightData;
+	std::vector<unsigned int> indexData;
+
+public:
+	static const int rowLength = 1024;
+
+	ClusteredLights()
+	{
+		unsigned int textures[3];
+		glGenTextures(3, &textures[0]);
+		lightTexture = textures[0]; clusterTexture = textures[1]; indexTexture = textures[2];
+
+		for (int i = 0; i < 3; i++)
+		{
+			glBindTexture(GL_TEXTURE_2D, textures[i]);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		}
+	}
+
+	~ClusteredLights()
+	{
+		unsigned int textures[3] = { lightTexture, clusterTexture, indexTexture };
+		glDeleteTextures(3, &textures[0]);
+	}
+
+	void Upload(LightGrid& grid, std::vector<PointLight>& lights)
+	{
+		// two texels per light: position + radius, color
+		int rows = std::max(1, ((int)lights.size() * 2 + rowLength - 1) / rowLength);
+		lightData.assign(rows * rowLength * 4, 0.0f);
+		for (unsigned int i = 0; i < lights.size(); i++)
+		{
+			float* d = &lightData[i * 8];
+			d[0] = lights[i].position.x; d[1] = lights[i].position.y; d[2] = lights[i].position.z; d[3] = lights[i].radius;
+			d[4] = lights[i].color.x; d[5] = lights[i].color.y; d[6] = lights[i].color.z; d[7] = 1.0;
+		}
+		glBindTexture(GL_TEXTURE_2D, lightTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, rowLength, rows, 0, GL_RGBA, GL_FLOAT, &lightData[0]);
+
+		glBindTexture(GL_TEXTURE_2D, clusterTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32UI, grid.GetTilesX() * grid.GetTilesY(), grid.GetSlices(), 0,
+			GL_RG_INTEGER, GL_UNSIGNED_INT, &grid.clusterTable[0]);
+
+		rows = std::max(1, ((int)grid.lightIndices.size() + rowLength - 1) / rowLength);
+		indexData.resize(rows * rowLength);
+		std::copy(grid.lightIndices.begin(), grid.lightIndices.end(), indexData.begin());
+		glBindTexture(GL_TEXTURE_2D, indexTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, rowLength, rows, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &indexData[0]);
+	}
+
+	// binds the light, cluster and index textures to firstUnit .. firstUnit + 2
+	void Bind(int firstUnit)
+	{
+		glActiveTexture(GL_TEXTURE0 + firstUnit);
+		glBindTexture(GL_TEXTURE_2D, lightTexture);
+		glActiveTexture(GL_TEXTURE0 + firstUnit + 1);
+		glBindTexture(GL_TEXTURE_2D, clusterTexture);
+		glActiveTexture(GL_TEXTURE0 + firstUnit + 2);
+		glBindTexture(GL_TEXTURE_2D, indexTexture);
+		glActiveTexture(GL_TEXTURE0);
+	}
+};
+
+// MeshShader with the point lights of the fragment's LightGrid cluster added to the global light
+class ForwardPlusShader : public MeshShader
+{
+public:
+	ForwardPlusShader(const std::string& defines = "") : MeshShader("CLUSTERED_LIGHTS " + defines) { }
+
+	void UploadLightGrid(LightGrid& grid, int firstUnit)
+	{
+		UploadLightGridUniforms(grid, firstUnit);
+	}
+};
+
+class InfiniteQuadShader: public MeshShader
+{
+public:
+	InfiniteQuadShader() : MeshShader("GROUND") { }
+};
+
+
+// depth-only prepass: position stream in, no color out. vec4 input so the
+// homogeneous ground vertices pass through while 3D positions get w = 1.
+class DepthShader: public Shader
+{
+public:
+	// INSTANCE_DATA: model matrices from the object data texture, see GpuScene
+	// TERRAIN: morphed like MeshShader's TERRAIN variant, so the depths match
+	// IMPOSTER_FADE: with INSTANCE_DATA, dithered out like MeshShader's IMPOSTER_FADE variant
+	DepthShader(const char *defines = "")
+	{
+        const char *vertexSource = "\n\
+        #version 130 \n\
+        precision highp float; \n\
+        \n\
+        in vec4 vertexPosition; \n\
+        #ifdef TERRAIN \n\
+        in vec4 vertexTexCoord; \n\
+        uniform vec3 morphEye; \n\
+        #endif \n\
+        #ifdef INSTANCE_DATA \n\
+        in uint objectIndex; \n\
+        uniform sampler2D objectData; \n\
+        uniform mat4 VP; \n\
+        mat4 objectMatrix(int column) { \n\
+            ivec2 texel = ivec2(int(objectIndex) % 128 * 8 + column, int(objectIndex) / 128); \n\
+            return mat4(texelFetch(objectData, texel, 0), texelFetch(objectData, texel + ivec2(1, 0), 0), \n\
+                texelFetch(objectData, texel + ivec2(2, 0), 0), texelFetch(objectData, texel + ivec2(3, 0), 0)); \n\
+        } \n\
+        #else \n\
+        uniform mat4 MVP; \n\
+        #endif \n\
+        #ifdef IMPOSTER_FADE \n\
+        uniform vec3 imposterEye; \n\
+        uniform vec2 imposterRange; \n\
+        flat out float fade; \n\
+        #endif \n\
+        invariant gl_Position; \n\
+        \n\
+        void main() { \n\
+        #ifdef INSTANCE_DATA \n\
+        mat4 M = objectMatrix(0), MVP = M * VP; \n\
+        #endif \n\
+        #ifdef IMPOSTER_FADE \n\
+        fade = clamp((distance((vec4(0.0, 0.0, 0.0, 1.0) * M).xyz, imposterEye) - imposterRange.x) / (imposterRange.y - imposterRange.x), 0.0, 1.0); \n\
+        #endif \n\
+        vec4 position = vertexPosition; \n\
+        #ifdef TERRAIN \n\
+        position.y = mix(position.y, vertexTexCoord.x, clamp((distance(position.xyz, morphEye) - vertexTexCoord.y) / (vertexTexCoord.z - vertexTexCoord.y), 0.0, 1.0)); \n\
+        #endif \n\
+        gl_Position = position * MVP; \n\
+        }";
+
+		const char *fragmentSource = "\n\
+        #version 130 \n\
+        precision highp float; \n\
+        #ifdef IMPOSTER_FADE \n\
+        flat in float fade; \n\
+        #endif \n\
+        \n\
+        void main() { \n\
+        #ifdef IMPOSTER_FADE \n\
+        if (fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715)))) < fade) discard; \n\
+        #endif \n\
+        }";
+
+		CompileProgram("depth", vertexSource, fragmentSource, defines, std::vector<std::string>());
+	}
+
+	// only the INSTANCE_DATA variant has VP
+	void UploadVP(mat4& VP)
+	{
+		int location = glGetUniformLocation(shaderProgram, "VP");
+		if (location >= 0) glUniformMatrix4fv(location, 1, GL_TRUE, VP); 
+	}
+
+	void UploadMVP(mat4& MVP)
+	{
+		int location = glGetUniformLocation(shaderProgram, "MVP");
+		if (location >= 0) glUniformMatrix4fv(location, 1, GL_TRUE, MVP); 
+		else printf("uniform MVP cannot be set\n");
+	}
+
+	void UploadMorphEye(vec3& eye)
+	{
+		int location = glGetUniformLocation(shaderProgram, "morphEye");
+		if (location >= 0) glUniform3f(location, eye.x, eye.y, eye.z);
+		else printf("uniform morphEye cannot be set\n");
+	}
+
+	void UploadImposterFade(vec3& eye, float start, float end)
+	{
+		int location = glGetUniformLocation(shaderProgram, "imposterEye");
+		if (location >= 0) glUniform3f(location, eye.x, eye.y, eye.z);
+		else printf("uniform imposterEye cannot be set\n");
+
+		location = glGetUniformLocation(shaderProgram, "imposterRange");
+		if (location >= 0) glUniform2f(location, start, end);
+		else printf("uniform imposterRange cannot be set\n");
+	}
+};
+
+
+class ShadowShader: public Shader
+{
+public:
+	// INSTANCE_DATA: model matrices from the object data texture, see GpuScene
+	ShadowShader(const char *defines = "")
+	{
+        const char *vertexSource = "\n\
+        #version 130 \n\
+        precision highp float; \n\
+        \n\
+        in vec3 vertexPosition; \n\
+        in vec2 vertexTexCoord; \n\
+        in vec3 vertexNormal; \n\
+        uniform mat4 VP; \n\
+        #ifdef INSTANCE_DATA \n\
+        in uint objectIndex; \n\
+        uniform sampler2D objectData; \n\
+        mat4 objectMatrix(int column) { \n\
+            ivec2 texel = ivec2(int(objectIndex) % 128 * 8 + column, int(objectIndex) / 128); \n\
+            return mat4(texelFetch(objectData, texel, 0), texelFetch(objectData, texel + ivec2(1, 0), 0), \n\
+                texelFetch(objectData, texel + ivec2(2, 0), 0), texelFetch(objectData, texel + ivec2(3, 0), 0)); \n\
+        } \n\
+        #else \n\
+        uniform mat4 M; \n\
+        #endif \n\
+        uniform vec4 worldLightPosition; \n\
+        \n\
+        void main() { \n\
+        #ifdef INSTANCE_DATA \n\
+        mat4 M = objectMatrix(0); \n\
+        #endif \n\
+        vec4 p = vec4(vertexPosition, 1) * M; \n\
+        vec3 s; \n\
+        s.y = -0.999; \n\
+        s.x = (p.x - worldLightPosition.x) / (p.y - worldLightPosition.y) * (s.y - worldLightPosition.y) + worldLightPosition.x; \n\
+        s.z = (p.z - worldLightPosition.z) / (p.y - worldLightPosition.y) * (s.y - worldLightPosition.y) + worldLightPosition.z; \n\
+        gl_Position = vec4(s, 1) * VP; \n\
+        }";
+
+		const char *fragmentSource = "\n\
+        #version 130 \n\
+        precision highp float; \n\
+        \n\
+        out vec4 fragmentColor; \n\
+        \n\
+        void main() \n\
+        { \n\
+            fragmentColor = vec4(0.0, 0.1, 0.0, 1); \n\
+        }";
+
+		CompileProgram("shadow", vertexSource, fragmentSource, defines);
+	}
+
+    void UploadVP(mat4& VP) { 
+		int location = glGetUniformLocation(shaderProgram, "VP");
+		if (location >= 0) glUniformMatrix4fv(location, 1, GL_TRUE, VP); 
+		else printf("uniform VP cannot be set\n");
+	}
+
+	void UploadM(mat4& M)
+	{
+		int location = glGetUniformLocation(shaderProgram, "M");
+		if (location >= 0) glUniformMatrix4fv(location, 1, GL_TRUE, M); 
+		else printf("uniform M cannot be set\n");
+	}
+
+
+    void UploadLightAttributes(vec3& La, vec3& Le, vec4& worldLightPosition) {
+
+        int location = glGetUniformLocation(shaderProgram, "worldLightPosition");
+		if (location >= 0) glUniform4f(location, worldLightPosition.x, 
+                worldLightPosition.y, worldLightPosition.z, worldLightPosition.w);
+		else printf("uniform worldLightPosition cannot be set\n");
+    }
+
+};
+
+
+// G-buffer fill for the deferred path: stores the ambient term, diffuse albedo, normal,
+// shininess and specular color per pixel and leaves the rest to DeferredLightingShader.
+// The ground variant maps the texture over the infinite plane like InfiniteQuadShader.
+class GBufferShader : public MeshShader
+{
+	static std::vector<std::string> FragmentOutputs()
+	{
+		std::vector<std::string> outputs;
+		outputs.push_back("accumulation");
+		outputs.push_back("albedo");
+		outputs.push_back("normalShininess");
+		outputs.push_back("specular");
+		return outputs;
+	}
+
+public:
+	GBufferShader(bool ground = false, const std::string& defines = "")
+		: MeshShader((ground ? "GBUFFER GROUND " : "GBUFFER ") + defines, FragmentOutputs()) { }
+
+	// only the ground variant needs M
+	void UploadM(mat4& M)
+	{
+		int location = glGetUniformLocation(shaderProgram, "M");
+		if (location >= 0) glUniformMatrix4fv(location, 1, GL_TRUE, M); 
+	}
+
+	// only the ambient term is resolved in the G-buffer pass
+    void UploadLightAttributes(vec3& La, vec3& Le, vec4& worldLightPosition) {
+
+        int location = glGetUniformLocation(shaderProgram, "La");
+		if (location >= 0) glUniform3f(location, La.x, La.y, La.z);
+		else printf("uniform La cannot be set\n");
+    }
+
+    void UploadEyePosition(vec3& wEye) { }
+};
+
+
+// full-screen lighting pass of the deferred path: reconstructs the world position from
+// the G-buffer depth and adds the global light and the pixel's LightGrid cluster lights
+class DeferredLightingShader : public Shader
+{
+public:
+	DeferredLightingShader()
+	{
+        const char *vertexSource = "\n\
+        #version 130 \n\
+        precision highp float; \n\
+        \n\
+        void main() { \n\
+        gl_Position = vec4(gl_VertexID == 1 ? 3.0 : -1.0, gl_VertexID == 2 ? 3.0 : -1.0, 0.0, 1.0); \n\
+        }";
+
+		const char *fragmentSource = "\n\
+        #version 130 \n\
+        precision highp float; \n\
+        uniform sampler2D accumulationMap, albedoMap, normalMap, specularMap, depthMap; \n\
+        uniform sampler2D lightData; \n\
+        uniform usampler2D clusterTable; \n\
+        uniform usampler2D lightIndexList; \n\
+        uniform ivec3 gridSize; \n\
+        uniform int tileSize; \n\
+        uniform vec2 sliceParams; \n\
+        uniform int pointLights; \n\
+        uniform mat4 InvVP; \n\
+        uniform vec2 depthRange; \n\
+        uniform vec3 Le; \n\
+        uniform vec4 worldLightPosition; \n\
+        uniform vec3 worldEyePosition; \n\
+        out vec4 fragmentColor; \n\
+        \n\
+        ivec2 row(int i) { return ivec2(i % 1024, i / 1024); } \n\
+        \n\
+        void main() { \n\
+        ivec2 pixel = ivec2(gl_FragCoord.xy); \n\
+        vec3 color = texelFetch(accumulationMap, pixel, 0).rgb; \n\
+        float depth = texelFetch(depthMap, pixel, 0).r; \n\
+        if (depth < 1.0) { \n\
+            float zNdc = depth * 2.0 - 1.0; \n\
+            vec2 ndc = gl_FragCoord.xy / vec2(textureSize(depthMap, 0)) * 2.0 - 1.0; \n\
+            vec4 world = vec4(ndc, zNdc, 1.0) * InvVP; \n\
+            vec3 worldPosition = world.xyz / world.w; \n\
+            vec3 albedo = texelFetch(albedoMap, pixel, 0).rgb; \n\
+            vec4 normalShininess = texelFetch(normalMap, pixel, 0); \n\
+            vec3 ks = texelFetch(specularMap, pixel, 0).rgb; \n\
+            float shininess = normalShininess.w; \n\
+            vec3 N = normalize(normalShininess.xyz); \n\
+            vec3 V = normalize(worldEyePosition - worldPosition); \n\
+            vec3 L = normalize(worldLightPosition.xyz - worldPosition * worldLightPosition.w); \n\
+            vec3 H = normalize(V + L); \n\
+            color += Le * albedo * max(0.0, dot(L, N)) + Le * ks * pow(max(0.0, dot(H, N)), shininess); \n\
+            \n\
+            if (pointLights != 0) { \n\
+                float viewDepth = 2.0 * depthRange.x * depthRange.y / (depthRange.y + depthRange.x - zNdc * (depthRange.y - depthRange.x)); \n\
+                ivec3 cluster = ivec3(pixel / tileSize, int(floor(log(viewDepth) * sliceParams.x + sliceParams.y))); \n\
+                cluster = clamp(cluster, ivec3(0), gridSize - 1); \n\
+                uvec2 range = texelFetch(clusterTable, ivec2(cluster.y * gridSize.x + cluster.x, cluster.z), 0).xy; \n\
+                for (int i = 0; i < int(range.y); i++) { \n\
+                    int light = int(texelFetch(lightIndexList, row(int(range.x) + i), 0).r); \n\
+                    vec4 positionRadius = texelFetch(lightData, row(light * 2), 0); \n\
+                    vec3 lightColor = texelFetch(lightData, row(light * 2 + 1), 0).rgb; \n\
+                    vec3 toLight = positionRadius.xyz - worldPosition; \n\
+                    float dist = length(toLight); \n\
+                    float attenuation = clamp(1.0 - dist / positionRadius.w, 0.0, 1.0); \n\
+                    vec3 Lp = toLight / max(dist, 0.0001); \n\
+                    vec3 Hp = normalize(V + Lp); \n\
+                    color += lightColor * attenuation * attenuation * \n\
+                        (albedo * max(0.0, dot(Lp, N)) + ks * pow(max(0.0, dot(Hp, N)), shininess)); \n\
+                } \n\
+            } \n\
+        } \n\
+        fragmentColor = vec4(color, 1); \n\
+        }";
+
+		CompileProgram("deferred lighting", vertexSource, fragmentSource);
+	}
+
+	// G-buffer textures on firstUnit .. firstUnit + 4, see GBuffer::BindTextures
+	void UploadGBuffer(int firstUnit, mat4& InvVP, float nearPlane, float farPlane, bool pointLights)
+	{
+		const char* samplers[5] = { "accumulationMap", "albedoMap", "normalMap", "specularMap", "depthMap" };
+		for (int i = 0; i < 5; i++)
+		{
+			int location = glGetUniformLocation(shaderProgram, samplers[i]);
+			if (location >= 0) glUniform1i(location, firstUnit + i);
+			else printf("uniform %s cannot be set\n", samplers[i]);
+		}
+
+		int location = glGetUniformLocation(shaderProgram, "InvVP");
+		if (location >= 0) glUniformMatrix4fv(location, 1, GL_TRUE, InvVP); 
+		else printf("uniform InvVP cannot be set\n");
+
+		location = glGetUniformLocation(shaderProgram, "depthRange");
+		if (location >= 0) glUniform2f(location, nearPlane, farPlane);
+		else printf("uniform depthRange cannot be set\n");
+
+		location = glGetUniformLocation(shaderProgram, "pointLights");
+		if (location >= 0) glUniform1i(location, pointLights ? 1 : 0);
+		else printf("uniform pointLights cannot be set\n");
+	}
+
+    void UploadLightAttributes(vec3& La, vec3& Le, vec4& worldLightPosition) {
+
+        int location = glGetUniformLocation(shaderProgram, "Le");
+		if (location >= 0) glUniform3f(location, Le.x, Le.y, Le.z);
+		else printf("uniform Le cannot be set\n");
+
+        location = glGetUniformLocation(shaderProgram, "worldLightPosition");
+		if (location >= 0) glUniform4f(location, worldLightPosition.x, 
+                worldLightPosition.y, worldLightPosition.z, worldLightPosition.w);
+		else printf("uniform worldLightPosition cannot be set\n");
+    }
+
+    void UploadEyePosition(vec3& wEye) {
+
+        int location = glGetUniformLocation(shaderProgram, "worldEyePosition");
+		if (location >= 0) glUniform3f(location, wEye.x, wEye.y, wEye.z);
+		else printf("uniform wEye cannot be set\n");
+    }
+
+	void UploadLightGrid(LightGrid& grid, int firstUnit)
+	{
+		UploadLightGridUniforms(grid, firstUnit);
+	}
+};
+
+
+// render targets of the deferred path, matching GBufferShader's outputs
+class GBuffer
+{
+	unsigned int fbo, depthTexture;
+	unsigned int textures[4];	// accumulation, albedo, normal + shininess, specular
+	int width, height;
+
+	void Release()
+	{
+		if (!fbo) return;
+		glDeleteFramebuffers(1, &fbo);
+		glDeleteTextures(4, &textures[0]);
+		glDeleteTextures(1, &depthTexture);
+		fbo = 0;
+	}
+
+public:
+	GBuffer() { fbo = 0; width = height = 0; }
+
+	~GBuffer() { Release(); }
+
+	void Resize(int w, int h)
+	{
+		if (fbo && w == width && h == height) return;
+		Release();
+		width = w; height = h;
+
+		int previous;
+		glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+
+		glGenFramebuffers(1, &fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+		glGenTextures(4, &textures[0]);
+		unsigned int formats[4] = { GL_RGBA8, GL_RGBA8, GL_RGBA16F, GL_RGBA8 };
+		for (int i = 0; i < 4; i++)
+		{
+			glBindTexture(GL_TEXTURE_2D, textures[i]);
+			glTexImage2D(GL_TEXTURE_2D, 0, formats[i], width, height, 0, GL_RGBA,
+				formats[i] == GL_RGBA16F ? GL_FLOAT : GL_UNSIGNED_BYTE, NULL);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, textures[i], 0);
+		}
+
+		glGenTextures(1, &depthTexture);
+		glBindTexture(GL_TEXTURE_2D, depthTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) printf("G-buffer is incomplete\n");
+		glBindFramebuffer(GL_FRAMEBUFFER, previous);
+	}
+
+	void BindForWriting()
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		unsigned int buffers[4] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3 };
+		glDrawBuffers(4, buffers);
+
+		float background[4] = { 0, 0, 1.0, 0 };
+		float zero[4] = { 0, 0, 0, 0 };
+		float farDepth = 1.0;
+		glClearBufferfv(GL_COLOR, 0, background);
+		for (int i = 1; i < 4; i++) glClearBufferfv(GL_COLOR, i, zero);
+		glClearBufferfv(GL_DEPTH, 0, &farDepth);
+	}
+
+	// accumulation, albedo, normal, specular and depth on firstUnit .. firstUnit + 4
+	void BindTextures(int firstUnit)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+			glBindTexture(GL_TEXTURE_2D, textures[i]);
+		}
+		glActiveTexture(GL_TEXTURE0 + firstUnit + 4);
+		glBindTexture(GL_TEXTURE_2D, depthTexture);
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	// copies the scene depth into target so forward passes can follow the lighting pass
+	void BlitDepth(unsigned int target)
+	{
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+		glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		glBindFramebuffer(GL_FRAMEBUFFER, target);
+	}
+};
+
+
+// streams images into textures through a ring of pixel buffer objects, so that loading
+// textures does not stall a frame: Update copies at most budget bytes of rows per frame
+// into the next free buffer and issues glTexSubImage2D from it, which returns before the
+// copy into the texture is done. A texture keeps its placeholder until the fence after its
+// last rows has signaled; then the filled texture takes the placeholder's place.
+class TextureStreamer
+{
+	struct Upload
+	{
+		unsigned int* texture;		// the Texture's id, the placeholder until done
+		unsigned int target;		// filled row by row, 0 until its first rows are staged
+		int width, height, components, nextRow;
+		unsigned char* pixels;
+		bool owned;					// freed with FreeDecodedImage when done
+	};
+
+	struct Staging
+	{
+		unsigned int buffer, size;
+		GLsync fence;				// 0 while free
+		std::vector<Upload> finished;	// uploads whose last rows came from this buffer
+	};
+
+	std::deque<Upload> queue;
+	std::vector<Staging> ring;
+	unsigned int budget;
+	unsigned int bufferSize;	// the budget, or one row of the widest image
+	int next;					// the oldest buffer in the ring
+
+	// swaps in the textures behind signaled fences, waiting up to timeout nanoseconds
+	void Retire(GLuint64 timeout)
+	{
+		for (int i = 0; i < ring.size(); i++)
+		{
+			Staging& staging = ring[i];
+			if (!staging.fence) continue;
+			GLenum status = glClientWaitSync(staging.fence, timeout ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, timeout);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) continue;
+			glDeleteSync(staging.fence);
+			staging.fence = 0;
+			for (int j = 0; j < staging.finished.size(); j++)
+			{
+				Upload& upload = staging.finished[j];
+				glDeleteTextures(1, upload.texture);
+				*upload.texture = upload.target;
+				if (upload.owned) FreeDecodedImage(upload.pixels);
+			}
+			staging.finished.clear();
+		}
+	}
+
+public:
+	unsigned int bytesUploaded;		// since the start
+
+	TextureStreamer(unsigned int budget, int bufferCount = 3) : budget(budget), bufferSize(budget), next(0), bytesUploaded(0)
+	{
+		ring.resize(bufferCount);
+		for (int i = 0; i < ring.size(); i++)
+		{
+			glGenBuffers(1, &ring[i].buffer);
+			ring[i].size = 0;
+			ring[i].fence = 0;
+		}
+	}
+
+	~TextureStreamer()
+	{
+		Finish();
+		for (int i = 0; i < ring.size(); i++) glDeleteBuffers(1, &ring[i].buffer);
+	}
+
+	// queues an image for the texture whose id is *texture; the pixels must stay valid until
+	// the upload is done
+	void Add(unsigned int* texture, int width, int height, int components, unsigned char* pixels, bool owned)
+	{
+		Upload upload = { texture, 0, width, height, components, 0, pixels, owned };
+		bufferSize = std::max(bufferSize, (unsigned int)(width * components));
+		queue.push_back(upload);
+	}
+
+	// textures still showing their placeholder
+	int GetPendingCount()
+	{
+		int pending = (int)queue.size();
+		for (int i = 0; i < ring.size(); i++) pending += (int)ring[i].finished.size();
+		return pending;
+	}
+
+	// once per frame: swap in what has arrived, then stage the next budget bytes
+	void Update()
+	{
+		PROFILE_SCOPE("texture streaming");
+		Retire(0);
+		Staging& staging = ring[next];
+		if (queue.empty() || staging.fence) return;
+
+		// storage for the images that start in this buffer, allocated before the buffer is
+		// bound (a NULL glTexImage2D would read from it)
+		size_t bytes = 0;
+		for (int i = 0; i < queue.size() && bytes < budget; i++)
+		{
+			Upload& upload = queue[i];
+			bytes += (size_t)(upload.height - upload.nextRow) * upload.width * upload.components;
+			if (upload.target) continue;
+			GLenum format = upload.components == 3 ? GL_RGB : GL_RGBA;
+			glGenTextures(1, &upload.target);
+			glBindTexture(GL_TEXTURE_2D, upload.target);
+			glTexImage2D(GL_TEXTURE_2D, 0, format, upload.width, upload.height, 0, format, GL_UNSIGNED_BYTE, NULL);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		}
+
+		struct Band { unsigned int target; int width, firstRow, rows, components; size_t offset; };
+		std::vector<Band> bands;
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer);
+		if (staging.size < bufferSize)
+		{
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, bufferSize, NULL, GL_STREAM_DRAW);
+			staging.size = bufferSize;
+		}
+		// the fence has signaled, so nothing reads the buffer any more
+		unsigned char* mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bufferSize,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		size_t offset = 0;
+		while (mapped && !queue.empty())
+		{
+			Upload& upload = queue.front();
+			size_t rowBytes = upload.width * upload.components;
+			int rows = std::min(upload.height - upload.nextRow, (int)((bufferSize - offset) / rowBytes));
+			if (rows == 0) break;
+			memcpy(mapped + offset, upload.pixels + upload.nextRow * rowBytes, rows * rowBytes);
+			Band band = { upload.target, upload.width, upload.nextRow, rows, upload.components, offset };
+			bands.push_back(band);
+			offset += rows * rowBytes;
+			upload.nextRow += rows;
+			if (upload.nextRow == upload.height)
+			{
+				staging.finished.push_back(upload);
+				queue.pop_front();
+			}
+			if (offset >= budget) break;
+		}
+		if (mapped) glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (int i = 0; i < bands.size(); i++)
+		{
+			glBindTexture(GL_TEXTURE_2D, bands[i].target);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, bands[i].firstRow, bands[i].width, bands[i].rows,
+				bands[i].components == 3 ? GL_RGB : GL_RGBA, GL_UNSIGNED_BYTE, (void*)bands[i].offset);
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		staging.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		next = (next + 1) % ring.size();
+		bytesUploaded += offset;
+	}
+
+	// everything queued in place now, e.g. before the textures are read back
+	void Finish()
+	{
+		while (GetPendingCount())
+		{
+			Update();
+			Retire(1000000000);
+		}
+	}
+};
+
+// streams every texture created while it is set, see Scene::Initialize
+TextureStreamer* textureStreamer = 0;
+
+class Texture
+{
+	unsigned int textureId;
+	int width, height;
+
+	// a missing image still leaves a texture to bind: one white texel
+	static unsigned char* White()
+	{
+		static unsigned char white[4] = { 255, 255, 255, 255 };
+		return white;
+	}
+
+	// uploads now, or queues data with textureStreamer and shows one white texel until
+	// it is done; owned: data came from DecodeImage
+	void Create(unsigned char* data, int nComponents, bool owned)
+	{
+		PROFILE_SCOPE("texture upload");
+		bool stream = textureStreamer && data != White();
+		glGenTextures(1, &textureId); 
+		glBindTexture(GL_TEXTURE_2D, textureId); 
+		
+		if (stream) glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, White());
+		else if(nComponents == 3) glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+		else if(nComponents == 4) glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR); 
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); 
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+		if (stream) textureStreamer->Add(&textureId, width, height, nComponents, data, owned);
+		else if (owned) FreeDecodedImage(data);
+	}
+
+public:
+	Texture(const std::string& inputFileName)
+	{
+		PROFILE_SCOPE("load texture");
+		unsigned char* data;
+		int nComponents = 4;
+		
+		data = DecodeImage(inputFileName, width, height, nComponents);
+		if(data == NULL) 
+		{ 
+			printf("cannot load %s\n", inputFileName.c_str());
+			width = height = 1;
+			Create(White(), 4, false);
+			return;
+		}
+		Create(data, nComponents, true);
+	}
+
+	// from RGBA texels that outlive the upload, e.g. generated ones
+	Texture(int width, int height, unsigned char* rgba) : width(width), height(height)
+	{
+		Create(rgba, 4, false);
+	}
+
+	~Texture()
+	{
+		glDeleteTextures(1, &textureId);
+	}
+
+	void Bind()
+	{
+		glBindTexture(GL_TEXTURE_2D, textureId);
+	}
+
+	int GetWidth() { return width; }
+	int GetHeight() { return height; }
+
+	// the texels back from GL as RGBA
+	void Read(std::vector<unsigned char>& pixels)
+	{
+		pixels.resize(width * height * 4);
+		glBindTexture(GL_TEXTURE_2D, textureId);
+		glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+	}
+};
+
+
+// textures of one size as the layers of a GL_TEXTURE_2D_ARRAY, so that objects with
+// different textures can share a draw; the layer of a texture is its place in the list
+class TextureArray
+{
+	unsigned int textureId;
+	std::vector<Texture*> layers;
+
+public:
+	TextureArray(const std::vector<Texture*>& textures) : layers(textures)
+	{
+		PROFILE_SCOPE("texture array");
+		int width = layers[0]->GetWidth(), height = layers[0]->GetHeight();
+		glGenTextures(1, &textureId);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, textureId);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, (int)layers.size(), 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+		std::vector<unsigned char> pixels;
+		for (int layer = 0; layer < layers.size(); layer++)
+		{
+			layers[layer]->Read(pixels);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, textureId);
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+		}
+
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	}
+
+	~TextureArray()
+	{
+		glDeleteTextures(1, &textureId);
+	}
+
+	int GetLayer(Texture* texture)
+	{
+		return (int)(std::find(layers.begin(), layers.end(), texture) - layers.begin());
+	}
+
+	void Bind()
+	{
+		glBindTexture(GL_TEXTURE_2D_ARRAY, textureId);
+	}
+};
+
+
+
+class Material
+{
+	Shader* shader;
+	Texture* texture;
+    vec3 ka, kd, ks;
+    float shininess;
+
+public:
+	Material(Shader* sh, Texture* t = 0, 
+             vec3 a=vec3(0.1,0.1,0.1), vec3 d=vec3(0.9,0.9,0.9), 
+             vec3 s=vec3(0.0,0.0,0.0), float shine=20.0)
+	{
+		shader = sh;
+		texture = t;
+        ka = a; kd=d; ks=s;
+        shininess = shine;
+	}
+
+	Shader* GetShader() { return shader; }
+
+	Texture* GetTexture() { return texture; }
+
+	void GetAttributes(vec3& a, vec3& d, vec3& s, float& shine) { a = ka; d = kd; s = ks; shine = shininess; }
+
+	// target: a variant of the material's shader with the same uniforms, see GpuScene
+	void UploadAttributes(Shader* target = 0)
+	{
+		if(texture)
+		{
+            Shader* shader = target ? target : this->shader;
+            shader->UploadMaterialAttributes(ka, kd, ks, shininess);
+			shader->UploadSamplerID();
+			texture->Bind();
+		}
+		else {
+        }
+    }
+};
+
+
+// the placements of the objects and of the lights attached to them
+TransformGraph transforms;
+
+
+class Light
+{
+    vec3 La, Le;
+    vec4 worldLightPosition;
+    int node;		// in transforms while attached, else -1
+
+    // the world position of the node once attached
+    vec4 GetWorldLightPosition() {
+        if (node < 0) return worldLightPosition;
+        const mat4& M = transforms.GetWorld(node);
+        return vec4(M.m[3][0], M.m[3][1], M.m[3][2], 1);
+    }
+
+public:
+    Light(vec3 a, vec3 e, vec4 worldLight) {
+        La = a;
+        Le = e;
+        worldLightPosition = worldLight;
+        node = -1;
+    }
+
+    ~Light() { if (node >= 0) transforms.Remove(node); }
+
+    // a point light at offset in the space of transform node parent, following it from the
+    // next transforms.Update
+    void Attach(int parent, vec3 offset) {
+        if (node < 0) node = transforms.Add(parent);
+        else transforms.SetParent(node, parent);
+        mat4 T = mat4(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, offset.x, offset.y, offset.z, 1);
+        mat4 InvT = mat4(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, -offset.x, -offset.y, -offset.z, 1);
+        transforms.SetLocal(node, T, InvT);
+    }
+
+    void UploadAttributes(Shader* shader) {
+        vec4 position = GetWorldLightPosition();
+        shader->UploadLightAttributes(La, Le, position);
+    }
+
+    void GetAttributes(vec3& a, vec3& e, vec4& position) { a = La; e = Le; position = GetWorldLightPosition(); }
+
+    void SetPointLightSource(vec3& pos) {
+        worldLightPosition = vec4(pos.x, pos.y, pos.z, 1);
+    }
+
+    void SetDirectionalLightSource(vec3& dir) {
+        worldLightPosition = vec4(dir.x, dir.y, dir.z, 0);
+    }
+
+    PointLight GetPointLight(float radius) {
+        vec4 position = GetWorldLightPosition();
+        return PointLight(vec3(position.x, position.y, position.z), radius, Le);
+    }
+
+};
+
+Light* light;
+
+
+class Mesh
+{
+	Geometry* geometry;
+	Material* material;
+	std::vector<Material*> rangeMaterials;	// by ObjMesh material index, see SetRangeMaterials
+
+public:
+	Mesh(Geometry* g, Material* m)
+	{
+		geometry = g;
+		material = m;
+	}
+
+	// the materials of the geometry's material ranges; the mesh's own material stands in
+	// where an entry is 0 and for the faces without any
+	void SetRangeMaterials(const std::vector<Material*>& materials) { rangeMaterials = materials; }
+
+	Shader* GetShader() { return material->GetShader(); }
+
+	Geometry* GetGeometry() { return geometry; }
+
+	Material* GetMaterial() { return material; }
+
+	// the material drawn for the faces of ObjMesh material index, see SetRangeMaterials
+	Material* GetRangeMaterial(int index)
+	{
+		return index >= 0 && index < rangeMaterials.size() && rangeMaterials[index] ? rangeMaterials[index] : material;
+	}
+
+	// the draw calls of Draw: one per material range
+	int GetDrawCalls() { return std::max(1, (int)geometry->GetMaterialRanges().size()); }
+
+	// every material range from the one bound buffer, the ranges are already in
+	// material order
+	void Draw()
+	{
+		const std::vector<ObjMesh::Submesh>& ranges = geometry->GetMaterialRanges();
+		if (ranges.empty())
+		{
+			material->UploadAttributes();
+			geometry->Draw();
+			return;
+		}
+
+		geometry->BeginRanges();
+		for (unsigned int i = 0; i < ranges.size(); i++)
+		{
+			GetRangeMaterial(ranges[i].material)->UploadAttributes();
+			geometry->DrawRange(ranges[i]);
+		}
+		geometry->EndRanges();
+	}
+
+	// for passes that bring their own shader and need no material
+	void DrawGeometry()
+	{
+		geometry->Draw();
+	}
+
+	void DrawPositions()
+	{
+		geometry->DrawPositions();
+	}
+
+	// a subset of the triangles, see Object::clusters
+	void DrawClusters(unsigned int indexBuffer, unsigned int firstIndex, unsigned int indexCount, bool positionsOnly)
+	{
+		if (!positionsOnly) material->UploadAttributes();
+		geometry->DrawIndices(indexBuffer, firstIndex, indexCount, positionsOnly);
+	}
+
+	BoundingBox GetBounds() { return geometry->GetBounds(); }
+
+	OccluderMesh* GetOccluder() { return geometry->GetOccluder(); }
+};
+
+
+
+
+
+class Camera {
+   float fov, asp, fp, bp;
+   float velocity, angularVelocity;
+   int isTracking;
+   vec3 startPos;
+   float t;
+
+public:
+   std::string state;
+   vec3  wEye, wLookat, wVup, wAvi;
+   float alpha;
+	Camera()
+	{
+        isTracking = 0;
+        t = 0;
+        state = "heliCam";
+		wEye = vec3(0.0, 0.0, 2.0);
+		wLookat = vec3(0.0, 0.0, 0.0);
+        wAvi = vec3(0.0, 0.0, 0.2);
+		wVup = vec3(0.0, 1.0, 0.0);
+		fov = M_PI / 4.0; asp = 1.0; fp = 0.01; bp = 10.0;		
+        velocity = 0.0; angularVelocity = 0.0;
+	}
+	
+	void SetAspectRatio(float a) { asp = a; }
+
+	float GetNearPlane() { return fp; }
+	float GetFarPlane() { return bp; }
+
+	mat4 GetViewMatrix() 
+	{ 
+		vec3 w = (wEye - wLookat).normalize();
+		vec3 u = cross(wVup, w).normalize();
+		vec3 v = cross(w, u);
+	
+		return  
+			mat4(	
+				1.0f,    0.0f,    0.0f,    0.0f,
+				0.0f,    1.0f,    0.0f,    0.0f,
+				0.0f,    0.0f,    1.0f,    0.0f,
+				-wEye.x, -wEye.y, -wEye.z, 1.0f ) *
+			mat4(	
+				u.x,  v.x,  w.x,  0.0f,
+				u.y,  v.y,  w.y,  0.0f,
+				u.z,  v.z,  w.z,  0.0f,
+				0.0f, 0.0f, 0.0f, 1.0f );
+   }
+
+	mat4 GetProjectionMatrix() 
+	{ 
+		float sy = 1/tan(fov/2);
+		return mat4(
+			sy/asp, 0.0f,  0.0f,               0.0f,
+			0.0f,   sy,    0.0f,               0.0f,
+			0.0f,   0.0f, -(fp+bp)/(bp - fp), -1.0f,
+			0.0f,   0.0f, -2*fp*bp/(bp - fp),  0.0f);
+	}
+
+    void UploadAttributes(Shader* shader) {
+        shader->UploadEyePosition(wEye);
+    }
+
+    void Control() {
+        // trackShot mode
+         if (keyboardState['t'] == true) {
+             state = "trackShot";
+         } else if (keyboardState['c'] == true) {
+             state = "moveCam";
+         } else {
+             state = "heliCam";
+             t = 0;
+
+         }
+
+         // rotate negative angular velocity
+         if (keyboardState['a'] == true) {
+             angularVelocity = -0.5;
+         // rotate positive angular velocity (with dvorak keyboard)
+         } else if (keyboardState['e'] == true) {
+             angularVelocity = 0.5;
+         } else { angularVelocity = 0.0; }
+         // move forward (with dvorak keyboard)
+         if (keyboardState[','] ==  true) {
+             velocity = 2.0;
+         // move backward (with dvorak keyboard)
+         } else if (keyboardState['o'] == true) {
+             velocity = -2.0;
+         } else { velocity = 0.0; }
+    }
+
+    float len(vec3 a, vec3 b) {
+        return sqrt( pow(a.x - b.x, 2) + pow(a.y - b.y, 2) + pow(a.z - b.z, 2));
+    }
+
+    /* return the direction from a to be on x y z (1 or -1) */
+    vec3 sign(vec3 a, vec3 b) {
+        float x;
+        float y;
+        float z;
+        if (a.x > b.x) {x = 1.0;} else {x = -1.0;}
+        if (a.y > b.y) {y = 1.0;} else {y = -1.0;}
+        if (a.z > b.z) {z = 1.0;} else {z = -1.0;}
+        return vec3(x,y,z);
+    }
+
+    float rad_2_deg(float rad) {
+        return rad * 180 / 3.14159;
+    }
+
+    float sign(float x) {
+        if ((x) < 0.0) {
+            return -1.0;
+        } else {
+            return 1.0;
+        }
+    }
+    
+    void Move(float dt) {
+        if (state == "moveCam") {
+            // move only the camera, not the avatar
+            vec3 norm = (wLookat - wEye).normalize();
+            float beta = angularVelocity * dt;
+            float l = len(wLookat, wEye);
+            mat4 rot = mat4(
+                    cos(beta), 0, sin(beta), 0,
+                    0, 1, 0, 0,
+                    -sin(beta), 0, cos(beta), 0,
+                    0, 0, 0, 1);
+            vec4 newNorm4 = vec4(norm.x, norm.y, norm.z, 1) * rot;
+
+            wEye = wEye + vec3(newNorm4.v[0], 0, newNorm4.v[2])*velocity*dt;
+            wLookat = wEye + vec3(newNorm4.v[0], 0, newNorm4.v[2]) * l;
+        } else if (state == "heliCam") {
+            // camera motion will be determined after avatar position
+        } else if (state == "trackShot") {
+            t += dt;
+            wEye = vec3(wLookat.x + 5*cos(t), 3, wLookat.z + 5*sin(t));
+            
+        }
+    }
+
+};
+
+Camera camera;
+
+// shadows are cast from a fixed point onto the ground, independently of the shading light
+vec3 shadowLightPosition = vec3(100.0, 100.0, 100.0);
+const float shadowPlaneHeight = -0.999;
+
+
+class Object
+{
+	Mesh *mesh;
+	Shader* mShader;
+
+	vec3 scaling;
+	Object* parent;
+	int node;		// in transforms
+
+public:
+	// relative to the parent; call Moved after changing them
+	float orientation;
+	vec3 position;
+
+	// this frame's visible meshlet triangles in a stream of the scene, whole mesh while indexCount < 0
+	struct Clusters
+	{
+		unsigned int indexBuffer, firstIndex;
+		int indexCount;
+	} clusters;
+
+	Object(Mesh *m, vec3 position = vec3(0.0, 0.0, 0.0), vec3 scaling = vec3(1.0, 1.0, 1.0), float orientation = 0.0) : position(position), scaling(scaling), orientation(orientation)
+	{
+		mShader = m->GetShader();
+		mesh = m;
+		clusters.indexCount = -1;
+		parent = 0;
+		node = transforms.Add();
+		Moved();
+	}
+
+	~Object() { transforms.Remove(node); }
+
+	vec3& GetPosition() { return position; }
+
+	// position, orientation and scaling are in the space of parent from now on, 0 for the world
+	void SetParent(Object* p)
+	{
+		parent = p;
+		transforms.SetParent(node, p ? p->node : -1);
+	}
+
+	Object* GetParent() { return parent; }
+
+	int GetNode() { return node; }
+
+	// the model matrix follows the new position, orientation and scaling from the next transforms.Update
+	void Moved() { transforms.SetLocal(node, GetLocalMatrix(), GetInverseLocalMatrix()); }
+
+	// changes whenever transforms.Update moves the object, its parents' moves included
+	int GetTransformVersion() { return transforms.GetVersion(node); }
+
+	vec3 GetWorldPosition()
+	{
+		const mat4& M = transforms.GetWorld(node);
+		return vec3(M.m[3][0], M.m[3][1], M.m[3][2]);
+	}
+
+	Mesh* GetMesh() { return mesh; }
+
+	void Draw()
+	{
+		PROFILE_SCOPE("Object::Draw");
+		mShader->Run();
+        light->UploadAttributes(mShader);
+		UploadAttributes();
+		if (clusters.indexCount >= 0) mesh->DrawClusters(clusters.indexBuffer, clusters.firstIndex, clusters.indexCount, false);
+		else mesh->Draw();
+	}
+
+	// the draw calls of Draw
+	int GetDrawCalls() { return clusters.indexCount >= 0 ? 1 : mesh->GetDrawCalls(); }
+
+    void DrawShadow(Shader* shadowShader) {
+        PROFILE_SCOPE("Object::DrawShadow");
+        shadowShader->Run();
+        UploadAttributes(shadowShader);
+
+        vec3 none;
+        vec4 lightPosition = vec4(shadowLightPosition.x, shadowLightPosition.y, shadowLightPosition.z, 1.0);
+        shadowShader->UploadLightAttributes(none, none, lightPosition);
+
+        camera.UploadAttributes(shadowShader);
+
+        mesh->DrawGeometry();
+
+    }
+
+	// the depth shader must already be running
+	void DrawDepth(Shader* depthShader) {
+		UploadAttributes(depthShader);
+		if (clusters.indexCount >= 0) mesh->DrawClusters(clusters.indexBuffer, clusters.firstIndex, clusters.indexCount, true);
+		else mesh->DrawPositions();
+	}
+
+	BoundingBox GetWorldBounds() { return mesh->GetBounds().Transform(GetModelMatrix()); }
+
+	OccluderMesh* GetOccluder() { return mesh->GetOccluder(); }
+
+	// the world bounds together with the projected shadow on the ground
+	BoundingBox GetShadowedBounds()
+	{
+		BoundingBox box = GetWorldBounds();
+		if (box.IsEmpty()) return box;
+		BoundingBox result = box;
+		vec3& l = shadowLightPosition;
+		for (int i = 0; i < 8; i++)
+		{
+			vec3 p = vec3(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y, i & 4 ? box.max.z : box.min.z);
+			if (p.y >= l.y) continue;
+			float t = (shadowPlaneHeight - l.y) / (p.y - l.y);
+			result.Extend(vec3(l.x + (p.x - l.x) * t, shadowPlaneHeight, l.z + (p.z - l.z) * t));
+		}
+		return result;
+	}
+
+	mat4 GetModelMatrix() { return transforms.GetWorld(node); }
+
+	mat4 GetInverseModelMatrix() { return transforms.GetInverseWorld(node); }
+
+	mat4 GetLocalMatrix()
+	{
+		float alpha = orientation / 180.0 * M_PI;
+		mat4 S = mat4(
+			scaling.x,		0.0,			0.0,			0.0,
+			0.0,			scaling.y,		0.0,			0.0,
+			0.0,			0.0,			scaling.z,		0.0,
+			0.0,			0.0,			0.0,			1.0);
+		mat4 R = mat4(
+			cos(alpha),		0.0,			sin(alpha),		0.0,
+			0.0,			1.0,			0.0,			0.0,
+			-sin(alpha),	0.0,			cos(alpha),		0.0,
+			0.0,			0.0,			0.0,			1.0);
+		mat4 T = mat4(
+			1.0,			0.0,			0.0,			0.0,
+			0.0,			1.0,			0.0,			0.0,
+			0.0,			0.0,			1.0,			0.0,
+			position.x,		position.y,		position.z,		1.0);
+		return S * R * T;
+	}
+
+	mat4 GetInverseLocalMatrix()
+	{
+		mat4 InvT = mat4(
+			1.0,			0.0,			0.0,			0.0,
+			0.0,			1.0,			0.0,			0.0,
+			0.0,			0.0,			1.0,			0.0,
+			-position.x,	-position.y,	-position.z,	1.0);
+
+		mat4 InvS = mat4(
+			1.0/scaling.x,	0.0,			0.0,			0.0,
+			0.0,			1.0/scaling.y,	0.0,			0.0,
+			0.0,			0.0,			1.0/scaling.z,	0.0,
+			0.0,			0.0,			0.0,			1.0);
+
+		float alpha = orientation / 180.0 * M_PI;
+
+		mat4 InvR = mat4(
+			cos(alpha),		0.0,			-sin(alpha),	0.0,
+			0.0,			1.0,			0.0,			0.0,
+			sin(alpha),		0.0,			cos(alpha),		0.0,
+			0.0,			0.0,			0.0,			1.0);
+
+		return InvT * InvR * InvS;
+	}
+
+	void UploadAttributes(Shader *shader=0)
+	{
+        if (shader == 0) {
+            shader = mShader;
+        }
+		mat4 M = GetModelMatrix();
+		mat4 InvM = GetInverseModelMatrix();
+
+		mat4 MVP = M * camera.GetViewMatrix() * camera.GetProjectionMatrix();
+        mat4 VP = camera.GetViewMatrix() * camera.GetProjectionMatrix();
+
+        shader->UploadM(M);
+		shader->UploadInvM(InvM);
+		shader->UploadMVP(MVP);
+        shader->UploadVP(VP);
+	}
+};
+
+class Chevy
+{
+    std::vector<Object*> wheels;	// front left, front right, rear left, rear right
+    Light* spotlight;
+    float wheelAngle;		// steering, of the front wheels
+    float velocity, angularVelocity;
+    InstanceBvh* world;
+    float groundHeight, rideHeight;
+
+    // the move from -> to, stopped where the chassis would run into the world's triangles
+    // (steps up to stepHeight are climbed) and resting on the highest of them below it
+    vec3 Collide(vec3 from, vec3 to)
+    {
+        static const float stepHeight = 0.1;
+        BoundingBox box = chassis->GetWorldBounds();
+        vec3 offset = to - from;
+        box.min = box.min + offset;
+        box.max = box.max + offset;
+        box.min.y += stepHeight;
+        std::vector<std::pair<int, int> > contacts;
+        world->Overlap(box, contacts);
+        if (!contacts.empty()) to = from;
+
+        float height = groundHeight;
+        RayHit hit;
+        if (world->Raycast(vec3(to.x, box.max.y, to.z), vec3(0.0, -1.0, 0.0), hit)) height = std::max(height, box.max.y - hit.t);
+        to.y = height + rideHeight;
+        return to;
+    }
+
+public:
+    Object* chassis;
+
+    // the wheels and the headlamp ride on the chassis: their placements are in chassis.obj units
+    Chevy(Object* chassis, Mesh* wheel, Light* spotlight): chassis(chassis), spotlight(spotlight)
+    {
+        world = 0;
+        wheelAngle = 0.0;
+        // the wheels are wheelHeight of the chassis tall and fill the corners of its bounds,
+        // standing on their bottom, front wheels to +z
+        static const float wheelHeight = 0.3;
+        BoundingBox body = chassis->GetMesh()->GetBounds(), tyre = wheel->GetBounds();
+        float wheelScale = wheelHeight * (body.max.y - body.min.y) / (tyre.max.y - tyre.min.y);
+        vec3 half = (tyre.max - tyre.min) * (0.5 * wheelScale), center = tyre.GetCenter() * wheelScale;
+        for (int i = 0; i < 4; i++) {
+            // the right side is the left one turned around, which also turns its bounds' center
+            float side = i % 2 ? -1.0 : 1.0;
+            vec3 corner = vec3(side > 0.0 ? body.max.x - half.x : body.min.x + half.x, body.min.y + half.y,
+                i < 2 ? body.max.z - half.z : body.min.z + half.z);
+            vec3 offset = corner - vec3(side * center.x, center.y, side * center.z);
+            wheels.push_back(new Object(wheel, offset, vec3(wheelScale, wheelScale, wheelScale), i % 2 ? 180.0 : 0.0));
+            wheels.back()->SetParent(chassis);
+        }
+        spotlight->Attach(chassis->GetNode(), vec3(0.0, 10.0, 0.0));
+    }
+
+    // owned by the scene's object list like the chassis
+    const std::vector<Object*>& GetWheels() { return wheels; }
+
+    // collide with world from now on, keeping the chassis as high above what it rests on
+    // as it is above the ground plane now
+    void SetWorld(InstanceBvh* w, float ground)
+    {
+        world = w;
+        groundHeight = ground;
+        rideHeight = chassis->position.y - ground;
+    }
+
+    Light* GetSpotlight() { return spotlight; }
+
+    void Control() {
+     // rotate negative angular velocity
+     if (keyboardState['a'] == true) {
+         angularVelocity = -100.0;
+     // rotate positive angular velocity (with dvorak keyboard)
+     } else if (keyboardState['e'] == true) {
+         angularVelocity = 100.0;
+     } else { angularVelocity = 0.0;}
+     // move forward (with dvorak keyboard)
+     if (keyboardState[','] ==  true) {
+         velocity = 2;
+     // move backward (with dvorak keyboard)
+     } else if (keyboardState['o'] == true) {
+         velocity = -2;
+     } else { velocity = 0.0; }
+    }
+
+    vec3 dirs(float angle) {
+        vec3 d = vec3(0, 0, 0);
+        angle = ( (int) angle % 360);
+        if (angle < 0) { angle = 360 + angle; }
+        //printf("%f   ", angle);
+        if ( (angle < 180) ) {
+            d.z = 1;
+            d.x = -1;
+        } else {
+            d.z = 1;
+            d.x = -1;
+        }
+        return d;
+    }
+
+    void Move(float dt) {
+        if (camera.state == "moveCam") {
+            //chassis->position = vec3(camera.wLookat.x, chassis->position.y, camera.wLookat.z);
+            //chassis->orientation = camera.alpha;
+        } else if (camera.state == "heliCam") {
+            // follow the avatar with the camera
+            float dAngle = angularVelocity*dt;
+            float ori = chassis->orientation;
+            vec3 dir = dirs(ori);
+            vec3 pos = chassis->position;
+            //printf("%f\n", chassis->orientation);
+            chassis->position = vec3(pos.x + dir.x*sin(3.14/180*chassis->orientation)*velocity*dt, pos.y, pos.z+dir.z*cos(3.14/180*chassis->orientation)*velocity*dt);
+            if (world) chassis->position = Collide(pos, chassis->position);
+            chassis->orientation = chassis->orientation + angularVelocity*dt;
+            // standing still leaves the chassis and the wheels out of the next transforms.Update
+            vec3 moved = chassis->position;
+            if (moved.x != pos.x || moved.y != pos.y || moved.z != pos.z || chassis->orientation != ori) chassis->Moved();
+            camera.wEye = vec3(pos.x - dir.x*sin(3.14/180*ori)*2, 1, pos.z - dir.z*cos(3.14/180*ori)*2);
+            camera.wLookat = chassis->position;
+
+        }
+        vec3 lPos = vec3(chassis->position.x, chassis->position.y+100, chassis->position.z);
+        light->SetPointLightSource(lPos);
+
+        // the front wheels turn with the chassis
+        float steering = angularVelocity > 0.0 ? 20.0 : (angularVelocity < 0.0 ? -20.0 : 0.0);
+        if (steering != wheelAngle) {
+            for (int i = 0; i < 2; i++) {
+                wheels[i]->orientation += steering - wheelAngle;
+                wheels[i]->Moved();
+            }
+            wheelAngle = steering;
+        }
+    }
+
+    void Draw() {
+            chassis->Draw();
+    }
+
+};
+
+// GL_TIME_ELAPSED queries around the named passes while the profiler is on. A result is
+// only read once GL_QUERY_RESULT_AVAILABLE says so, normally a frame or two later, and then
+// joins the frame that issued it; the queries never stall the pipeline. They cannot nest,
+// so a pass that starts inside another one is left to its CPU scope.
+class GpuPassQueries
+{
+	struct Pending
+	{
+		unsigned int query;
+		const char* name;
+		int frame;
+		double cpuStart;
+	};
+
+	std::vector<unsigned int> spare;
+	std::deque<Pending> pending;
+	bool open;
+	int supported;		// GL 3.3 timer queries, -1 until the first Begin
+
+public:
+	GpuPassQueries() : open(false), supported(-1) {}
+
+	~GpuPassQueries()
+	{
+		for (unsigned int i = 0; i < pending.size(); i++) spare.push_back(pending[i].query);
+		if (!spare.empty()) glDeleteQueries((int)spare.size(), &spare[0]);
+	}
+
+	bool Begin(const char* name, double cpuStart)
+	{
+		if (supported < 0) supported = majorVersion * 10 + minorVersion >= 33;
+		if (open || !supported) return false;
+		Pending query = { 0, name, Profiler::Get().GetFrameIndex(), cpuStart };
+		if (spare.empty()) glGenQueries(1, &query.query);
+		else
+		{
+			query.query = spare.back();
+			spare.pop_back();
+		}
+		glBeginQuery(GL_TIME_ELAPSED, query.query);
+		pending.push_back(query);
+		open = true;
+		return true;
+	}
+
+	void End()
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		open = false;
+	}
+
+	// hands the finished results to the profiler, oldest first; wait blocks for all of them
+	void Collect(bool wait = false)
+	{
+		while (!pending.empty() && !(open && pending.size() == 1))
+		{
+			Pending& query = pending.front();
+			int available = 0;
+			if (!wait) glGetQueryObjectiv(query.query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!wait && !available) break;
+			GLuint64 nanoseconds = 0;
+			glGetQueryObjectui64v(query.query, GL_QUERY_RESULT, &nanoseconds);
+			Profiler::Get().AddEvent(query.name, query.cpuStart, nanoseconds * 0.001, true, query.frame);
+			spare.push_back(query.query);
+			pending.pop_front();
+		}
+	}
+};
+
+GpuPassQueries gpuPassQueries;
+
+// start of a frame for the profiler, which also takes the GPU pass times that are ready,
+// and for the GL call counts
+void BeginProfilerFrame()
+{
+#if defined(MESHLOADER_GL_TRACE)
+	GLTrace::Get().BeginFrame();
+#endif
+	if (!Profiler::Get().enabled) return;
+	Profiler::Get().BeginFrame();
+	gpuPassQueries.Collect();
+}
+
+// wall-clock time of a render pass; with options.passStats the GL queue is drained at
+// both ends so that (software) GL work is charged to the pass that issued it. A named
+// pass is also recorded by the profiler, on the CPU and, through a timer query, on the GPU.
+class PassTimer
+{
+	std::chrono::steady_clock::time_point start;
+	const char* name;
+	double profileStart;
+	bool gpuQuery;
+
+public:
+	PassTimer() : name(0), gpuQuery(false) {}
+
+	void Begin(const char* pass = 0)
+	{
+		if (options.passStats) glFinish();
+		name = Profiler::Get().enabled ? pass : 0;
+		if (name)
+		{
+			profileStart = Profiler::Get().Now();
+			gpuQuery = gpuPassQueries.Begin(name, profileStart);
+		}
+		start = std::chrono::steady_clock::now();
+	}
+
+	double End()
+	{
+		if (options.passStats) glFinish();
+		double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (name)
+		{
+			if (gpuQuery) gpuPassQueries.End();
+			Profiler::Get().AddEvent(name, profileStart, Profiler::Get().Now() - profileStart);
+			name = 0;
+		}
+		return milliseconds;
+	}
+};
+
+// result of a counting query between Begin and End, e.g. GL_SAMPLES_PASSED for fragments
+// passing the depth test; only taken with options.passStats, and never when target is 0
+class QueryCounter
+{
+	unsigned int target, query;
+
+public:
+	QueryCounter(unsigned int target = 0) : target(target) { query = 0; }
+
+	~QueryCounter() { if (query) glDeleteQueries(1, &query); }
+
+	void SetTarget(unsigned int t) { target = t; }
+
+	bool IsAvailable() { return target != 0; }
+
+	void Begin()
+	{
+		if (!options.passStats || !target) return;
+		if (!query) glGenQueries(1, &query);
+		glBeginQuery(target, query);
+	}
+
+	unsigned int End()
+	{
+		if (!options.passStats || !target) return 0;
+		glEndQuery(target);
+		unsigned int result = 0;
+		glGetQueryObjectuiv(query, GL_QUERY_RESULT, &result);
+		return result;
+	}
+};
+
+// one opaque draw, ordered by the view depth of its object
+struct DrawPacket
+{
+	Object* object;
+	float depth;
+
+	bool operator<(const DrawPacket& p) const { return depth < p.depth; }
+};
+
+// hardware occlusion culling with one frame of latency. Objects are bucketed by a
+// world grid into groups; a group whose box was hidden last frame skips all of its
+// objects, and inside a visible group every object goes by its own last result.
+// Boxes include the projected shadow, are queried after the opaque pass and read
+// back only once available, so the CPU never waits on them; visible nodes are
+// re-tested every few frames only.
+class OcclusionCuller
+{
+	struct Node
+	{
+		BoundingBox box;
+		unsigned int query;
+		bool pending, visible;
+		int lastTested;
+
+		Node() { query = 0; pending = false; visible = true; lastTested = -1000; }
+	};
+
+	struct Group
+	{
+		Node node;
+		std::vector<int> members;
+	};
+
+	std::vector<Node> objectNodes;
+	std::vector<Group*> objectGroups;
+	std::map<std::pair<int, int>, Group> groups;
+	DepthShader* boxShader;
+	unsigned int boxVao, boxVbo;
+	float cellSize;
+	int retestInterval, frame;
+
+	// true when the result of the node's last query is in; never blocks
+	bool Collect(Node& node)
+	{
+		if (!node.pending) return false;
+		unsigned int available = 0;
+		glGetQueryObjectuiv(node.query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) return false;
+		unsigned int samples = 0;
+		glGetQueryObjectuiv(node.query, GL_QUERY_RESULT, &samples);
+		node.pending = false;
+		node.visible = samples > 0;
+		return true;
+	}
+
+	// a box around the eye would be clipped by the near plane and wrongly come out hidden
+	bool ContainsEye(const BoundingBox& box, vec3& eye)
+	{
+		float margin = camera.GetNearPlane() * 4.0f;
+		return eye.x >= box.min.x - margin && eye.x <= box.max.x + margin && eye.y >= box.min.y - margin
+			&& eye.y <= box.max.y + margin && eye.z >= box.min.z - margin && eye.z <= box.max.z + margin;
+	}
+
+	bool NeedsTest(Node& node)
+	{
+		return !node.pending && (!node.visible || frame - node.lastTested >= retestInterval);
+	}
+
+	void Test(Node& node, mat4& VP)
+	{
+		if (!node.query) glGenQueries(1, &node.query);
+		vec3 size = node.box.max - node.box.min;
+		mat4 M = mat4(
+			size.x,				0.0,				0.0,				0.0,
+			0.0,				size.y,				0.0,				0.0,
+			0.0,				0.0,				size.z,				0.0,
+			node.box.min.x,		node.box.min.y,		node.box.min.z,		1.0);
+		mat4 MVP = M * VP;
+		boxShader->UploadMVP(MVP);
+		glBeginQuery(GL_SAMPLES_PASSED, node.query);
+		glDrawArrays(GL_TRIANGLES, 0, 36);
+		glEndQuery(GL_SAMPLES_PASSED);
+		node.pending = true;
+		node.lastTested = frame;
+		queries++;
+	}
+
+public:
+	int culled, queries;	// last frame
+
+	OcclusionCuller(float cellSize = 4.0, int retestInterval = 4) : cellSize(cellSize), retestInterval(retestInterval)
+	{
+		frame = 0;
+		culled = queries = 0;
+		boxShader = new DepthShader();
+
+		// unit cube, two triangles per face
+		static const int faces[6][4] = {
+			{ 0, 2, 6, 4 }, { 1, 5, 7, 3 }, { 0, 4, 5, 1 }, { 2, 3, 7, 6 }, { 0, 1, 3, 2 }, { 4, 6, 7, 5 } };
+		float vertices[36 * 3];
+		for (int f = 0; f < 6; f++)
+		{
+			int corners[6] = { faces[f][0], faces[f][1], faces[f][2], faces[f][0], faces[f][2], faces[f][3] };
+			for (int k = 0; k < 6; k++)
+			{
+				vertices[(f * 6 + k) * 3] = corners[k] & 1 ? 1.0f : 0.0f;
+				vertices[(f * 6 + k) * 3 + 1] = corners[k] & 2 ? 1.0f : 0.0f;
+				vertices[(f * 6 + k) * 3 + 2] = corners[k] & 4 ? 1.0f : 0.0f;
+			}
+		}
+		glGenVertexArrays(1, &boxVao);
+		glBindVertexArray(boxVao);
+		glGenBuffers(1, &boxVbo);
+		glBindBuffer(GL_ARRAY_BUFFER, boxVbo);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+	}
+
+	~OcclusionCuller()
+	{
+		for (unsigned int i = 0; i < objectNodes.size(); i++) if (objectNodes[i].query) glDeleteQueries(1, &objectNodes[i].query);
+		for (std::map<std::pair<int, int>, Group>::iterator g = groups.begin(); g != groups.end(); g++)
+			if (g->second.node.query) glDeleteQueries(1, &g->second.node.query);
+		glDeleteBuffers(1, &boxVbo);
+		glDeleteVertexArrays(1, &boxVao);
+		delete boxShader;
+	}
+
+	// picks up last frame's results and regroups the objects at their current place
+	void Update(std::vector<Object*>& objects)
+	{
+		frame++;
+		culled = queries = 0;
+		objectNodes.resize(objects.size());
+		objectGroups.assign(objects.size(), (Group*)0);
+
+		for (std::map<std::pair<int, int>, Group>::iterator g = groups.begin(); g != groups.end(); g++)
+		{
+			Group& group = g->second;
+			bool wasVisible = group.node.visible;
+			// members were not tested while their group was hidden
+			if (Collect(group.node) && !wasVisible && group.node.visible)
+				for (unsigned int j = 0; j < group.members.size(); j++) objectNodes[group.members[j]].visible = true;
+			group.members.clear();
+			group.node.box = BoundingBox();
+		}
+
+		for (unsigned int i = 0; i < objects.size(); i++)
+		{
+			Node& node = objectNodes[i];
+			Collect(node);
+			// an object stays if only its shadow shows
+			node.box = objects[i]->GetShadowedBounds();
+			if (node.box.IsEmpty()) continue;
+			vec3 center = node.box.GetCenter();
+			Group& group = groups[std::make_pair((int)floor(center.x / cellSize), (int)floor(center.z / cellSize))];
+			group.members.push_back(i);
+			group.node.box.Extend(node.box);
+			objectGroups[i] = &group;
+		}
+
+		for (std::map<std::pair<int, int>, Group>::iterator g = groups.begin(); g != groups.end(); g++)
+		{
+			Group& group = g->second;
+			if (!group.members.empty() && ContainsEye(group.node.box, camera.wEye)) group.node.visible = true;
+			for (unsigned int j = 0; j < group.members.size(); j++)
+			{
+				Node& node = objectNodes[group.members[j]];
+				// single objects are decided by their group alone
+				if (group.members.size() == 1 || ContainsEye(node.box, camera.wEye)) node.visible = group.node.visible;
+				if (!IsVisible(group.members[j])) culled++;
+			}
+		}
+	}
+
+	bool IsVisible(int i)
+	{
+		if (i >= objectGroups.size() || !objectGroups[i]) return true;
+		return objectGroups[i]->node.visible && objectNodes[i].visible;
+	}
+
+	// box queries against the finished depth buffer, without touching color or depth
+	void IssueQueries()
+	{
+		mat4 VP = camera.GetViewMatrix() * camera.GetProjectionMatrix();
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		glDepthMask(GL_FALSE);
+		glEnable(GL_DEPTH_TEST);
+		boxShader->Run();
+		glBindVertexArray(boxVao);
+
+		for (std::map<std::pair<int, int>, Group>::iterator g = groups.begin(); g != groups.end(); g++)
+		{
+			Group& group = g->second;
+			if (group.members.empty()) continue;
+			if (NeedsTest(group.node)) Test(group.node, VP);
+			if (!group.node.visible || group.members.size() == 1) continue;
+			for (unsigned int j = 0; j < group.members.size(); j++)
+			{
+				Node& node = objectNodes[group.members[j]];
+				if (NeedsTest(node)) Test(node, VP);
+			}
+		}
+
+		glDisable(GL_DEPTH_TEST);
+		glDepthMask(GL_TRUE);
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	}
+};
+
+// a mesh rendered once, orthographically, from azimuths x elevations directions around its
+// bounding sphere: the texture and coverage into one atlas, the object space normals into
+// another, a cell per view. The views face the sphere's center from azimuths around y at
+// elevations from the horizon up in steps of 90 / elevations degrees, as the IMPOSTER
+// variants pick them.
+class ImposterAtlas
+{
+	class BakeShader : public Shader
+	{
+	public:
+		BakeShader()
+		{
+			const char *vertexSource = "\n\
+            #version 130 \n\
+            precision highp float; \n\
+            \n\
+            in vec3 vertexPosition; \n\
+            in vec2 vertexTexCoord; \n\
+            in vec3 vertexNormal; \n\
+            uniform mat4 MVP; \n\
+            out vec2 texCoord; \n\
+            out vec3 objectNormal; \n\
+            \n\
+            void main() { \n\
+            texCoord = vertexTexCoord; \n\
+            objectNormal = vertexNormal; \n\
+            gl_Position = vec4(vertexPosition, 1) * MVP; \n\
+            }";
+
+			const char *fragmentSource = "\n\
+            #version 130 \n\
+            precision highp float; \n\
+            \n\
+            uniform sampler2D samplerUnit; \n\
+            in vec2 texCoord; \n\
+            in vec3 objectNormal; \n\
+            out vec4 color; \n\
+            out vec4 normal; \n\
+            \n\
+            void main() { \n\
+            color = vec4(texture(samplerUnit, texCoord).rgb, 1); \n\
+            normal = vec4(normalize(objectNormal) * 0.5 + 0.5, 1); \n\
+            }";
+
+			std::vector<std::string> outputs;
+			outputs.push_back("color");
+			outputs.push_back("normal");
+			CompileProgram("imposter bake", vertexSource, fragmentSource, "", outputs);
+		}
+
+		void UploadMVP(mat4& MVP)
+		{
+			int location = glGetUniformLocation(shaderProgram, "MVP");
+			if (location >= 0) glUniformMatrix4fv(location, 1, GL_TRUE, MVP);
+			else printf("uniform MVP cannot be set\n");
+		}
+
+		void UploadSamplerID()
+		{
+			int location = glGetUniformLocation(shaderProgram, "samplerUnit");
+			if (location >= 0) glUniform1i(location, 0);
+			glActiveTexture(GL_TEXTURE0);
+		}
+	};
+
+	unsigned int textures[2];	// color and coverage, normals
+	vec4 sphere;
+	Material* material;
+
+	// the sphere into the unit cube, seen from azimuth and elevation
+	mat4 ViewMatrix(float azimuth, float elevation)
+	{
+		vec3 center(sphere.x, sphere.y, sphere.z);
+		vec3 w(cosf(elevation) * cosf(azimuth), sinf(elevation), cosf(elevation) * sinf(azimuth));
+		vec3 u = fabsf(w.y) > 0.999f ? vec3(1.0f, 0.0f, 0.0f) : cross(vec3(0.0f, 1.0f, 0.0f), w).normalize();
+		vec3 v = cross(w, u);
+		float s = 1.0f / sphere.w;
+		return mat4(u.x * s, v.x * s, -w.x * s, 0.0f,
+			u.y * s, v.y * s, -w.y * s, 0.0f,
+			u.z * s, v.z * s, -w.z * s, 0.0f,
+			-dot(center, u) * s, -dot(center, v) * s, dot(center, w) * s, 1.0f);
+	}
+
+public:
+	static const int azimuths = 8, elevations = 2, cellSize = 128;
+
+	// the mesh is count indices from firstIndex of vao, drawn with material's texture
+	ImposterAtlas(Material* material, const BoundingBox& bounds, unsigned int vao, unsigned int count, unsigned int firstIndex)
+	{
+		this->material = material;
+		vec3 center = bounds.GetCenter(), max = bounds.max;
+		sphere = vec4(center.x, center.y, center.z, std::max((max - center).length(), 1e-6f));
+
+		int width = azimuths * cellSize, height = elevations * cellSize;
+		int previous, viewport[4];
+		glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+		glGetIntegerv(GL_VIEWPORT, viewport);
+
+		unsigned int fbo, depth;
+		glGenFramebuffers(1, &fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		glGenTextures(2, &textures[0]);
+		for (int i = 0; i < 2; i++)
+		{
+			glBindTexture(GL_TEXTURE_2D, textures[i]);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			// cells of 8 texels at the smallest, before the neighbours bleed in
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 4);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, textures[i], 0);
+		}
+		glGenRenderbuffers(1, &depth);
+		glBindRenderbuffer(GL_RENDERBUFFER, depth);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) printf("imposter atlas is incomplete\n");
+
+		unsigned int buffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+		glDrawBuffers(2, buffers);
+		float zero[4] = { 0, 0, 0, 0 };
+		float farDepth = 1.0;
+		glClearBufferfv(GL_COLOR, 0, zero);
+		glClearBufferfv(GL_COLOR, 1, zero);
+		glClearBufferfv(GL_DEPTH, 0, &farDepth);
+
+		BakeShader shader;
+		shader.Run();
+		material->UploadAttributes(&shader);
+		glEnable(GL_DEPTH_TEST);
+		glBindVertexArray(vao);
+		for (int j = 0; j < elevations; j++)
+			for (int k = 0; k < azimuths; k++)
+			{
+				mat4 MVP = ViewMatrix(k * 2.0f * (float)M_PI / azimuths, j * 0.5f * (float)M_PI / elevations);
+				shader.UploadMVP(MVP);
+				glViewport(k * cellSize, j * cellSize, cellSize, cellSize);
+				glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, (void*)(firstIndex * sizeof(unsigned int)));
+			}
+		glBindVertexArray(0);
+		glDisable(GL_DEPTH_TEST);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, previous);
+		glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+		glDeleteRenderbuffers(1, &depth);
+		glDeleteFramebuffers(1, &fbo);
+		for (int i = 0; i < 2; i++)
+		{
+			glBindTexture(GL_TEXTURE_2D, textures[i]);
+			glGenerateMipmap(GL_TEXTURE_2D);
+		}
+	}
+
+	~ImposterAtlas()
+	{
+		glDeleteTextures(2, &textures[0]);
+	}
+
+	// with the mipmaps
+	long long GetBytes() { return 2LL * azimuths * cellSize * elevations * cellSize * 4 * 4 / 3; }
+
+	// material and atlas into an IMPOSTER variant, the normals on normalUnit
+	void Bind(Shader* shader, bool materials, int normalUnit)
+	{
+		if (materials) material->UploadAttributes(shader);
+		shader->UploadImposterAtlas(sphere, azimuths, elevations, normalUnit);
+		shader->UploadSamplerID();
+		glBindTexture(GL_TEXTURE_2D, textures[0]);
+		glActiveTexture(GL_TEXTURE0 + normalUnit);
+		glBindTexture(GL_TEXTURE_2D, textures[1]);
+		glActiveTexture(GL_TEXTURE0);
+	}
+};
+
+// GPU-driven submission of every object whose geometry has an IndexedMesh. All meshes share
+// one vertex and one index buffer, the model matrices live in a float texture (8 texels per
+// object: the columns of M and InvM, read by the INSTANCE_DATA shader variants) and each
+// object owns one indirect draw command, grouped by material. With GL 4.3 a compute pass
+// tests the objects' shadowed bounding spheres against the frustum, picks a LOD by distance
+// over radius and writes the commands, and each material is one glMultiDrawElementsIndirect.
+// Older contexts run the same test on the CPU and draw the visible objects one by one with
+// the object index as a constant vertex attribute. Indices are stored absolute, so neither
+// path needs base vertex draws. With options.textureArrays the materials of one shader whose
+// textures have the same size share a batch: the textures become the layers of a
+// TextureArray and the material attributes and layer move into a second float texture
+// (4 texels per object, read by the TEXTURE_ARRAY shader variants). With options.imposters
+// every mesh gets an ImposterAtlas while loading, and objects beyond options.imposters from
+// the eye drop out of the commands; they are drawn as quads, an instanced draw per mesh, from
+// a list of object indices the CPU rebuilds each frame. Over the quarter beyond that distance
+// both are drawn and the IMPOSTER_FADE and IMPOSTER variants dither one into the other. The
+// fade goes by the objects' origins; the compute pass, which only has the spheres, keeps
+// the commands of every sphere that reaches inside the fade's end.
+class GpuScene
+{
+	struct Command
+	{
+		unsigned int count, instanceCount, firstIndex;
+		int baseVertex;
+		unsigned int baseInstance;
+	};
+
+	struct Batch
+	{
+		Material* material;		// the first material of a TextureArray batch
+		TextureArray* array;	// 0 without texture arrays
+		int first, count;
+	};
+
+	static const int objectsPerRow = ClusteredLights::rowLength / 8;
+	static const int objectDataUnit = 9;	// after the light and G-buffer textures
+	static const int materialDataUnit = 10;
+	static const int imposterNormalUnit = 11;
+
+	std::vector<Object*> drawObjects;		// in command order
+	std::vector<unsigned int> drawMeshes;	// mesh of each command
+	std::vector<char> batched;				// per scene object
+	std::vector<unsigned int> lods;			// per mesh and LOD: count, first index, 0, 0
+	std::vector<Batch> batches;
+	std::vector<float> objectData;
+	std::vector<TextureArray*> arrays;
+	std::vector<float> spheres;				// shadowed bounds: center, radius
+	std::vector<int> versions;				// transform versions of the uploaded matrices
+	std::vector<Command> commands;			// CPU culling only
+	float lodDistances[2];
+	bool compute;
+	std::vector<BoundingBox> meshBounds;	// per mesh, in object space
+	std::vector<ImposterAtlas*> atlases;		// per mesh, empty without imposters
+	std::vector<unsigned int> imposterObjects;	// this frame's, grouped by mesh
+	std::vector<int> imposterFirst;				// per mesh, into imposterObjects, and the end
+	float imposterStart, imposterEnd;
+	vec3 eye;
+
+	unsigned int vao, vertexBuffer, indexBuffer, objectIndexBuffer, objectTexture, materialTexture;
+	unsigned int sphereBuffer, meshBuffer, lodBuffer, commandBuffer, cullProgram;
+	unsigned int imposterVao, imposterBuffer;
+
+	static const char *CullSource()
+	{
+		return "\n\
+        #version 430 \n\
+        layout(local_size_x = 64) in; \n\
+        struct Command { uint count, instanceCount, firstIndex; int baseVertex; uint baseInstance; }; \n\
+        layout(std430, binding = 0) readonly buffer Spheres { vec4 spheres[]; }; \n\
+        layout(std430, binding = 1) readonly buffer Meshes { uint meshes[]; }; \n\
+        layout(std430, binding = 2) readonly buffer Lods { uvec4 lods[]; }; \n\
+        layout(std430, binding = 3) writeonly buffer Commands { Command commands[]; }; \n\
+        uniform vec4 frustum[6]; \n\
+        uniform vec3 eye; \n\
+        uniform vec2 lodDistances; \n\
+        uniform float imposterEnd; \n\
+        uniform uint objectCount; \n\
+        \n\
+        void main() { \n\
+        uint i = gl_GlobalInvocationID.x; \n\
+        if (i >= objectCount) return; \n\
+        vec4 sphere = spheres[i]; \n\
+        bool visible = true; \n\
+        for (int p = 0; p < 6; p++) visible = visible && dot(frustum[p].xyz, sphere.xyz) + frustum[p].w >= -sphere.w; \n\
+        visible = visible && length(sphere.xyz - eye) - sphere.w < imposterEnd; \n\
+        float distance = length(sphere.xyz - eye) / sphere.w; \n\
+        uint lod = distance > lodDistances.y ? 2u : (distance > lodDistances.x ? 1u : 0u); \n\
+        uvec4 range = lods[meshes[i] * 3u + lod]; \n\
+        commands[i] = Command(range.x, visible ? 1u : 0u, range.y, 0, i); \n\
+        }";
+	}
+
+	void Place(int i)
+	{
+		Object* object = drawObjects[i];
+		mat4 M = object->GetModelMatrix(), InvM = object->GetInverseModelMatrix();
+		float* data = &objectData[i * 32];
+		for (int column = 0; column < 4; column++)
+			for (int row = 0; row < 4; row++)
+			{
+				data[column * 4 + row] = M.m[row][column];
+				data[16 + column * 4 + row] = InvM.m[row][column];
+			}
+
+		BoundingBox box = object->GetShadowedBounds();
+		vec3 center = box.GetCenter();
+		float sphere[4] = { center.x, center.y, center.z, (box.max - center).length() };
+		std::copy(sphere, sphere + 4, &spheres[i * 4]);
+		versions[i] = object->GetTransformVersion();
+	}
+
+	// from the eye to the object's origin, as the IMPOSTER variants measure it to fade
+	float GetOriginDistance(int i)
+	{
+		float* data = &objectData[i * 32];
+		return (vec3(data[3], data[7], data[11]) - eye).length();
+	}
+
+	void AddMesh(IndexedMesh* mesh, std::vector<float>& vertices, std::vector<unsigned int>& indices)
+	{
+		unsigned int base = (unsigned int)(vertices.size() / IndexedMesh::vertexSize);
+		vertices.insert(vertices.end(), mesh->vertices.begin(), mesh->vertices.end());
+		meshBounds.push_back(mesh->bounds);
+		for (int lod = 0; lod < IndexedMesh::lodCount; lod++)
+		{
+			unsigned int range[4] = { (unsigned int)mesh->lods[lod].size(), (unsigned int)indices.size(), 0, 0 };
+			lods.insert(lods.end(), range, range + 4);
+			for (unsigned int i = 0; i < mesh->lods[lod].size(); i++) indices.push_back(base + mesh->lods[lod][i]);
+		}
+	}
+
+public:
+	int drawCalls, visibleObjects;	// visibleObjects is -1 when the GPU culled and nobody asked
+	long long triangles;			// drawn from the commands, -1 like visibleObjects
+	double imposterBakeTime;
+
+	GpuScene(std::vector<Object*>& objects, bool useCompute)
+	{
+		compute = useCompute;
+		drawCalls = 0;
+		visibleObjects = -1;
+		triangles = -1;
+		imposterBakeTime = 0.0;
+		lodDistances[0] = options.gpuLod ? 20.0f : 1e30f;
+		lodDistances[1] = options.gpuLod ? 60.0f : 1e30f;
+		imposterStart = options.imposters > 0.0f ? options.imposters : 1e30f;
+		imposterEnd = options.imposters > 0.0f ? 1.25f * options.imposters : 1e30f;
+
+		// commands grouped by material (or texture array), in order of first use
+		std::map<Geometry*, unsigned int> meshIds;
+		std::map<Material*, int> materialIds;
+		std::vector<std::vector<int> > members;
+		std::vector<std::vector<Texture*> > layers;
+		std::vector<Material*> meshMaterials;	// of the mesh's first object
+		std::vector<float> vertices;
+		std::vector<unsigned int> indices;
+		batched.assign(objects.size(), 0);
+		for (unsigned int i = 0; i < objects.size(); i++)
+		{
+			Mesh* mesh = objects[i]->GetMesh();
+			Material* material = mesh->GetMaterial();
+			IndexedMesh* indexed = mesh->GetGeometry()->GetIndexedMesh();
+			// one material per command, so meshes with material ranges stay per object
+			if (!indexed || indexed->lods[0].empty() || !mesh->GetGeometry()->GetMaterialRanges().empty()) continue;
+			if (options.textureArrays && !material->GetTexture()) continue;
+			if (meshIds.find(mesh->GetGeometry()) == meshIds.end())
+			{
+				meshIds[mesh->GetGeometry()] = (unsigned int)(lods.size() / (4 * IndexedMesh::lodCount));
+				AddMesh(indexed, vertices, indices);
+				meshMaterials.push_back(material);
+			}
+			if (materialIds.find(material) == materialIds.end())
+			{
+				int batch = -1;
+				for (int b = 0; options.textureArrays && b < batches.size() && batch < 0; b++)
+				{
+					Texture* first = layers[b][0];
+					if (batches[b].material->GetShader() == material->GetShader() && first->GetWidth() == material->GetTexture()->GetWidth() &&
+						first->GetHeight() == material->GetTexture()->GetHeight()) batch = b;
+				}
+				if (batch < 0)
+				{
+					batch = (int)batches.size();
+					Batch added = { material, 0, 0, 0 };
+					batches.push_back(added);
+					members.push_back(std::vector<int>());
+					layers.push_back(std::vector<Texture*>());
+				}
+				materialIds[material] = batch;
+				if (std::find(layers[batch].begin(), layers[batch].end(), material->GetTexture()) == layers[batch].end())
+					layers[batch].push_back(material->GetTexture());
+			}
+			members[materialIds[material]].push_back(i);
+			batched[i] = 1;
+		}
+		for (unsigned int b = 0; b < batches.size(); b++)
+		{
+			if (options.textureArrays)
+			{
+				arrays.push_back(new TextureArray(layers[b]));
+				batches[b].array = arrays.back();
+			}
+			batches[b].first = (int)drawObjects.size();
+			batches[b].count = (int)members[b].size();
+			for (unsigned int j = 0; j < members[b].size(); j++)
+			{
+				drawObjects.push_back(objects[members[b][j]]);
+				drawMeshes.push_back(meshIds[objects[members[b][j]]->GetMesh()->GetGeometry()]);
+			}
+		}
+
+		int count = (int)drawObjects.size();
+		int rows = std::max(1, (count + objectsPerRow - 1) / objectsPerRow);
+		objectData.assign(rows * ClusteredLights::rowLength * 4, 0.0f);
+		spheres.resize(count * 4);
+		versions.resize(count);
+		commands.resize(count);
+		for (int i = 0; i < count; i++) Place(i);
+
+		glGenTextures(1, &objectTexture);
+		glBindTexture(GL_TEXTURE_2D, objectTexture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, ClusteredLights::rowLength, rows, 0, GL_RGBA, GL_FLOAT, &objectData[0]);
+
+		// ambient and layer, diffuse and shininess, specular
+		materialTexture = 0;
+		if (!arrays.empty())
+		{
+			const int materialsPerRow = ClusteredLights::rowLength / 4;
+			std::vector<float> materialData(std::max(1, (count + materialsPerRow - 1) / materialsPerRow) * ClusteredLights::rowLength * 4, 0.0f);
+			for (unsigned int b = 0; b < batches.size(); b++)
+				for (int i = batches[b].first; i < batches[b].first + batches[b].count; i++)
+				{
+					Material* material = drawObjects[i]->GetMesh()->GetMaterial();
+					vec3 ka, kd, ks;
+					float shininess;
+					material->GetAttributes(ka, kd, ks, shininess);
+					float texels[12] = { ka.x, ka.y, ka.z, (float)batches[b].array->GetLayer(material->GetTexture()),
+						kd.x, kd.y, kd.z, shininess, ks.x, ks.y, ks.z, 0.0f };
+					std::copy(texels, texels + 12, &materialData[i * 16]);
+				}
+			glGenTextures(1, &materialTexture);
+			glBindTexture(GL_TEXTURE_2D, materialTexture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, ClusteredLights::rowLength, (int)materialData.size() / (ClusteredLights::rowLength * 4), 0,
+				GL_RGBA, GL_FLOAT, &materialData[0]);
+		}
+
+		unsigned int buffers[3];
+		glGenBuffers(3, &buffers[0]);
+		vertexBuffer = buffers[0]; indexBuffer = buffers[1]; objectIndexBuffer = buffers[2];
+
+		glGenVertexArrays(1, &vao);
+		glBindVertexArray(vao);
+		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, std::max((int)vertices.size(), 1) * sizeof(float), vertices.empty() ? 0 : &vertices[0], GL_STATIC_DRAW);
+		int stride = IndexedMesh::vertexSize * sizeof(float);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (void*)(5 * sizeof(float)));
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, std::max((int)indices.size(), 1) * sizeof(unsigned int), indices.empty() ? 0 : &indices[0], GL_STATIC_DRAW);
+
+		sphereBuffer = meshBuffer = lodBuffer = commandBuffer = cullProgram = 0;
+#if defined(GL_COMPUTE_SHADER)
+		if (compute && count > 0)
+		{
+			// object index = baseInstance of the command, through a per instance attribute
+			std::vector<unsigned int> objectIndices(count);
+			for (int i = 0; i < count; i++) objectIndices[i] = i;
+			glBindBuffer(GL_ARRAY_BUFFER, objectIndexBuffer);
+			glBufferData(GL_ARRAY_BUFFER, count * sizeof(unsigned int), &objectIndices[0], GL_STATIC_DRAW);
+			glEnableVertexAttribArray(3);
+			glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, 0, (void*)0);
+			glVertexAttribDivisor(3, 1);
+
+			glGenBuffers(1, &sphereBuffer);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, sphereBuffer);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, count * 4 * sizeof(float), &spheres[0], GL_DYNAMIC_DRAW);
+			glGenBuffers(1, &meshBuffer);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, meshBuffer);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(unsigned int), &drawMeshes[0], GL_STATIC_DRAW);
+			glGenBuffers(1, &lodBuffer);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, lodBuffer);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, lods.size() * sizeof(unsigned int), &lods[0], GL_STATIC_DRAW);
+			glGenBuffers(1, &commandBuffer);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(Command), NULL, GL_DYNAMIC_DRAW);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+			cullProgram = shaderManager.GetComputeProgram("cull", CullSource());
+		}
+#endif
+		compute = cullProgram != 0;
+		glBindVertexArray(0);
+
+		// the atlases from the full LODs, and the object indices of the quads as a per instance attribute
+		imposterVao = imposterBuffer = 0;
+		if (options.imposters > 0.0f && count > 0)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (unsigned int m = 0; m < meshBounds.size(); m++)
+			{
+				unsigned int* range = &lods[m * IndexedMesh::lodCount * 4];
+				atlases.push_back(new ImposterAtlas(meshMaterials[m], meshBounds[m], vao, range[0], range[1]));
+			}
+			glFinish();
+			imposterBakeTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			glGenVertexArrays(1, &imposterVao);
+			glBindVertexArray(imposterVao);
+			glGenBuffers(1, &imposterBuffer);
+			glBindBuffer(GL_ARRAY_BUFFER, imposterBuffer);
+			glEnableVertexAttribArray(3);
+			glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, 0, (void*)0);
+			glVertexAttribDivisor(3, 1);
+			glBindVertexArray(0);
+			imposterFirst.assign(atlases.size() + 1, 0);
+		}
+	}
+
+	~GpuScene()
+	{
+		unsigned int buffers[8] = { vertexBuffer, indexBuffer, objectIndexBuffer, sphereBuffer, meshBuffer, lodBuffer, commandBuffer, imposterBuffer };
+		glDeleteBuffers(8, &buffers[0]);
+		for (unsigned int i = 0; i < atlases.size(); i++) delete atlases[i];
+		if (imposterVao) glDeleteVertexArrays(1, &imposterVao);
+		glDeleteTextures(1, &objectTexture);
+		if (materialTexture) glDeleteTextures(1, &materialTexture);
+		for (unsigned int i = 0; i < arrays.size(); i++) delete arrays[i];
+		glDeleteVertexArrays(1, &vao);
+	}
+
+	bool IsBatched(int i) { return i < batched.size() && batched[i]; }
+
+	bool UsesCompute() { return compute; }
+
+	int GetObjectCount() { return (int)drawObjects.size(); }
+
+	bool HasImposters() { return !atlases.empty(); }
+
+	int GetImposterCount() { return (int)imposterObjects.size(); }
+
+	long long GetAtlasBytes() { return atlases.empty() ? 0 : atlases.size() * atlases[0]->GetBytes(); }
+
+	// uploads the objects that moved since the last frame and culls for this camera
+	void Update(mat4& VP, vec3& eye)
+	{
+		int count = (int)drawObjects.size();
+		if (count == 0) return;
+		this->eye = eye;
+
+		int first = count, last = -1;
+		for (int i = 0; i < count; i++)
+		{
+			if (versions[i] == drawObjects[i]->GetTransformVersion()) continue;
+			Place(i);
+			first = std::min(first, i);
+			last = i;
+		}
+		if (last >= 0)
+		{
+			int firstRow = first / objectsPerRow, lastRow = last / objectsPerRow;
+			glBindTexture(GL_TEXTURE_2D, objectTexture);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, firstRow, ClusteredLights::rowLength, lastRow - firstRow + 1, GL_RGBA, GL_FLOAT,
+				&objectData[firstRow * ClusteredLights::rowLength * 4]);
+#if defined(GL_COMPUTE_SHADER)
+			if (compute)
+			{
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, sphereBuffer);
+				glBufferSubData(GL_SHADER_STORAGE_BUFFER, first * 4 * sizeof(float), (last - first + 1) * 4 * sizeof(float), &spheres[first * 4]);
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+			}
+#endif
+		}
+
+		Frustum frustum(VP);
+		if (!atlases.empty()) UpdateImposters(frustum);
+#if defined(GL_COMPUTE_SHADER)
+		if (compute)
+		{
+			glUseProgram(cullProgram);
+			glUniform4fv(glGetUniformLocation(cullProgram, "frustum"), 6, &frustum.planes[0][0]);
+			glUniform3f(glGetUniformLocation(cullProgram, "eye"), eye.x, eye.y, eye.z);
+			glUniform2f(glGetUniformLocation(cullProgram, "lodDistances"), lodDistances[0], lodDistances[1]);
+			glUniform1f(glGetUniformLocation(cullProgram, "imposterEnd"), imposterEnd);
+			glUniform1ui(glGetUniformLocation(cullProgram, "objectCount"), count);
+			unsigned int bindings[4] = { sphereBuffer, meshBuffer, lodBuffer, commandBuffer };
+			for (int b = 0; b < 4; b++) glBindBufferBase(GL_SHADER_STORAGE_BUFFER, b, bindings[b]);
+			glDispatchCompute((count + 63) / 64, 1, 1);
+			glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+			drawCalls = (int)batches.size();
+
+			// counting the survivors means waiting for the GPU
+			visibleObjects = -1;
+			triangles = -1;
+			if (options.passStats)
+			{
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+				Command* result = (Command*)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(Command), GL_MAP_READ_BIT);
+				visibleObjects = 0;
+				triangles = 0;
+				for (int i = 0; result && i < count; i++)
+				{
+					visibleObjects += result[i].instanceCount;
+					triangles += result[i].instanceCount * result[i].count / 3;
+				}
+				glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+			}
+			return;
+		}
+#endif
+		visibleObjects = 0;
+		triangles = 0;
+		for (int i = 0; i < count; i++)
+		{
+			float* sphere = &spheres[i * 4];
+			vec3 center = vec3(sphere[0], sphere[1], sphere[2]);
+			Command& command = commands[i];
+			command.instanceCount = frustum.IntersectsSphere(center, sphere[3]) && GetOriginDistance(i) < imposterEnd * 1.001f ? 1 : 0;
+			visibleObjects += command.instanceCount;
+
+			float distance = (center - eye).length() / sphere[3];
+			int lod = distance > lodDistances[1] ? 2 : (distance > lodDistances[0] ? 1 : 0);
+			unsigned int* range = &lods[(drawMeshes[i] * IndexedMesh::lodCount + lod) * 4];
+			command.count = range[0];
+			command.firstIndex = range[1];
+			triangles += command.instanceCount * command.count / 3;
+		}
+		drawCalls = visibleObjects;
+	}
+
+	// the objects in the frustum whose origin is past imposterStart, by mesh, with some slack
+	// for the shaders' rounding: where the fade is 0 an imposter only costs its discards
+	void UpdateImposters(Frustum& frustum)
+	{
+		int count = (int)drawObjects.size();
+		imposterObjects.clear();
+		std::fill(imposterFirst.begin(), imposterFirst.end(), 0);
+		std::vector<char> selected(count, 0);
+		for (int i = 0; i < count; i++)
+		{
+			float* sphere = &spheres[i * 4];
+			vec3 center = vec3(sphere[0], sphere[1], sphere[2]);
+			if (GetOriginDistance(i) <= imposterStart * 0.999f || !frustum.IntersectsSphere(center, sphere[3])) continue;
+			selected[i] = 1;
+			imposterFirst[drawMeshes[i] + 1]++;
+		}
+		for (unsigned int m = 1; m < imposterFirst.size(); m++) imposterFirst[m] += imposterFirst[m - 1];
+		imposterObjects.resize(imposterFirst.back());
+		std::vector<int> next(imposterFirst.begin(), imposterFirst.end() - 1);
+		for (int i = 0; i < count; i++) if (selected[i]) imposterObjects[next[drawMeshes[i]]++] = i;
+
+		glBindBuffer(GL_ARRAY_BUFFER, imposterBuffer);
+		glBufferData(GL_ARRAY_BUFFER, std::max((int)imposterObjects.size(), 1) * sizeof(unsigned int),
+			imposterObjects.empty() ? 0 : &imposterObjects[0], GL_STREAM_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	// shader must be an INSTANCE_DATA variant (and TEXTURE_ARRAY with texture arrays) and
+	// already running with its per frame uniforms; materials: upload each batch's material
+	// or texture array into it
+	void Draw(Shader* shader, bool materials)
+	{
+		if (drawObjects.empty()) return;
+		if (!atlases.empty()) shader->UploadImposterFade(eye, imposterStart, imposterEnd);
+		shader->UploadObjectData(objectDataUnit);
+		glActiveTexture(GL_TEXTURE0 + objectDataUnit);
+		glBindTexture(GL_TEXTURE_2D, objectTexture);
+		if (materials && materialTexture)
+		{
+			shader->UploadMaterialData(materialDataUnit);
+			glActiveTexture(GL_TEXTURE0 + materialDataUnit);
+			glBindTexture(GL_TEXTURE_2D, materialTexture);
+		}
+		glActiveTexture(GL_TEXTURE0);
+
+		glEnable(GL_DEPTH_TEST);
+		glBindVertexArray(vao);
+#if defined(GL_COMPUTE_SHADER)
+		if (compute) glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+#endif
+		for (unsigned int b = 0; b < batches.size(); b++)
+		{
+			if (materials && batches[b].array)
+			{
+				shader->UploadSamplerID();
+				batches[b].array->Bind();
+			}
+			else if (materials) batches[b].material->UploadAttributes(shader);
+#if defined(GL_COMPUTE_SHADER)
+			if (compute)
+			{
+				glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(batches[b].first * sizeof(Command)),
+					batches[b].count, 0);
+				continue;
+			}
+#endif
+			for (int i = batches[b].first; i < batches[b].first + batches[b].count; i++)
+			{
+				if (!commands[i].instanceCount) continue;
+				glVertexAttribI1ui(3, i);
+				glDrawElements(GL_TRIANGLES, commands[i].count, GL_UNSIGNED_INT, (void*)(commands[i].firstIndex * sizeof(unsigned int)));
+			}
+		}
+#if defined(GL_COMPUTE_SHADER)
+		if (compute) glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+#endif
+		glDisable(GL_DEPTH_TEST);
+	}
+
+	// this frame's imposters with an INSTANCE_DATA IMPOSTER variant, running with its per
+	// frame uniforms like in Draw; materials: the meshes' material attributes as well
+	void DrawImposters(Shader* shader, bool materials)
+	{
+		if (imposterObjects.empty()) return;
+		shader->UploadImposterFade(eye, imposterStart, imposterEnd);
+		shader->UploadObjectData(objectDataUnit);
+		glActiveTexture(GL_TEXTURE0 + objectDataUnit);
+		glBindTexture(GL_TEXTURE_2D, objectTexture);
+		glActiveTexture(GL_TEXTURE0);
+
+		glEnable(GL_DEPTH_TEST);
+		glBindVertexArray(imposterVao);
+		glBindBuffer(GL_ARRAY_BUFFER, imposterBuffer);
+		for (unsigned int m = 0; m < atlases.size(); m++)
+		{
+			int first = imposterFirst[m], count = imposterFirst[m + 1] - first;
+			if (count == 0) continue;
+			atlases[m]->Bind(shader, materials, imposterNormalUnit);
+			glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, 0, (void*)(first * sizeof(unsigned int)));
+			glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindVertexArray(0);
+		glDisable(GL_DEPTH_TEST);
+	}
+
+	// instanced draws of this frame's imposters
+	int GetImposterDrawCalls()
+	{
+		int calls = 0;
+		for (unsigned int m = 0; m < atlases.size(); m++) calls += imposterFirst[m + 1] > imposterFirst[m];
+		return calls;
+	}
+};
+
+
+// the GL side of TerrainQuadtree: a GeometryRange for each tile in memory, built as the
+// tiles are read and freed as they are dropped, drawn with the ground's placement
+class TerrainChunks
+{
+	TerrainQuadtree quadtree;
+	std::map<long long, GeometryRange> ranges;	// by node
+	std::vector<unsigned int> indices;
+	std::vector<float> vertices;
+	vec3 localEye;
+
+	static const int vertexFormat[3];	// position, coarser height and morph range, normal
+
+	void Upload()
+	{
+		int n = quadtree.GetHeader().tileSize + 1;
+		for (int i = 0; i < quadtree.loaded.size(); i++)
+		{
+			quadtree.BuildVertices(*quadtree.loaded[i], vertices);
+			ranges[quadtree.loaded[i]->node] = geometryPool.Allocate(std::vector<int>(vertexFormat, vertexFormat + 3), &vertices[0], n * n,
+				&indices[0], (unsigned int)indices.size());
+		}
+	}
+
+public:
+	int maxLoads;	// tile reads per frame
+
+	TerrainChunks() : maxLoads(16) {}
+
+	~TerrainChunks()
+	{
+		for (std::map<long long, GeometryRange>::iterator it = ranges.begin(); it != ranges.end(); ++it)
+			if (it->second.buffer) it->second.buffer->Free(it->second);
+	}
+
+	// a missing file is cooked from RollingHills first: 64 units on a side, 1/32 apart at the finest level
+	bool Open(const std::string& filename)
+	{
+		if (!quadtree.Open(filename))
+		{
+			if (FILE* file = fopen(filename.c_str(), "rb"))
+			{
+				fclose(file);
+				printf("%s is not a cooked terrain\n", filename.c_str());
+				return false;
+			}
+			printf("cooking terrain %s\n", filename.c_str());
+			if (!TerrainFile::Cook(filename, 64.0f, 8, 16, -4.0f, 4.0f, RollingHills) || !quadtree.Open(filename)) return false;
+		}
+		TerrainQuadtree::BuildIndices(quadtree.GetHeader().tileSize, indices);
+		Upload();
+		return true;
+	}
+
+	// InvM and MVP: the terrain's placement
+	void Update(mat4 InvM, vec3 eye, const mat4& MVP, int loads)
+	{
+		vec4 e = vec4(eye.x, eye.y, eye.z, 1.0) * InvM;
+		localEye = vec3(e.v[0], e.v[1], e.v[2]);
+		quadtree.Update(localEye, MVP, loads);
+		for (int i = 0; i < quadtree.evicted.size(); i++)
+		{
+			GeometryRange& range = ranges[quadtree.evicted[i]];
+			if (range.buffer) range.buffer->Free(range);
+			ranges.erase(quadtree.evicted[i]);
+		}
+		Upload();
+	}
+
+	// the shader must already be running with the placement uploaded
+	void Draw(Shader* shader)
+	{
+		shader->UploadMorphEye(localEye);
+		glEnable(GL_DEPTH_TEST);
+		for (int i = 0; i < quadtree.selection.size(); i++)
+		{
+			GeometryRange& range = ranges[quadtree.selection[i]->node];
+			range.buffer->Draw(range);
+		}
+		glDisable(GL_DEPTH_TEST);
+	}
+
+	const TerrainQuadtree& GetQuadtree() { return quadtree; }
+
+	// the heights in memory and their vertices and indices
+	long long GetResidentBytes()
+	{
+		int n = quadtree.GetHeader().tileSize + 1;
+		return quadtree.GetResidentBytes() + (long long)ranges.size() * (n * n * sizeof(float) * 11 + indices.size() * sizeof(unsigned int));
+	}
+};
+
+const int TerrainChunks::vertexFormat[3] = { 4, 4, 3 };
+
+
+class Scene
+{
+	MeshShader *meshShader;
+    InfiniteQuadShader *groundShader;
+    ShadowShader *shadowShader;
+    ForwardPlusShader *forwardPlusShader, *groundForwardPlusShader;
+    GBufferShader *gBufferShader, *groundGBufferShader;
+    DeferredLightingShader *deferredLightingShader;
+    DepthShader *depthShader;
+    Shader *instancedLitShader, *instancedDepthShader, *instancedShadowShader;
+    Shader *imposterShader;		// also the imposters' depth prepass, so that both passes discard alike
+
+    LightGrid* lightGrid;
+    ClusteredLights* clusteredLights;
+    Shader* lightGridShader;
+    GBuffer* gBuffer;
+    FullScreenTriangle* fullScreenTriangle;
+    OcclusionCuller* occlusionCuller;
+    SoftwareOcclusion* softwareOcclusion;
+    GpuScene* gpuScene;
+    InstanceBvh* collisionBvh;
+    std::vector<int> collisionObjects;	// by instance of collisionBvh
+    SpatialHash* broadPhase;
+    std::vector<int> broadPhaseVersions;	// transform versions of the hashed boxes, by object
+    std::vector<std::pair<int, int> > contacts;	// objects whose world boxes overlap
+    RayTracer* rayTracer;
+    std::map<Mesh*, int> traceMeshes;			// into rayTracer->meshes, -1 for meshes it cannot trace
+    std::map<Material*, int> traceMaterials;
+    std::map<Texture*, int> traceTextures;
+    TerrainChunks* terrain;
+    Shader *terrainShader, *terrainDepthShader;
+    MeshletCuller* meshletCuller;
+    std::vector<MeshletCuller::Instance> meshletInstances;
+    unsigned int meshletIndexBuffer;
+    std::vector<BoundingBox> objectBounds;
+    std::vector<char> softwareVisible;
+    std::vector<DrawPacket> occluderPackets;
+    QueryCounter sampleCounter;
+    QueryCounter invocationCounter;
+    std::vector<DrawPacket> opaquePackets;
+    std::vector<PointLight> sceneLights;
+    std::vector<PointLight> pointLights;
+    int viewportWidth, viewportHeight;
+    static const int bulkTextureSize = 1024, bulkTextureFrame = 10;
+    std::vector<unsigned char> bulkPixels;	// shared by the options.bulkTextures textures
+    int frame;
+
+    Object* avi;
+    Object* gnd;
+    Chevy* chevy;
+	
+	std::vector<Texture*> textures;
+	std::vector<Material*> materials;
+	std::vector<Geometry*> geometries;
+	std::vector<Mesh*> meshes;
+	std::vector<Object*> objects;
+
+public:
+    RenderStats stats;
+
+	Scene() 
+	{ 
+		meshShader = 0;
+        groundShader = 0;
+        shadowShader = 0;
+        forwardPlusShader = groundForwardPlusShader = 0;
+        gBufferShader = groundGBufferShader = 0;
+        deferredLightingShader = 0;
+        depthShader = 0;
+        instancedLitShader = instancedDepthShader = instancedShadowShader = 0;
+        imposterShader = 0;
+        sampleCounter.SetTarget(GL_SAMPLES_PASSED);
+        lightGrid = 0;
+        clusteredLights = 0;
+        lightGridShader = 0;
+        gBuffer = 0;
+        fullScreenTriangle = 0;
+        occlusionCuller = 0;
+        softwareOcclusion = 0;
+        gpuScene = 0;
+        collisionBvh = 0;
+        broadPhase = 0;
+        rayTracer = 0;
+        terrain = 0;
+        terrainShader = terrainDepthShader = 0;
+        meshletCuller = 0;
+        meshletIndexBuffer = 0;
+        viewportWidth = windowWidth;
+        viewportHeight = windowHeight;
+        frame = 0;
+	}
+
+	void SetViewport(int width, int height)
+	{
+		viewportWidth = width;
+		viewportHeight = height;
+	}
+
+	void Initialize()
+	{
+		if (options.textureBudget > 0) textureStreamer = new TextureStreamer(options.textureBudget);
+		meshShader = new MeshShader();
+        groundShader = new InfiniteQuadShader();
+        shadowShader = new ShadowShader();
+        if (options.depthPrepass) depthShader = new DepthShader();
+        if (options.occlusionCulling) occlusionCuller = new OcclusionCuller();
+#if defined(GL_FRAGMENT_SHADER_INVOCATIONS_ARB)
+        if (hasExtension("GL_ARB_pipeline_statistics_query")) invocationCounter.SetTarget(GL_FRAGMENT_SHADER_INVOCATIONS_ARB);
+#endif
+
+        Shader* litShader = meshShader;
+        Shader* litGroundShader = groundShader;
+        if (options.deferred) {
+            gBufferShader = new GBufferShader();
+            groundGBufferShader = new GBufferShader(true);
+            deferredLightingShader = new DeferredLightingShader();
+            gBuffer = new GBuffer();
+            fullScreenTriangle = new FullScreenTriangle();
+            litShader = gBufferShader;
+            litGroundShader = groundGBufferShader;
+            lightGridShader = deferredLightingShader;
+        } else if (options.forwardPlus) {
+            forwardPlusShader = new ForwardPlusShader();
+            groundForwardPlusShader = new ForwardPlusShader("GROUND");
+            litShader = forwardPlusShader;
+            litGroundShader = groundForwardPlusShader;
+            lightGridShader = forwardPlusShader;
+        }
+
+        if (lightGridShader) {
+            lightGrid = new LightGrid();
+            clusteredLights = new ClusteredLights();
+
+            // scatter the point lights over the ground around the origin
+            for (int i = 0; i < options.pointLights; i++) {
+                vec3 p = vec3::random();
+                vec3 c = vec3::random();
+                sceneLights.push_back(PointLight(vec3(p.x * 5.0, -0.8 + (p.y + 1.0) * 0.5, p.z * 5.0),
+                            0.5 + (float)rand() / RAND_MAX, vec3(c.x + 1.0, c.y + 1.0, c.z + 1.0) * 0.5));
+            }
+        }
+
+        // make tigger
+		textures.push_back(new Texture("tigger.png"));
+		materials.push_back(new Material(litShader, textures[0], vec3(0.1, 0.1, 0.1),
+                            vec3(0.6,0.6,0.6), vec3(0.3, 0.3, 0.3), 50)); 
+		geometries.push_back(new PolygonalMesh("tigger.obj"));		
+		meshes.push_back(new Mesh(geometries[0], materials[0]));
+		
+		Object* object = new Object(meshes[0], vec3(2.0, -1.0, -3.0), vec3(0.05, 0.05, 0.05), -90.0);
+		objects.push_back(object);
+
+        // make tree
+		textures.push_back(new Texture("tree.png"));
+		materials.push_back(new Material(litShader, textures[1], vec3(0.1, 0.1, 0.1), 
+                            vec3(0.9,0.9,0.9), vec3(0.0, 0.0, 0.0), 50)); 
+		geometries.push_back(new PolygonalMesh("tree.obj"));		
+		meshes.push_back(new Mesh(geometries[1], materials[1]));
+		
+		Object* ob = new Object(meshes[1], vec3(-0.8, 0.0, 0.0), vec3(0.025, 0.025, 0.025), 0.0);
+		objects.push_back(ob);
+
+        // make the second tree
+        objects.push_back( new Object(meshes[1], vec3(0.0, 0.0, 3.0), vec3(0.025, 0.025, 0.025), 0.0));
+
+        // forest rows behind the first tree, mostly hidden by the rows in front
+        for (int i = 0; i < options.trees; i++) {
+            vec3 jitter = vec3::random();
+            objects.push_back(new Object(meshes[1], vec3((i % 16 - 7.5) * 0.6 + jitter.x * 0.2, 0.0, -1.0 - (i / 16) * 0.6 + jitter.z * 0.2),
+                            vec3(0.025, 0.025, 0.025), jitter.y * 180.0));
+        }
+
+        // make floor
+        materials.push_back(new Material(litGroundShader, textures[1], vec3(0.1, 0.1, 0.1),
+                            vec3(0.6, 0.6, 0.6), vec3(0.3, 0.3, 0.3), 50));
+        geometries.push_back(new TexturedQuad());
+        meshes.push_back(new Mesh(geometries[2], materials[2]));
+        gnd = (new Object(meshes[2], vec3(0.0, -1.0, 0.0), vec3(1.0, 1.0, 1.0), 0));
+
+        // or a heightmap terrain in its place, with its placement and material
+        if (!options.terrainFile.empty()) {
+            terrain = new TerrainChunks();
+            if (terrain->Open(options.terrainFile)) {
+                if (options.deferred) terrainShader = new GBufferShader(true, "TERRAIN");
+                else if (options.forwardPlus) terrainShader = new ForwardPlusShader("GROUND TERRAIN");
+                else terrainShader = new MeshShader("GROUND TERRAIN");
+                if (depthShader) terrainDepthShader = new DepthShader("TERRAIN");
+            } else {
+                printf("cannot open terrain %s, drawing the ground plane\n", options.terrainFile.c_str());
+                delete terrain;
+                terrain = 0;
+            }
+        }
+
+        // avatar (chevy)
+        textures.push_back(new Texture("chevy/chevy.png"));
+        materials.push_back(new Material(litShader, textures[2]));
+        geometries.push_back(new PolygonalMesh("chevy/chassis.obj"));
+        meshes.push_back(new Mesh(geometries[3], materials[3]));
+        avi = new Object(meshes[3], vec3(0.0, -0.5, 0.9), vec3(0.03, 0.03, 0.03), 180);
+        
+        geometries.push_back(new PolygonalMesh("chevy/wheel.obj"));
+        meshes.push_back(new Mesh(geometries[4], materials[3]));
+
+        Light* chevLight = new Light(vec3(1.5, 1.5, 1.5), vec3(1.5, 1.5, 1.5), vec4(avi->position.x, avi->position.y, avi->position.z, 1));
+        chevy = new Chevy(avi, meshes[4], chevLight);
+        objects.push_back(avi);
+        objects.insert(objects.end(), chevy->GetWheels().begin(), chevy->GetWheels().end());
+
+        // synthetic load: spheres of about options.triangles triangles resting on the ground
+        if (options.objects > 0) {
+            int stacks = std::max(2, (int)sqrt(options.triangles / 4.0));
+            geometries.push_back(new PolygonalMesh(2 * stacks, stacks));
+            meshes.push_back(new Mesh(geometries.back(), materials[1]));
+            for (int i = 0; i < options.objects; i++) {
+                vec3 r = vec3::random();
+                float radius = 0.1 + 0.05 * (r.y + 1.0);
+                objects.push_back(new Object(meshes.back(), vec3(r.x * 6.0, -1.0 + radius, r.z * 6.0), vec3(radius, radius, radius), 0.0));
+            }
+        }
+
+        transforms.Update();
+
+        // the first view read in full while loading
+        for (int i = 0; terrain && i < 64 && (i == 0 || terrain->GetQuadtree().GetPendingCount() > 0); i++) UpdateTerrain(1 << 30);
+
+        if (options.collisions) {
+            chevy->SetWorld(GetCollisionBvh(), gnd->position.y);
+            CreateBroadPhase();
+        }
+
+        std::map<std::string, Texture*> maps;
+        for (int i = 0; i < meshes.size(); i++) AddObjMaterials(meshes[i], maps);
+
+        // a diagonal gradient for the bulk load, generated now so that only the upload is timed
+        if (options.bulkTextures > 0) {
+            bulkPixels.resize(bulkTextureSize * bulkTextureSize * 4);
+            for (int i = 0; i < bulkTextureSize * bulkTextureSize; i++) {
+                int x = i % bulkTextureSize, y = i / bulkTextureSize;
+                unsigned char texel[4] = { (unsigned char)x, (unsigned char)y, (unsigned char)(x + y), 255 };
+                memcpy(&bulkPixels[i * 4], texel, 4);
+            }
+        }
+
+        if (options.gpuDriven) {
+            std::string instanced = options.textureArrays ? "INSTANCE_DATA TEXTURE_ARRAY" : "INSTANCE_DATA";
+            if (options.imposters > 0.0f) instanced += " IMPOSTER_FADE";
+            if (options.deferred) instancedLitShader = new GBufferShader(false, instanced);
+            else if (options.forwardPlus) instancedLitShader = new ForwardPlusShader(instanced);
+            else instancedLitShader = new MeshShader(instanced);
+            if (depthShader) instancedDepthShader = new DepthShader(options.imposters > 0.0f ? "INSTANCE_DATA IMPOSTER_FADE" : "INSTANCE_DATA");
+            instancedShadowShader = new ShadowShader("INSTANCE_DATA");
+            if (options.imposters > 0.0f) {
+                if (options.deferred) imposterShader = new GBufferShader(false, "INSTANCE_DATA IMPOSTER");
+                else if (options.forwardPlus) imposterShader = new ForwardPlusShader("INSTANCE_DATA IMPOSTER");
+                else imposterShader = new MeshShader("INSTANCE_DATA IMPOSTER");
+            }
+            // the arrays copy the textures, the atlases are baked from them
+            if (textureStreamer && (options.textureArrays || options.imposters > 0.0f)) textureStreamer->Finish();
+            gpuScene = new GpuScene(objects, options.gpuCompute && majorVersion * 10 + minorVersion >= 43);
+            stats.imposterBakeTime = gpuScene->imposterBakeTime;
+            stats.imposterAtlasBytes = gpuScene->GetAtlasBytes();
+        }
+        else if (options.imposters > 0.0f) printf("imposters need -gpudriven\n");
+
+	}
+
+	// a Material for each MTL material of the mesh's OBJ file, on the shader of the mesh's
+	// own material and with its texture where the MTL names no map_Kd; maps: the textures
+	// loaded so far by file name
+	void AddObjMaterials(Mesh* mesh, std::map<std::string, Texture*>& maps)
+	{
+		ObjMesh* obj = mesh->GetGeometry()->GetObjMesh();
+		if (!obj || mesh->GetGeometry()->GetMaterialRanges().empty()) return;
+
+		const std::vector<ObjMesh::Material>& mtl = obj->GetMaterials();
+		std::vector<Material*> rangeMaterials(mtl.size(), (Material*)0);
+		for (int i = 0; i < mtl.size(); i++)
+		{
+			if (!mtl[i].defined) continue;
+			Texture* texture = mesh->GetMaterial()->GetTexture();
+			if (!mtl[i].diffuseMap.empty())
+			{
+				if (maps.find(mtl[i].diffuseMap) == maps.end())
+				{
+					textures.push_back(new Texture(mtl[i].diffuseMap));
+					maps[mtl[i].diffuseMap] = textures.back();
+				}
+				texture = maps[mtl[i].diffuseMap];
+			}
+			materials.push_back(new Material(mesh->GetShader(), texture, mtl[i].ambient, mtl[i].diffuse, mtl[i].specular, mtl[i].shininess));
+			rangeMaterials[i] = materials.back();
+		}
+		mesh->SetRangeMaterials(rangeMaterials);
+	}
+
+	~Scene()
+	{
+		if(textureStreamer) { delete textureStreamer; textureStreamer = 0; }
+		for(int i = 0; i < textures.size(); i++) delete textures[i];
+		for(int i = 0; i < materials.size(); i++) delete materials[i];
+		for(int i = 0; i < geometries.size(); i++) delete geometries[i];
+		for(int i = 0; i < meshes.size(); i++) delete meshes[i];
+		for(int i = 0; i < objects.size(); i++) delete objects[i];
+		
+		if(meshShader) delete meshShader;
+		if(forwardPlusShader) delete forwardPlusShader;
+		if(groundForwardPlusShader) delete groundForwardPlusShader;
+		if(gBufferShader) delete gBufferShader;
+		if(groundGBufferShader) delete groundGBufferShader;
+		if(deferredLightingShader) delete deferredLightingShader;
+		if(depthShader) delete depthShader;
+		if(lightGrid) delete lightGrid;
+		if(clusteredLights) delete clusteredLights;
+		if(gBuffer) delete gBuffer;
+		if(fullScreenTriangle) delete fullScreenTriangle;
+		if(occlusionCuller) delete occlusionCuller;
+		if(softwareOcclusion) delete softwareOcclusion;
+		if(gpuScene) delete gpuScene;
+		if(collisionBvh) delete collisionBvh;
+		if(broadPhase) delete broadPhase;
+		if(rayTracer) delete rayTracer;
+		if(terrain) delete terrain;
+		if(terrainShader) delete terrainShader;
+		if(terrainDepthShader) delete terrainDepthShader;
+		if(meshletCuller) delete meshletCuller;
+		if(meshletIndexBuffer) glDeleteBuffers(1, &meshletIndexBuffer);
+		if(instancedLitShader) delete instancedLitShader;
+		if(instancedDepthShader) delete instancedDepthShader;
+		if(instancedShadowShader) delete instancedShadowShader;
+		if(imposterShader) delete imposterShader;
+	}
+
+	int GetObjectCount() { return (int)objects.size(); }
+
+	GpuScene* GetGpuScene() { return gpuScene; }
+
+	// every object but the avatar and its wheels under one top level BVH, built on first use;
+	// the objects are not expected to move
+	InstanceBvh* GetCollisionBvh()
+	{
+		if (collisionBvh) return collisionBvh;
+		PROFILE_SCOPE("build scene bvh");
+		collisionBvh = new InstanceBvh();
+		for (int i = 0; i < objects.size(); i++)
+		{
+			TriangleBvh* bvh = objects[i]->GetMesh()->GetGeometry()->GetBvh();
+			if (!bvh || objects[i] == avi || objects[i]->GetParent() == avi) continue;
+			collisionBvh->Add(bvh, objects[i]->GetModelMatrix(), objects[i]->GetInverseModelMatrix());
+			collisionObjects.push_back(i);
+		}
+		collisionBvh->Build();
+		return collisionBvh;
+	}
+
+	// every object's world box in a spatial hash with cells as large as the average box;
+	// the ground is left out, it would share a cell with everything
+	void CreateBroadPhase()
+	{
+		float size = 0.0f;
+		int count = 0;
+		for (int i = 0; i < objects.size(); i++)
+		{
+			if (objects[i] == gnd) continue;
+			vec3 extent = objects[i]->GetWorldBounds().max - objects[i]->GetWorldBounds().min;
+			size += std::max(extent.x, std::max(extent.y, extent.z));
+			count++;
+		}
+		broadPhase = new SpatialHash(count ? std::max(size / count, 0.01f) : 1.0f, (int)objects.size() * 2);
+		broadPhaseVersions.resize(objects.size());
+		for (int i = 0; i < objects.size(); i++)
+		{
+			Object* object = objects[i];
+			broadPhaseVersions[i] = object->GetTransformVersion();
+			broadPhase->Add(object == gnd ? BoundingBox() : object->GetWorldBounds());	// ids are object indices
+		}
+	}
+
+	// the world matrices of what moved this frame and of everything attached to it
+	void UpdateTransforms()
+	{
+		PROFILE_SCOPE("transforms");
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		stats.transformNodes = transforms.Update();
+		stats.transformTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// the terrain nodes for this view, reading at most maxLoads tiles
+	void UpdateTerrain(int maxLoads)
+	{
+		PROFILE_SCOPE("terrain");
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		mat4 MVP = gnd->GetModelMatrix() * camera.GetViewMatrix() * camera.GetProjectionMatrix();
+		terrain->Update(gnd->GetInverseModelMatrix(), camera.wEye, MVP, maxLoads);
+		const TerrainQuadtree& quadtree = terrain->GetQuadtree();
+		stats.terrainNodes = (int)quadtree.selection.size();
+		stats.terrainTriangles = (unsigned int)quadtree.GetTriangleCount();
+		stats.terrainLoads = (int)quadtree.loaded.size();
+		stats.terrainResidentTiles = quadtree.GetResidentCount();
+		stats.terrainResidentBytes = terrain->GetResidentBytes();
+		stats.terrainFileBytes = quadtree.GetFileSize();
+		stats.terrainExtent = quadtree.GetHeader().size;
+		stats.terrainTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// the terrain with the ground's placement; lit: light, eye and the ground's material too
+	void DrawTerrain(Shader* shader, bool lit)
+	{
+		shader->Run();
+		if (lit)
+		{
+			light->UploadAttributes(shader);
+			camera.UploadAttributes(shader);
+			gnd->GetMesh()->GetMaterial()->UploadAttributes(shader);
+			if (lightGrid) shader->UploadLightGrid(*lightGrid, 1);
+		}
+		gnd->UploadAttributes(shader);
+		terrain->Draw(shader);
+	}
+
+	// rehashes the objects that moved since the last frame and finds the overlapping pairs
+	void UpdateBroadPhase()
+	{
+		PROFILE_SCOPE("broad phase");
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		stats.broadPhaseMoves = 0;
+		for (int i = 0; i < objects.size(); i++)
+		{
+			Object* object = objects[i];
+			if (object == gnd || broadPhaseVersions[i] == object->GetTransformVersion()) continue;
+			broadPhaseVersions[i] = object->GetTransformVersion();
+			broadPhase->Update(i, object->GetWorldBounds());
+			stats.broadPhaseMoves++;
+		}
+		contacts.clear();
+		broadPhase->FindPairs(contacts);
+		stats.broadPhasePairs = (int)contacts.size();
+		stats.broadPhaseTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// the index of material in rayTracer->materials, its texture read back from GL on first use
+	int GetTraceMaterial(Material* material)
+	{
+		std::map<Material*, int>::iterator found = traceMaterials.find(material);
+		if (found != traceMaterials.end()) return found->second;
+		TraceMaterial traced;
+		material->GetAttributes(traced.ka, traced.kd, traced.ks, traced.shininess);
+		traced.texture = -1;
+		Texture* texture = material->GetTexture();
+		if (texture)
+		{
+			std::map<Texture*, int>::iterator image = traceTextures.find(texture);
+			if (image == traceTextures.end())
+			{
+				rayTracer->textures.push_back(TraceTexture());
+				TraceTexture& texels = rayTracer->textures.back();
+				texels.width = texture->GetWidth();
+				texels.height = texture->GetHeight();
+				texture->Read(texels.texels);
+				image = traceTextures.insert(std::make_pair(texture, (int)rayTracer->textures.size() - 1)).first;
+			}
+			traced.texture = image->second;
+		}
+		rayTracer->materials.push_back(traced);
+		return traceMaterials[material] = (int)rayTracer->materials.size() - 1;
+	}
+
+	// the index of mesh in rayTracer->meshes, with the material of each triangle as Mesh::Draw
+	// picks it; -1 for geometry without triangles to trace
+	int GetTraceMesh(Mesh* mesh)
+	{
+		std::map<Mesh*, int>::iterator found = traceMeshes.find(mesh);
+		if (found != traceMeshes.end()) return found->second;
+		Geometry* geometry = mesh->GetGeometry();
+		ObjMesh* obj = geometry->GetObjMesh();
+		TriangleBvh* bvh = obj ? geometry->GetBvh() : 0;
+		if (!bvh) return traceMeshes[mesh] = -1;
+
+		TraceMesh traced;
+		traced.bvh = bvh;
+		obj->GetTriangles(traced.vertices);
+		traced.materials.assign(obj->GetTriangleCount(), GetTraceMaterial(mesh->GetMaterial()));
+		if (!geometry->GetMaterialRanges().empty())
+		{
+			const std::vector<ObjMesh::Submesh>& submeshes = obj->GetSubmeshes();
+			for (int i = 0; i < submeshes.size(); i++)
+			{
+				int material = GetTraceMaterial(mesh->GetRangeMaterial(submeshes[i].material));
+				std::fill(traced.materials.begin() + submeshes[i].firstTriangle,
+					traced.materials.begin() + submeshes[i].firstTriangle + submeshes[i].triangleCount, material);
+			}
+		}
+		rayTracer->meshes.push_back(traced);
+		return traceMeshes[mesh] = (int)rayTracer->meshes.size() - 1;
+	}
+
+	// the scene as the forward path draws it with the main light, traced on the CPU; meshes,
+	// materials and textures are gathered on the first call, the placements on every call
+	long long RayTrace(int width, int height, unsigned char* rgb, int threads)
+	{
+		PROFILE_SCOPE("ray trace");
+		if (textureStreamer) textureStreamer->Finish();
+		if (!rayTracer)
+		{
+			rayTracer = new RayTracer();
+			rayTracer->groundMaterial = GetTraceMaterial(gnd->GetMesh()->GetMaterial());
+		}
+		rayTracer->ClearInstances();
+		for (int i = 0; i < objects.size(); i++)
+		{
+			int mesh = GetTraceMesh(objects[i]->GetMesh());
+			if (mesh >= 0) rayTracer->AddInstance(mesh, objects[i]->GetModelMatrix(), objects[i]->GetInverseModelMatrix());
+		}
+		rayTracer->Build();
+		rayTracer->groundHeight = gnd->position.y;
+
+		// the basis of Camera::GetViewMatrix, scaled by the projection
+		mat4 P = camera.GetProjectionMatrix();
+		vec3 w = (camera.wEye - camera.wLookat).normalize();
+		vec3 u = cross(camera.wVup, w).normalize();
+		vec3 v = cross(w, u);
+		rayTracer->eye = camera.wEye;
+		rayTracer->forward = w * -1.0f;
+		rayTracer->right = u / P.m[0][0];
+		rayTracer->up = v / P.m[1][1];
+		rayTracer->nearPlane = camera.GetNearPlane();
+		rayTracer->farPlane = camera.GetFarPlane();
+		// the forward path never uploads worldEyePosition to the mesh and ground shaders, so
+		// their specular term is seen from the origin; the reference matches what is drawn
+		rayTracer->viewer = vec3(0.0, 0.0, 0.0);
+
+		light->GetAttributes(rayTracer->La, rayTracer->Le, rayTracer->lightPosition);
+		rayTracer->shadowLight = shadowLightPosition;
+		rayTracer->background = vec3(0.0, 0.0, 1.0);	// ClearFrame's color
+
+		ThreadPool pool(threads);
+		return rayTracer->Render(width, height, rgb, &pool);
+	}
+
+	// the object seen through viewport pixel (x, y), counted from the top left; -1 for none
+	int Pick(int x, int y)
+	{
+		mat4 InvVP = inverse(camera.GetViewMatrix() * camera.GetProjectionMatrix());
+		float ndcX = 2.0f * (x + 0.5f) / viewportWidth - 1.0f, ndcY = 1.0f - 2.0f * (y + 0.5f) / viewportHeight;
+		vec4 nearPoint = vec4(ndcX, ndcY, -1.0f, 1.0f) * InvVP, farPoint = vec4(ndcX, ndcY, 1.0f, 1.0f) * InvVP;
+		vec3 origin = vec3(nearPoint.v[0], nearPoint.v[1], nearPoint.v[2]) / nearPoint.v[3];
+		vec3 target = vec3(farPoint.v[0], farPoint.v[1], farPoint.v[2]) / farPoint.v[3];
+		RayHit hit;
+		if (!GetCollisionBvh()->Raycast(origin, (target - origin).normalize(), hit)) return -1;
+		return collisionObjects[hit.instance];
+	}
+
+	bool IsBatched(int i) { return gpuScene && gpuScene->IsBatched(i); }
+
+	bool IsCulled(int i)
+	{
+		if (i < softwareVisible.size() && !softwareVisible[i]) return true;
+		return occlusionCuller && !occlusionCuller->IsVisible(i);
+	}
+
+	// the nearest objects are rasterized at a quarter of the viewport resolution and
+	// every object is tested against them before anything is submitted
+	void UpdateSoftwareOcclusion()
+	{
+		PROFILE_SCOPE("software occlusion");
+		const int maxOccluders = 32;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		int width = std::max(viewportWidth / 4, 1), height = std::max(viewportHeight / 4, 1);
+		if (!softwareOcclusion || softwareOcclusion->GetWidth() != width || softwareOcclusion->GetHeight() != height)
+		{
+			if (softwareOcclusion) delete softwareOcclusion;
+			softwareOcclusion = new SoftwareOcclusion(width, height);
+		}
+
+		mat4 VP = camera.GetViewMatrix() * camera.GetProjectionMatrix();
+		softwareOcclusion->Begin(VP, camera.GetNearPlane());
+
+		occluderPackets.clear();
+		for(int i = 0; i < objects.size(); i++)
+		{
+			if (!objects[i]->GetOccluder()) continue;
+			DrawPacket packet = { objects[i], (objects[i]->GetWorldPosition() - camera.wEye).length() };
+			occluderPackets.push_back(packet);
+		}
+		std::sort(occluderPackets.begin(), occluderPackets.end());
+		for(int i = 0; i < occluderPackets.size() && i < maxOccluders; i++)
+		{
+			mat4 M = occluderPackets[i].object->GetModelMatrix();
+			softwareOcclusion->AddOccluder(*occluderPackets[i].object->GetOccluder(), M);
+		}
+		softwareOcclusion->Rasterize();
+
+		objectBounds.resize(objects.size());
+		for(int i = 0; i < objects.size(); i++) objectBounds[i] = objects[i]->GetShadowedBounds();
+		softwareOcclusion->TestBoxes(objectBounds, softwareVisible);
+
+		stats.occluderTriangles = softwareOcclusion->occluderTriangles;
+		stats.occlusionTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// rebuilds the clustered light lists for the current camera and hands them to the
+	// shaders that walk them (forward+ for the objects and the ground, or deferred lighting)
+	void UpdateLightGrid()
+	{
+		PROFILE_SCOPE("light grid");
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		pointLights = sceneLights;
+		pointLights.push_back(chevy->GetSpotlight()->GetPointLight(1.5));
+
+		mat4 V = camera.GetViewMatrix();
+		mat4 P = camera.GetProjectionMatrix();
+		lightGrid->Resize(viewportWidth, viewportHeight);
+		lightGrid->Build(pointLights, V, P, camera.GetNearPlane(), camera.GetFarPlane());
+		clusteredLights->Upload(*lightGrid, pointLights);
+
+		lightGridShader->Run();
+		lightGridShader->UploadLightGrid(*lightGrid, 1);
+		if (groundForwardPlusShader)
+		{
+			groundForwardPlusShader->Run();
+			groundForwardPlusShader->UploadLightGrid(*lightGrid, 1);
+		}
+		clusteredLights->Bind(1);
+
+		stats.lightGridTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// ground first, then the objects in scene order or, with options.sortOpaque, front
+	// to back by view depth; the infinite ground then goes last as the farthest. The
+	// terrain is drawn on its own, see DrawTerrain.
+	void CollectOpaquePackets()
+	{
+		opaquePackets.clear();
+		vec3 viewDir = (camera.wLookat - camera.wEye).normalize();
+
+		DrawPacket ground = { gnd, 1e30f };
+		if (!options.sortOpaque && !terrain) opaquePackets.push_back(ground);
+		for(int i = 0; i < objects.size(); i++)
+		{
+			if (IsCulled(i) || IsBatched(i)) continue;
+			vec3 toObject = objects[i]->GetWorldPosition() - camera.wEye;
+			DrawPacket packet = { objects[i], dot(toObject, viewDir) };
+			opaquePackets.push_back(packet);
+		}
+		if (options.sortOpaque)
+		{
+			std::sort(opaquePackets.begin(), opaquePackets.end());
+			if (!terrain) opaquePackets.push_back(ground);
+		}
+	}
+
+	// meshlets of the drawn objects against the camera, into one index stream for this frame
+	void UpdateMeshlets()
+	{
+		PROFILE_SCOPE("meshlet culling");
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		if (!meshletCuller)
+		{
+			meshletCuller = new MeshletCuller();
+			glGenBuffers(1, &meshletIndexBuffer);
+		}
+
+		mat4 VP = camera.GetViewMatrix() * camera.GetProjectionMatrix();
+		std::vector<int> owners;
+		meshletInstances.clear();
+		for (int i = 0; i < objects.size(); i++)
+		{
+			objects[i]->clusters.indexCount = -1;
+			if (IsCulled(i) || IsBatched(i)) continue;
+			Geometry* geometry = objects[i]->GetMesh()->GetGeometry();
+			MeshletMesh* meshlets = geometry->GetMaterialRanges().empty() ? geometry->GetMeshlets() : 0;
+			if (!meshlets) continue;
+
+			MeshletCuller::Instance instance;
+			instance.mesh = meshlets;
+			instance.MVP = objects[i]->GetModelMatrix() * VP;
+			vec4 eye = vec4(camera.wEye.x, camera.wEye.y, camera.wEye.z, 1.0) * objects[i]->GetInverseModelMatrix();
+			instance.eye = vec3(eye.v[0], eye.v[1], eye.v[2]);
+			meshletInstances.push_back(instance);
+			owners.push_back(i);
+		}
+		meshletCuller->Run(meshletInstances);
+
+		// orphaned every frame so that the upload does not wait for last frame's draws
+		PROFILE_SCOPE("meshlet upload");
+		std::vector<unsigned int>& stream = meshletCuller->stream;
+		glBindBuffer(GL_COPY_WRITE_BUFFER, meshletIndexBuffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, stream.size() * sizeof(unsigned int), stream.empty() ? NULL : &stream[0], GL_STREAM_DRAW);
+		for (int k = 0; k < owners.size(); k++)
+		{
+			Object::Clusters& clusters = objects[owners[k]]->clusters;
+			clusters.indexBuffer = meshletIndexBuffer;
+			clusters.firstIndex = meshletInstances[k].firstIndex;
+			clusters.indexCount = (int)meshletInstances[k].indexCount;
+		}
+
+		stats.meshletsTested = meshletCuller->meshletsTested;
+		stats.meshletsVisible = meshletCuller->meshletsVisible;
+		stats.meshletTrianglesTested = meshletCuller->trianglesTested;
+		stats.meshletTrianglesVisible = meshletCuller->trianglesVisible;
+		stats.meshletTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// the GpuScene objects, or their imposters, with an INSTANCE_DATA shader; lit: light, eye
+	// and materials too
+	void DrawInstanced(Shader* shader, bool lit, bool imposters = false)
+	{
+		mat4 VP = camera.GetViewMatrix() * camera.GetProjectionMatrix();
+		shader->Run();
+		shader->UploadVP(VP);
+		if (lit)
+		{
+			light->UploadAttributes(shader);
+			camera.UploadAttributes(shader);
+			if (lightGrid) shader->UploadLightGrid(*lightGrid, 1);
+		}
+		if (imposters) gpuScene->DrawImposters(shader, lit);
+		else gpuScene->Draw(shader, lit);
+	}
+
+	void DrawShadows()
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for(int i = 0; i < objects.size(); i++) if (!IsCulled(i) && !IsBatched(i)) objects[i]->DrawShadow(shadowShader);
+		if (gpuScene)
+		{
+			vec3 none;
+			vec4 lightPosition = vec4(shadowLightPosition.x, shadowLightPosition.y, shadowLightPosition.z, 1.0);
+			mat4 VP = camera.GetViewMatrix() * camera.GetProjectionMatrix();
+			instancedShadowShader->Run();
+			instancedShadowShader->UploadVP(VP);
+			instancedShadowShader->UploadLightAttributes(none, none, lightPosition);
+			gpuScene->Draw(instancedShadowShader, false);
+		}
+		stats.submissionTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// shading pass shared by the forward and G-buffer paths, optionally behind a depth
+	// prepass so that only the visible fragment of each pixel runs the lit shader
+	void DrawOpaque()
+	{
+		PassTimer timer;
+		CollectOpaquePackets();
+
+		if (depthShader)
+		{
+			timer.Begin("depth prepass");
+			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			depthShader->Run();
+			for(int i = 0; i < opaquePackets.size(); i++) opaquePackets[i].object->DrawDepth(depthShader);
+			if (gpuScene) DrawInstanced(instancedDepthShader, false);
+			if (imposterShader) DrawInstanced(imposterShader, false, true);
+			if (terrain) DrawTerrain(terrainDepthShader, false);
+			stats.submissionTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+			glDepthFunc(GL_EQUAL);
+			glDepthMask(GL_FALSE);
+			stats.depthPassTime = timer.End();
+		}
+
+		timer.Begin("shading");
+		sampleCounter.Begin();
+		invocationCounter.Begin();
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		stats.drawCalls = 0;
+		for(int i = 0; i < opaquePackets.size(); i++)
+		{
+			opaquePackets[i].object->Draw();
+			stats.drawCalls += opaquePackets[i].object->GetDrawCalls();
+		}
+		if (gpuScene)
+		{
+			DrawInstanced(instancedLitShader, true);
+			stats.drawCalls += gpuScene->drawCalls;
+		}
+		if (imposterShader)
+		{
+			DrawInstanced(imposterShader, true, true);
+			stats.drawCalls += gpuScene->GetImposterDrawCalls();
+		}
+		if (terrain)
+		{
+			DrawTerrain(terrainShader, true);
+			stats.drawCalls += stats.terrainNodes;
+		}
+		stats.submissionTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		stats.fragmentInvocations = invocationCounter.End();
+		stats.fragmentsShaded = sampleCounter.End();
+		stats.shadingPassTime = timer.End();
+
+		if (depthShader)
+		{
+			glDepthFunc(GL_LESS);
+			glDepthMask(GL_TRUE);
+		}
+
+		if (occlusionCuller)
+		{
+			timer.Begin("occlusion queries");
+			occlusionCuller->IssueQueries();
+			stats.occlusionTime += timer.End();
+			stats.occlusionQueries = occlusionCuller->queries;
+		}
+	}
+
+	void DrawForward()
+	{
+		PassTimer timer;
+
+		DrawOpaque();
+		stats.fragmentsLit = stats.fragmentsShaded;
+
+		timer.Begin("shadows");
+		DrawShadows();
+		stats.shadowPassTime = timer.End();
+	}
+
+	// G-buffer fill, one full-screen lighting pass into the current framebuffer,
+	// then the projected shadows on top of the G-buffer depth
+	void DrawDeferred()
+	{
+		PassTimer timer;
+		int target;
+		glGetIntegerv(GL_FRAMEBUFFER_BINDING, &target);
+		gBuffer->Resize(viewportWidth, viewportHeight);
+
+		gBuffer->BindForWriting();
+		DrawOpaque();
+
+		timer.Begin("lighting");
+		sampleCounter.Begin();
+		glBindFramebuffer(GL_FRAMEBUFFER, target);
+		deferredLightingShader->Run();
+		light->UploadAttributes(deferredLightingShader);
+		camera.UploadAttributes(deferredLightingShader);
+		mat4 InvVP = inverse(camera.GetViewMatrix() * camera.GetProjectionMatrix());
+		deferredLightingShader->UploadGBuffer(4, InvVP, camera.GetNearPlane(), camera.GetFarPlane(), lightGrid != 0);
+		gBuffer->BindTextures(4);
+		fullScreenTriangle->Draw();
+		stats.fragmentsLit = sampleCounter.End();
+		stats.lightingPassTime = timer.End();
+
+		timer.Begin("shadows");
+		gBuffer->BlitDepth(target);
+		DrawShadows();
+		stats.shadowPassTime = timer.End();
+	}
+
+	// options.bulkTextures textures at once mid-run, streamed or uploaded on the spot
+	void LoadBulkTextures()
+	{
+		PROFILE_SCOPE("bulk texture load");
+		for (int i = 0; i < options.bulkTextures; i++)
+			textures.push_back(new Texture(bulkTextureSize, bulkTextureSize, &bulkPixels[0]));
+	}
+
+	void Draw(float dt=0.0)
+	{
+        PROFILE_SCOPE("Scene::Draw");
+        std::chrono::steady_clock::time_point textureStart = std::chrono::steady_clock::now();
+        if (frame++ == bulkTextureFrame && options.bulkTextures > 0) LoadBulkTextures();
+        if (textureStreamer) textureStreamer->Update();
+        stats.textureTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - textureStart).count();
+        stats.texturesPending = textureStreamer ? textureStreamer->GetPendingCount() : 0;
+
+        chevy->Control();
+        chevy->Move(dt);
+        UpdateTransforms();
+        if (terrain) UpdateTerrain(terrain->maxLoads);
+        if (broadPhase) UpdateBroadPhase();
+        if (lightGrid) UpdateLightGrid();
+
+        stats.occlusionTime = 0.0;
+        if (options.softwareOcclusion) UpdateSoftwareOcclusion();
+        if (occlusionCuller) {
+            PassTimer timer;
+            timer.Begin("occlusion update");
+            occlusionCuller->Update(objects);
+            stats.occlusionTime += timer.End();
+        }
+        stats.objectsCulled = 0;
+        for (int i = 0; i < objects.size(); i++) if (IsCulled(i)) stats.objectsCulled++;
+
+        stats.submissionTime = 0.0;
+        if (gpuScene) {
+            PROFILE_SCOPE("gpu scene update");
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            mat4 VP = camera.GetViewMatrix() * camera.GetProjectionMatrix();
+            gpuScene->Update(VP, camera.wEye);
+            stats.cullTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            stats.gpuVisibleObjects = gpuScene->visibleObjects;
+            stats.gpuTriangles = gpuScene->triangles;
+            stats.imposters = gpuScene->GetImposterCount();
+        }
+        if (options.meshlets) UpdateMeshlets();
+
+        if (gBuffer) DrawDeferred();
+        else DrawForward();
+	}
+};
+
+Scene scene;
+
+void onInitialization() 
+{
+	if (!options.profileFile.empty())
+	{
+		Profiler::Get().enabled = true;
+		Profiler::Get().BeginFrame();		// frame 0: loading
+	}
+    light = new Light(vec3(.5, .5, .5), vec3(1.5, 1.5, 1.5), vec4(-7.0, 1.0, 20.0, 0.0));
+	SetViewport(options.width, options.height);
+
+	srand(options.seed);
+	shaderManager.SetCacheDirectory(options.shaderCache);
+	scene.Initialize();
+	shaderManager.PrintReport();
+}
+
+void onExit() 
+{
+	printf("exit");
+}
+
+// results still in flight are waited for, so the trace ends with complete frames
+void WriteProfile()
+{
+	if (!Profiler::Get().enabled) return;
+	glFinish();
+	gpuPassQueries.Collect(true);
+	if (Profiler::Get().WriteChromeTrace(options.profileFile)) printf("profile written to %s\n", options.profileFile.c_str());
+	Profiler::Get().PrintSummary();
+}
+
+void SetViewport(int width, int height)
+{
+	camera.SetAspectRatio((float)width / height);
+	scene.SetViewport(width, height);
+	glViewport(0, 0, width, height);
+}
+
+void ClearFrame()
+{
+	glClearColor(0, 0, 1.0, 0); 
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); 
+}
+
+void UpdateCamera(float dt)
+{
+	camera.Control();
+	camera.Move(dt);
+}
+
+void DrawScene(float dt)
+{
+	scene.Draw(dt);
+}
+
+const RenderStats& GetRenderStats()
+{
+	return scene.stats;
+}
+
+int GetObjectCount()
+{
+	return scene.GetObjectCount();
+}
+
+long long RayTraceScene(int width, int height, unsigned char* rgb, int threads)
+{
+	return scene.RayTrace(width, height, rgb, threads);
+}
+
+int PickObject(int x, int y)
+{
+	return scene.Pick(x, y);
+}
+
+void PrintGeometryStats()
+{
+	geometryPool.PrintStats();
+}
+
+bool GetGpuSceneInfo(bool& usesCompute, int& objectCount)
+{
+	GpuScene* gpuScene = scene.GetGpuScene();
+	if (!gpuScene) return false;
+	usesCompute = gpuScene->UsesCompute();
+	objectCount = gpuScene->GetObjectCount();
+	return true;
+}
+
+int CheckGLBudgets()
+{
+#if defined(MESHLOADER_GL_TRACE)
+	GLTrace::Get().BeginFrame();
+	GLTrace::Get().PrintReport();
+	return GLTrace::Get().CheckBudgets(options.glBudgets);
+#else
+	if (options.glBudgets.empty()) return 0;
+	printf("gl budgets need a build with -DMESHLOADER_GL_TRACE\n");
+	return (int)options.glBudgets.size();
+#endif
+}
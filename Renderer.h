@@ -0,0 +1,97 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include "RenderOptions.h"
+
+// per frame measurements of Scene::Draw, times in ms
+struct RenderStats
+{
+	double lightGridTime;		// CPU light list build and upload
+	double depthPassTime;		// depth prepass
+	double shadingPassTime;		// forward: lit draws; deferred: G-buffer fill
+	double lightingPassTime;	// deferred full-screen lighting
+	double shadowPassTime;
+	double occlusionTime;		// query readback and box draws
+	double submissionTime;		// CPU time spent issuing the depth, shading and shadow draws
+	double cullTime;			// GpuScene::Update
+	int objectsCulled, occlusionQueries, occluderTriangles;
+	int drawCalls;				// shading pass draw calls
+	double meshletTime;			// meshlet culling, compaction and upload
+	int meshletsTested, meshletsVisible;
+	unsigned int meshletTrianglesTested, meshletTrianglesVisible;
+	int gpuVisibleObjects;		// GpuScene survivors, -1 if not counted
+	long long gpuTriangles;		// drawn by their commands, -1 if not counted
+	int imposters;				// GpuScene objects drawn as imposters, those fading out included
+	double imposterBakeTime;	// all atlases, while loading
+	long long imposterAtlasBytes;
+	double textureTime;			// texture creation and streaming
+	int texturesPending;		// streamed textures not in place yet
+	double transformTime;		// world matrix propagation
+	int transformNodes;			// world matrices recomputed
+	double broadPhaseTime;		// spatial hash update and pair search
+	int broadPhaseMoves, broadPhasePairs;	// objects that moved, overlapping world boxes
+	double terrainTime;			// node selection, tile reads and vertex uploads
+	int terrainNodes, terrainLoads, terrainResidentTiles;	// drawn, read this frame, in memory
+	unsigned int terrainTriangles;
+	long long terrainResidentBytes, terrainFileBytes;	// heights and vertices in memory, the cooked file
+	float terrainExtent;		// side of the terrain, 0 without one
+	unsigned int fragmentsShaded;	// fragments written by the shading pass, overdraw included
+	unsigned int fragmentsLit;		// fragments that evaluated the lighting equation
+	unsigned int fragmentInvocations;	// shading pass fragment shader runs, where GL_ARB_pipeline_statistics_query exists
+
+	RenderStats()
+	{
+		lightGridTime = depthPassTime = shadingPassTime = lightingPassTime = shadowPassTime = occlusionTime = 0.0;
+		submissionTime = cullTime = meshletTime = textureTime = transformTime = broadPhaseTime = terrainTime = 0.0;
+		meshletsTested = meshletsVisible = 0;
+		meshletTrianglesTested = meshletTrianglesVisible = 0;
+		objectsCulled = occlusionQueries = occluderTriangles = drawCalls = gpuVisibleObjects = texturesPending = 0;
+		transformNodes = broadPhaseMoves = broadPhasePairs = 0;
+		terrainNodes = terrainLoads = terrainResidentTiles = 0;
+		terrainTriangles = 0;
+		terrainResidentBytes = terrainFileBytes = 0;
+		terrainExtent = 0.0f;
+		gpuTriangles = imposterAtlasBytes = 0;
+		imposters = 0;
+		imposterBakeTime = 0.0;
+		fragmentsShaded = fragmentsLit = fragmentInvocations = 0;
+	}
+};
+
+// requested GL version before the context exists, the context's version after
+extern int majorVersion, minorVersion;
+
+// held keys, read by the camera and the avatar
+extern bool keyboardState[256];
+
+// the scene, shaders and textures; needs a current context with its entry points loaded
+void onInitialization();
+void onExit();
+
+void SetViewport(int width, int height);
+void ClearFrame();
+void UpdateCamera(float dt);
+void DrawScene(float dt = 0.0);
+
+const RenderStats& GetRenderStats();
+int GetObjectCount();
+
+// the index of the object seen through viewport pixel (x, y), counted from the top left; -1 for none
+int PickObject(int x, int y);
+
+// the current frame ray traced on the CPU on threads threads (0 for all), see RayTracer.h:
+// width x height RGB pixels with the rows from the bottom, like glReadPixels; returns the rays cast
+long long RayTraceScene(int width, int height, unsigned char* rgb, int threads = 0);
+void PrintGeometryStats();
+
+// false without the GPU driven path, else its mode and number of batched objects
+bool GetGpuSceneInfo(bool& usesCompute, int& objectCount);
+
+void BeginProfilerFrame();
+void WriteProfile();
+
+// GL call report and options.glBudgets check of builds with MESHLOADER_GL_TRACE;
+// returns the number of budgets exceeded
+int CheckGLBudgets();
+
+#endif
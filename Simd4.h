@@ -0,0 +1,89 @@
+#ifndef SIMD4_H
+#define SIMD4_H
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD4_SSE 1
+#include <emmintrin.h>
+#else
+#define SIMD4_SSE 0
+#include <math.h>
+#endif
+
+// four floats processed in lock step; comparisons return all-ones/all-zeros lane
+// masks which are consumed by Select, And, Or and MoveMask. Without SSE2 the
+// same interface falls back to plain scalar loops.
+struct float4
+{
+#if SIMD4_SSE
+	__m128 v;
+
+	float4() {}
+	float4(__m128 v) : v(v) {}
+	float4(float s) : v(_mm_set1_ps(s)) {}
+	float4(float a, float b, float c, float d) : v(_mm_setr_ps(a, b, c, d)) {}
+
+	static float4 Load(const float* p) { return _mm_loadu_ps(p); }
+	void Store(float* p) const { _mm_storeu_ps(p, v); }
+
+	float4 operator+(const float4& o) const { return _mm_add_ps(v, o.v); }
+	float4 operator-(const float4& o) const { return _mm_sub_ps(v, o.v); }
+	float4 operator*(const float4& o) const { return _mm_mul_ps(v, o.v); }
+	float4 operator/(const float4& o) const { return _mm_div_ps(v, o.v); }
+
+	float4 operator<(const float4& o) const { return _mm_cmplt_ps(v, o.v); }
+	float4 operator>(const float4& o) const { return _mm_cmpgt_ps(v, o.v); }
+	float4 operator<=(const float4& o) const { return _mm_cmple_ps(v, o.v); }
+	float4 operator>=(const float4& o) const { return _mm_cmpge_ps(v, o.v); }
+#else
+	float v[4];
+
+	float4() {}
+	float4(float s) { v[0] = v[1] = v[2] = v[3] = s; }
+	float4(float a, float b, float c, float d) { v[0] = a; v[1] = b; v[2] = c; v[3] = d; }
+
+	static float4 Load(const float* p) { return float4(p[0], p[1], p[2], p[3]); }
+	void Store(float* p) const { for (int i = 0; i < 4; i++) p[i] = v[i]; }
+
+	static float Mask(bool b) { unsigned int m = b ? 0xffffffffu : 0u; float f; memcpy(&f, &m, 4); return f; }
+	static unsigned int Bits(float f) { unsigned int m; memcpy(&m, &f, 4); return m; }
+	static float Float(unsigned int m) { float f; memcpy(&f, &m, 4); return f; }
+
+	float4 operator+(const float4& o) const { return float4(v[0] + o.v[0], v[1] + o.v[1], v[2] + o.v[2], v[3] + o.v[3]); }
+	float4 operator-(const float4& o) const { return float4(v[0] - o.v[0], v[1] - o.v[1], v[2] - o.v[2], v[3] - o.v[3]); }
+	float4 operator*(const float4& o) const { return float4(v[0] * o.v[0], v[1] * o.v[1], v[2] * o.v[2], v[3] * o.v[3]); }
+	float4 operator/(const float4& o) const { return float4(v[0] / o.v[0], v[1] / o.v[1], v[2] / o.v[2], v[3] / o.v[3]); }
+
+	float4 operator<(const float4& o) const { return float4(Mask(v[0] < o.v[0]), Mask(v[1] < o.v[1]), Mask(v[2] < o.v[2]), Mask(v[3] < o.v[3])); }
+	float4 operator>(const float4& o) const { return float4(Mask(v[0] > o.v[0]), Mask(v[1] > o.v[1]), Mask(v[2] > o.v[2]), Mask(v[3] > o.v[3])); }
+	float4 operator<=(const float4& o) const { return float4(Mask(v[0] <= o.v[0]), Mask(v[1] <= o.v[1]), Mask(v[2] <= o.v[2]), Mask(v[3] <= o.v[3])); }
+	float4 operator>=(const float4& o) const { return float4(Mask(v[0] >= o.v[0]), Mask(v[1] >= o.v[1]), Mask(v[2] >= o.v[2]), Mask(v[3] >= o.v[3])); }
+#endif
+};
+
+#if SIMD4_SSE
+inline float4 Min(const float4& a, const float4& b) { return _mm_min_ps(a.v, b.v); }
+inline float4 Max(const float4& a, const float4& b) { return _mm_max_ps(a.v, b.v); }
+inline float4 Sqrt(const float4& a) { return _mm_sqrt_ps(a.v); }
+inline float4 And(const float4& a, const float4& b) { return _mm_and_ps(a.v, b.v); }
+inline float4 Or(const float4& a, const float4& b) { return _mm_or_ps(a.v, b.v); }
+inline float4 Select(const float4& mask, const float4& a, const float4& b) { return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)); }
+inline int MoveMask(const float4& mask) { return _mm_movemask_ps(mask.v); }
+// truncating conversion, exact for the small non-negative values used as indices
+inline void StoreInt(const float4& a, int* p) { _mm_storeu_si128((__m128i*)p, _mm_cvttps_epi32(a.v)); }
+#else
+inline float4 Min(const float4& a, const float4& b) { float4 r; for (int i = 0; i < 4; i++) r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i]; return r; }
+inline float4 Max(const float4& a, const float4& b) { float4 r; for (int i = 0; i < 4; i++) r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]; return r; }
+inline float4 Sqrt(const float4& a) { float4 r; for (int i = 0; i < 4; i++) r.v[i] = sqrtf(a.v[i]); return r; }
+inline float4 And(const float4& a, const float4& b) { float4 r; for (int i = 0; i < 4; i++) r.v[i] = float4::Float(float4::Bits(a.v[i]) & float4::Bits(b.v[i])); return r; }
+inline float4 Or(const float4& a, const float4& b) { float4 r; for (int i = 0; i < 4; i++) r.v[i] = float4::Float(float4::Bits(a.v[i]) | float4::Bits(b.v[i])); return r; }
+inline float4 Select(const float4& mask, const float4& a, const float4& b) { float4 r; for (int i = 0; i < 4; i++) r.v[i] = float4::Bits(mask.v[i]) ? a.v[i] : b.v[i]; return r; }
+inline int MoveMask(const float4& mask) { int m = 0; for (int i = 0; i < 4; i++) if (float4::Bits(mask.v[i]) >> 31) m |= 1 << i; return m; }
+inline void StoreInt(const float4& a, int* p) { for (int i = 0; i < 4; i++) p[i] = (int)a.v[i]; }
+#endif
+
+// the inverse of MoveMask: all-ones in the lanes whose bit is set
+inline float4 LaneMask(int lanes) { return float4((float)(lanes & 1), (float)(lanes & 2), (float)(lanes & 4), (float)(lanes & 8)) > float4(0.0f); }
+
+#endif
@@ -0,0 +1,384 @@
+#ifndef SOFTWAREOCCLUSION_H
+#define SOFTWAREOCCLUSION_H
+
+#include <vector>
+#include <map>
+#include <algorithm>
+#include "VectorMath.h"
+#include "Simd4.h"
+#include "ParallelFor.h"
+
+// indexed triangles that only ever go into the occlusion depth buffer
+struct OccluderMesh
+{
+	std::vector<vec3> positions;
+	std::vector<unsigned int> indices;
+
+	int GetTriangleCount() { return (int)indices.size() / 3; }
+
+	// vertex clustering on a grid^3 lattice over the bounds of a triangle soup: the
+	// vertices of a cell merge into their average and collapsed triangles are dropped.
+	// Silhouettes move by up to half a cell, so big occluders want a fine grid.
+	static OccluderMesh* Simplify(const std::vector<vec3>& triangles, int grid)
+	{
+		OccluderMesh* mesh = new OccluderMesh();
+		BoundingBox box;
+		for (unsigned int i = 0; i < triangles.size(); i++) box.Extend(triangles[i]);
+		if (box.IsEmpty()) return mesh;
+
+		vec3 extent = box.max - box.min;
+		float cell[3] = { extent.x / grid, extent.y / grid, extent.z / grid };
+		std::map<int, unsigned int> cells;
+		std::vector<int> counts;
+		std::vector<unsigned int> remap(triangles.size());
+
+		for (unsigned int i = 0; i < triangles.size(); i++)
+		{
+			const vec3& p = triangles[i];
+			float offset[3] = { p.x - box.min.x, p.y - box.min.y, p.z - box.min.z };
+			int c[3];
+			for (int k = 0; k < 3; k++) c[k] = cell[k] > 0.0f ? std::min((int)(offset[k] / cell[k]), grid - 1) : 0;
+			int key = (c[0] * grid + c[1]) * grid + c[2];
+
+			std::map<int, unsigned int>::iterator found = cells.find(key);
+			if (found == cells.end())
+			{
+				found = cells.insert(std::make_pair(key, (unsigned int)mesh->positions.size())).first;
+				mesh->positions.push_back(vec3(0.0, 0.0, 0.0));
+				counts.push_back(0);
+			}
+			unsigned int v = found->second;
+			mesh->positions[v] = mesh->positions[v] + p;
+			counts[v]++;
+			remap[i] = v;
+		}
+		for (unsigned int v = 0; v < mesh->positions.size(); v++) mesh->positions[v] = mesh->positions[v] / (float)counts[v];
+
+		for (unsigned int i = 0; i + 2 < triangles.size(); i += 3)
+		{
+			unsigned int a = remap[i], b = remap[i + 1], c = remap[i + 2];
+			if (a == b || b == c || a == c) continue;
+			mesh->indices.push_back(a);
+			mesh->indices.push_back(b);
+			mesh->indices.push_back(c);
+		}
+		return mesh;
+	}
+};
+
+// CPU occlusion culling without GL: occluder triangles are rasterized into a small
+// depth buffer (nearest depth wins), a max-depth pyramid is built over it, and a
+// bounding box is hidden when its nearest depth lies behind every pyramid texel
+// under its screen rectangle. Depth is NDC z mapped to [0, 1]; rows go bottom up.
+class SoftwareOcclusion
+{
+	// edge functions and depth plane of one screen space triangle
+	struct Triangle
+	{
+		float a[3], b[3], c[3];
+		float zx, zy, z0;
+		int x0, x1, y0, y1;
+	};
+
+	int width, height, stride;
+	mat4 VP;
+	float nearPlane;
+
+	std::vector<vec4> clipPositions;
+	std::vector<float> screenVertices;	// x, y, z of every triangle corner
+	std::vector<Triangle> setup;
+
+	// level 0 is the depth buffer, every other level holds the max of 2x2 texels below
+	std::vector<std::vector<float> > hiZ;
+	std::vector<int> levelWidth, levelHeight;
+
+	void AddScreenVertex(const vec4& p)
+	{
+		float invW = 1.0f / p.v[3];
+		screenVertices.push_back((p.v[0] * invW * 0.5f + 0.5f) * width);
+		screenVertices.push_back((p.v[1] * invW * 0.5f + 0.5f) * height);
+		screenVertices.push_back(p.v[2] * invW * 0.5f + 0.5f);
+	}
+
+	static vec4 Lerp(const vec4& a, const vec4& b, float t)
+	{
+		return vec4(a.v[0] + (b.v[0] - a.v[0]) * t, a.v[1] + (b.v[1] - a.v[1]) * t,
+			a.v[2] + (b.v[2] - a.v[2]) * t, a.v[3] + (b.v[3] - a.v[3]) * t);
+	}
+
+	// the part of the triangle in front of the near plane, as a fan
+	void AddClipTriangle(const vec4& p0, const vec4& p1, const vec4& p2)
+	{
+		const vec4* in[3] = { &p0, &p1, &p2 };
+		int inside = 0, outsideX0 = 0, outsideX1 = 0, outsideY0 = 0, outsideY1 = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			const float* v = in[k]->v;
+			if (v[3] >= nearPlane) inside++;
+			if (v[0] < -v[3]) outsideX0++;
+			if (v[0] > v[3]) outsideX1++;
+			if (v[1] < -v[3]) outsideY0++;
+			if (v[1] > v[3]) outsideY1++;
+		}
+		if (inside == 0 || outsideX0 == 3 || outsideX1 == 3 || outsideY0 == 3 || outsideY1 == 3) return;
+
+		if (inside == 3)
+		{
+			AddScreenVertex(p0); AddScreenVertex(p1); AddScreenVertex(p2);
+			return;
+		}
+
+		vec4 polygon[4];
+		int n = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			const vec4& a = *in[k];
+			const vec4& b = *in[(k + 1) % 3];
+			bool aIn = a.v[3] >= nearPlane, bIn = b.v[3] >= nearPlane;
+			if (aIn) polygon[n++] = a;
+			if (aIn != bIn) polygon[n++] = Lerp(a, b, (nearPlane - a.v[3]) / (b.v[3] - a.v[3]));
+		}
+		for (int k = 1; k + 1 < n; k++)
+		{
+			AddScreenVertex(polygon[0]); AddScreenVertex(polygon[k]); AddScreenVertex(polygon[k + 1]);
+		}
+	}
+
+	void SetupTriangles(int begin, int end)
+	{
+		for (int t = begin; t < end; t++)
+		{
+			const float* v = &screenVertices[t * 9];
+			Triangle& tri = setup[t];
+			float x[3] = { v[0], v[3], v[6] }, y[3] = { v[1], v[4], v[7] }, z[3] = { v[2], v[5], v[8] };
+
+			float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+			if (fabs(area) < 1e-6f)
+			{
+				tri.x0 = tri.y0 = 1; tri.x1 = tri.y1 = 0;
+				continue;
+			}
+			// both windings are occluders; make the edge functions positive inside
+			if (area < 0.0f)
+			{
+				std::swap(x[1], x[2]); std::swap(y[1], y[2]); std::swap(z[1], z[2]);
+				area = -area;
+			}
+			for (int e = 0; e < 3; e++)
+			{
+				int i = e, j = (e + 1) % 3;
+				tri.a[e] = y[i] - y[j];
+				tri.b[e] = x[j] - x[i];
+				tri.c[e] = x[i] * y[j] - x[j] * y[i];
+			}
+			tri.zx = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+			tri.zy = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+			tri.z0 = z[0] - tri.zx * x[0] - tri.zy * y[0];
+
+			// pixels whose centers may be covered
+			tri.x0 = std::max((int)floor(std::min(x[0], std::min(x[1], x[2])) - 0.5f), 0);
+			tri.x1 = std::min((int)ceil(std::max(x[0], std::max(x[1], x[2])) - 0.5f), width - 1);
+			tri.y0 = std::max((int)floor(std::min(y[0], std::min(y[1], y[2])) - 0.5f), 0);
+			tri.y1 = std::min((int)ceil(std::max(y[0], std::max(y[1], y[2])) - 0.5f), height - 1);
+		}
+	}
+
+	// all triangles clipped to the rows [rowBegin, rowEnd), four pixels at a time
+	void RasterizeRows(int rowBegin, int rowEnd)
+	{
+		float* depth = &hiZ[0][0];
+		float4 laneOffset(0.5f, 1.5f, 2.5f, 3.5f), zero(0.0f);
+
+		for (unsigned int t = 0; t < setup.size(); t++)
+		{
+			const Triangle& tri = setup[t];
+			int y0 = std::max(tri.y0, rowBegin), y1 = std::min(tri.y1, rowEnd - 1);
+			if (y0 > y1 || tri.x0 > tri.x1) continue;
+			int x0 = tri.x0 & ~3;
+
+			float4 a0(tri.a[0]), a1(tri.a[1]), a2(tri.a[2]), zx(tri.zx);
+			for (int y = y0; y <= y1; y++)
+			{
+				float py = y + 0.5f;
+				float4 px = float4((float)x0) + laneOffset;
+				float4 e0 = a0 * px + float4(tri.b[0] * py + tri.c[0]);
+				float4 e1 = a1 * px + float4(tri.b[1] * py + tri.c[1]);
+				float4 e2 = a2 * px + float4(tri.b[2] * py + tri.c[2]);
+				float4 z = zx * px + float4(tri.zy * py + tri.z0);
+				float4 step4(4.0f), a0Step = a0 * step4, a1Step = a1 * step4, a2Step = a2 * step4, zStep = zx * step4;
+
+				float* row = depth + y * stride;
+				for (int x = x0; x <= tri.x1; x += 4)
+				{
+					float4 inside = And(And(e0 >= zero, e1 >= zero), e2 >= zero);
+					if (MoveMask(inside))
+					{
+						float4 d = float4::Load(row + x);
+						Select(inside, Min(d, z), d).Store(row + x);
+					}
+					e0 = e0 + a0Step; e1 = e1 + a1Step; e2 = e2 + a2Step; z = z + zStep;
+				}
+			}
+		}
+	}
+
+	void BuildLevel(int level, int rowBegin, int rowEnd)
+	{
+		const std::vector<float>& src = hiZ[level - 1];
+		std::vector<float>& dst = hiZ[level];
+		int srcWidth = levelWidth[level - 1], srcHeight = levelHeight[level - 1];
+		int srcStride = level == 1 ? stride : srcWidth;
+		int w = levelWidth[level];
+
+		for (int y = rowBegin; y < rowEnd; y++)
+		{
+			int sy0 = y * 2, sy1 = std::min(y * 2 + 1, srcHeight - 1);
+			for (int x = 0; x < w; x++)
+			{
+				int sx0 = x * 2, sx1 = std::min(x * 2 + 1, srcWidth - 1);
+				dst[y * w + x] = std::max(std::max(src[sy0 * srcStride + sx0], src[sy0 * srcStride + sx1]),
+					std::max(src[sy1 * srcStride + sx0], src[sy1 * srcStride + sx1]));
+			}
+		}
+	}
+
+	float GetTexel(int level, int x, int y)
+	{
+		return hiZ[level][y * (level == 0 ? stride : levelWidth[level]) + x];
+	}
+
+public:
+	int occluderTriangles;	// triangles rasterized by the last Rasterize
+
+	SoftwareOcclusion(int width = 320, int height = 180) : width(width), height(height)
+	{
+		stride = (width + 3) & ~3;
+		nearPlane = 0.01f;
+		occluderTriangles = 0;
+
+		int w = width, h = height;
+		hiZ.push_back(std::vector<float>(stride * height + 4, 1.0f));
+		levelWidth.push_back(w);
+		levelHeight.push_back(h);
+		while (w > 1 || h > 1)
+		{
+			w = std::max(1, (w + 1) / 2);
+			h = std::max(1, (h + 1) / 2);
+			hiZ.push_back(std::vector<float>(w * h, 1.0f));
+			levelWidth.push_back(w);
+			levelHeight.push_back(h);
+		}
+	}
+
+	int GetWidth() { return width; }
+	int GetHeight() { return height; }
+	int GetLevelCount() { return (int)hiZ.size(); }
+
+	// row-major depth buffer, GetStride() floats per row
+	const float* GetDepth() { return &hiZ[0][0]; }
+	int GetStride() { return stride; }
+
+	// starts a frame; nearPlane is the view depth (clip w) at which occluders are cut
+	void Begin(mat4& viewProjection, float near)
+	{
+		VP = viewProjection;
+		nearPlane = near;
+		screenVertices.clear();
+	}
+
+	void AddOccluder(OccluderMesh& mesh, mat4& M)
+	{
+		mat4 MVP = M * VP;
+		int n = (int)mesh.positions.size();
+		clipPositions.resize(n);
+
+		// four vertices at a time, as in LightGrid::Build
+		for (int b = 0; b < n; b += 4)
+		{
+			float px[4], py[4], pz[4];
+			for (int k = 0; k < 4; k++)
+			{
+				const vec3& p = mesh.positions[std::min(b + k, n - 1)];
+				px[k] = p.x; py[k] = p.y; pz[k] = p.z;
+			}
+			float4 x = float4::Load(px), y = float4::Load(py), z = float4::Load(pz);
+			float out[4][4];
+			for (int c = 0; c < 4; c++)
+				(x * MVP.m[0][c] + y * MVP.m[1][c] + z * MVP.m[2][c] + MVP.m[3][c]).Store(out[c]);
+			for (int k = 0; k < 4 && b + k < n; k++) clipPositions[b + k] = vec4(out[0][k], out[1][k], out[2][k], out[3][k]);
+		}
+
+		for (unsigned int i = 0; i + 2 < mesh.indices.size(); i += 3)
+			AddClipTriangle(clipPositions[mesh.indices[i]], clipPositions[mesh.indices[i + 1]], clipPositions[mesh.indices[i + 2]]);
+	}
+
+	// fills the depth buffer with everything added since Begin and builds the pyramid
+	void Rasterize(ThreadPool* pool = 0)
+	{
+		if (!pool) pool = &ThreadPool::Global();
+
+		int n = (int)screenVertices.size() / 9;
+		occluderTriangles = n;
+		setup.resize(n);
+		pool->ParallelFor(n, [&](int begin, int end) { SetupTriangles(begin, end); });
+
+		std::fill(hiZ[0].begin(), hiZ[0].end(), 1.0f);
+		const int bandHeight = 4;
+		pool->ParallelFor((height + bandHeight - 1) / bandHeight, [&](int begin, int end)
+		{
+			RasterizeRows(begin * bandHeight, std::min(end * bandHeight, height));
+		}, 1);
+
+		for (int level = 1; level < GetLevelCount(); level++)
+		{
+			if (levelHeight[level] >= 16)
+				pool->ParallelFor(levelHeight[level], [&](int begin, int end) { BuildLevel(level, begin, end); });
+			else
+				BuildLevel(level, 0, levelHeight[level]);
+		}
+	}
+
+	// false when the world space box is outside the view or behind the occluders
+	bool IsVisible(const BoundingBox& box)
+	{
+		if (box.IsEmpty()) return true;
+
+		float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, minZ = 1e30f;
+		for (int i = 0; i < 8; i++)
+		{
+			vec4 p = vec4(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y, i & 4 ? box.max.z : box.min.z, 1.0) * VP;
+			// crosses the near plane
+			if (p.v[3] < nearPlane) return true;
+			float invW = 1.0f / p.v[3];
+			float x = (p.v[0] * invW * 0.5f + 0.5f) * width, y = (p.v[1] * invW * 0.5f + 0.5f) * height;
+			minX = std::min(minX, x); maxX = std::max(maxX, x);
+			minY = std::min(minY, y); maxY = std::max(maxY, y);
+			minZ = std::min(minZ, p.v[2] * invW * 0.5f + 0.5f);
+		}
+		if (maxX < 0.0f || maxY < 0.0f || minX > width || minY > height || minZ > 1.0f) return false;
+
+		int x0 = std::max((int)minX, 0), x1 = std::min((int)maxX, width - 1);
+		int y0 = std::max((int)minY, 0), y1 = std::min((int)maxY, height - 1);
+
+		// coarsest level where the rectangle spans at most 2x2 texels
+		int level = 0;
+		while (level + 1 < GetLevelCount() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1)) level++;
+
+		for (int y = y0 >> level; y <= y1 >> level; y++)
+			for (int x = x0 >> level; x <= x1 >> level; x++)
+				if (GetTexel(level, x, y) >= minZ) return true;
+		return false;
+	}
+
+	void TestBoxes(const std::vector<BoundingBox>& boxes, std::vector<char>& visible, ThreadPool* pool = 0)
+	{
+		if (!pool) pool = &ThreadPool::Global();
+		visible.resize(boxes.size());
+		pool->ParallelFor((int)boxes.size(), [&](int begin, int end)
+		{
+			for (int i = begin; i < end; i++) visible[i] = IsVisible(boxes[i]);
+		});
+	}
+};
+
+#endif
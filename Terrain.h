@@ -0,0 +1,421 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include "VectorMath.h"
+
+struct TerrainHeader
+{
+	char magic[4];				// "TERC"
+	unsigned int version;
+	int tileSize;				// quads on a tile's side, even
+	int levels;
+	float size;					// side of the whole terrain, centered on the origin
+	float minHeight, maxHeight;	// heights are quantized in steps of (maxHeight - minHeight) / 65536
+	float rootMin, rootMax;		// the heights of the whole terrain
+};
+
+// a node's heights, (tileSize + 1) squared in rows along x from the node's low z edge
+struct TerrainTile
+{
+	long long node;
+	int level, x, z;
+	std::vector<float> heights;
+	float childMin[4], childMax[4];		// the full resolution heights under each child, (0, 0) (1, 0) (0, 1) (1, 1)
+	int lastUsed;
+};
+
+// a cooked heightmap as a quadtree of tiles, the root covering the whole terrain and every
+// level halving the spacing. A coarser tile is every second sample of the finer ones, so
+// the vertices levels share have the same height. File layout: header, then the tiles level
+// by level, the nodes of a level in rows along x; a tile is its quantized heights followed
+// by the height ranges under its four children, so the children can be culled before they
+// are read.
+class TerrainFile
+{
+	FILE* file;
+	TerrainHeader header;
+
+	static long long TileBytes(int tileSize) { return (long long)(tileSize + 1) * (tileSize + 1) * sizeof(unsigned short) + 8 * sizeof(float); }
+
+	static unsigned short Quantize(float h, float minHeight, float maxHeight)
+	{
+		float q = floorf((h - minHeight) / (maxHeight - minHeight) * 65536.0f + 0.5f);
+		return (unsigned short)std::min(std::max(q, 0.0f), 65535.0f);
+	}
+
+	static float Dequantize(unsigned short q, float minHeight, float maxHeight) { return minHeight + q * ((maxHeight - minHeight) / 65536.0f); }
+
+public:
+	static const unsigned int version = 1;
+
+	// levels before this one, then rows
+	static long long NodeIndex(int level, int x, int z) { return ((1LL << 2 * level) - 1) / 3 + ((long long)z << level) + x; }
+
+	TerrainFile() : file(0) { memset(&header, 0, sizeof(header)); }
+	~TerrainFile() { if (file) fclose(file); }
+
+	const TerrainHeader& GetHeader() const { return header; }
+	float GetNodeSize(int level) const { return header.size / (1 << level); }
+	long long GetFileSize() const { return sizeof(header) + NodeIndex(header.levels, 0, 0) * TileBytes(header.tileSize); }
+
+	// false for a missing, truncated or foreign file
+	bool Open(const std::string& filename)
+	{
+		if (file) fclose(file);
+		file = fopen(filename.c_str(), "rb");
+		if (!file) return false;
+		bool valid = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, "TERC", 4) == 0 && header.version == version &&
+			header.tileSize > 0 && header.tileSize % 2 == 0 && header.levels > 0 && header.levels <= 16;
+		if (valid)
+		{
+			fseek(file, 0, SEEK_END);
+			valid = ftell(file) == GetFileSize();
+		}
+		if (!valid)
+		{
+			fclose(file);
+			file = 0;
+		}
+		return valid;
+	}
+
+	bool ReadTile(int level, int x, int z, TerrainTile& tile)
+	{
+		int n = header.tileSize + 1;
+		std::vector<unsigned short> quantized(n * n);
+		if (!file || fseek(file, (long)(sizeof(header) + NodeIndex(level, x, z) * TileBytes(header.tileSize)), SEEK_SET) != 0) return false;
+		if (fread(&quantized[0], sizeof(unsigned short), n * n, file) != n * n || fread(tile.childMin, sizeof(float), 4, file) != 4 ||
+			fread(tile.childMax, sizeof(float), 4, file) != 4) return false;
+		tile.node = NodeIndex(level, x, z);
+		tile.level = level;
+		tile.x = x;
+		tile.z = z;
+		tile.heights.resize(n * n);
+		for (int i = 0; i < n * n; i++) tile.heights[i] = Dequantize(quantized[i], header.minHeight, header.maxHeight);
+		return true;
+	}
+
+	// height(x, z) at every sample of a terrain size on a side; the finest spacing is
+	// size / (tileSize << (levels - 1))
+	static bool Cook(const std::string& filename, float size, int levels, int tileSize, float minHeight, float maxHeight, float (*height)(float, float))
+	{
+		FILE* out = fopen(filename.c_str(), "wb");
+		if (!out)
+		{
+			printf("cannot write %s\n", filename.c_str());
+			return false;
+		}
+		TerrainHeader cooked;
+		memset(&cooked, 0, sizeof(cooked));
+		memcpy(cooked.magic, "TERC", 4);
+		cooked.version = version;
+		cooked.tileSize = tileSize;
+		cooked.levels = levels;
+		cooked.size = size;
+		cooked.minHeight = minHeight;
+		cooked.maxHeight = maxHeight;
+
+		// finest level first, so that every tile knows the heights under its children
+		int n = tileSize + 1, finest = levels - 1;
+		float spacing = size / ((long long)tileSize << finest);
+		std::vector<float> mins, maxs, childMins, childMaxs;
+		std::vector<unsigned short> quantized(n * n);
+		for (int level = finest; level >= 0; level--)
+		{
+			int count = 1 << level, step = 1 << (finest - level);
+			mins.assign((size_t)count * count, 1e30f);
+			maxs.assign((size_t)count * count, -1e30f);
+			for (int z = 0; z < count; z++)
+				for (int x = 0; x < count; x++)
+				{
+					int node = z * count + x;
+					float bounds[8] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+					for (int j = 0; j < n; j++)
+						for (int i = 0; i < n; i++)
+						{
+							// in finest samples, so that the levels agree to the bit
+							long long gx = ((long long)x * tileSize + i) * step, gz = ((long long)z * tileSize + j) * step;
+							quantized[j * n + i] = Quantize(height(-0.5f * size + gx * spacing, -0.5f * size + gz * spacing), minHeight, maxHeight);
+							float h = Dequantize(quantized[j * n + i], minHeight, maxHeight);
+							mins[node] = std::min(mins[node], h);
+							maxs[node] = std::max(maxs[node], h);
+						}
+					if (level < finest)
+						for (int c = 0; c < 4; c++)
+						{
+							int child = (2 * z + (c >> 1)) * 2 * count + 2 * x + (c & 1);
+							bounds[c] = childMins[child];
+							bounds[4 + c] = childMaxs[child];
+							mins[node] = std::min(mins[node], childMins[child]);
+							maxs[node] = std::max(maxs[node], childMaxs[child]);
+						}
+					fseek(out, (long)(sizeof(cooked) + NodeIndex(level, x, z) * TileBytes(tileSize)), SEEK_SET);
+					fwrite(&quantized[0], sizeof(unsigned short), n * n, out);
+					fwrite(bounds, sizeof(float), 8, out);
+				}
+			childMins.swap(mins);
+			childMaxs.swap(maxs);
+		}
+		cooked.rootMin = childMins[0];
+		cooked.rootMax = childMaxs[0];
+		fseek(out, 0, SEEK_SET);
+		fwrite(&cooked, sizeof(cooked), 1, out);
+		bool written = ferror(out) == 0;
+		fclose(out);
+		if (!written) printf("cannot write %s\n", filename.c_str());
+		return written;
+	}
+};
+
+// value noise on the integer lattice, in [-1, 1]
+inline float LatticeNoise(float x, float z)
+{
+	struct Hash
+	{
+		static float At(int i, int j)
+		{
+			unsigned int h = (unsigned int)i * 374761393u + (unsigned int)j * 668265263u;
+			h = (h ^ (h >> 13)) * 1274126177u;
+			return (h ^ (h >> 16)) / 2147483647.5f - 1.0f;
+		}
+	};
+	float fx = floorf(x), fz = floorf(z), ax = x - fx, az = z - fz;
+	ax = ax * ax * (3.0f - 2.0f * ax);
+	az = az * az * (3.0f - 2.0f * az);
+	int i = (int)fx, j = (int)fz;
+	float low = Hash::At(i, j) + (Hash::At(i + 1, j) - Hash::At(i, j)) * ax;
+	float high = Hash::At(i, j + 1) + (Hash::At(i + 1, j + 1) - Hash::At(i, j + 1)) * ax;
+	return low + (high - low) * az;
+}
+
+// rolling hills within [-4, 4], flat within 8 of the origin where the scene stands
+inline float RollingHills(float x, float z)
+{
+	float h = 0.0f, amplitude = 2.0f, frequency = 1.0f / 16.0f;
+	for (int octave = 0; octave < 5; octave++, amplitude *= 0.5f, frequency *= 2.0f)
+		h += amplitude * LatticeNoise(x * frequency + 17.0f * octave, z * frequency);
+	float t = std::min(std::max((sqrtf(x * x + z * z) - 8.0f) / 8.0f, 0.0f), 1.0f);
+	return h * t * t * (3.0f - 2.0f * t);
+}
+
+// what a frame draws of a TerrainFile, after Strugar's continuous distance-dependent LOD: a
+// node is split where its box comes within the range of the next finer level, the ranges
+// halving with every level, and the vertices of a level morph to the next coarser one over
+// the last quarter of its range, so neighbours of different levels meet without cracks.
+// The selection is culled against the frustum node by node and kept under maxNodes by
+// giving up the finest levels. Tiles are read as the selection reaches them, at most a
+// few per frame and coarse first; until a node's visible children are all in memory the
+// node is drawn instead. Tiles the selection no longer visits are dropped oldest first
+// beyond maxResident.
+class TerrainQuadtree
+{
+	struct Request
+	{
+		int level, x, z;
+		float distance;
+
+		bool operator<(const Request& other) const { return level != other.level ? level < other.level : distance < other.distance; }
+	};
+
+	TerrainFile file;
+	std::map<long long, TerrainTile*> tiles;
+	std::vector<Request> requests;
+	int frame;
+	bool failed;
+
+	static float Distance(const BoundingBox& box, const vec3& p)
+	{
+		float dx = std::max(std::max(box.min.x - p.x, p.x - box.max.x), 0.0f);
+		float dy = std::max(std::max(box.min.y - p.y, p.y - box.max.y), 0.0f);
+		float dz = std::max(std::max(box.min.z - p.z, p.z - box.max.z), 0.0f);
+		return sqrtf(dx * dx + dy * dy + dz * dz);
+	}
+
+	TerrainTile* Find(long long node) const
+	{
+		std::map<long long, TerrainTile*>::const_iterator it = tiles.find(node);
+		return it == tiles.end() ? 0 : it->second;
+	}
+
+	TerrainTile* Load(int level, int x, int z)
+	{
+		TerrainTile* tile = new TerrainTile();
+		if (!file.ReadTile(level, x, z, *tile))
+		{
+			if (!failed) printf("cannot read terrain tile %d of level %d\n", (int)TerrainFile::NodeIndex(level, x, z), level);
+			failed = true;
+			delete tile;
+			return 0;
+		}
+		tile->lastUsed = frame;
+		tiles[tile->node] = tile;
+		loaded.push_back(tile);
+		return tile;
+	}
+
+	void Select(const Frustum& frustum, const vec3& eye, int level, int x, int z, float minHeight, float maxHeight)
+	{
+		BoundingBox box = GetBox(level, x, z, minHeight, maxHeight);
+		if (!frustum.IntersectsBox(box)) return;
+		TerrainTile* tile = Find(TerrainFile::NodeIndex(level, x, z));
+		tile->lastUsed = frame;
+		if (level < finestLevel && Distance(box, eye) < GetRange(level + 1))
+		{
+			bool ready = true;
+			for (int c = 0; c < 4; c++)
+			{
+				int cx = 2 * x + (c & 1), cz = 2 * z + (c >> 1);
+				BoundingBox childBox = GetBox(level + 1, cx, cz, tile->childMin[c], tile->childMax[c]);
+				if (!frustum.IntersectsBox(childBox) || Find(TerrainFile::NodeIndex(level + 1, cx, cz))) continue;
+				Request request = { level + 1, cx, cz, Distance(childBox, eye) };
+				requests.push_back(request);
+				ready = false;
+			}
+			if (ready)
+			{
+				for (int c = 0; c < 4; c++) Select(frustum, eye, level + 1, 2 * x + (c & 1), 2 * z + (c >> 1), tile->childMin[c], tile->childMax[c]);
+				return;
+			}
+		}
+		selection.push_back(tile);
+	}
+
+public:
+	float rangeFactor;		// a level's range in its node sizes; below 6 the levels can jump by two
+	int maxNodes;			// the vertex budget, in tiles
+	int maxResident;
+
+	std::vector<TerrainTile*> selection;	// to draw this frame
+	std::vector<TerrainTile*> loaded;		// read this frame
+	std::vector<long long> evicted;			// dropped this frame
+	int finestLevel;						// the finest level the budget allowed this frame
+
+	TerrainQuadtree() : frame(0), failed(false), rangeFactor(6.0f), maxNodes(256), maxResident(1024), finestLevel(0) {}
+
+	~TerrainQuadtree()
+	{
+		for (std::map<long long, TerrainTile*>::iterator it = tiles.begin(); it != tiles.end(); ++it) delete it->second;
+	}
+
+	// the root stays in memory
+	bool Open(const std::string& filename)
+	{
+		return file.Open(filename) && Load(0, 0, 0) != 0;
+	}
+
+	const TerrainHeader& GetHeader() const { return file.GetHeader(); }
+	long long GetFileSize() const { return file.GetFileSize(); }
+	float GetNodeSize(int level) const { return file.GetNodeSize(level); }
+	float GetRange(int level) const { return rangeFactor * GetNodeSize(level); }
+
+	BoundingBox GetBox(int level, int x, int z, float minHeight, float maxHeight) const
+	{
+		float s = GetNodeSize(level), x0 = -0.5f * GetHeader().size + x * s, z0 = -0.5f * GetHeader().size + z * s;
+		BoundingBox box;
+		box.Extend(vec3(x0, minHeight, z0));
+		box.Extend(vec3(x0 + s, maxHeight, z0 + s));
+		return box;
+	}
+
+	// the morph of a level's vertices starts and ends at these distances from the eye
+	void GetMorphRange(int level, float& start, float& end) const
+	{
+		end = level > 0 ? GetRange(level) : 2e30f;
+		start = level > 0 ? 0.75f * end : 1e30f;
+	}
+
+	int GetResidentCount() const { return (int)tiles.size(); }
+	long long GetResidentBytes() const
+	{
+		int n = GetHeader().tileSize + 1;
+		return (long long)tiles.size() * (sizeof(TerrainTile) + n * n * sizeof(float));
+	}
+	long long GetTriangleCount() const { return (long long)selection.size() * GetHeader().tileSize * GetHeader().tileSize * 2; }
+	int GetPendingCount() const { return (int)requests.size(); }
+
+	// eye and VP in the terrain's space
+	void Update(const vec3& eye, const mat4& VP, int maxLoads)
+	{
+		frame++;
+		loaded.clear();
+		evicted.clear();
+		if (tiles.empty()) return;
+		Frustum frustum(VP);
+		for (finestLevel = GetHeader().levels - 1; ; finestLevel--)
+		{
+			selection.clear();
+			requests.clear();
+			Select(frustum, eye, 0, 0, 0, GetHeader().rootMin, GetHeader().rootMax);
+			if (selection.size() <= maxNodes || finestLevel == 0) break;
+		}
+
+		std::sort(requests.begin(), requests.end());
+		for (int i = 0; i < requests.size() && i < maxLoads && !failed; i++) Load(requests[i].level, requests[i].x, requests[i].z);
+
+		if (tiles.size() <= maxResident) return;
+		std::vector<std::pair<int, TerrainTile*> > unused;
+		for (std::map<long long, TerrainTile*>::iterator it = tiles.begin(); it != tiles.end(); ++it)
+			if (it->second->lastUsed < frame && it->second->level > 0) unused.push_back(std::make_pair(it->second->lastUsed, it->second));
+		std::sort(unused.begin(), unused.end());
+		for (int i = 0; i < unused.size() && tiles.size() > maxResident; i++)
+		{
+			evicted.push_back(unused[i].second->node);
+			tiles.erase(unused[i].second->node);
+			delete unused[i].second;
+		}
+	}
+
+	// for the format { 4, 4, 3 }: the position with w = 1; the height of the next coarser
+	// level at the vertex and the tile's morph range; the normal
+	void BuildVertices(const TerrainTile& tile, std::vector<float>& vertices) const
+	{
+		int tileSize = GetHeader().tileSize, n = tileSize + 1, step = 1 << (GetHeader().levels - 1 - tile.level);
+		float size = GetHeader().size, finestSpacing = size / ((long long)tileSize << (GetHeader().levels - 1)), spacing = finestSpacing * step;
+		float start, end;
+		GetMorphRange(tile.level, start, end);
+		const std::vector<float>& h = tile.heights;
+		vertices.resize(n * n * 11);
+		for (int j = 0; j < n; j++)
+			for (int i = 0; i < n; i++)
+			{
+				float* v = &vertices[(j * n + i) * 11];
+				// odd vertices lie on the coarser level's edges and diagonals, see BuildIndices
+				float coarse = h[j * n + i];
+				if (i % 2 && j % 2) coarse = 0.5f * (h[(j - 1) * n + i - 1] + h[(j + 1) * n + i + 1]);
+				else if (i % 2) coarse = 0.5f * (h[j * n + i - 1] + h[j * n + i + 1]);
+				else if (j % 2) coarse = 0.5f * (h[(j - 1) * n + i] + h[(j + 1) * n + i]);
+				float dx = (h[j * n + std::min(i + 1, tileSize)] - h[j * n + std::max(i - 1, 0)]) / ((std::min(i + 1, tileSize) - std::max(i - 1, 0)) * spacing);
+				float dz = (h[std::min(j + 1, tileSize) * n + i] - h[std::max(j - 1, 0) * n + i]) / ((std::min(j + 1, tileSize) - std::max(j - 1, 0)) * spacing);
+				vec3 normal = vec3(-dx, 1.0f, -dz).normalize();
+				// in finest samples like the cooker, so that neighbours share their edges to the bit
+				float x = -0.5f * size + ((long long)tile.x * tileSize + i) * step * finestSpacing;
+				float z = -0.5f * size + ((long long)tile.z * tileSize + j) * step * finestSpacing;
+				float position[11] = { x, h[j * n + i], z, 1.0f, coarse, start, end, 0.0f, normal.x, normal.y, normal.z };
+				memcpy(v, position, sizeof(position));
+			}
+	}
+
+	// the same for every tile: each quad split along the diagonal from its low x and z corner,
+	// which lines the quads of a level up with the diagonals of the next coarser one
+	static void BuildIndices(int tileSize, std::vector<unsigned int>& indices)
+	{
+		int n = tileSize + 1;
+		indices.clear();
+		for (int j = 0; j < tileSize; j++)
+			for (int i = 0; i < tileSize; i++)
+			{
+				unsigned int a = j * n + i, b = a + 1, c = a + n + 1, d = a + n;
+				unsigned int quad[6] = { a, c, b, a, d, c };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+	}
+};
+
+#endif
@@ -0,0 +1,192 @@
+// CPU benchmark for TerrainQuadtree, no GL needed. Terrains of growing extent, with the
+// same spacing at the finest level, are cooked from RollingHills and flown over low, looking
+// out to the far edge; each frame selects the nodes to draw and reads at most 16 tiles. The
+// table shows what a frame draws and keeps in memory against the extent. At the end of each
+// flight the selection, with every tile it wants read, is checked for cracks: along every
+// edge between two levels the finer side's morphed heights have to lie on the coarser side.
+//   g++ -O2 -std=c++11 TerrainBench.cpp -o TerrainBench
+//   ./TerrainBench [largest extent] [frames]
+
+#define _USE_MATH_DEFINES
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <map>
+#include <vector>
+#include "Terrain.h"
+
+mat4 LookAt(vec3 wEye, vec3 wLookat, vec3 wVup)
+{
+	vec3 w = (wEye - wLookat).normalize();
+	vec3 u = cross(wVup, w).normalize();
+	vec3 v = cross(w, u);
+	return
+		mat4(1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			-wEye.x, -wEye.y, -wEye.z, 1.0f) *
+		mat4(u.x, v.x, w.x, 0.0f,
+			u.y, v.y, w.y, 0.0f,
+			u.z, v.z, w.z, 0.0f,
+			0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+mat4 Perspective(float fov, float asp, float fp, float bp)
+{
+	float sy = 1 / tan(fov / 2);
+	return mat4(
+		sy / asp, 0.0f, 0.0f, 0.0f,
+		0.0f, sy, 0.0f, 0.0f,
+		0.0f, 0.0f, -(fp + bp) / (bp - fp), -1.0f,
+		0.0f, 0.0f, -2 * fp * bp / (bp - fp), 0.0f);
+}
+
+// the height MeshShader's TERRAIN vertices end up at
+float Morphed(const float* v, const vec3& eye)
+{
+	float dx = v[0] - eye.x, dy = v[1] - eye.y, dz = v[2] - eye.z;
+	float morph = std::min(std::max((sqrtf(dx * dx + dy * dy + dz * dz) - v[5]) / (v[6] - v[5]), 0.0f), 1.0f);
+	return v[1] + (v[4] - v[1]) * morph;
+}
+
+// edge vertices of selected tiles whose coarser neighbour's surface is elsewhere; level
+// jumps of more than one count separately
+int CountCracks(const TerrainQuadtree& terrain, const vec3& eye, int& jumps)
+{
+	const TerrainHeader& header = terrain.GetHeader();
+	int n = header.tileSize + 1;
+	std::map<long long, std::vector<float> > vertices;
+	std::map<long long, const TerrainTile*> selected;
+	for (int k = 0; k < terrain.selection.size(); k++)
+	{
+		terrain.BuildVertices(*terrain.selection[k], vertices[terrain.selection[k]->node]);
+		selected[terrain.selection[k]->node] = terrain.selection[k];
+	}
+
+	int cracks = 0;
+	jumps = 0;
+	for (int k = 0; k < terrain.selection.size(); k++)
+	{
+		const TerrainTile* tile = terrain.selection[k];
+		const std::vector<float>& v = vertices[tile->node];
+		for (int side = 0; side < 4; side++)
+		{
+			// sides at low x, high x, low z, high z; along is the coordinate that varies
+			int along = side < 2 ? 2 : 0, across = 2 - along, edge = side % 2 ? n - 1 : 0;
+			float outward = side % 2 ? 1.0f : -1.0f;
+			for (int e = 0; e < n; e++)
+			{
+				const float* p = &v[(side < 2 ? e * n + edge : edge * n + e) * 11];
+				float q[3] = { p[0], 0.0f, p[2] };
+				// just across the side, and inside it at the corners
+				float nudge = 0.25f * terrain.GetNodeSize(header.levels - 1) / header.tileSize;
+				q[across] += outward * nudge;
+				q[along] += e == 0 ? nudge : e == n - 1 ? -nudge : 0.0f;
+				const TerrainTile* neighbour = 0;
+				for (int level = tile->level - 1; level >= 0 && !neighbour; level--)
+				{
+					float s = terrain.GetNodeSize(level);
+					int x = (int)floorf((q[0] + 0.5f * header.size) / s), z = (int)floorf((q[2] + 0.5f * header.size) / s);
+					if (x < 0 || z < 0 || x >= (1 << level) || z >= (1 << level)) break;
+					std::map<long long, const TerrainTile*>::iterator it = selected.find(TerrainFile::NodeIndex(level, x, z));
+					if (it != selected.end()) neighbour = it->second;
+				}
+				if (!neighbour) continue;
+				if (neighbour->level < tile->level - 1) jumps++;
+
+				// the neighbour's facing edge, linear between its vertices
+				const std::vector<float>& w = vertices[neighbour->node];
+				int facing = side % 2 ? 0 : n - 1;
+				const float* first = &w[(side < 2 ? facing : facing * n) * 11];
+				float spacing = terrain.GetNodeSize(neighbour->level) / header.tileSize;
+				float t = (p[along] - first[along]) / spacing;
+				int i = std::min(std::max((int)floorf(t), 0), n - 2);
+				const float* a = &w[(side < 2 ? i * n + facing : facing * n + i) * 11];
+				const float* b = &w[(side < 2 ? (i + 1) * n + facing : facing * n + i + 1) * 11];
+				float h = Morphed(a, eye) + (Morphed(b, eye) - Morphed(a, eye)) * (t - i);
+				if (fabsf(Morphed(p, eye) - h) > 1e-3f) cracks++;
+			}
+		}
+	}
+	return cracks;
+}
+
+double Milliseconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+	int largest = argc > 1 ? atoi(argv[1]) : 512;
+	int frames = argc > 2 ? atoi(argv[2]) : 120;
+	const int tileSize = 16, maxLoads = 16;
+	const float leafSize = 2.0f;
+
+	int errors = 0;
+	printf("finest spacing %.3f, %d quads per tile side, %d tile reads per frame\n", leafSize / tileSize, tileSize, maxLoads);
+	printf("extent\tlevels\tfile MB\tnodes\ttriangles\tfull res triangles\tresident tiles\tresident KB\treads/frame\tupdate ms\tcracks\n");
+	for (int extent = 64; extent <= largest; extent *= 2)
+	{
+		int levels = 1;
+		while (leafSize * (1 << (levels - 1)) < extent) levels++;
+		char filename[64];
+		sprintf(filename, "TerrainBench%d.ter", extent);
+		if (!TerrainFile::Cook(filename, (float)extent, levels, tileSize, -4.0f, 4.0f, RollingHills))
+		{
+			errors++;
+			continue;
+		}
+
+		TerrainQuadtree terrain;
+		if (!terrain.Open(filename))
+		{
+			printf("cannot open %s\n", filename);
+			errors++;
+			continue;
+		}
+		// across the middle at twice the hills' height, looking ahead and a little down
+		mat4 P = Perspective(M_PI / 3.0, 16.0f / 9.0f, 0.1f, 2.0f * extent);
+		double updateTime = 0.0, nodes = 0.0, triangles = 0.0, reads = 0.0;
+		vec3 eye, ahead;
+		mat4 VP;
+		for (int frame = 0; frame < frames; frame++)
+		{
+			float t = (float)frame / frames, angle = 0.7f + 1.3f * t;
+			eye = vec3(-0.25f * extent + 0.5f * extent * t, 8.0f, -0.2f * extent + 0.4f * extent * t);
+			ahead = vec3(cosf(angle), -0.15f, sinf(angle));
+			VP = LookAt(eye, eye + ahead, vec3(0.0f, 1.0f, 0.0f)) * P;
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			terrain.Update(eye, VP, maxLoads);
+			updateTime += Milliseconds(start);
+			nodes += terrain.selection.size();
+			triangles += terrain.GetTriangleCount();
+			reads += terrain.loaded.size();
+		}
+		if (terrain.selection.size() > terrain.maxNodes)
+		{
+			printf("extent %d: %d nodes over the budget of %d\n", extent, (int)terrain.selection.size(), terrain.maxNodes);
+			errors++;
+		}
+
+		// everything the last view wants, then no cracks
+		for (int i = 0; i < 64 && (i == 0 || terrain.GetPendingCount() > 0); i++) terrain.Update(eye, VP, 1 << 30);
+		int jumps, cracks = CountCracks(terrain, eye, jumps);
+		if (cracks || jumps)
+		{
+			printf("extent %d: %d cracked vertices, %d level jumps\n", extent, cracks, jumps);
+			errors++;
+		}
+
+		double fullTriangles = 2.0 * pow((double)tileSize * (1 << (levels - 1)), 2.0);
+		int n = tileSize + 1;
+		long long residentBytes = terrain.GetResidentBytes() + (long long)terrain.GetResidentCount() * n * n * 11 * sizeof(float);
+		printf("%d\t%d\t%.1f\t%.0f\t%.0f\t\t%.0f\t\t%d\t\t%lld\t\t%.2f\t\t%.3f\t\t%d\n", extent, levels, terrain.GetFileSize() / 1048576.0,
+			nodes / frames, triangles / frames, fullTriangles, terrain.GetResidentCount(), residentBytes / 1024, reads / frames, updateTime / frames, cracks);
+		remove(filename);
+	}
+	printf("resident KB: heights in memory and their vertices at 44 bytes each\n");
+	printf("check: %s\n", errors ? "failed" : "selections within budget and without cracks");
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,169 @@
+// CPU benchmark for TransformGraph, no GL needed. The nodes form hierarchies of 64, each a
+// random tree like a skeleton; every frame 1% of the nodes (or the given fraction) get a new
+// local matrix and Update propagates them. The world matrices are checked against a plain
+// pass over every node in creation order, which is also timed for comparison, as is a
+// full Update of every node and removing them all.
+//   g++ -O2 -std=c++11 -pthread TransformBench.cpp -o TransformBench
+//   ./TransformBench [nodes] [dirty percent]
+
+#define _USE_MATH_DEFINES
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "TransformGraph.h"
+
+double Milliseconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+float Random() { return (float)rand() / RAND_MAX; }
+
+// a turn about y and a move, and its inverse
+void Placement(mat4& M, mat4& InvM)
+{
+	float angle = Random() * 2.0f * M_PI, c = cosf(angle), s = sinf(angle);
+	vec3 t = vec3(Random() - 0.5f, Random() - 0.5f, Random() - 0.5f);
+	M = mat4(c, 0.0f, s, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, -s, 0.0f, c, 0.0f, t.x, t.y, t.z, 1.0f);
+	InvM = mat4(1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, -t.x, -t.y, -t.z, 1.0f) *
+		mat4(c, 0.0f, -s, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, s, 0.0f, c, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+// the reference: one struct per node, every node in creation order, parents first
+struct Node
+{
+	int parent;
+	mat4 local, inverseLocal, world, inverseWorld;
+};
+
+void PropagateAll(std::vector<Node>& nodes)
+{
+	for (int i = 0; i < nodes.size(); i++)
+	{
+		Node& node = nodes[i];
+		if (node.parent < 0)
+		{
+			node.world = node.local;
+			node.inverseWorld = node.inverseLocal;
+			continue;
+		}
+		node.world = node.local * nodes[node.parent].world;
+		node.inverseWorld = nodes[node.parent].inverseWorld * node.inverseLocal;
+	}
+}
+
+float Difference(const mat4& a, const mat4& b)
+{
+	float d = 0.0f;
+	for (int i = 0; i < 16; i++) d = std::max(d, fabsf(a.m[i / 4][i % 4] - b.m[i / 4][i % 4]));
+	return d;
+}
+
+int main(int argc, char* argv[])
+{
+	int count = argc > 1 ? atoi(argv[1]) : 1000000;
+	float dirtyPercent = argc > 2 ? (float)atof(argv[2]) : 1.0f;
+	const int groupSize = 64, frames = 30;
+	int dirtyCount = std::max(1, (int)(count * dirtyPercent / 100.0f));
+
+	srand(1);
+	TransformGraph graph;
+	std::vector<Node> nodes(count);
+	std::vector<int> handles(count);
+	for (int i = 0; i < count; i++)
+	{
+		int first = i - i % groupSize;
+		nodes[i].parent = i == first ? -1 : first + rand() % (i - first);
+		Placement(nodes[i].local, nodes[i].inverseLocal);
+		handles[i] = graph.Add(nodes[i].parent < 0 ? -1 : handles[nodes[i].parent]);
+		graph.SetLocal(handles[i], nodes[i].local, nodes[i].inverseLocal);
+	}
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	graph.Update();
+	printf("%d nodes in %d levels, sorted and propagated in %.1f ms\n", count, graph.GetDepth(), Milliseconds(start));
+
+	int errors = 0;
+	printf("threads\tdirty\tupdated\tupdate ms\tM nodes/s\tall nodes ms\tone struct per node ms\n");
+	std::vector<int> threadCounts = ThreadCounts();
+	for (unsigned int step = 0; step < threadCounts.size(); step++)
+	{
+		int t = threadCounts[step];
+		ThreadPool pool(t);
+		double updateTime = 0.0;
+		long long updated = 0;
+		for (int frame = 0; frame < frames; frame++)
+		{
+			for (int k = 0; k < dirtyCount; k++)
+			{
+				int i = rand() % count;
+				Placement(nodes[i].local, nodes[i].inverseLocal);
+				graph.SetLocal(handles[i], nodes[i].local, nodes[i].inverseLocal);
+			}
+			start = std::chrono::steady_clock::now();
+			updated += graph.Update(&pool);
+			updateTime += Milliseconds(start);
+		}
+
+		// every node: the roots marked, and the same with one struct per node
+		start = std::chrono::steady_clock::now();
+		for (int i = 0; i < count; i += groupSize) graph.SetLocal(handles[i], nodes[i].local, nodes[i].inverseLocal);
+		graph.Update(&pool);
+		double allTime = Milliseconds(start);
+		start = std::chrono::steady_clock::now();
+		PropagateAll(nodes);
+		double structTime = Milliseconds(start);
+
+		for (int i = 0; i < count; i++)
+		{
+			float d = std::max(Difference(graph.GetWorld(handles[i]), nodes[i].world), Difference(graph.GetInverseWorld(handles[i]), nodes[i].inverseWorld));
+			if (d > 1e-4f && errors++ < 5) printf("node %d: world matrices differ by %g\n", i, d);
+		}
+		printf("%d\t%d\t%.0f\t%.3f\t\t%.2f\t\t%.3f\t\t%.3f\n", t, dirtyCount, (double)updated / frames, updateTime / frames,
+			updated / (updateTime * 1000.0), allTime, structTime);
+	}
+
+	// tearing the scene down a node at a time, parents first so every child becomes a root on the way
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < count; i++) graph.Remove(handles[i]);
+	graph.Update();
+	printf("%d nodes removed in %.1f ms\n", count, Milliseconds(start));
+	if (graph.GetNodeCount() != 0 || graph.GetDepth() != 0)
+	{
+		printf("remove: %d nodes left\n", graph.GetNodeCount());
+		errors++;
+	}
+
+	// reparenting sorts again, removed nodes hand their children to the roots, cycles are refused
+	TransformGraph small;
+	mat4 M, InvM;
+	Placement(M, InvM);
+	int a = small.Add(), b = small.Add(a), c = small.Add(b);
+	small.SetLocal(a, M, InvM);
+	small.SetParent(a, c);
+	small.Update();
+	bool moved = Difference(small.GetWorld(c), M) < 1e-6f;
+	small.SetParent(c, -1);
+	small.Remove(b);
+	small.Update();
+	if (small.GetParent(a) != -1 || small.GetParent(c) != -1 || !moved || small.GetNodeCount() != 2 || small.GetDepth() != 1)
+	{
+		printf("reparent and remove: wrong parents or matrices\n");
+		errors++;
+	}
+	int d = small.Add(a), e = small.Add(a), f = small.Add(a);
+	small.Remove(e);
+	small.Remove(a);
+	small.Update();
+	if (small.GetParent(d) != -1 || small.GetParent(f) != -1 || small.GetNodeCount() != 3)
+	{
+		printf("remove: the children of a removed node are not roots\n");
+		errors++;
+	}
+
+	printf("check: %s\n", errors ? "world matrices differ" : "world matrices match one struct per node");
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,272 @@
+#ifndef TRANSFORMGRAPH_H
+#define TRANSFORMGRAPH_H
+
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include "VectorMath.h"
+#include "Simd4.h"
+#include "ParallelFor.h"
+
+// parent-child transforms: every node has a local matrix relative to its parent, and the
+// world matrix is local * parent's world (row vectors, like the rest of the renderer), with
+// the inverses kept alongside so that nothing needs a general inverse. The nodes are stored
+// breadth first, one array per attribute, so the children of a node are contiguous and a
+// level only depends on the one above. SetLocal marks a node; Update goes down the levels
+// and recomputes the marked nodes and everything below them, a level at a time in
+// parallel. Adding, removing or reparenting nodes sorts the arrays again on the next Update,
+// which then recomputes every node.
+class TransformGraph
+{
+	// by handle
+	std::vector<int> parentHandles;		// -1 for a root, freeNode for a removed node
+	std::vector<int> slots;				// index in the arrays below
+	std::vector<int> freeHandles;
+	std::vector<int> firstChildHandles, nextSiblings, previousSiblings;	// -1 for none
+
+	// by index, breadth first
+	std::vector<int> handles, parents, depths, firstChild, childCount, versions;
+	std::vector<mat4> locals, inverseLocals, worlds, inverseWorlds;
+	std::vector<char> marked;
+	std::vector<std::vector<int> > pending;	// marked nodes by depth
+	bool sorted;
+	int version;
+
+	static const int freeNode = -2;
+
+	// into or out of the parent's list of children, which Remove walks instead of every node
+	void Link(int handle)
+	{
+		int p = parentHandles[handle];
+		previousSiblings[handle] = -1;
+		nextSiblings[handle] = -1;
+		if (p < 0) return;
+		int next = firstChildHandles[p];
+		nextSiblings[handle] = next;
+		if (next >= 0) previousSiblings[next] = handle;
+		firstChildHandles[p] = handle;
+	}
+
+	void Unlink(int handle)
+	{
+		int p = parentHandles[handle];
+		if (p < 0) return;
+		int previous = previousSiblings[handle], next = nextSiblings[handle];
+		if (previous >= 0) nextSiblings[previous] = next;
+		else firstChildHandles[p] = next;
+		if (next >= 0) previousSiblings[next] = previous;
+	}
+
+	static mat4 Identity() { return mat4(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1); }
+
+	// a * b a row at a time, the same sums in the same order as mat4::operator*
+	static void Multiply(const mat4& a, const mat4& b, mat4& result)
+	{
+		float4 rows[4] = { float4::Load(b.m[0]), float4::Load(b.m[1]), float4::Load(b.m[2]), float4::Load(b.m[3]) };
+		for (int i = 0; i < 4; i++)
+			(float4(a.m[i][0]) * rows[0] + float4(a.m[i][1]) * rows[1] + float4(a.m[i][2]) * rows[2] + float4(a.m[i][3]) * rows[3]).Store(result.m[i]);
+	}
+
+	void Compute(int i)
+	{
+		int p = parents[i];
+		if (p < 0)
+		{
+			worlds[i] = locals[i];
+			inverseWorlds[i] = inverseLocals[i];
+		}
+		else
+		{
+			Multiply(locals[i], worlds[p], worlds[i]);
+			Multiply(inverseWorlds[p], inverseLocals[i], inverseWorlds[i]);
+		}
+		versions[i] = version;
+	}
+
+	// breadth first from the roots in handle order, each node's children after the ones of
+	// the nodes before it
+	void Sort()
+	{
+		int handleCount = (int)parentHandles.size();
+		std::vector<int> childStart(handleCount + 1, 0), children;
+		for (int h = 0; h < handleCount; h++)
+			if (parentHandles[h] >= 0) childStart[parentHandles[h] + 1]++;
+		for (int h = 0; h < handleCount; h++) childStart[h + 1] += childStart[h];
+		children.resize(childStart[handleCount]);
+		std::vector<int> fill(childStart.begin(), childStart.end() - 1);
+		std::vector<int> order;
+		for (int h = 0; h < handleCount; h++)
+		{
+			if (parentHandles[h] >= 0) children[fill[parentHandles[h]]++] = h;
+			else if (parentHandles[h] == -1) order.push_back(h);
+		}
+
+		std::vector<int> newParents(order.size(), -1), newDepths(order.size(), 0), newFirst, newCount;
+		for (int i = 0; i < order.size(); i++)
+		{
+			int h = order[i];
+			newFirst.push_back((int)order.size());
+			newCount.push_back(childStart[h + 1] - childStart[h]);
+			for (int c = childStart[h]; c < childStart[h + 1]; c++)
+			{
+				order.push_back(children[c]);
+				newParents.push_back(i);
+				newDepths.push_back(newDepths[i] + 1);
+			}
+		}
+
+		std::vector<mat4> newLocals(order.size()), newInverseLocals(order.size());
+		for (int i = 0; i < order.size(); i++)
+		{
+			newLocals[i] = locals[slots[order[i]]];
+			newInverseLocals[i] = inverseLocals[slots[order[i]]];
+		}
+		for (int i = 0; i < order.size(); i++) slots[order[i]] = i;
+		handles.swap(order);
+		parents.swap(newParents);
+		depths.swap(newDepths);
+		firstChild.swap(newFirst);
+		childCount.swap(newCount);
+		locals.swap(newLocals);
+		inverseLocals.swap(newInverseLocals);
+		worlds.resize(handles.size());
+		inverseWorlds.resize(handles.size());
+		versions.assign(handles.size(), -1);
+		marked.assign(handles.size(), 0);
+		pending.assign(handles.empty() ? 0 : depths.back() + 1, std::vector<int>());
+		sorted = true;
+	}
+
+public:
+	TransformGraph() : sorted(true), version(0) {}
+
+	int GetNodeCount() const { return (int)(parentHandles.size() - freeHandles.size()); }
+
+	// the number of levels, roots included, as of the last Update
+	int GetDepth() const { return (int)pending.size(); }
+
+	// a node with an identity local matrix; the handle stays valid until the node is removed
+	int Add(int parent = -1)
+	{
+		int handle;
+		if (!freeHandles.empty()) { handle = freeHandles.back(); freeHandles.pop_back(); }
+		else
+		{
+			handle = (int)parentHandles.size();
+			parentHandles.push_back(-1);
+			slots.push_back(-1);
+			firstChildHandles.push_back(-1);
+			nextSiblings.push_back(-1);
+			previousSiblings.push_back(-1);
+		}
+		parentHandles[handle] = parent;
+		firstChildHandles[handle] = -1;
+		Link(handle);
+		slots[handle] = (int)locals.size();
+		locals.push_back(Identity());
+		inverseLocals.push_back(Identity());
+		sorted = false;
+		return handle;
+	}
+
+	// the children of a removed node become roots
+	void Remove(int handle)
+	{
+		for (int c = firstChildHandles[handle]; c >= 0; c = nextSiblings[c]) parentHandles[c] = -1;
+		firstChildHandles[handle] = -1;
+		Unlink(handle);
+		parentHandles[handle] = freeNode;
+		freeHandles.push_back(handle);
+		sorted = false;
+	}
+
+	int GetParent(int handle) const { return parentHandles[handle]; }
+
+	// -1 for a root; refused where the node would become its own ancestor
+	void SetParent(int handle, int parent)
+	{
+		for (int p = parent; p >= 0; p = parentHandles[p])
+			if (p == handle)
+			{
+				printf("transform %d cannot be a child of its descendant %d\n", handle, parent);
+				return;
+			}
+		if (parentHandles[handle] == parent) return;
+		Unlink(handle);
+		parentHandles[handle] = parent;
+		Link(handle);
+		sorted = false;
+	}
+
+	// M relative to the parent and its inverse, in the world matrices from the next Update
+	void SetLocal(int handle, const mat4& M, const mat4& InvM)
+	{
+		int i = slots[handle];
+		locals[i] = M;
+		inverseLocals[i] = InvM;
+		if (!sorted || marked[i]) return;
+		marked[i] = 1;
+		pending[depths[i]].push_back(i);
+	}
+
+	const mat4& GetLocal(int handle) const { return locals[slots[handle]]; }
+
+	// as of the last Update
+	const mat4& GetWorld(int handle) const { return worlds[slots[handle]]; }
+	const mat4& GetInverseWorld(int handle) const { return inverseWorlds[slots[handle]]; }
+
+	// the Update that last changed the node's world matrix, to tell which ones moved
+	int GetVersion(int handle) const { return versions[slots[handle]]; }
+
+	// the world matrices of the nodes marked since the last Update and their descendants;
+	// returns the number of nodes recomputed
+	int Update(ThreadPool* pool = 0)
+	{
+		if (!pool) pool = &ThreadPool::Global();
+		const int grain = 256;
+		version++;
+		if (!sorted)
+		{
+			Sort();
+			int start = 0;
+			while (start < handles.size())
+			{
+				int end = start;
+				while (end < handles.size() && depths[end] == depths[start]) end++;
+				pool->ParallelFor(end - start, [&](int begin, int stop)
+				{
+					for (int i = start + begin; i < start + stop; i++) Compute(i);
+				}, grain);
+				start = end;
+			}
+			return (int)handles.size();
+		}
+
+		int updated = 0;
+		for (int d = 0; d < pending.size(); d++)
+		{
+			std::vector<int>& nodes = pending[d];
+			if (nodes.empty()) continue;
+			pool->ParallelFor((int)nodes.size(), [&](int begin, int end)
+			{
+				for (int k = begin; k < end; k++) Compute(nodes[k]);
+			}, grain);
+			for (int k = 0; k < nodes.size(); k++)
+			{
+				int i = nodes[k];
+				marked[i] = 0;
+				for (int c = firstChild[i]; c < firstChild[i] + childCount[i]; c++)
+				{
+					if (marked[c]) continue;
+					marked[c] = 1;
+					pending[d + 1].push_back(c);
+				}
+			}
+			updated += (int)nodes.size();
+			nodes.clear();
+		}
+		return updated;
+	}
+};
+
+#endif
@@ -0,0 +1,242 @@
+#ifndef VECTORMATH_H
+#define VECTORMATH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+// row-major matrix 4x4
+struct mat4 
+{
+	float m[4][4];
+public:
+	mat4() {}
+	mat4(float m00, float m01, float m02, float m03,
+		float m10, float m11, float m12, float m13,
+		float m20, float m21, float m22, float m23,
+		float m30, float m31, float m32, float m33) 
+	{
+		m[0][0] = m00; m[0][1] = m01; m[0][2] = m02; m[0][3] = m03;
+		m[1][0] = m10; m[1][1] = m11; m[1][2] = m12; m[1][3] = m13;
+		m[2][0] = m20; m[2][1] = m21; m[2][2] = m22; m[2][3] = m23;
+		m[3][0] = m30; m[3][1] = m31; m[3][2] = m32; m[3][3] = m33;
+	}
+
+	mat4 operator*(const mat4& right) 
+	{
+		mat4 result;
+		for (int i = 0; i < 4; i++) 
+		{
+			for (int j = 0; j < 4; j++) 
+			{
+				result.m[i][j] = 0;
+				for (int k = 0; k < 4; k++) result.m[i][j] += m[i][k] * right.m[k][j];
+			}
+		}
+		return result;
+	}
+	operator float*() { return &m[0][0]; }
+};
+
+
+// 3D point in homogeneous coordinates
+struct vec4 
+{
+	float v[4];
+    float x, y, z, w;
+
+	vec4(float x = 0, float y = 0, float z = 0, float w = 1)  : x(x), y(y), z(z), w(w)
+	{
+		v[0] = x; v[1] = y; v[2] = z; v[3] = w;
+	}
+
+	vec4 operator*(const mat4& mat) 
+	{
+		vec4 result;
+		for (int j = 0; j < 4; j++) 
+		{
+			result.v[j] = 0;
+			for (int i = 0; i < 4; i++) result.v[j] += v[i] * mat.m[i][j];
+		}
+		return result;
+	}
+
+	vec4 operator+(const vec4& vec) 
+	{
+		vec4 result(x + vec.x, y + vec.y, z + vec.z, w + vec.w);
+		return result;
+	}
+};
+
+// 2D point in Cartesian coordinates
+struct vec2 
+{
+	float x, y;
+
+	vec2(float x = 0.0, float y = 0.0) : x(x), y(y) {}
+
+	vec2 operator+(const vec2& v) 
+	{
+		return vec2(x + v.x, y + v.y);
+	}
+
+	vec2 operator*(float s) 
+	{
+		return vec2(x * s, y * s);
+	}
+
+};
+
+// 3D point in Cartesian coordinates
+struct vec3 
+{
+	float x, y, z;
+
+	vec3(float x = 0.0, float y = 0.0, float z = 0.0) : x(x), y(y), z(z) {}
+
+	static vec3 random() { return vec3(((float)rand() / RAND_MAX) * 2 - 1, ((float)rand() / RAND_MAX) * 2 - 1, ((float)rand() / RAND_MAX) * 2 - 1); }
+
+	vec3 operator+(const vec3& v) { return vec3(x + v.x, y + v.y, z + v.z); }
+
+	vec3 operator-(const vec3& v) { return vec3(x - v.x, y - v.y, z - v.z); }
+
+	vec3 operator*(float s) { return vec3(x * s, y * s, z * s); }
+
+	vec3 operator/(float s) { return vec3(x / s, y / s, z / s); }
+
+	float length() { return sqrt(x * x + y * y + z * z); }
+
+	vec3 normalize() { return *this / length(); }
+
+	void print() { printf("%f \t %f \t %f \n", x, y, z); }
+};
+
+inline vec3 cross(const vec3& a, const vec3& b)
+{
+	return vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x );
+}
+
+inline float dot(vec3& a, vec3& b) {
+    return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+// general 4x4 inverse by cofactor expansion; a singular matrix is returned unchanged
+inline mat4 inverse(const mat4& a)
+{
+	const float* m = &a.m[0][0];
+	float inv[16];
+
+	inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+	inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+	inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+	inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+	inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+	inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+	inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+	inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+	inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+	inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+	inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+	inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+	inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+	inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+	inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+	inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+	float det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+	if (det == 0) return a;
+
+	mat4 result;
+	for (int i = 0; i < 16; i++) (&result.m[0][0])[i] = inv[i] / det;
+	return result;
+}
+
+// axis aligned bounding box, empty until the first Extend
+struct BoundingBox
+{
+	vec3 min, max;
+
+	BoundingBox() : min(1e30f, 1e30f, 1e30f), max(-1e30f, -1e30f, -1e30f) {}
+
+	bool IsEmpty() const { return min.x > max.x; }
+
+	void Extend(const vec3& p)
+	{
+		min.x = p.x < min.x ? p.x : min.x; max.x = p.x > max.x ? p.x : max.x;
+		min.y = p.y < min.y ? p.y : min.y; max.y = p.y > max.y ? p.y : max.y;
+		min.z = p.z < min.z ? p.z : min.z; max.z = p.z > max.z ? p.z : max.z;
+	}
+
+	void Extend(const BoundingBox& b)
+	{
+		if (b.IsEmpty()) return;
+		Extend(b.min);
+		Extend(b.max);
+	}
+
+	bool Contains(const vec3& p) const
+	{
+		return p.x >= min.x && p.x <= max.x && p.y >= min.y && p.y <= max.y && p.z >= min.z && p.z <= max.z;
+	}
+
+	vec3 GetCenter() const { return vec3((min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f, (min.z + max.z) * 0.5f); }
+
+	// box around the eight corners transformed by M (row vectors, p * M)
+	BoundingBox Transform(const mat4& M) const
+	{
+		BoundingBox result;
+		if (IsEmpty()) return result;
+		for (int i = 0; i < 8; i++)
+		{
+			vec4 corner = vec4(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z, 1.0) * M;
+			result.Extend(vec3(corner.v[0], corner.v[1], corner.v[2]));
+		}
+		return result;
+	}
+};
+
+// the six clip planes of a view-projection matrix (row vectors, p * VP), normalized,
+// with the inside where dot(n, p) + d >= 0
+struct Frustum
+{
+	float planes[6][4];
+
+	Frustum(const mat4& VP)
+	{
+		for (int i = 0; i < 6; i++)
+		{
+			int axis = i / 2;
+			float sign = i % 2 ? -1.0f : 1.0f;
+			float length = 0.0f;
+			for (int k = 0; k < 4; k++)
+			{
+				planes[i][k] = VP.m[k][3] + sign * VP.m[k][axis];
+				if (k < 3) length += planes[i][k] * planes[i][k];
+			}
+			length = sqrt(length);
+			for (int k = 0; k < 4; k++) planes[i][k] /= length;
+		}
+	}
+
+	bool IntersectsSphere(const vec3& center, float radius) const
+	{
+		for (int i = 0; i < 6; i++)
+			if (planes[i][0] * center.x + planes[i][1] * center.y + planes[i][2] * center.z + planes[i][3] < -radius) return false;
+		return true;
+	}
+
+	// against the corner furthest along each plane's normal
+	bool IntersectsBox(const BoundingBox& box) const
+	{
+		for (int i = 0; i < 6; i++)
+		{
+			float x = planes[i][0] > 0.0f ? box.max.x : box.min.x;
+			float y = planes[i][1] > 0.0f ? box.max.y : box.min.y;
+			float z = planes[i][2] > 0.0f ? box.max.z : box.min.z;
+			if (planes[i][0] * x + planes[i][1] * y + planes[i][2] * z + planes[i][3] < 0.0f) return false;
+		}
+		return true;
+	}
+};
+
+#endif
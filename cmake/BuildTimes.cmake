@@ -0,0 +1,86 @@
+# Times a clean build of the project and the rebuild after touching each of a list of
+# files, in a separate build directory, and writes the results as JSON.
+#   cmake -DSOURCE_DIR=<src> -DBINARY_DIR=<dir> -DOUTPUT=<json> [-DGENERATOR=<gen>]
+#         [-DBUILD_TYPE=<type>] [-DLTO=ON|OFF] [-DJOBS=<n>] [-DFILES=a.cpp;b.h] -P BuildTimes.cmake
+# Touched files keep their contents, only their modification times change. With LTO the
+# link steps dominate the incremental times.
+
+cmake_minimum_required(VERSION 3.13)
+
+foreach(required SOURCE_DIR BINARY_DIR OUTPUT)
+	if(NOT ${required})
+		message(FATAL_ERROR "BuildTimes.cmake needs -D${required}=...")
+	endif()
+endforeach()
+if(NOT BUILD_TYPE)
+	set(BUILD_TYPE Release)
+endif()
+if(NOT DEFINED LTO)
+	set(LTO ON)
+endif()
+if(NOT JOBS)
+	cmake_host_system_information(RESULT JOBS QUERY NUMBER_OF_LOGICAL_CORES)
+endif()
+if(NOT FILES)
+	# each library source, a front end, and headers with few and many includers
+	set(FILES ObjMesh.cpp RenderOptions.cpp Renderer.cpp Headless.cpp MeshLoader.cpp Renderer.h VectorMath.h)
+endif()
+
+# microseconds where TIMESTAMP has them (CMake 3.23), else whole seconds
+function(now result)
+	if(CMAKE_VERSION VERSION_LESS 3.23)
+		string(TIMESTAMP seconds "%s")
+		set(${result} "${seconds}000000" PARENT_SCOPE)
+	else()
+		string(TIMESTAMP microseconds "%s%f")
+		set(${result} ${microseconds} PARENT_SCOPE)
+	endif()
+endfunction()
+
+function(timed_build result)
+	now(start)
+	execute_process(COMMAND ${CMAKE_COMMAND} --build ${BINARY_DIR} -j ${JOBS} ${ARGN}
+		RESULT_VARIABLE failed OUTPUT_QUIET)
+	now(end)
+	if(failed)
+		message(FATAL_ERROR "build failed in ${BINARY_DIR}")
+	endif()
+	math(EXPR milliseconds "(${end} - ${start}) / 1000")
+	set(${result} ${milliseconds} PARENT_SCOPE)
+endfunction()
+
+set(generatorArguments)
+if(GENERATOR)
+	set(generatorArguments -G ${GENERATOR})
+endif()
+execute_process(COMMAND ${CMAKE_COMMAND} -S ${SOURCE_DIR} -B ${BINARY_DIR} ${generatorArguments}
+	-DCMAKE_BUILD_TYPE=${BUILD_TYPE} -DMESHLOADER_LTO=${LTO} RESULT_VARIABLE failed OUTPUT_QUIET)
+if(failed)
+	message(FATAL_ERROR "cannot configure ${BINARY_DIR}")
+endif()
+
+execute_process(COMMAND ${CMAKE_COMMAND} --build ${BINARY_DIR} --target clean OUTPUT_QUIET)
+timed_build(fullBuild)
+message(STATUS "clean build: ${fullBuild} ms")
+timed_build(nullBuild)
+message(STATUS "no-op build: ${nullBuild} ms")
+
+set(incremental)
+foreach(file ${FILES})
+	if(NOT EXISTS ${SOURCE_DIR}/${file})
+		message(STATUS "skipping missing ${file}")
+		continue()
+	endif()
+	file(TOUCH_NOCREATE ${SOURCE_DIR}/${file})
+	timed_build(rebuild)
+	message(STATUS "touch ${file}: ${rebuild} ms")
+	if(incremental)
+		string(APPEND incremental ",\n")
+	endif()
+	string(APPEND incremental "    \"${file}\": ${rebuild}")
+endforeach()
+
+string(TIMESTAMP date "%Y-%m-%dT%H:%M:%S")
+file(WRITE ${OUTPUT} "{\n  \"date\": \"${date}\",\n  \"build_type\": \"${BUILD_TYPE}\",\n  \"lto\": \"${LTO}\",\n  \"jobs\": ${JOBS},\n"
+	"  \"clean_build_ms\": ${fullBuild},\n  \"noop_build_ms\": ${nullBuild},\n  \"incremental_ms\": {\n${incremental}\n  }\n}\n")
+message(STATUS "build times written to ${OUTPUT}")